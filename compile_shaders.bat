@@ -15,4 +15,22 @@ glslc ./src/Shaders/shader.frag -o %out_path%Shaders/frag.spv -std=%version%
 spirv-link %out_path%Shaders/vert.spv %out_path%Shaders/frag.spv -o %out_path%Shaders/shader.spv
 
 del %out_path%Shaders\vert.spv
-del %out_path%Shaders\frag.spv
\ No newline at end of file
+del %out_path%Shaders\frag.spv
+
+glslc ./src/Shaders/mesh.vert -o %out_path%Shaders/vert.spv -std=%version%
+glslc ./src/Shaders/mesh.frag -o %out_path%Shaders/frag.spv -std=%version%
+
+spirv-link %out_path%Shaders/vert.spv %out_path%Shaders/frag.spv -o %out_path%Shaders/mesh.spv
+
+del %out_path%Shaders\vert.spv
+del %out_path%Shaders\frag.spv
+
+glslc ./src/Shaders/particles.vert -o %out_path%Shaders/vert.spv -std=%version%
+glslc ./src/Shaders/particles.frag -o %out_path%Shaders/frag.spv -std=%version%
+
+spirv-link %out_path%Shaders/vert.spv %out_path%Shaders/frag.spv -o %out_path%Shaders/particles.spv
+
+del %out_path%Shaders\vert.spv
+del %out_path%Shaders\frag.spv
+
+glslc ./src/Shaders/particles.comp -o %out_path%Shaders/particles_simulate.spv -std=%version%
\ No newline at end of file
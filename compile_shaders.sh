@@ -0,0 +1,36 @@
+#!/bin/sh
+
+out_path=$1
+version=460core
+
+if [ ! -d "${out_path}Shaders" ]; then
+    mkdir -p "${out_path}Shaders"
+else
+    rm -f "${out_path}"Shaders/*.spv
+fi
+
+glslc ./src/Shaders/shader.vert -o "${out_path}Shaders/vert.spv" -std=$version
+glslc ./src/Shaders/shader.frag -o "${out_path}Shaders/frag.spv" -std=$version
+
+spirv-link "${out_path}Shaders/vert.spv" "${out_path}Shaders/frag.spv" -o "${out_path}Shaders/shader.spv"
+
+rm "${out_path}Shaders/vert.spv"
+rm "${out_path}Shaders/frag.spv"
+
+glslc ./src/Shaders/mesh.vert -o "${out_path}Shaders/vert.spv" -std=$version
+glslc ./src/Shaders/mesh.frag -o "${out_path}Shaders/frag.spv" -std=$version
+
+spirv-link "${out_path}Shaders/vert.spv" "${out_path}Shaders/frag.spv" -o "${out_path}Shaders/mesh.spv"
+
+rm "${out_path}Shaders/vert.spv"
+rm "${out_path}Shaders/frag.spv"
+
+glslc ./src/Shaders/particles.vert -o "${out_path}Shaders/vert.spv" -std=$version
+glslc ./src/Shaders/particles.frag -o "${out_path}Shaders/frag.spv" -std=$version
+
+spirv-link "${out_path}Shaders/vert.spv" "${out_path}Shaders/frag.spv" -o "${out_path}Shaders/particles.spv"
+
+rm "${out_path}Shaders/vert.spv"
+rm "${out_path}Shaders/frag.spv"
+
+glslc ./src/Shaders/particles.comp -o "${out_path}Shaders/particles_simulate.spv" -std=$version
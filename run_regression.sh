@@ -0,0 +1,22 @@
+#!/bin/sh
+#
+# Headless regression run of the triangle against the references in regression/, on lavapipe.
+# Build ./ladybug and the shaders first (see README.md). Extra arguments are passed on: -update (re)writes the
+# references from this run, -perfgate makes a performance regression fail the run instead of only being reported.
+# The exit code is non-zero when a check fails or the golden is missing.
+#
+# The references have to come from the lavapipe machine that runs the checks: run with -update there and commit
+# regression/triangle.png and regression/lavapipe_baseline.txt.
+#
+
+binary=${LADYBUG:-./ladybug}
+icd=${VK_ICD_FILENAMES:-/usr/share/vulkan/icd.d/lvp_icd.x86_64.json}
+
+if [ ! -f "$icd" ]; then
+    echo "lavapipe ICD not found at $icd, set VK_ICD_FILENAMES"
+    exit 1
+fi
+
+mkdir -p regression
+VK_ICD_FILENAMES="$icd" exec "$binary" -headless -frames 60 \
+    -golden regression/triangle.png -baseline regression/lavapipe_baseline.txt "$@"
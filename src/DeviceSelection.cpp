@@ -0,0 +1,477 @@
+//
+// Physical device scoring and the optional startup benchmark probe.
+//
+// Devices that don't meet the hard requirements (queue family, surface, timeline semaphores) never get here,
+// the score only decides between usable devices. With probing enabled every candidate runs a short offscreen
+// clear/copy benchmark, the results are cached by device UUID so that each device is only probed once. The probe
+// only ranks devices of the same type: a memory copy benchmark says little about rendering, and a fast CPU running
+// a software rasterizer must not win over a GPU because of it.
+//
+
+constexpr const char* DeviceProbeCachePath = "device_probe_cache.txt";
+
+struct SDeviceCandidate
+{
+    SVulkanPhysicalDevice* Device;
+    uint32_t QueueFamilyIndex;
+    VkFormat SurfaceFormat;
+    VkColorSpaceKHR SurfaceColorSpace;
+
+    uint64_t Score;
+    // Memory throughput measured by the probe in GB/s, 0 if not probed
+    double ProbeResult;
+};
+
+struct SDeviceProbeCacheEntry
+{
+    uint8_t DeviceUUID[VK_UUID_SIZE];
+    double ProbeResult;
+};
+
+// Higher is better, devices of a lower tier are only picked when there's nothing else
+uint32_t VulkanGetDeviceTypeTier(VkPhysicalDeviceType DeviceType)
+{
+    switch(DeviceType)
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:      return 4;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:    return 3;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:       return 2;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:               return 0;
+        default:                                        return 1;
+    }
+}
+
+uint64_t VulkanScorePhysicalDevice(const SVulkanPhysicalDevice* Device)
+{
+    uint64_t Score = 0;
+
+    // Device type dominates everything else, a software rasterizer should only ever be the last resort
+    switch(Device->Properties.deviceType)
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:      Score += 100000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:    Score += 50000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:       Score += 20000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:               Score += 0; break;
+        default:                                        Score += 10000; break;
+    }
+
+    // Largest device local heap, in MiB, capped so it can't outweigh the device type
+    VkDeviceSize LargestDeviceLocalHeap = 0;
+    for(uint32_t HeapIndex = 0; HeapIndex < Device->MemoryProperties.memoryHeapCount; ++HeapIndex)
+    {
+        const VkMemoryHeap& Heap = Device->MemoryProperties.memoryHeaps[HeapIndex];
+        if(Heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            LargestDeviceLocalHeap = std::max(LargestDeviceLocalHeap, Heap.size);
+        }
+    }
+    Score += std::min<uint64_t>(LargestDeviceLocalHeap / (1024 * 1024), 32768);
+
+    // Limits
+    const VkPhysicalDeviceLimits& Limits = Device->Properties.limits;
+    Score += Limits.maxImageDimension2D / 1024;
+    // Highest MSAA sample count, the limit itself is a mask of VkSampleCountFlagBits
+    for(uint32_t SampleCount = VK_SAMPLE_COUNT_64_BIT; SampleCount > 0; SampleCount >>= 1)
+    {
+        if(Limits.framebufferColorSampleCounts & SampleCount)
+        {
+            Score += SampleCount;
+            break;
+        }
+    }
+
+    // Optional features we make use of
+    if(Device->bPresentWaitSupported || Device->bDisplayTimingSupported)
+    {
+        Score += 100;
+    }
+
+    return Score;
+}
+
+std::vector<SDeviceProbeCacheEntry> LoadDeviceProbeCache()
+{
+    std::vector<SDeviceProbeCacheEntry> Cache;
+
+    FILE* File = fopen(DeviceProbeCachePath, "r");
+    if(File)
+    {
+        char UUIDString[2 * VK_UUID_SIZE + 1];
+        double ProbeResult;
+        while(fscanf(File, "%32s %lf", UUIDString, &ProbeResult) == 2)
+        {
+            SDeviceProbeCacheEntry Entry = {};
+            for(uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+            {
+                unsigned int Byte = 0;
+                sscanf(UUIDString + 2 * i, "%2x", &Byte);
+                Entry.DeviceUUID[i] = (uint8_t)Byte;
+            }
+            Entry.ProbeResult = ProbeResult;
+            Cache.push_back(Entry);
+        }
+        fclose(File);
+    }
+
+    return Cache;
+}
+
+void SaveDeviceProbeCache(const std::vector<SDeviceProbeCacheEntry>& Cache)
+{
+    FILE* File = fopen(DeviceProbeCachePath, "w");
+    if(File)
+    {
+        for(const SDeviceProbeCacheEntry& Entry : Cache)
+        {
+            for(uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+            {
+                fprintf(File, "%02x", Entry.DeviceUUID[i]);
+            }
+            fprintf(File, " %f\n", Entry.ProbeResult);
+        }
+        fclose(File);
+    }
+    else
+    {
+        printf("Warning: couldn't write %s\n", DeviceProbeCachePath);
+    }
+}
+
+// Runs a short clear + copy benchmark on a temporary logical device, returns the achieved throughput in GB/s
+double VulkanProbePhysicalDevice(const SVulkanPhysicalDevice* PhysicalDevice, uint32_t QueueFamilyIndex)
+{
+    constexpr uint32_t ProbeImageSize = 2048;
+    constexpr uint32_t ProbeIterationCount = 16;
+    constexpr VkFormat ProbeFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+    VkResult Result = VK_SUCCESS;
+
+    VkDevice Device;
+    VkQueue Queue;
+    {
+        float QueuePriorities[1] = { 1.0f };
+        VkDeviceQueueCreateInfo QueueCreateInfo = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+        QueueCreateInfo.pNext = nullptr;
+        QueueCreateInfo.flags = 0;
+        QueueCreateInfo.queueFamilyIndex = QueueFamilyIndex;
+        QueueCreateInfo.queueCount = 1;
+        QueueCreateInfo.pQueuePriorities = QueuePriorities;
+
+        VkDeviceCreateInfo DeviceCreateInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+        DeviceCreateInfo.pNext = nullptr;
+        DeviceCreateInfo.flags = 0;
+        DeviceCreateInfo.queueCreateInfoCount = 1;
+        DeviceCreateInfo.pQueueCreateInfos = &QueueCreateInfo;
+        DeviceCreateInfo.enabledLayerCount = 0;
+        DeviceCreateInfo.ppEnabledLayerNames = nullptr;
+        DeviceCreateInfo.enabledExtensionCount = 0;
+        DeviceCreateInfo.ppEnabledExtensionNames = nullptr;
+        DeviceCreateInfo.pEnabledFeatures = nullptr;
+
+        Result = vkCreateDevice(PhysicalDevice->Device, &DeviceCreateInfo, nullptr, &Device);
+        if(Result != VK_SUCCESS)
+        {
+            return 0.0;
+        }
+        vkGetDeviceQueue(Device, QueueFamilyIndex, 0, &Queue);
+    }
+
+    // Two images in a single device local allocation
+    VkImage Images[2];
+    VkDeviceMemory Memory;
+    {
+        VkImageCreateInfo ImageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        ImageCreateInfo.pNext = nullptr;
+        ImageCreateInfo.flags = 0;
+        ImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        ImageCreateInfo.format = ProbeFormat;
+        ImageCreateInfo.extent = { ProbeImageSize, ProbeImageSize, 1 };
+        ImageCreateInfo.mipLevels = 1;
+        ImageCreateInfo.arrayLayers = 1;
+        ImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        ImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ImageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        ImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ImageCreateInfo.queueFamilyIndexCount = 0;
+        ImageCreateInfo.pQueueFamilyIndices = nullptr;
+        ImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        Result = vkCreateImage(Device, &ImageCreateInfo, nullptr, &Images[0]);
+        if(Result != VK_SUCCESS)
+        {
+            vkDestroyDevice(Device, nullptr);
+            return 0.0;
+        }
+        Result = vkCreateImage(Device, &ImageCreateInfo, nullptr, &Images[1]);
+        if(Result != VK_SUCCESS)
+        {
+            vkDestroyImage(Device, Images[0], nullptr);
+            vkDestroyDevice(Device, nullptr);
+            return 0.0;
+        }
+
+        VkMemoryRequirements MemoryRequirements;
+        vkGetImageMemoryRequirements(Device, Images[0], &MemoryRequirements);
+        VkDeviceSize ImageOffset = (MemoryRequirements.size + MemoryRequirements.alignment - 1) & ~(MemoryRequirements.alignment - 1);
+
+        VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        AllocateInfo.pNext = nullptr;
+        AllocateInfo.allocationSize = ImageOffset + MemoryRequirements.size;
+        AllocateInfo.memoryTypeIndex = VulkanFindMemoryType(&PhysicalDevice->MemoryProperties, MemoryRequirements.memoryTypeBits,
+                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if(AllocateInfo.memoryTypeIndex == UINT32_MAX)
+        {
+            AllocateInfo.memoryTypeIndex = VulkanFindMemoryType(&PhysicalDevice->MemoryProperties, MemoryRequirements.memoryTypeBits, 0);
+        }
+
+        Result = vkAllocateMemory(Device, &AllocateInfo, nullptr, &Memory);
+        if(Result != VK_SUCCESS)
+        {
+            vkDestroyImage(Device, Images[0], nullptr);
+            vkDestroyImage(Device, Images[1], nullptr);
+            vkDestroyDevice(Device, nullptr);
+            return 0.0;
+        }
+
+        vkBindImageMemory(Device, Images[0], Memory, 0);
+        vkBindImageMemory(Device, Images[1], Memory, ImageOffset);
+    }
+
+    VkCommandPool CommandPool;
+    VkCommandBuffer CommandBuffer;
+    {
+        VkCommandPoolCreateInfo CommandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        CommandPoolCreateInfo.pNext = nullptr;
+        CommandPoolCreateInfo.queueFamilyIndex = QueueFamilyIndex;
+        CommandPoolCreateInfo.flags = 0;
+        Result = vkCreateCommandPool(Device, &CommandPoolCreateInfo, nullptr, &CommandPool);
+        if(Result != VK_SUCCESS)
+        {
+            vkDestroyImage(Device, Images[0], nullptr);
+            vkDestroyImage(Device, Images[1], nullptr);
+            vkFreeMemory(Device, Memory, nullptr);
+            vkDestroyDevice(Device, nullptr);
+            return 0.0;
+        }
+
+        VkCommandBufferAllocateInfo CommandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        CommandBufferInfo.pNext = nullptr;
+        CommandBufferInfo.commandPool = CommandPool;
+        CommandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        CommandBufferInfo.commandBufferCount = 1;
+        Result = vkAllocateCommandBuffers(Device, &CommandBufferInfo, &CommandBuffer);
+        if(Result != VK_SUCCESS)
+        {
+            vkDestroyCommandPool(Device, CommandPool, nullptr);
+            vkDestroyImage(Device, Images[0], nullptr);
+            vkDestroyImage(Device, Images[1], nullptr);
+            vkFreeMemory(Device, Memory, nullptr);
+            vkDestroyDevice(Device, nullptr);
+            return 0.0;
+        }
+    }
+
+    // GPU timestamps if the queue supports them, CPU time around the submission otherwise
+    bool bUseTimestamps = PhysicalDevice->QueueFamilies[QueueFamilyIndex].timestampValidBits != 0 &&
+                          PhysicalDevice->Properties.limits.timestampPeriod > 0.0f;
+    VkQueryPool QueryPool = VK_NULL_HANDLE;
+    if(bUseTimestamps)
+    {
+        VkQueryPoolCreateInfo QueryPoolCreateInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        QueryPoolCreateInfo.pNext = nullptr;
+        QueryPoolCreateInfo.flags = 0;
+        QueryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        QueryPoolCreateInfo.queryCount = 2;
+        QueryPoolCreateInfo.pipelineStatistics = 0;
+        Result = vkCreateQueryPool(Device, &QueryPoolCreateInfo, nullptr, &QueryPool);
+        if(Result != VK_SUCCESS)
+        {
+            vkDestroyCommandPool(Device, CommandPool, nullptr);
+            vkDestroyImage(Device, Images[0], nullptr);
+            vkDestroyImage(Device, Images[1], nullptr);
+            vkFreeMemory(Device, Memory, nullptr);
+            vkDestroyDevice(Device, nullptr);
+            return 0.0;
+        }
+    }
+
+    VkCommandBufferBeginInfo BeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    BeginInfo.pNext = nullptr;
+    BeginInfo.flags = 0;
+    BeginInfo.pInheritanceInfo = nullptr;
+    vkBeginCommandBuffer(CommandBuffer, &BeginInfo);
+    {
+        VkImageSubresourceRange Range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        VkImageMemoryBarrier InitialBarriers[2];
+        for(uint32_t ImageIndex = 0; ImageIndex < 2; ++ImageIndex)
+        {
+            VkImageMemoryBarrier& Barrier = InitialBarriers[ImageIndex];
+            Barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+            Barrier.srcAccessMask = 0;
+            Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            Barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            Barrier.image = Images[ImageIndex];
+            Barrier.subresourceRange = Range;
+        }
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 2, InitialBarriers);
+
+        if(bUseTimestamps)
+        {
+            vkCmdResetQueryPool(CommandBuffer, QueryPool, 0, 2);
+            vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, QueryPool, 0);
+        }
+
+        VkMemoryBarrier TransferBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        TransferBarrier.pNext = nullptr;
+        TransferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        TransferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        VkImageCopy Region = {};
+        Region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        Region.srcOffset = { 0, 0, 0 };
+        Region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        Region.dstOffset = { 0, 0, 0 };
+        Region.extent = { ProbeImageSize, ProbeImageSize, 1 };
+
+        for(uint32_t Iteration = 0; Iteration < ProbeIterationCount; ++Iteration)
+        {
+            VkClearColorValue ClearColor = {};
+            ClearColor.float32[0] = (float)Iteration / ProbeIterationCount;
+            vkCmdClearColorImage(CommandBuffer, Images[0], VK_IMAGE_LAYOUT_GENERAL, &ClearColor, 1, &Range);
+            vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 1, &TransferBarrier, 0, nullptr, 0, nullptr);
+            vkCmdCopyImage(CommandBuffer, Images[0], VK_IMAGE_LAYOUT_GENERAL, Images[1], VK_IMAGE_LAYOUT_GENERAL, 1, &Region);
+            vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 1, &TransferBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        if(bUseTimestamps)
+        {
+            vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, QueryPool, 1);
+        }
+    }
+    vkEndCommandBuffer(CommandBuffer);
+
+    VkSubmitInfo SubmitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    SubmitInfo.pNext = nullptr;
+    SubmitInfo.commandBufferCount = 1;
+    SubmitInfo.pCommandBuffers = &CommandBuffer;
+
+    // The probe device is thrown away right after, so idling the queue is fine here
+    uint64_t BeginTime = PlatformGetTimeNs();
+    vkQueueSubmit(Queue, 1, &SubmitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(Queue);
+    uint64_t EndTime = PlatformGetTimeNs();
+
+    double ElapsedSeconds = (double)(EndTime - BeginTime) / 1e9;
+    if(bUseTimestamps)
+    {
+        uint64_t Timestamps[2] = {};
+        Result = vkGetQueryPoolResults(Device, QueryPool, 0, 2, sizeof(Timestamps), Timestamps, sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        if(Result == VK_SUCCESS && Timestamps[1] > Timestamps[0])
+        {
+            ElapsedSeconds = (double)(Timestamps[1] - Timestamps[0]) * PhysicalDevice->Properties.limits.timestampPeriod / 1e9;
+        }
+    }
+
+    // Each iteration clears one image (1 write) and copies it into the other (1 read + 1 write)
+    double BytesMoved = 3.0 * ProbeIterationCount * ProbeImageSize * ProbeImageSize * 4.0;
+    double Throughput = (ElapsedSeconds > 0.0) ? (BytesMoved / ElapsedSeconds) / 1e9 : 0.0;
+
+    if(QueryPool)
+    {
+        vkDestroyQueryPool(Device, QueryPool, nullptr);
+    }
+    vkDestroyCommandPool(Device, CommandPool, nullptr);
+    vkDestroyImage(Device, Images[0], nullptr);
+    vkDestroyImage(Device, Images[1], nullptr);
+    vkFreeMemory(Device, Memory, nullptr);
+    vkDestroyDevice(Device, nullptr);
+
+    return Throughput;
+}
+
+// Returns the index of the best candidate
+uint32_t VulkanSelectDeviceCandidate(std::vector<SDeviceCandidate>& Candidates, bool bProbe)
+{
+    assert(!Candidates.empty());
+
+    for(SDeviceCandidate& Candidate : Candidates)
+    {
+        Candidate.Score = VulkanScorePhysicalDevice(Candidate.Device);
+    }
+
+    if(bProbe && Candidates.size() > 1)
+    {
+        std::vector<SDeviceProbeCacheEntry> Cache = LoadDeviceProbeCache();
+        bool bCacheChanged = false;
+
+        for(SDeviceCandidate& Candidate : Candidates)
+        {
+            const SDeviceProbeCacheEntry* CachedEntry = nullptr;
+            for(const SDeviceProbeCacheEntry& Entry : Cache)
+            {
+                if(memcmp(Entry.DeviceUUID, Candidate.Device->DeviceUUID, VK_UUID_SIZE) == 0)
+                {
+                    CachedEntry = &Entry;
+                    break;
+                }
+            }
+
+            if(CachedEntry)
+            {
+                Candidate.ProbeResult = CachedEntry->ProbeResult;
+            }
+            else
+            {
+                Candidate.ProbeResult = VulkanProbePhysicalDevice(Candidate.Device, Candidate.QueueFamilyIndex);
+
+                SDeviceProbeCacheEntry Entry = {};
+                memcpy(Entry.DeviceUUID, Candidate.Device->DeviceUUID, VK_UUID_SIZE);
+                Entry.ProbeResult = Candidate.ProbeResult;
+                Cache.push_back(Entry);
+                bCacheChanged = true;
+            }
+        }
+
+        if(bCacheChanged)
+        {
+            SaveDeviceProbeCache(Cache);
+        }
+    }
+
+    uint32_t BestIndex = 0;
+    for(uint32_t CandidateIndex = 0; CandidateIndex < Candidates.size(); ++CandidateIndex)
+    {
+        const SDeviceCandidate& Candidate = Candidates[CandidateIndex];
+        const SDeviceCandidate& Best = Candidates[BestIndex];
+
+        printf("Device candidate %s: score %" PRIu64 ", probe %.2f GB/s\n",
+               Candidate.Device->Properties.deviceName, Candidate.Score, Candidate.ProbeResult);
+
+        // The device type decides first, within a type the measured throughput wins when we have it and the
+        // static score breaks ties and covers the unprobed case
+        uint32_t CandidateTier = VulkanGetDeviceTypeTier(Candidate.Device->Properties.deviceType);
+        uint32_t BestTier = VulkanGetDeviceTypeTier(Best.Device->Properties.deviceType);
+        if(CandidateTier != BestTier)
+        {
+            if(CandidateTier > BestTier)
+            {
+                BestIndex = CandidateIndex;
+            }
+        }
+        else if(Candidate.ProbeResult > Best.ProbeResult ||
+                (Candidate.ProbeResult == Best.ProbeResult && Candidate.Score > Best.Score))
+        {
+            BestIndex = CandidateIndex;
+        }
+    }
+
+    return BestIndex;
+}
@@ -0,0 +1,422 @@
+//
+// Sorted draw submission.
+//
+// Draws aren't recorded where they're produced: each one is emitted as a packet (geometry, draw size, push constants)
+// with a 64-bit sort key, from the top bit down:
+//
+//   pass (4) | pipeline (12) | material (16) | depth (32)
+//
+// The keys are radix sorted every frame and the packets are recorded in key order, so draws sharing a pipeline and a
+// material end up next to each other and opaque draws go front to back. Recording only binds what differs from the
+// previous packet in the same command buffer (pipeline, descriptor set, vertex and index buffer), the skipped binds
+// are what the sorting buys. Pipelines and materials are turned into key bits by small per-frame tables, indices are
+// handed out in order of first use.
+//
+// Emitting is thread safe once the slots are reserved: DrawQueueReserve hands out a range of packets (and their push
+// constant storage) that jobs then fill with DrawQueueWrite. The sorted packets are recorded in ranges by jobs, one
+// secondary command buffer each; every range starts with nothing bound.
+//
+// Binds are counted per frame, together with how many there would have been when recording in emission order.
+//
+
+enum EDrawPass
+{
+    DrawPass_Opaque,
+    // Back to front
+    DrawPass_Transparent,
+
+    DrawPass_Count,
+};
+
+constexpr uint32_t DrawKeyDepthBits = 32;
+constexpr uint32_t DrawKeyMaterialBits = 16;
+constexpr uint32_t DrawKeyPipelineBits = 12;
+constexpr uint32_t DrawKeyPassBits = 4;
+static_assert(DrawKeyDepthBits + DrawKeyMaterialBits + DrawKeyPipelineBits + DrawKeyPassBits == 64, "Sort key has to fill 64 bits");
+
+constexpr uint32_t DrawKeyMaterialShift = DrawKeyDepthBits;
+constexpr uint32_t DrawKeyPipelineShift = DrawKeyMaterialShift + DrawKeyMaterialBits;
+constexpr uint32_t DrawKeyPassShift = DrawKeyPipelineShift + DrawKeyPipelineBits;
+
+// Pipeline state a packet's key refers to
+struct SDrawPipeline
+{
+    VkPipeline Pipeline;
+    VkPipelineLayout Layout;
+    VkShaderStageFlags PushConstantStages;
+};
+
+struct SDrawPacket
+{
+    // VK_NULL_HANDLE when the pipeline has no vertex input
+    VkBuffer VertexBuffer;
+    // VK_NULL_HANDLE for non-indexed draws
+    VkBuffer IndexBuffer;
+    VkDeviceSize IndexOffset;
+    VkIndexType IndexType;
+    // Vertices or indices
+    uint32_t Count;
+
+    // Set by DrawQueueReserve
+    uint32_t PushConstantOffset;
+    uint32_t PushConstantSize;
+};
+
+struct SDrawSortEntry
+{
+    uint64_t Key;
+    uint32_t PacketIndex;
+};
+
+struct SDrawBindStats
+{
+    uint64_t DrawCount;
+    uint64_t PipelineBindCount;
+    uint64_t DescriptorSetBindCount;
+    uint64_t VertexBufferBindCount;
+    uint64_t IndexBufferBindCount;
+};
+
+// What's bound in the command buffer being recorded
+struct SDrawBindState
+{
+    uint32_t PipelineIndex;
+    uint32_t MaterialIndex;
+    VkBuffer VertexBuffer;
+    VkBuffer IndexBuffer;
+    VkDeviceSize IndexOffset;
+};
+
+enum EDrawBind
+{
+    DrawBind_Pipeline = 1 << 0,
+    DrawBind_DescriptorSet = 1 << 1,
+    DrawBind_VertexBuffer = 1 << 2,
+    DrawBind_IndexBuffer = 1 << 3,
+};
+
+struct SDrawQueue
+{
+    // Per frame tables, indexed by the key bits
+    std::vector<SDrawPipeline> Pipelines;
+    std::vector<VkDescriptorSet> Materials;
+
+    std::vector<SDrawPacket> Packets;
+    std::vector<uint8_t> PushConstantData;
+    // Sorted by DrawQueueSort, SortScratch is the other half of the radix sort's ping-pong
+    std::vector<SDrawSortEntry> SortEntries;
+    std::vector<SDrawSortEntry> SortScratch;
+
+    // Recording ranges, each job writes its own stats
+    uint32_t DrawsPerJob;
+    uint32_t JobCount;
+    std::vector<SDrawBindStats> JobStats;
+
+    // Totals over every frame that had draws
+    uint32_t FrameCount;
+    uint64_t SortTimeNs;
+    SDrawBindStats Stats;
+    SDrawBindStats EmissionOrderStats;
+};
+
+void DrawQueueBeginFrame(SDrawQueue* Queue)
+{
+    Queue->Pipelines.clear();
+    Queue->Materials.clear();
+    Queue->Packets.clear();
+    Queue->PushConstantData.clear();
+    Queue->SortEntries.clear();
+    Queue->JobCount = 0;
+}
+
+// Pipeline key bits, the same pipeline always gets the same index within a frame
+uint32_t DrawQueueGetPipeline(SDrawQueue* Queue, VkPipeline Pipeline, VkPipelineLayout Layout, VkShaderStageFlags PushConstantStages)
+{
+    for(uint32_t PipelineIndex = 0; PipelineIndex < Queue->Pipelines.size(); ++PipelineIndex)
+    {
+        if(Queue->Pipelines[PipelineIndex].Pipeline == Pipeline)
+        {
+            return PipelineIndex;
+        }
+    }
+
+    assert(Queue->Pipelines.size() < (1u << DrawKeyPipelineBits));
+    Queue->Pipelines.push_back({ Pipeline, Layout, PushConstantStages });
+    return (uint32_t)Queue->Pipelines.size() - 1;
+}
+
+// Material key bits, a material is the descriptor set bound at set 0. Linear search, there are few of them and
+// draws of the same material are usually emitted together.
+uint32_t DrawQueueGetMaterial(SDrawQueue* Queue, VkDescriptorSet DescriptorSet)
+{
+    for(uint32_t MaterialIndex = (uint32_t)Queue->Materials.size(); MaterialIndex > 0; --MaterialIndex)
+    {
+        if(Queue->Materials[MaterialIndex - 1] == DescriptorSet)
+        {
+            return MaterialIndex - 1;
+        }
+    }
+
+    assert(Queue->Materials.size() < (1u << DrawKeyMaterialBits));
+    Queue->Materials.push_back(DescriptorSet);
+    return (uint32_t)Queue->Materials.size() - 1;
+}
+
+// Depth is the view space distance, the bits of a non-negative float sort like the float itself
+uint64_t DrawQueueMakeKey(EDrawPass Pass, uint32_t PipelineIndex, uint32_t MaterialIndex, float Depth)
+{
+    uint32_t DepthBits;
+    Depth = std::max(Depth, 0.0f);
+    memcpy(&DepthBits, &Depth, sizeof(DepthBits));
+    if(Pass == DrawPass_Transparent)
+    {
+        DepthBits = ~DepthBits;
+    }
+
+    return ((uint64_t)Pass << DrawKeyPassShift) |
+           ((uint64_t)PipelineIndex << DrawKeyPipelineShift) |
+           ((uint64_t)MaterialIndex << DrawKeyMaterialShift) |
+           (uint64_t)DepthBits;
+}
+
+// Reserves Count packets with PushConstantSize bytes of push constants each, returns the first packet's index
+uint32_t DrawQueueReserve(SDrawQueue* Queue, uint32_t Count, uint32_t PushConstantSize)
+{
+    uint32_t FirstPacket = (uint32_t)Queue->Packets.size();
+    uint32_t PushConstantOffset = (uint32_t)Queue->PushConstantData.size();
+
+    Queue->Packets.resize(FirstPacket + Count);
+    Queue->SortEntries.resize(FirstPacket + Count);
+    Queue->PushConstantData.resize(PushConstantOffset + (size_t)Count * PushConstantSize);
+    for(uint32_t PacketIndex = FirstPacket; PacketIndex < FirstPacket + Count; ++PacketIndex)
+    {
+        Queue->Packets[PacketIndex].PushConstantOffset = PushConstantOffset;
+        Queue->Packets[PacketIndex].PushConstantSize = PushConstantSize;
+        PushConstantOffset += PushConstantSize;
+    }
+    return FirstPacket;
+}
+
+// Fills a reserved packet, returns where its push constants go. Different packets can be written from different threads.
+void* DrawQueueWrite(SDrawQueue* Queue, uint32_t PacketIndex, uint64_t Key, const SDrawPacket* Packet)
+{
+    SDrawPacket& Destination = Queue->Packets[PacketIndex];
+    uint32_t PushConstantOffset = Destination.PushConstantOffset;
+    uint32_t PushConstantSize = Destination.PushConstantSize;
+    Destination = *Packet;
+    Destination.PushConstantOffset = PushConstantOffset;
+    Destination.PushConstantSize = PushConstantSize;
+
+    Queue->SortEntries[PacketIndex] = { Key, PacketIndex };
+    return Queue->PushConstantData.data() + PushConstantOffset;
+}
+
+// Applies a packet to the bound state, returns the binds (EDrawBind) it needs
+static uint32_t DrawQueueUpdateBindState(SDrawBindState* State, uint64_t Key, const SDrawPacket* Packet, SDrawBindStats* Stats)
+{
+    uint32_t PipelineIndex = (uint32_t)(Key >> DrawKeyPipelineShift) & ((1u << DrawKeyPipelineBits) - 1);
+    uint32_t MaterialIndex = (uint32_t)(Key >> DrawKeyMaterialShift) & ((1u << DrawKeyMaterialBits) - 1);
+
+    uint32_t Binds = 0;
+    if(PipelineIndex != State->PipelineIndex)
+    {
+        // The descriptor set is rebound as well, the layouts aren't necessarily compatible
+        Binds |= DrawBind_Pipeline;
+        State->PipelineIndex = PipelineIndex;
+        State->MaterialIndex = UINT32_MAX;
+        Stats->PipelineBindCount++;
+    }
+    if(MaterialIndex != State->MaterialIndex)
+    {
+        Binds |= DrawBind_DescriptorSet;
+        State->MaterialIndex = MaterialIndex;
+        Stats->DescriptorSetBindCount++;
+    }
+    if(Packet->VertexBuffer != VK_NULL_HANDLE && Packet->VertexBuffer != State->VertexBuffer)
+    {
+        Binds |= DrawBind_VertexBuffer;
+        State->VertexBuffer = Packet->VertexBuffer;
+        Stats->VertexBufferBindCount++;
+    }
+    if(Packet->IndexBuffer != VK_NULL_HANDLE && (Packet->IndexBuffer != State->IndexBuffer || Packet->IndexOffset != State->IndexOffset))
+    {
+        Binds |= DrawBind_IndexBuffer;
+        State->IndexBuffer = Packet->IndexBuffer;
+        State->IndexOffset = Packet->IndexOffset;
+        Stats->IndexBufferBindCount++;
+    }
+    Stats->DrawCount++;
+    return Binds;
+}
+
+static void DrawQueueAddStats(SDrawBindStats* Stats, const SDrawBindStats* Other)
+{
+    Stats->DrawCount += Other->DrawCount;
+    Stats->PipelineBindCount += Other->PipelineBindCount;
+    Stats->DescriptorSetBindCount += Other->DescriptorSetBindCount;
+    Stats->VertexBufferBindCount += Other->VertexBufferBindCount;
+    Stats->IndexBufferBindCount += Other->IndexBufferBindCount;
+}
+
+// LSD radix sort of the keys, 8 bits per pass. All 8 histograms are built in one pass over the keys and the passes
+// where every key has the same digit are skipped, usually most of them: within a frame the pass, pipeline and
+// material bits barely vary. Stable, draws with equal keys stay in emission order.
+static void DrawQueueRadixSort(SDrawQueue* Queue)
+{
+    uint32_t Count = (uint32_t)Queue->SortEntries.size();
+    Queue->SortScratch.resize(Count);
+
+    uint32_t Histograms[8][256] = {};
+    for(const SDrawSortEntry& Entry : Queue->SortEntries)
+    {
+        for(uint32_t Digit = 0; Digit < 8; ++Digit)
+        {
+            Histograms[Digit][(Entry.Key >> (8 * Digit)) & 0xFF]++;
+        }
+    }
+
+    SDrawSortEntry* Source = Queue->SortEntries.data();
+    SDrawSortEntry* Destination = Queue->SortScratch.data();
+    for(uint32_t Digit = 0; Digit < 8; ++Digit)
+    {
+        uint32_t* Histogram = Histograms[Digit];
+        if(Histogram[(Source[0].Key >> (8 * Digit)) & 0xFF] == Count)
+        {
+            continue;
+        }
+
+        // Counts to offsets
+        uint32_t Offset = 0;
+        for(uint32_t Bucket = 0; Bucket < 256; ++Bucket)
+        {
+            uint32_t BucketCount = Histogram[Bucket];
+            Histogram[Bucket] = Offset;
+            Offset += BucketCount;
+        }
+
+        for(uint32_t EntryIndex = 0; EntryIndex < Count; ++EntryIndex)
+        {
+            const SDrawSortEntry& Entry = Source[EntryIndex];
+            Destination[Histogram[(Entry.Key >> (8 * Digit)) & 0xFF]++] = Entry;
+        }
+        std::swap(Source, Destination);
+    }
+
+    if(Source != Queue->SortEntries.data())
+    {
+        Queue->SortEntries.swap(Queue->SortScratch);
+    }
+}
+
+// Sorts the frame's packets and splits them into recording ranges of DrawsPerJob
+void DrawQueueSort(SDrawQueue* Queue, uint32_t DrawsPerJob)
+{
+    uint32_t Count = (uint32_t)Queue->SortEntries.size();
+    Queue->DrawsPerJob = DrawsPerJob;
+    Queue->JobCount = (Count + DrawsPerJob - 1) / DrawsPerJob;
+    Queue->JobStats.assign(Queue->JobCount, {});
+    if(Count == 0)
+    {
+        return;
+    }
+
+    // Binds with the same ranges in emission order, for comparison
+    for(uint32_t First = 0; First < Count; First += DrawsPerJob)
+    {
+        SDrawBindState State = { UINT32_MAX, UINT32_MAX, VK_NULL_HANDLE, VK_NULL_HANDLE, 0 };
+        for(uint32_t PacketIndex = First; PacketIndex < std::min(First + DrawsPerJob, Count); ++PacketIndex)
+        {
+            DrawQueueUpdateBindState(&State, Queue->SortEntries[PacketIndex].Key, &Queue->Packets[PacketIndex], &Queue->EmissionOrderStats);
+        }
+    }
+
+    uint64_t SortStartTime = PlatformGetTimeNs();
+    DrawQueueRadixSort(Queue);
+    Queue->SortTimeNs += PlatformGetTimeNs() - SortStartTime;
+}
+
+// Records a sorted range into a command buffer that is inside the render pass
+void DrawQueueRecord(SDrawQueue* Queue, VkCommandBuffer CommandBuffer, uint32_t JobIndex)
+{
+    SDrawBindStats* Stats = &Queue->JobStats[JobIndex];
+    SDrawBindState State = { UINT32_MAX, UINT32_MAX, VK_NULL_HANDLE, VK_NULL_HANDLE, 0 };
+
+    uint32_t FirstEntry = JobIndex * Queue->DrawsPerJob;
+    uint32_t EndEntry = std::min(FirstEntry + Queue->DrawsPerJob, (uint32_t)Queue->SortEntries.size());
+    for(uint32_t EntryIndex = FirstEntry; EntryIndex < EndEntry; ++EntryIndex)
+    {
+        const SDrawSortEntry& Entry = Queue->SortEntries[EntryIndex];
+        const SDrawPacket* Packet = &Queue->Packets[Entry.PacketIndex];
+
+        uint32_t Binds = DrawQueueUpdateBindState(&State, Entry.Key, Packet, Stats);
+        const SDrawPipeline* Pipeline = &Queue->Pipelines[State.PipelineIndex];
+        if(Binds & DrawBind_Pipeline)
+        {
+            vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Pipeline);
+        }
+        if(Binds & DrawBind_DescriptorSet)
+        {
+            vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline->Layout, 0, 1, &Queue->Materials[State.MaterialIndex], 0, nullptr);
+        }
+        if(Binds & DrawBind_VertexBuffer)
+        {
+            VkDeviceSize VertexOffset = 0;
+            vkCmdBindVertexBuffers(CommandBuffer, 0, 1, &Packet->VertexBuffer, &VertexOffset);
+        }
+        if(Binds & DrawBind_IndexBuffer)
+        {
+            vkCmdBindIndexBuffer(CommandBuffer, Packet->IndexBuffer, Packet->IndexOffset, Packet->IndexType);
+        }
+
+        if(Packet->PushConstantSize)
+        {
+            vkCmdPushConstants(CommandBuffer, Pipeline->Layout, Pipeline->PushConstantStages, 0, Packet->PushConstantSize,
+                               Queue->PushConstantData.data() + Packet->PushConstantOffset);
+        }
+
+        if(Packet->IndexBuffer != VK_NULL_HANDLE)
+        {
+            vkCmdDrawIndexed(CommandBuffer, Packet->Count, 1, 0, 0, 0);
+        }
+        else
+        {
+            vkCmdDraw(CommandBuffer, Packet->Count, 1, 0, 0);
+        }
+    }
+}
+
+// After the record jobs are done
+void DrawQueueEndFrame(SDrawQueue* Queue)
+{
+    if(Queue->JobCount == 0)
+    {
+        return;
+    }
+
+    for(const SDrawBindStats& JobStats : Queue->JobStats)
+    {
+        DrawQueueAddStats(&Queue->Stats, &JobStats);
+    }
+    Queue->FrameCount++;
+}
+
+void DrawQueuePrintStats(const SDrawQueue* Queue)
+{
+    if(Queue->FrameCount == 0)
+    {
+        return;
+    }
+
+    double FrameCount = (double)Queue->FrameCount;
+    const SDrawBindStats& Stats = Queue->Stats;
+    const SDrawBindStats& Unsorted = Queue->EmissionOrderStats;
+    uint64_t BindCount = Stats.PipelineBindCount + Stats.DescriptorSetBindCount + Stats.VertexBufferBindCount + Stats.IndexBufferBindCount;
+    uint64_t UnsortedBindCount = Unsorted.PipelineBindCount + Unsorted.DescriptorSetBindCount + Unsorted.VertexBufferBindCount + Unsorted.IndexBufferBindCount;
+
+    printf("Draw queue: %.1f draws per frame, sorted in %.3f ms per frame\n",
+           (double)Stats.DrawCount / FrameCount, (double)Queue->SortTimeNs / 1000000.0 / FrameCount);
+    printf("  Binds per frame: %.1f pipeline, %.1f descriptor set, %.1f vertex buffer, %.1f index buffer (%.1f total, %.1f in emission order)\n",
+           (double)Stats.PipelineBindCount / FrameCount, (double)Stats.DescriptorSetBindCount / FrameCount,
+           (double)Stats.VertexBufferBindCount / FrameCount, (double)Stats.IndexBufferBindCount / FrameCount,
+           (double)BindCount / FrameCount, (double)UnsortedBindCount / FrameCount);
+}
@@ -0,0 +1,435 @@
+//
+// Asynchronous frame readback.
+//
+// The rendered image is copied into one of a small ring of persistently mapped host visible buffers.
+// Each slot remembers the graphics timeline value of the submission that filled it, so the CPU only
+// ever looks at copies that are known to be complete and never waits on the frame it's currently recording.
+// Completed slots are handed to a writer thread that converts and streams them to disk, then gives the slot back.
+//
+// Output format is picked from the file extension:
+//  .raw - every frame appended to a single file as tightly packed 8-bit RGBA
+//  .y4m - YUV4MPEG2 stream (4:4:4), playable/encodable by ffmpeg and most video tools
+//  .png - one file per frame, the frame number is appended to the name (capture.png -> capture_000000.png)
+// Without a path nothing is written, the frames are only read back (for -golden, which keeps the last one).
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+#include "ImageFile.cpp"
+
+constexpr uint32_t CaptureRingSize = 4;
+
+enum ECaptureFormat
+{
+    CaptureFormat_Raw,
+    CaptureFormat_Y4M,
+    CaptureFormat_PNG,
+    CaptureFormat_None,
+};
+
+enum ECaptureSlotState
+{
+    CaptureSlot_Free,
+    CaptureSlot_Pending,    // Copy submitted to the GPU
+    CaptureSlot_Writing,    // Owned by the writer thread
+};
+
+struct SCaptureSlot
+{
+    VkBuffer Buffer;
+    VkDeviceMemory Memory;
+    uint8_t* Mapped;
+
+    ECaptureSlotState State;
+    uint64_t TimelineValue;
+    uint64_t FrameNumber;
+};
+
+struct SFrameCapture
+{
+    VkDevice Device;
+
+    ECaptureFormat Format;
+    char Path[512];
+    uint32_t FrameRate;
+
+    uint32_t Width;
+    uint32_t Height;
+    bool bIsBGRA;
+    VkDeviceSize FrameSize;
+    // Non-coherent memory has to be invalidated before the CPU reads it
+    bool bIsCoherent;
+
+    SCaptureSlot Slots[CaptureRingSize];
+    uint32_t NextSlot;
+
+    uint64_t FrameCount;
+    uint64_t CapturedCount;
+    uint64_t DroppedCount;
+
+    // Raw and Y4M frames are appended to a single stream
+    FILE* StreamFile;
+    std::vector<uint8_t> ConvertScratch;
+    std::vector<uint8_t> EncodeScratch;
+
+    // Writer thread, the mutex protects the slot states and the queue
+    std::thread Writer;
+    std::mutex Mutex;
+    std::condition_variable QueueCondition;
+    std::condition_variable SlotFreedCondition;
+    std::deque<uint32_t> WriteQueue;
+    bool bQuit;
+    bool bWriteFailed;
+
+    // Set before FrameCaptureInit, the last written frame (RGBA) is kept for after FrameCaptureClose
+    bool bKeepLastFrame;
+    std::vector<uint8_t> LastFrame;
+};
+
+void FrameCaptureWriteSlot(SFrameCapture* Capture, SCaptureSlot* Slot)
+{
+    // Convert to RGBA so that every writer only has to deal with a single layout
+    const uint8_t* Pixels = Slot->Mapped;
+    if(Capture->bIsBGRA)
+    {
+        Capture->ConvertScratch.resize((size_t)Capture->FrameSize);
+        uint8_t* Dst = Capture->ConvertScratch.data();
+        size_t PixelCount = (size_t)Capture->Width * Capture->Height;
+        for(size_t i = 0; i < PixelCount; ++i)
+        {
+            Dst[4 * i + 0] = Pixels[4 * i + 2];
+            Dst[4 * i + 1] = Pixels[4 * i + 1];
+            Dst[4 * i + 2] = Pixels[4 * i + 0];
+            Dst[4 * i + 3] = Pixels[4 * i + 3];
+        }
+        Pixels = Dst;
+    }
+
+    if(Capture->bKeepLastFrame)
+    {
+        Capture->LastFrame.assign(Pixels, Pixels + Capture->FrameSize);
+    }
+
+    bool bSuccess = true;
+    switch(Capture->Format)
+    {
+        case CaptureFormat_Raw:
+        {
+            bSuccess = fwrite(Pixels, 1, (size_t)Capture->FrameSize, Capture->StreamFile) == Capture->FrameSize;
+        } break;
+        case CaptureFormat_Y4M:
+        {
+            WriteY4MFrame(Capture->StreamFile, Capture->Width, Capture->Height, Pixels, Capture->EncodeScratch);
+            bSuccess = ferror(Capture->StreamFile) == 0;
+        } break;
+        case CaptureFormat_PNG:
+        {
+            // Insert the frame number before the extension
+            char FramePath[600];
+            const char* Extension = strrchr(Capture->Path, '.');
+            int StemLength = (int)(Extension - Capture->Path);
+            snprintf(FramePath, sizeof(FramePath), "%.*s_%06" PRIu64 "%s", StemLength, Capture->Path, Slot->FrameNumber, Extension);
+
+            bSuccess = WritePNG(FramePath, Capture->Width, Capture->Height, Pixels);
+        } break;
+        case CaptureFormat_None: break;
+    }
+
+    if(!bSuccess && !Capture->bWriteFailed)
+    {
+        printf("Frame capture: failed to write frame %" PRIu64 "\n", Slot->FrameNumber);
+        Capture->bWriteFailed = true;
+    }
+}
+
+void FrameCaptureWriterThread(SFrameCapture* Capture)
+{
+    for(;;)
+    {
+        uint32_t SlotIndex;
+        {
+            std::unique_lock<std::mutex> Lock(Capture->Mutex);
+            Capture->QueueCondition.wait(Lock, [Capture] { return Capture->bQuit || !Capture->WriteQueue.empty(); });
+            if(Capture->WriteQueue.empty())
+            {
+                return;
+            }
+            SlotIndex = Capture->WriteQueue.front();
+            Capture->WriteQueue.pop_front();
+        }
+
+        FrameCaptureWriteSlot(Capture, &Capture->Slots[SlotIndex]);
+
+        {
+            std::lock_guard<std::mutex> Lock(Capture->Mutex);
+            Capture->Slots[SlotIndex].State = CaptureSlot_Free;
+        }
+        Capture->SlotFreedCondition.notify_all();
+    }
+}
+
+// Format is the format of the image that will be copied, only 8-bit RGBA/BGRA formats are supported.
+// FrameRate is only used for the Y4M header.
+bool FrameCaptureInit(SFrameCapture* Capture, VkDevice Device, const VkPhysicalDeviceMemoryProperties* MemoryProperties,
+                      const char* Path, uint32_t Width, uint32_t Height, VkFormat Format, uint32_t FrameRate)
+{
+    Capture->Device = Device;
+    Capture->Width = Width;
+    Capture->Height = Height;
+    Capture->FrameRate = FrameRate ? FrameRate : 60;
+    Capture->FrameSize = (VkDeviceSize)Width * Height * 4;
+    snprintf(Capture->Path, sizeof(Capture->Path), "%s", Path ? Path : "");
+
+    switch(Format)
+    {
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            Capture->bIsBGRA = true;
+            break;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            Capture->bIsBGRA = false;
+            break;
+        default:
+            printf("Frame capture: unsupported image format %x\n", Format);
+            return false;
+    }
+
+    const char* Extension = Path ? strrchr(Path, '.') : nullptr;
+    if(!Path)
+    {
+        Capture->Format = CaptureFormat_None;
+    }
+    else if(Extension && strcmp(Extension, ".raw") == 0)
+    {
+        Capture->Format = CaptureFormat_Raw;
+    }
+    else if(Extension && strcmp(Extension, ".y4m") == 0)
+    {
+        Capture->Format = CaptureFormat_Y4M;
+    }
+    else if(Extension && strcmp(Extension, ".png") == 0)
+    {
+        Capture->Format = CaptureFormat_PNG;
+    }
+    else
+    {
+        printf("Frame capture: unknown file extension in %s (expected .raw, .y4m or .png)\n", Path);
+        return false;
+    }
+
+    if(Capture->Format == CaptureFormat_Raw || Capture->Format == CaptureFormat_Y4M)
+    {
+        Capture->StreamFile = fopen(Path, "wb");
+        if(!Capture->StreamFile)
+        {
+            printf("Frame capture: couldn't open %s\n", Path);
+            return false;
+        }
+
+        if(Capture->Format == CaptureFormat_Y4M)
+        {
+            fprintf(Capture->StreamFile, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444 XCOLORRANGE=FULL\n", Width, Height, Capture->FrameRate);
+        }
+    }
+
+    // Readback buffers
+    for(uint32_t SlotIndex = 0; SlotIndex < CaptureRingSize; ++SlotIndex)
+    {
+        SCaptureSlot& Slot = Capture->Slots[SlotIndex];
+
+        VkBufferCreateInfo BufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        BufferCreateInfo.pNext = nullptr;
+        BufferCreateInfo.flags = 0;
+        BufferCreateInfo.size = Capture->FrameSize;
+        BufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        BufferCreateInfo.queueFamilyIndexCount = 0;
+        BufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+        VkResult Result = vkCreateBuffer(Device, &BufferCreateInfo, nullptr, &Slot.Buffer);
+        assert(Result == VK_SUCCESS);
+
+        VkMemoryRequirements MemoryRequirements;
+        vkGetBufferMemoryRequirements(Device, Slot.Buffer, &MemoryRequirements);
+
+        // Cached memory makes the CPU reads fast, fall back to whatever is host visible
+        uint32_t MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        if(MemoryTypeIndex == UINT32_MAX)
+        {
+            MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        }
+        assert(MemoryTypeIndex != UINT32_MAX);
+        Capture->bIsCoherent = (MemoryProperties->memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+        VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        AllocateInfo.pNext = nullptr;
+        AllocateInfo.allocationSize = MemoryRequirements.size;
+        AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+
+        Result = vkAllocateMemory(Device, &AllocateInfo, nullptr, &Slot.Memory);
+        assert(Result == VK_SUCCESS);
+        vkBindBufferMemory(Device, Slot.Buffer, Slot.Memory, 0);
+
+        Result = vkMapMemory(Device, Slot.Memory, 0, VK_WHOLE_SIZE, 0, (void**)&Slot.Mapped);
+        assert(Result == VK_SUCCESS);
+
+        Slot.State = CaptureSlot_Free;
+    }
+
+    Capture->Writer = std::thread(FrameCaptureWriterThread, Capture);
+    return true;
+}
+
+// Hands every slot whose copy has finished on the GPU over to the writer thread, never blocks
+void FrameCaptureCollect(SFrameCapture* Capture, SVulkanTimeline* Timeline)
+{
+    bool bQueued = false;
+    {
+        std::lock_guard<std::mutex> Lock(Capture->Mutex);
+
+        // Walk the ring in submission order so that streamed frames stay in order
+        for(uint32_t i = 0; i < CaptureRingSize; ++i)
+        {
+            SCaptureSlot& Slot = Capture->Slots[(Capture->NextSlot + i) % CaptureRingSize];
+            if(Slot.State != CaptureSlot_Pending)
+            {
+                continue;
+            }
+            if(!TimelineIsComplete(Timeline, Slot.TimelineValue))
+            {
+                break;
+            }
+
+            if(!Capture->bIsCoherent)
+            {
+                VkMappedMemoryRange Range = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE };
+                Range.pNext = nullptr;
+                Range.memory = Slot.Memory;
+                Range.offset = 0;
+                Range.size = VK_WHOLE_SIZE;
+                vkInvalidateMappedMemoryRanges(Capture->Device, 1, &Range);
+            }
+
+            Slot.State = CaptureSlot_Writing;
+            Capture->WriteQueue.push_back((uint32_t)(&Slot - Capture->Slots));
+            bQueued = true;
+        }
+    }
+
+    if(bQueued)
+    {
+        Capture->QueueCondition.notify_one();
+    }
+}
+
+// Returns the slot the current frame should be copied into.
+// When every slot is still in use either waits for the oldest one (bWait) or drops the frame and returns UINT32_MAX.
+uint32_t FrameCaptureBeginFrame(SFrameCapture* Capture, SVulkanTimeline* Timeline, bool bWait)
+{
+    uint64_t FrameNumber = Capture->FrameCount++;
+
+    FrameCaptureCollect(Capture, Timeline);
+
+    uint32_t SlotIndex = Capture->NextSlot;
+    SCaptureSlot& Slot = Capture->Slots[SlotIndex];
+
+    if(bWait)
+    {
+        if(Slot.State == CaptureSlot_Pending)
+        {
+            TimelineWait(Timeline, Slot.TimelineValue);
+            FrameCaptureCollect(Capture, Timeline);
+        }
+
+        std::unique_lock<std::mutex> Lock(Capture->Mutex);
+        Capture->SlotFreedCondition.wait(Lock, [&Slot] { return Slot.State == CaptureSlot_Free; });
+    }
+    else
+    {
+        std::lock_guard<std::mutex> Lock(Capture->Mutex);
+        if(Slot.State != CaptureSlot_Free)
+        {
+            Capture->DroppedCount++;
+            return UINT32_MAX;
+        }
+    }
+
+    Slot.FrameNumber = FrameNumber;
+    Capture->NextSlot = (Capture->NextSlot + 1) % CaptureRingSize;
+    return SlotIndex;
+}
+
+// Image has to be in TRANSFER_SRC_OPTIMAL layout with all prior writes made available to the transfer stage
+void FrameCaptureRecordCopy(SFrameCapture* Capture, VkCommandBuffer CommandBuffer, uint32_t SlotIndex, VkImage Image)
+{
+    SCaptureSlot& Slot = Capture->Slots[SlotIndex];
+
+    VkBufferImageCopy Region = {};
+    Region.bufferOffset = 0;
+    Region.bufferRowLength = 0;
+    Region.bufferImageHeight = 0;
+    Region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    Region.imageOffset = { 0, 0, 0 };
+    Region.imageExtent = { Capture->Width, Capture->Height, 1 };
+    vkCmdCopyImageToBuffer(CommandBuffer, Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Slot.Buffer, 1, &Region);
+
+    VkBufferMemoryBarrier Barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    Barrier.pNext = nullptr;
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.buffer = Slot.Buffer;
+    Barrier.offset = 0;
+    Barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &Barrier, 0, nullptr);
+}
+
+// TimelineValue is the value signaled by the submission containing the copy
+void FrameCaptureEndFrame(SFrameCapture* Capture, uint32_t SlotIndex, uint64_t TimelineValue)
+{
+    std::lock_guard<std::mutex> Lock(Capture->Mutex);
+    SCaptureSlot& Slot = Capture->Slots[SlotIndex];
+    Slot.TimelineValue = TimelineValue;
+    Slot.State = CaptureSlot_Pending;
+    Capture->CapturedCount++;
+}
+
+// Waits for every outstanding copy and write, then releases everything
+void FrameCaptureClose(SFrameCapture* Capture, SVulkanTimeline* Timeline)
+{
+    TimelineWait(Timeline, Timeline->LastSubmittedValue);
+    FrameCaptureCollect(Capture, Timeline);
+
+    {
+        std::lock_guard<std::mutex> Lock(Capture->Mutex);
+        Capture->bQuit = true;
+    }
+    Capture->QueueCondition.notify_one();
+    Capture->Writer.join();
+
+    for(SCaptureSlot& Slot : Capture->Slots)
+    {
+        vkUnmapMemory(Capture->Device, Slot.Memory);
+        vkDestroyBuffer(Capture->Device, Slot.Buffer, nullptr);
+        vkFreeMemory(Capture->Device, Slot.Memory, nullptr);
+    }
+
+    if(Capture->StreamFile)
+    {
+        fclose(Capture->StreamFile);
+        Capture->StreamFile = nullptr;
+    }
+
+    if(Capture->Format != CaptureFormat_None)
+    {
+        printf("Frame capture: %" PRIu64 " frames written to %s, %" PRIu64 " dropped\n",
+               Capture->CapturedCount, Capture->Path, Capture->DroppedCount);
+    }
+}
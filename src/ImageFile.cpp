@@ -0,0 +1,196 @@
+//
+// Minimal image file writers, no external dependencies.
+// PNGs are written with uncompressed (stored) deflate blocks: bigger files, but encoding is just a memcpy
+// plus checksums, which keeps the capture writer thread ahead of the renderer.
+//
+
+struct SCRC32Table
+{
+    uint32_t Entries[256];
+};
+
+static constexpr SCRC32Table MakeCRC32Table()
+{
+    SCRC32Table Table = {};
+    for(uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t C = i;
+        for(uint32_t k = 0; k < 8; ++k)
+        {
+            C = (C & 1) ? (0xEDB88320u ^ (C >> 1)) : (C >> 1);
+        }
+        Table.Entries[i] = C;
+    }
+    return Table;
+}
+
+// Built at compile time, so the capture writer thread never races an initialization
+static constexpr SCRC32Table CRC32Table = MakeCRC32Table();
+
+uint32_t UpdateCRC32(uint32_t CRC, const uint8_t* Data, size_t Size)
+{
+    uint32_t C = CRC ^ 0xFFFFFFFFu;
+    for(size_t i = 0; i < Size; ++i)
+    {
+        C = CRC32Table.Entries[(C ^ Data[i]) & 0xFF] ^ (C >> 8);
+    }
+    return C ^ 0xFFFFFFFFu;
+}
+
+// The modulo is only taken every 5552 bytes, the most that can be summed before B could overflow 32 bits
+uint32_t UpdateAdler32(uint32_t Adler, const uint8_t* Data, size_t Size)
+{
+    constexpr size_t MaxRunSize = 5552;
+
+    uint32_t A = Adler & 0xFFFF;
+    uint32_t B = Adler >> 16;
+    while(Size)
+    {
+        size_t RunSize = std::min(Size, MaxRunSize);
+        for(size_t i = 0; i < RunSize; ++i)
+        {
+            A += Data[i];
+            B += A;
+        }
+        A %= 65521;
+        B %= 65521;
+
+        Data += RunSize;
+        Size -= RunSize;
+    }
+    return (B << 16) | A;
+}
+
+static void PNGPutU32(std::vector<uint8_t>& Out, uint32_t Value)
+{
+    Out.push_back((uint8_t)(Value >> 24));
+    Out.push_back((uint8_t)(Value >> 16));
+    Out.push_back((uint8_t)(Value >> 8));
+    Out.push_back((uint8_t)(Value));
+}
+
+static void PNGWriteChunk(FILE* File, const char* Type, const std::vector<uint8_t>& Data)
+{
+    std::vector<uint8_t> Header;
+    PNGPutU32(Header, (uint32_t)Data.size());
+    fwrite(Header.data(), 1, 4, File);
+
+    uint32_t CRC = UpdateCRC32(0, (const uint8_t*)Type, 4);
+    CRC = UpdateCRC32(CRC, Data.data(), Data.size());
+    fwrite(Type, 1, 4, File);
+    fwrite(Data.data(), 1, Data.size(), File);
+
+    std::vector<uint8_t> Footer;
+    PNGPutU32(Footer, CRC);
+    fwrite(Footer.data(), 1, 4, File);
+}
+
+// Pixels are tightly packed 8-bit RGBA
+bool WritePNG(const char* Path, uint32_t Width, uint32_t Height, const uint8_t* Pixels)
+{
+    FILE* File = fopen(Path, "wb");
+    if(!File)
+    {
+        return false;
+    }
+
+    static const uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(Signature, 1, sizeof(Signature), File);
+
+    std::vector<uint8_t> IHDR;
+    PNGPutU32(IHDR, Width);
+    PNGPutU32(IHDR, Height);
+    IHDR.push_back(8);  // Bit depth
+    IHDR.push_back(6);  // RGBA
+    IHDR.push_back(0);  // Deflate
+    IHDR.push_back(0);  // Adaptive filtering
+    IHDR.push_back(0);  // No interlace
+    PNGWriteChunk(File, "IHDR", IHDR);
+
+    // Raw scanlines, each prefixed by filter type 0
+    size_t RowSize = (size_t)Width * 4;
+    size_t RawSize = (RowSize + 1) * Height;
+
+    // zlib stream made of stored deflate blocks
+    constexpr size_t MaxBlockSize = 65535;
+    size_t BlockCount = (RawSize + MaxBlockSize - 1) / MaxBlockSize;
+
+    std::vector<uint8_t> IDAT(2 + RawSize + BlockCount * 5);
+    uint8_t* Out = IDAT.data();
+    *Out++ = 0x78;
+    *Out++ = 0x01;
+
+    // Copies raw bytes, starting a new stored block whenever the current one is full
+    size_t RawRemaining = RawSize;
+    size_t BlockRemaining = 0;
+    auto AppendRaw = [&](const uint8_t* Data, size_t Size)
+    {
+        while(Size)
+        {
+            if(BlockRemaining == 0)
+            {
+                uint16_t BlockSize = (uint16_t)std::min(RawRemaining, MaxBlockSize);
+                RawRemaining -= BlockSize;
+
+                Out[0] = RawRemaining ? 0 : 1;
+                Out[1] = (uint8_t)(BlockSize & 0xFF);
+                Out[2] = (uint8_t)(BlockSize >> 8);
+                Out[3] = (uint8_t)(~BlockSize & 0xFF);
+                Out[4] = (uint8_t)((uint16_t)~BlockSize >> 8);
+                Out += 5;
+                BlockRemaining = BlockSize;
+            }
+
+            size_t CopySize = std::min(Size, BlockRemaining);
+            memcpy(Out, Data, CopySize);
+            Out += CopySize;
+            Data += CopySize;
+            Size -= CopySize;
+            BlockRemaining -= CopySize;
+        }
+    };
+
+    static const uint8_t FilterNone = 0;
+    uint32_t Adler = 1;
+    for(uint32_t Row = 0; Row < Height; ++Row)
+    {
+        const uint8_t* RowPixels = Pixels + Row * RowSize;
+        AppendRaw(&FilterNone, 1);
+        AppendRaw(RowPixels, RowSize);
+        Adler = UpdateAdler32(Adler, &FilterNone, 1);
+        Adler = UpdateAdler32(Adler, RowPixels, RowSize);
+    }
+    assert(Out == IDAT.data() + IDAT.size());
+    PNGPutU32(IDAT, Adler);
+    PNGWriteChunk(File, "IDAT", IDAT);
+
+    PNGWriteChunk(File, "IEND", std::vector<uint8_t>());
+
+    bool bSuccess = ferror(File) == 0;
+    fclose(File);
+    return bSuccess;
+}
+
+// Full range BT.601 4:4:4, written as a single frame of a YUV4MPEG2 stream (the header is written separately)
+void WriteY4MFrame(FILE* File, uint32_t Width, uint32_t Height, const uint8_t* Pixels, std::vector<uint8_t>& Scratch)
+{
+    size_t PlaneSize = (size_t)Width * Height;
+    Scratch.resize(3 * PlaneSize);
+
+    uint8_t* Y = Scratch.data();
+    uint8_t* U = Y + PlaneSize;
+    uint8_t* V = U + PlaneSize;
+    for(size_t i = 0; i < PlaneSize; ++i)
+    {
+        float R = Pixels[4 * i + 0];
+        float G = Pixels[4 * i + 1];
+        float B = Pixels[4 * i + 2];
+
+        Y[i] = (uint8_t)Clamp(0.299f * R + 0.587f * G + 0.114f * B + 0.5f, 0.0f, 255.0f);
+        U[i] = (uint8_t)Clamp(-0.168736f * R - 0.331264f * G + 0.5f * B + 128.5f, 0.0f, 255.0f);
+        V[i] = (uint8_t)Clamp(0.5f * R - 0.418688f * G - 0.081312f * B + 128.5f, 0.0f, 255.0f);
+    }
+
+    fputs("FRAME\n", File);
+    fwrite(Scratch.data(), 1, Scratch.size(), File);
+}
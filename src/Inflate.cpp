@@ -0,0 +1,398 @@
+//
+// zlib (RFC 1950) / deflate (RFC 1951) decompression, used for ZLIB supercompressed KTX2 mip levels.
+// Straightforward canonical Huffman decoder, bit by bit: decoding only happens in background jobs
+// and the output size is known up front, so simplicity wins over speed here.
+//
+
+constexpr uint32_t InflateMaxBits = 15;
+constexpr uint32_t InflateMaxLiteralCodes = 286;
+constexpr uint32_t InflateMaxDistanceCodes = 30;
+constexpr uint32_t InflateFixedLiteralCodes = 288;
+
+struct SInflateState
+{
+    const uint8_t* In;
+    size_t InSize;
+    size_t InPos;
+
+    uint32_t BitBuffer;
+    uint32_t BitCount;
+
+    uint8_t* Out;
+    size_t OutSize;
+    size_t OutPos;
+
+    bool bError;
+};
+
+struct SHuffmanTable
+{
+    uint16_t Counts[InflateMaxBits + 1];
+    uint16_t Symbols[InflateFixedLiteralCodes];
+};
+
+static uint32_t InflateBits(SInflateState* State, uint32_t Count)
+{
+    uint32_t Value = State->BitBuffer;
+    while(State->BitCount < Count)
+    {
+        if(State->InPos >= State->InSize)
+        {
+            State->bError = true;
+            return 0;
+        }
+        Value |= (uint32_t)State->In[State->InPos++] << State->BitCount;
+        State->BitCount += 8;
+    }
+
+    State->BitBuffer = (Count < 32) ? (Value >> Count) : 0;
+    State->BitCount -= Count;
+    return Value & ((1u << Count) - 1);
+}
+
+// Returns false for over-subscribed code sets, incomplete ones are allowed (single distance code case)
+static bool InflateBuildTable(SHuffmanTable* Table, const uint8_t* Lengths, uint32_t Count)
+{
+    memset(Table->Counts, 0, sizeof(Table->Counts));
+    for(uint32_t Symbol = 0; Symbol < Count; ++Symbol)
+    {
+        Table->Counts[Lengths[Symbol]]++;
+    }
+
+    int32_t Left = 1;
+    for(uint32_t Length = 1; Length <= InflateMaxBits; ++Length)
+    {
+        Left <<= 1;
+        Left -= Table->Counts[Length];
+        if(Left < 0)
+        {
+            return false;
+        }
+    }
+
+    uint16_t Offsets[InflateMaxBits + 1];
+    Offsets[1] = 0;
+    for(uint32_t Length = 1; Length < InflateMaxBits; ++Length)
+    {
+        Offsets[Length + 1] = Offsets[Length] + Table->Counts[Length];
+    }
+
+    for(uint32_t Symbol = 0; Symbol < Count; ++Symbol)
+    {
+        if(Lengths[Symbol] != 0)
+        {
+            Table->Symbols[Offsets[Lengths[Symbol]]++] = (uint16_t)Symbol;
+        }
+    }
+    return true;
+}
+
+static int32_t InflateDecodeSymbol(SInflateState* State, const SHuffmanTable* Table)
+{
+    int32_t Code = 0;
+    int32_t First = 0;
+    int32_t Index = 0;
+    for(uint32_t Length = 1; Length <= InflateMaxBits; ++Length)
+    {
+        Code |= (int32_t)InflateBits(State, 1);
+        int32_t Count = Table->Counts[Length];
+        if(Code - Count < First)
+        {
+            return Table->Symbols[Index + (Code - First)];
+        }
+        Index += Count;
+        First += Count;
+        First <<= 1;
+        Code <<= 1;
+    }
+
+    State->bError = true;
+    return -1;
+}
+
+static bool InflateStored(SInflateState* State)
+{
+    // Stored blocks start on a byte boundary
+    State->BitBuffer = 0;
+    State->BitCount = 0;
+
+    if(State->InPos + 4 > State->InSize)
+    {
+        return false;
+    }
+    uint32_t Length = State->In[State->InPos] | (State->In[State->InPos + 1] << 8);
+    uint32_t InvLength = State->In[State->InPos + 2] | (State->In[State->InPos + 3] << 8);
+    State->InPos += 4;
+
+    if(Length != (~InvLength & 0xFFFF) ||
+       State->InPos + Length > State->InSize ||
+       State->OutPos + Length > State->OutSize)
+    {
+        return false;
+    }
+
+    memcpy(State->Out + State->OutPos, State->In + State->InPos, Length);
+    State->InPos += Length;
+    State->OutPos += Length;
+    return true;
+}
+
+static bool InflateCodes(SInflateState* State, const SHuffmanTable* LiteralTable, const SHuffmanTable* DistanceTable)
+{
+    static const uint16_t LengthBase[29] =
+    {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const uint8_t LengthExtra[29] =
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    static const uint16_t DistanceBase[30] =
+    {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+    static const uint8_t DistanceExtra[30] =
+    {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+
+    for(;;)
+    {
+        int32_t Symbol = InflateDecodeSymbol(State, LiteralTable);
+        if(State->bError)
+        {
+            return false;
+        }
+
+        if(Symbol < 256)
+        {
+            if(State->OutPos >= State->OutSize)
+            {
+                return false;
+            }
+            State->Out[State->OutPos++] = (uint8_t)Symbol;
+        }
+        else if(Symbol == 256)
+        {
+            return true;
+        }
+        else
+        {
+            Symbol -= 257;
+            if(Symbol >= 29)
+            {
+                return false;
+            }
+            uint32_t Length = LengthBase[Symbol] + InflateBits(State, LengthExtra[Symbol]);
+
+            int32_t DistanceSymbol = InflateDecodeSymbol(State, DistanceTable);
+            if(State->bError || DistanceSymbol >= 30)
+            {
+                return false;
+            }
+            size_t Distance = DistanceBase[DistanceSymbol] + InflateBits(State, DistanceExtra[DistanceSymbol]);
+
+            if(State->bError || Distance > State->OutPos || State->OutPos + Length > State->OutSize)
+            {
+                return false;
+            }
+
+            // Byte by byte, the source and destination ranges can overlap
+            for(uint32_t i = 0; i < Length; ++i, ++State->OutPos)
+            {
+                State->Out[State->OutPos] = State->Out[State->OutPos - Distance];
+            }
+        }
+    }
+}
+
+struct SInflateFixedTables
+{
+    SHuffmanTable LiteralTable;
+    SHuffmanTable DistanceTable;
+};
+
+static SInflateFixedTables InflateBuildFixedTables()
+{
+    SInflateFixedTables Tables = {};
+
+    uint8_t Lengths[InflateFixedLiteralCodes];
+    uint32_t Symbol = 0;
+    for(; Symbol < 144; ++Symbol) Lengths[Symbol] = 8;
+    for(; Symbol < 256; ++Symbol) Lengths[Symbol] = 9;
+    for(; Symbol < 280; ++Symbol) Lengths[Symbol] = 7;
+    for(; Symbol < InflateFixedLiteralCodes; ++Symbol) Lengths[Symbol] = 8;
+    InflateBuildTable(&Tables.LiteralTable, Lengths, InflateFixedLiteralCodes);
+
+    for(Symbol = 0; Symbol < InflateMaxDistanceCodes; ++Symbol) Lengths[Symbol] = 5;
+    InflateBuildTable(&Tables.DistanceTable, Lengths, InflateMaxDistanceCodes);
+
+    return Tables;
+}
+
+static bool InflateFixed(SInflateState* State)
+{
+    // Several decode jobs can get here at the same time, function-local static initialization is thread safe
+    static const SInflateFixedTables Tables = InflateBuildFixedTables();
+    return InflateCodes(State, &Tables.LiteralTable, &Tables.DistanceTable);
+}
+
+static bool InflateDynamic(SInflateState* State)
+{
+    static const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    uint32_t LiteralCount = InflateBits(State, 5) + 257;
+    uint32_t DistanceCount = InflateBits(State, 5) + 1;
+    uint32_t CodeLengthCount = InflateBits(State, 4) + 4;
+    if(State->bError || LiteralCount > InflateMaxLiteralCodes || DistanceCount > InflateMaxDistanceCodes)
+    {
+        return false;
+    }
+
+    uint8_t Lengths[InflateMaxLiteralCodes + InflateMaxDistanceCodes] = {};
+    for(uint32_t i = 0; i < CodeLengthCount; ++i)
+    {
+        Lengths[CodeLengthOrder[i]] = (uint8_t)InflateBits(State, 3);
+    }
+
+    SHuffmanTable CodeLengthTable;
+    if(State->bError || !InflateBuildTable(&CodeLengthTable, Lengths, 19))
+    {
+        return false;
+    }
+
+    uint32_t Index = 0;
+    while(Index < LiteralCount + DistanceCount)
+    {
+        int32_t Symbol = InflateDecodeSymbol(State, &CodeLengthTable);
+        if(State->bError)
+        {
+            return false;
+        }
+
+        if(Symbol < 16)
+        {
+            Lengths[Index++] = (uint8_t)Symbol;
+            continue;
+        }
+
+        uint8_t Length = 0;
+        uint32_t Repeat;
+        if(Symbol == 16)
+        {
+            if(Index == 0)
+            {
+                return false;
+            }
+            Length = Lengths[Index - 1];
+            Repeat = 3 + InflateBits(State, 2);
+        }
+        else if(Symbol == 17)
+        {
+            Repeat = 3 + InflateBits(State, 3);
+        }
+        else
+        {
+            Repeat = 11 + InflateBits(State, 7);
+        }
+
+        if(Index + Repeat > LiteralCount + DistanceCount)
+        {
+            return false;
+        }
+        while(Repeat--)
+        {
+            Lengths[Index++] = Length;
+        }
+    }
+
+    // The end of block code has to be present
+    if(Lengths[256] == 0)
+    {
+        return false;
+    }
+
+    SHuffmanTable LiteralTable;
+    SHuffmanTable DistanceTable;
+    if(!InflateBuildTable(&LiteralTable, Lengths, LiteralCount) ||
+       !InflateBuildTable(&DistanceTable, Lengths + LiteralCount, DistanceCount))
+    {
+        return false;
+    }
+
+    return InflateCodes(State, &LiteralTable, &DistanceTable);
+}
+
+// Decompresses a zlib stream into exactly OutSize bytes
+bool ZlibDecompress(const uint8_t* In, size_t InSize, uint8_t* Out, size_t OutSize)
+{
+    if(InSize < 6)
+    {
+        return false;
+    }
+
+    // CM = 8 (deflate), no preset dictionary, header checksum
+    uint32_t CMF = In[0];
+    uint32_t FLG = In[1];
+    if((CMF & 0x0F) != 8 || (FLG & 0x20) || ((CMF << 8) | FLG) % 31 != 0)
+    {
+        return false;
+    }
+
+    SInflateState State = {};
+    State.In = In + 2;
+    State.InSize = InSize - 2;
+    State.Out = Out;
+    State.OutSize = OutSize;
+
+    bool bIsLastBlock = false;
+    while(!bIsLastBlock)
+    {
+        bIsLastBlock = InflateBits(&State, 1) != 0;
+        uint32_t Type = InflateBits(&State, 2);
+        if(State.bError)
+        {
+            return false;
+        }
+
+        bool bSuccess = false;
+        switch(Type)
+        {
+            case 0: bSuccess = InflateStored(&State); break;
+            case 1: bSuccess = InflateFixed(&State); break;
+            case 2: bSuccess = InflateDynamic(&State); break;
+            default: break;
+        }
+
+        if(!bSuccess)
+        {
+            return false;
+        }
+    }
+
+    if(State.OutPos != OutSize)
+    {
+        return false;
+    }
+
+    // Adler-32 of the uncompressed data follows the deflate stream, byte aligned
+    size_t ChecksumPos = State.InPos;
+    if(ChecksumPos + 4 > State.InSize)
+    {
+        return false;
+    }
+    const uint8_t* Checksum = State.In + ChecksumPos;
+    uint32_t Expected = ((uint32_t)Checksum[0] << 24) | ((uint32_t)Checksum[1] << 16) | ((uint32_t)Checksum[2] << 8) | Checksum[3];
+
+    uint32_t A = 1, B = 0;
+    for(size_t i = 0; i < OutSize; ++i)
+    {
+        A = (A + Out[i]) % 65521;
+        B = (B + A) % 65521;
+    }
+    return ((B << 16) | A) == Expected;
+}
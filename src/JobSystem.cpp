@@ -0,0 +1,610 @@
+//
+// Work-stealing job system.
+//
+// The main thread is worker 0, every other worker is a thread of its own. Each worker owns a Chase-Lev deque:
+// the owner pushes and pops at the bottom (newest first, its data is still in cache) while idle workers steal from
+// the top (oldest first, usually the largest pieces of work). Jobs carry their captures inline, adding one never
+// allocates. Waiting on jobs doesn't block, the waiting thread runs other jobs until the ones it waits for are done.
+//
+// Dependencies are counters: adding a job increments its counter, finishing it decrements it. A job can also be
+// added after a counter, it's then parked on that counter and pushed as a continuation once the counter reaches zero.
+//
+// Background jobs (file loading, decoding) go through a shared FIFO only the worker threads take from, so the main
+// thread never gets stuck in a long job while it's helping out with frame work.
+//
+// Every job is timed under its name. Per name totals are always kept, the individual runs are only recorded
+// when a trace was requested and can then be written in the Chrome trace event format (chrome://tracing, Perfetto).
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <new>
+#include <type_traits>
+
+constexpr uint32_t MaxJobWorkers = 64;
+// Both per worker and powers of two
+constexpr uint32_t JobQueueSize = 4096;
+constexpr uint32_t JobPoolSize = 4096;
+constexpr uint32_t JobPayloadSize = 64;
+// Per worker, a minute of a few jobs per frame
+constexpr uint32_t MaxJobTraceEvents = 1u << 20;
+// Failed attempts to find a job before a worker goes to sleep (or a waiting thread yields)
+constexpr uint32_t JobSpinCount = 64;
+
+struct SJob;
+
+struct SJobCounter
+{
+    std::atomic<uint32_t> Count { 0 };
+
+    // Jobs to push when Count reaches zero. Count is only decremented with the mutex held.
+    std::mutex Mutex;
+    std::vector<SJob*> Continuations;
+};
+
+struct SJob
+{
+    void (*Function)(void* Payload);
+    alignas(16) uint8_t Payload[JobPayloadSize];
+
+    const char* Name;
+    SJobCounter* Counter;
+
+    // Set from allocation until the job has run, the pool slot can't be reused before that
+    std::atomic<bool> bIsInUse;
+};
+
+// Chase-Lev work-stealing deque with a fixed capacity (Le et al., "Correct and Efficient Work-Stealing for Weak
+// Memory Models"). Only the owning worker pushes and pops, any worker may steal.
+struct SJobQueue
+{
+    alignas(64) std::atomic<int64_t> Top;
+    alignas(64) std::atomic<int64_t> Bottom;
+    std::atomic<SJob*> Jobs[JobQueueSize];
+};
+
+struct SJobStats
+{
+    const char* Name;
+    uint64_t RunCount;
+    uint64_t TotalNs;
+    uint64_t MaxNs;
+};
+
+struct SJobTraceEvent
+{
+    const char* Name;
+    uint64_t StartNs;
+    uint64_t EndNs;
+};
+
+struct SJobWorker
+{
+    SJobQueue Queue;
+
+    // Jobs added by this worker, allocated round-robin
+    SJob JobPool[JobPoolSize];
+    uint32_t NextPoolIndex;
+
+    // Victim selection for stealing
+    uint32_t RandomState;
+
+    // Only ever touched by the worker itself
+    uint32_t Depth;
+    uint64_t RunCount;
+    uint64_t StolenCount;
+    uint64_t BusyNs;
+    std::vector<SJobStats> Stats;
+    std::vector<SJobTraceEvent> Trace;
+
+    std::thread Thread;
+};
+
+struct SJobSystem
+{
+    // Including the main thread
+    uint32_t WorkerCount;
+    SJobWorker* Workers;
+
+    bool bTrace;
+    uint64_t StartTimeNs;
+
+    std::mutex BackgroundMutex;
+    std::deque<SJob*> BackgroundJobs;
+
+    // Jobs sitting in any of the queues, idle workers sleep while there are none
+    std::atomic<int32_t> QueuedCount;
+    std::atomic<uint32_t> SleepingCount;
+    std::mutex SleepMutex;
+    std::condition_variable WakeUp;
+    std::atomic<bool> bQuit;
+};
+
+static thread_local uint32_t JobWorkerIndex = UINT32_MAX;
+
+static bool JobQueuePush(SJobQueue* Queue, SJob* Job)
+{
+    int64_t Bottom = Queue->Bottom.load(std::memory_order_relaxed);
+    int64_t Top = Queue->Top.load(std::memory_order_acquire);
+    if(Bottom - Top >= (int64_t)JobQueueSize)
+    {
+        return false;
+    }
+
+    Queue->Jobs[Bottom & (JobQueueSize - 1)].store(Job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Queue->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static SJob* JobQueuePop(SJobQueue* Queue)
+{
+    int64_t Bottom = Queue->Bottom.load(std::memory_order_relaxed) - 1;
+    Queue->Bottom.store(Bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t Top = Queue->Top.load(std::memory_order_relaxed);
+
+    if(Top > Bottom)
+    {
+        // Empty
+        Queue->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    SJob* Job = Queue->Jobs[Bottom & (JobQueueSize - 1)].load(std::memory_order_relaxed);
+    if(Top == Bottom)
+    {
+        // Last job, race the stealers for it
+        if(!Queue->Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            Job = nullptr;
+        }
+        Queue->Bottom.store(Bottom + 1, std::memory_order_relaxed);
+    }
+    return Job;
+}
+
+static SJob* JobQueueSteal(SJobQueue* Queue)
+{
+    int64_t Top = Queue->Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t Bottom = Queue->Bottom.load(std::memory_order_acquire);
+    if(Top >= Bottom)
+    {
+        return nullptr;
+    }
+
+    SJob* Job = Queue->Jobs[Top & (JobQueueSize - 1)].load(std::memory_order_relaxed);
+    if(!Queue->Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        return nullptr;
+    }
+    return Job;
+}
+
+static void JobSystemRecordRun(SJobSystem* System, SJobWorker* Worker, const char* Name, uint64_t StartNs, uint64_t EndNs)
+{
+    uint64_t DurationNs = EndNs - StartNs;
+    Worker->RunCount++;
+    if(Worker->Depth == 0)
+    {
+        // Jobs run while waiting inside another job are already covered by the outer one
+        Worker->BusyNs += DurationNs;
+    }
+
+    // Names are string literals, comparing pointers is enough here
+    SJobStats* Stats = nullptr;
+    for(SJobStats& Entry : Worker->Stats)
+    {
+        if(Entry.Name == Name)
+        {
+            Stats = &Entry;
+            break;
+        }
+    }
+    if(!Stats)
+    {
+        Worker->Stats.push_back({ Name, 0, 0, 0 });
+        Stats = &Worker->Stats.back();
+    }
+    Stats->RunCount++;
+    Stats->TotalNs += DurationNs;
+    Stats->MaxNs = std::max(Stats->MaxNs, DurationNs);
+
+    if(System->bTrace && Worker->Trace.size() < MaxJobTraceEvents)
+    {
+        Worker->Trace.push_back({ Name, StartNs, EndNs });
+    }
+}
+
+static void JobSystemPush(SJobSystem* System, SJob* Job);
+
+static void JobSystemExecute(SJobSystem* System, SJob* Job)
+{
+    SJobWorker* Worker = &System->Workers[JobWorkerIndex];
+
+    Worker->Depth++;
+    uint64_t StartNs = PlatformGetTimeNs();
+    Job->Function(Job->Payload);
+    uint64_t EndNs = PlatformGetTimeNs();
+    Worker->Depth--;
+
+    const char* Name = Job->Name;
+    SJobCounter* Counter = Job->Counter;
+    Job->bIsInUse.store(false, std::memory_order_release);
+
+    JobSystemRecordRun(System, Worker, Name, StartNs, EndNs);
+
+    if(Counter)
+    {
+        std::vector<SJob*> Continuations;
+        {
+            std::lock_guard<std::mutex> Lock(Counter->Mutex);
+            if(Counter->Count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                Continuations.swap(Counter->Continuations);
+            }
+        }
+
+        for(SJob* Continuation : Continuations)
+        {
+            JobSystemPush(System, Continuation);
+        }
+    }
+}
+
+static void JobSystemWakeWorker(SJobSystem* System)
+{
+    if(System->SleepingCount.load() > 0)
+    {
+        // Taking the lock makes sure the sleeper is either still before its check or already waiting
+        {
+            std::lock_guard<std::mutex> Lock(System->SleepMutex);
+        }
+        System->WakeUp.notify_one();
+    }
+}
+
+static void JobSystemPush(SJobSystem* System, SJob* Job)
+{
+    SJobWorker* Worker = &System->Workers[JobWorkerIndex];
+    if(!JobQueuePush(&Worker->Queue, Job))
+    {
+        // The queue is full, which only happens if something adds jobs in a loop without ever waiting
+        JobSystemExecute(System, Job);
+        return;
+    }
+
+    System->QueuedCount.fetch_add(1);
+    JobSystemWakeWorker(System);
+}
+
+// Own queue first, then the other workers' queues starting at a random one, then the background queue
+static bool JobSystemRunNext(SJobSystem* System, bool bAllowBackground)
+{
+    SJobWorker* Worker = &System->Workers[JobWorkerIndex];
+
+    SJob* Job = JobQueuePop(&Worker->Queue);
+    if(!Job && System->WorkerCount > 1)
+    {
+        // xorshift32
+        Worker->RandomState ^= Worker->RandomState << 13;
+        Worker->RandomState ^= Worker->RandomState >> 17;
+        Worker->RandomState ^= Worker->RandomState << 5;
+
+        uint32_t FirstVictim = Worker->RandomState % System->WorkerCount;
+        for(uint32_t i = 0; i < System->WorkerCount && !Job; ++i)
+        {
+            uint32_t VictimIndex = (FirstVictim + i) % System->WorkerCount;
+            if(VictimIndex != JobWorkerIndex)
+            {
+                Job = JobQueueSteal(&System->Workers[VictimIndex].Queue);
+            }
+        }
+
+        if(Job)
+        {
+            Worker->StolenCount++;
+        }
+    }
+
+    if(!Job && bAllowBackground)
+    {
+        std::lock_guard<std::mutex> Lock(System->BackgroundMutex);
+        if(!System->BackgroundJobs.empty())
+        {
+            Job = System->BackgroundJobs.front();
+            System->BackgroundJobs.pop_front();
+        }
+    }
+
+    if(!Job)
+    {
+        return false;
+    }
+
+    System->QueuedCount.fetch_sub(1);
+    JobSystemExecute(System, Job);
+    return true;
+}
+
+static void JobSystemWorkerThread(SJobSystem* System, uint32_t WorkerIndex)
+{
+    JobWorkerIndex = WorkerIndex;
+
+    uint32_t IdleCount = 0;
+    while(!System->bQuit.load(std::memory_order_acquire))
+    {
+        if(JobSystemRunNext(System, true))
+        {
+            IdleCount = 0;
+            continue;
+        }
+
+        if(++IdleCount < JobSpinCount)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Lock(System->SleepMutex);
+        System->SleepingCount.fetch_add(1);
+        System->WakeUp.wait(Lock, [System]
+        {
+            return System->QueuedCount.load() > 0 || System->bQuit.load();
+        });
+        System->SleepingCount.fetch_sub(1);
+        IdleCount = 0;
+    }
+}
+
+// ThreadCount is the number of threads besides the calling one, which becomes worker 0.
+// With no threads at all, jobs run when they're waited on and background jobs run immediately.
+void JobSystemInit(SJobSystem* System, uint32_t ThreadCount, bool bTrace)
+{
+    System->WorkerCount = std::min(ThreadCount + 1, MaxJobWorkers);
+    System->Workers = new SJobWorker[System->WorkerCount]();
+    System->bTrace = bTrace;
+    System->StartTimeNs = PlatformGetTimeNs();
+    System->QueuedCount = 0;
+    System->SleepingCount = 0;
+    System->bQuit = false;
+
+    JobWorkerIndex = 0;
+    for(uint32_t WorkerIndex = 0; WorkerIndex < System->WorkerCount; ++WorkerIndex)
+    {
+        SJobWorker& Worker = System->Workers[WorkerIndex];
+        Worker.RandomState = 0x9E3779B9u * (WorkerIndex + 1);
+        if(WorkerIndex > 0)
+        {
+            Worker.Thread = std::thread(JobSystemWorkerThread, System, WorkerIndex);
+        }
+    }
+}
+
+// Nothing may be queued or running anymore
+void JobSystemShutdown(SJobSystem* System)
+{
+    {
+        std::lock_guard<std::mutex> Lock(System->SleepMutex);
+        System->bQuit = true;
+    }
+    System->WakeUp.notify_all();
+
+    for(uint32_t WorkerIndex = 1; WorkerIndex < System->WorkerCount; ++WorkerIndex)
+    {
+        System->Workers[WorkerIndex].Thread.join();
+    }
+
+    delete[] System->Workers;
+    System->Workers = nullptr;
+    System->WorkerCount = 0;
+}
+
+uint32_t JobSystemGetWorkerCount(const SJobSystem* System)
+{
+    return System->WorkerCount;
+}
+
+// Index of the worker running the calling code, for per-worker resources (e.g. command pools)
+uint32_t JobSystemGetWorkerIndex()
+{
+    assert(JobWorkerIndex != UINT32_MAX);
+    return JobWorkerIndex;
+}
+
+static SJob* JobSystemAllocateJob(SJobSystem* System, const char* Name, SJobCounter* Counter)
+{
+    // Only the workers (including the main thread) can add jobs, they allocate from their own pools
+    assert(JobWorkerIndex < System->WorkerCount);
+    SJobWorker* Worker = &System->Workers[JobWorkerIndex];
+
+    SJob* Job = nullptr;
+    for(uint32_t Attempt = 1; !Job; ++Attempt)
+    {
+        SJob* Candidate = &Worker->JobPool[Worker->NextPoolIndex++ & (JobPoolSize - 1)];
+        if(!Candidate->bIsInUse.load(std::memory_order_acquire))
+        {
+            Job = Candidate;
+        }
+        else if(Attempt % JobPoolSize == 0)
+        {
+            // Every slot holds a job that hasn't run yet
+            JobSystemRunNext(System, JobWorkerIndex != 0);
+        }
+    }
+
+    Job->bIsInUse.store(true, std::memory_order_relaxed);
+    Job->Name = Name;
+    Job->Counter = Counter;
+    if(Counter)
+    {
+        Counter->Count.fetch_add(1);
+    }
+    return Job;
+}
+
+template<typename F>
+SJob* JobSystemCreateJob(SJobSystem* System, const char* Name, SJobCounter* Counter, const F& Function)
+{
+    static_assert(sizeof(F) <= JobPayloadSize, "Job captures too much, capture a pointer to the data instead");
+    static_assert(alignof(F) <= 16, "Job capture alignment too large");
+    static_assert(std::is_trivially_copyable<F>::value && std::is_trivially_destructible<F>::value,
+                  "Jobs are copied around as bytes and never destroyed, only capture plain data");
+
+    SJob* Job = JobSystemAllocateJob(System, Name, Counter);
+    new(Job->Payload) F(Function);
+    Job->Function = [](void* Payload)
+    {
+        (*(F*)Payload)();
+    };
+    return Job;
+}
+
+// Name has to be a string literal (or otherwise outlive the job system), it identifies the job in the timings.
+// Counter may be null.
+template<typename F>
+void JobSystemAdd(SJobSystem* System, const char* Name, SJobCounter* Counter, const F& Function)
+{
+    JobSystemPush(System, JobSystemCreateJob(System, Name, Counter, Function));
+}
+
+// The job is only queued once Dependency reaches zero
+template<typename F>
+void JobSystemAddAfter(SJobSystem* System, const char* Name, SJobCounter* Dependency, SJobCounter* Counter, const F& Function)
+{
+    SJob* Job = JobSystemCreateJob(System, Name, Counter, Function);
+    {
+        std::lock_guard<std::mutex> Lock(Dependency->Mutex);
+        if(Dependency->Count.load(std::memory_order_acquire) > 0)
+        {
+            Dependency->Continuations.push_back(Job);
+            return;
+        }
+    }
+    JobSystemPush(System, Job);
+}
+
+// For long running jobs nothing on the main thread waits for every frame
+template<typename F>
+void JobSystemAddBackground(SJobSystem* System, const char* Name, SJobCounter* Counter, const F& Function)
+{
+    SJob* Job = JobSystemCreateJob(System, Name, Counter, Function);
+    if(System->WorkerCount == 1)
+    {
+        JobSystemExecute(System, Job);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock(System->BackgroundMutex);
+        System->BackgroundJobs.push_back(Job);
+    }
+    System->QueuedCount.fetch_add(1);
+    JobSystemWakeWorker(System);
+}
+
+// Runs other jobs until every job added with Counter is done
+void JobSystemWait(SJobSystem* System, SJobCounter* Counter)
+{
+    uint32_t IdleCount = 0;
+    while(Counter->Count.load(std::memory_order_acquire) > 0)
+    {
+        // The main thread leaves background jobs to the workers
+        if(JobSystemRunNext(System, JobWorkerIndex != 0))
+        {
+            IdleCount = 0;
+        }
+        else if(++IdleCount >= JobSpinCount)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // The last job may still hold the mutex, the counter can only go away after that
+    std::lock_guard<std::mutex> Lock(Counter->Mutex);
+}
+
+// Per name totals over every worker, the longest total first
+void JobSystemPrintStats(const SJobSystem* System)
+{
+    std::vector<SJobStats> Totals;
+    uint64_t RunCount = 0;
+    uint64_t StolenCount = 0;
+    for(uint32_t WorkerIndex = 0; WorkerIndex < System->WorkerCount; ++WorkerIndex)
+    {
+        const SJobWorker& Worker = System->Workers[WorkerIndex];
+        RunCount += Worker.RunCount;
+        StolenCount += Worker.StolenCount;
+
+        for(const SJobStats& Stats : Worker.Stats)
+        {
+            auto It = std::find_if(Totals.begin(), Totals.end(), [&Stats](const SJobStats& Total)
+            {
+                return strcmp(Total.Name, Stats.Name) == 0;
+            });
+            if(It == Totals.end())
+            {
+                Totals.push_back(Stats);
+            }
+            else
+            {
+                It->RunCount += Stats.RunCount;
+                It->TotalNs += Stats.TotalNs;
+                It->MaxNs = std::max(It->MaxNs, Stats.MaxNs);
+            }
+        }
+    }
+
+    std::sort(Totals.begin(), Totals.end(), [](const SJobStats& A, const SJobStats& B)
+    {
+        return A.TotalNs > B.TotalNs;
+    });
+
+    printf("Jobs: %u workers, %" PRIu64 " jobs run, %" PRIu64 " stolen\n", System->WorkerCount, RunCount, StolenCount);
+    for(const SJobStats& Total : Totals)
+    {
+        printf("  %-24s %8" PRIu64 " runs, %10.3fms total, %9.1fus avg, %9.1fus max\n", Total.Name, Total.RunCount,
+               (double)Total.TotalNs / 1000000.0, (double)Total.TotalNs / (1000.0 * Total.RunCount), (double)Total.MaxNs / 1000.0);
+    }
+
+    double ElapsedNs = (double)(PlatformGetTimeNs() - System->StartTimeNs);
+    printf("  Worker utilization:");
+    for(uint32_t WorkerIndex = 0; WorkerIndex < System->WorkerCount; ++WorkerIndex)
+    {
+        printf(" %.1f%%", ElapsedNs > 0.0 ? 100.0 * (double)System->Workers[WorkerIndex].BusyNs / ElapsedNs : 0.0);
+    }
+    printf("\n");
+}
+
+// Chrome trace event format, one track per worker
+bool JobSystemWriteTrace(const SJobSystem* System, const char* Path)
+{
+    FILE* File = fopen(Path, "w");
+    if(!File)
+    {
+        printf("Couldn't open job trace %s\n", Path);
+        return false;
+    }
+
+    fprintf(File, "{\"traceEvents\":[\n");
+    bool bIsFirst = true;
+    for(uint32_t WorkerIndex = 0; WorkerIndex < System->WorkerCount; ++WorkerIndex)
+    {
+        fprintf(File, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                bIsFirst ? "" : ",\n", WorkerIndex, WorkerIndex == 0 ? "Main" : "Worker", WorkerIndex);
+        bIsFirst = false;
+
+        for(const SJobTraceEvent& Event : System->Workers[WorkerIndex].Trace)
+        {
+            fprintf(File, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    Event.Name, WorkerIndex, (double)(Event.StartNs - System->StartTimeNs) / 1000.0, (double)(Event.EndNs - Event.StartNs) / 1000.0);
+        }
+    }
+    fprintf(File, "\n]}\n");
+    fclose(File);
+    return true;
+}
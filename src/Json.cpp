@@ -0,0 +1,273 @@
+//
+// Minimal JSON DOM parser, enough for glTF: no \u escapes beyond the basic multilingual plane, numbers are doubles.
+//
+
+#include <string>
+
+enum EJsonType
+{
+    Json_Null,
+    Json_Bool,
+    Json_Number,
+    Json_String,
+    Json_Array,
+    Json_Object,
+};
+
+struct SJsonValue
+{
+    EJsonType Type = Json_Null;
+    bool Bool = false;
+    double Number = 0.0;
+    std::string String;
+    std::vector<SJsonValue> Array;
+    std::vector<std::pair<std::string, SJsonValue>> Object;
+
+    // Both return a null value for missing members/elements or mismatching types, so lookups can be chained
+    const SJsonValue& operator[](const char* Key) const
+    {
+        static const SJsonValue Null;
+        for(const auto& Member : Object)
+        {
+            if(Member.first == Key)
+            {
+                return Member.second;
+            }
+        }
+        return Null;
+    }
+
+    const SJsonValue& At(size_t Index) const
+    {
+        static const SJsonValue Null;
+        return (Index < Array.size()) ? Array[Index] : Null;
+    }
+
+    bool IsNull() const { return Type == Json_Null; }
+    double GetNumber(double Default = 0.0) const { return (Type == Json_Number) ? Number : Default; }
+    uint32_t GetUInt(uint32_t Default = 0) const { return (Type == Json_Number) ? (uint32_t)Number : Default; }
+};
+
+struct SJsonParser
+{
+    const char* At;
+    const char* End;
+    bool bError;
+};
+
+static void JsonSkipWhitespace(SJsonParser* Parser)
+{
+    while(Parser->At < Parser->End && (*Parser->At == ' ' || *Parser->At == '\t' || *Parser->At == '\n' || *Parser->At == '\r'))
+    {
+        Parser->At++;
+    }
+}
+
+static bool JsonMatch(SJsonParser* Parser, const char* Literal)
+{
+    size_t Length = strlen(Literal);
+    if((size_t)(Parser->End - Parser->At) >= Length && memcmp(Parser->At, Literal, Length) == 0)
+    {
+        Parser->At += Length;
+        return true;
+    }
+    return false;
+}
+
+static bool JsonParseString(SJsonParser* Parser, std::string* String)
+{
+    if(Parser->At >= Parser->End || *Parser->At != '"')
+    {
+        return false;
+    }
+    Parser->At++;
+
+    while(Parser->At < Parser->End && *Parser->At != '"')
+    {
+        char C = *Parser->At++;
+        if(C != '\\')
+        {
+            String->push_back(C);
+            continue;
+        }
+
+        if(Parser->At >= Parser->End)
+        {
+            return false;
+        }
+        C = *Parser->At++;
+        switch(C)
+        {
+            case 'b': String->push_back('\b'); break;
+            case 'f': String->push_back('\f'); break;
+            case 'n': String->push_back('\n'); break;
+            case 'r': String->push_back('\r'); break;
+            case 't': String->push_back('\t'); break;
+            case 'u':
+            {
+                if(Parser->End - Parser->At < 4)
+                {
+                    return false;
+                }
+                uint32_t CodePoint = (uint32_t)strtoul(std::string(Parser->At, 4).c_str(), nullptr, 16);
+                Parser->At += 4;
+
+                // UTF-8 encode
+                if(CodePoint < 0x80)
+                {
+                    String->push_back((char)CodePoint);
+                }
+                else if(CodePoint < 0x800)
+                {
+                    String->push_back((char)(0xC0 | (CodePoint >> 6)));
+                    String->push_back((char)(0x80 | (CodePoint & 0x3F)));
+                }
+                else
+                {
+                    String->push_back((char)(0xE0 | (CodePoint >> 12)));
+                    String->push_back((char)(0x80 | ((CodePoint >> 6) & 0x3F)));
+                    String->push_back((char)(0x80 | (CodePoint & 0x3F)));
+                }
+            } break;
+            default: String->push_back(C); break;
+        }
+    }
+
+    if(Parser->At >= Parser->End)
+    {
+        return false;
+    }
+    Parser->At++;
+    return true;
+}
+
+static void JsonParseValue(SJsonParser* Parser, SJsonValue* Value, uint32_t Depth)
+{
+    JsonSkipWhitespace(Parser);
+    if(Parser->At >= Parser->End || Depth > 64)
+    {
+        Parser->bError = true;
+        return;
+    }
+
+    char C = *Parser->At;
+    if(C == '{')
+    {
+        Value->Type = Json_Object;
+        Parser->At++;
+        JsonSkipWhitespace(Parser);
+        if(Parser->At < Parser->End && *Parser->At == '}')
+        {
+            Parser->At++;
+            return;
+        }
+
+        while(!Parser->bError)
+        {
+            JsonSkipWhitespace(Parser);
+            std::pair<std::string, SJsonValue> Member;
+            if(!JsonParseString(Parser, &Member.first))
+            {
+                Parser->bError = true;
+                return;
+            }
+
+            JsonSkipWhitespace(Parser);
+            if(!JsonMatch(Parser, ":"))
+            {
+                Parser->bError = true;
+                return;
+            }
+
+            JsonParseValue(Parser, &Member.second, Depth + 1);
+            Value->Object.push_back(std::move(Member));
+
+            JsonSkipWhitespace(Parser);
+            if(JsonMatch(Parser, "}"))
+            {
+                return;
+            }
+            if(!JsonMatch(Parser, ","))
+            {
+                Parser->bError = true;
+            }
+        }
+    }
+    else if(C == '[')
+    {
+        Value->Type = Json_Array;
+        Parser->At++;
+        JsonSkipWhitespace(Parser);
+        if(Parser->At < Parser->End && *Parser->At == ']')
+        {
+            Parser->At++;
+            return;
+        }
+
+        while(!Parser->bError)
+        {
+            Value->Array.emplace_back();
+            JsonParseValue(Parser, &Value->Array.back(), Depth + 1);
+
+            JsonSkipWhitespace(Parser);
+            if(JsonMatch(Parser, "]"))
+            {
+                return;
+            }
+            if(!JsonMatch(Parser, ","))
+            {
+                Parser->bError = true;
+            }
+        }
+    }
+    else if(C == '"')
+    {
+        Value->Type = Json_String;
+        if(!JsonParseString(Parser, &Value->String))
+        {
+            Parser->bError = true;
+        }
+    }
+    else if(JsonMatch(Parser, "true"))
+    {
+        Value->Type = Json_Bool;
+        Value->Bool = true;
+    }
+    else if(JsonMatch(Parser, "false"))
+    {
+        Value->Type = Json_Bool;
+        Value->Bool = false;
+    }
+    else if(JsonMatch(Parser, "null"))
+    {
+        Value->Type = Json_Null;
+    }
+    else
+    {
+        // strtod needs a terminated string, numbers are short
+        char Number[64] = {};
+        size_t Length = 0;
+        while(Parser->At + Length < Parser->End && Length < sizeof(Number) - 1 && strchr("+-0123456789.eE", Parser->At[Length]))
+        {
+            Number[Length] = Parser->At[Length];
+            Length++;
+        }
+
+        char* NumberEnd = nullptr;
+        Value->Type = Json_Number;
+        Value->Number = strtod(Number, &NumberEnd);
+        if(Length == 0 || NumberEnd != Number + Length)
+        {
+            Parser->bError = true;
+        }
+        Parser->At += Length;
+    }
+}
+
+bool JsonParse(const char* Text, size_t Length, SJsonValue* Root)
+{
+    SJsonParser Parser = { Text, Text + Length, false };
+    JsonParseValue(&Parser, Root, 0);
+    JsonSkipWhitespace(&Parser);
+    return !Parser.bError && Parser.At == Parser.End;
+}
@@ -0,0 +1,229 @@
+//
+// KTX2 container loading.
+//
+// Only 2D textures (single layer and face) are supported. The level data is kept in the Vulkan layout it's
+// stored in, so block compressed formats (BCn, ETC2, ASTC) are uploaded as they are.
+// Supercompression: none and ZLIB are decoded here, Zstandard and BasisLZ would need external libraries
+// and are rejected.
+//
+
+#include "Inflate.cpp"
+
+enum EKTX2Supercompression
+{
+    KTX2Supercompression_None = 0,
+    KTX2Supercompression_BasisLZ = 1,
+    KTX2Supercompression_Zstd = 2,
+    KTX2Supercompression_Zlib = 3,
+};
+
+struct SFormatBlockInfo
+{
+    uint32_t BlockWidth;
+    uint32_t BlockHeight;
+    uint32_t BlockSize;
+};
+
+struct SKTX2Texture
+{
+    VkFormat Format;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t LevelCount;
+    SFormatBlockInfo BlockInfo;
+
+    // Uncompressed data for every level, level 0 is the largest
+    std::vector<std::vector<uint8_t>> Levels;
+};
+
+bool GetFormatBlockInfo(VkFormat Format, SFormatBlockInfo* Info)
+{
+    *Info = { 1, 1, 0 };
+    switch(Format)
+    {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SRGB:
+            Info->BlockSize = 1;
+            break;
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R8G8_SRGB:
+            Info->BlockSize = 2;
+            break;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            Info->BlockSize = 4;
+            break;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            Info->BlockSize = 8;
+            break;
+
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+            *Info = { 4, 4, 8 };
+            break;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+            *Info = { 4, 4, 16 };
+            break;
+
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK: case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: *Info = { 4, 4, 16 }; break;
+        case VK_FORMAT_ASTC_5x4_UNORM_BLOCK: case VK_FORMAT_ASTC_5x4_SRGB_BLOCK: *Info = { 5, 4, 16 }; break;
+        case VK_FORMAT_ASTC_5x5_UNORM_BLOCK: case VK_FORMAT_ASTC_5x5_SRGB_BLOCK: *Info = { 5, 5, 16 }; break;
+        case VK_FORMAT_ASTC_6x5_UNORM_BLOCK: case VK_FORMAT_ASTC_6x5_SRGB_BLOCK: *Info = { 6, 5, 16 }; break;
+        case VK_FORMAT_ASTC_6x6_UNORM_BLOCK: case VK_FORMAT_ASTC_6x6_SRGB_BLOCK: *Info = { 6, 6, 16 }; break;
+        case VK_FORMAT_ASTC_8x5_UNORM_BLOCK: case VK_FORMAT_ASTC_8x5_SRGB_BLOCK: *Info = { 8, 5, 16 }; break;
+        case VK_FORMAT_ASTC_8x6_UNORM_BLOCK: case VK_FORMAT_ASTC_8x6_SRGB_BLOCK: *Info = { 8, 6, 16 }; break;
+        case VK_FORMAT_ASTC_8x8_UNORM_BLOCK: case VK_FORMAT_ASTC_8x8_SRGB_BLOCK: *Info = { 8, 8, 16 }; break;
+        case VK_FORMAT_ASTC_10x5_UNORM_BLOCK: case VK_FORMAT_ASTC_10x5_SRGB_BLOCK: *Info = { 10, 5, 16 }; break;
+        case VK_FORMAT_ASTC_10x6_UNORM_BLOCK: case VK_FORMAT_ASTC_10x6_SRGB_BLOCK: *Info = { 10, 6, 16 }; break;
+        case VK_FORMAT_ASTC_10x8_UNORM_BLOCK: case VK_FORMAT_ASTC_10x8_SRGB_BLOCK: *Info = { 10, 8, 16 }; break;
+        case VK_FORMAT_ASTC_10x10_UNORM_BLOCK: case VK_FORMAT_ASTC_10x10_SRGB_BLOCK: *Info = { 10, 10, 16 }; break;
+        case VK_FORMAT_ASTC_12x10_UNORM_BLOCK: case VK_FORMAT_ASTC_12x10_SRGB_BLOCK: *Info = { 12, 10, 16 }; break;
+        case VK_FORMAT_ASTC_12x12_UNORM_BLOCK: case VK_FORMAT_ASTC_12x12_SRGB_BLOCK: *Info = { 12, 12, 16 }; break;
+
+        default:
+            return false;
+    }
+    return true;
+}
+
+inline uint32_t GetMipDimension(uint32_t Dimension, uint32_t Level)
+{
+    return std::max(Dimension >> Level, 1u);
+}
+
+// Size in bytes of a single block row and the number of block rows in a mip level
+inline void GetMipBlockRows(const SKTX2Texture* Texture, uint32_t Level, uint32_t* BlockRowSize, uint32_t* BlockRowCount)
+{
+    const SFormatBlockInfo& Info = Texture->BlockInfo;
+    uint32_t BlocksX = (GetMipDimension(Texture->Width, Level) + Info.BlockWidth - 1) / Info.BlockWidth;
+    uint32_t BlocksY = (GetMipDimension(Texture->Height, Level) + Info.BlockHeight - 1) / Info.BlockHeight;
+    *BlockRowSize = BlocksX * Info.BlockSize;
+    *BlockRowCount = BlocksY;
+}
+
+static uint32_t KTX2ReadU32(const uint8_t* Data)
+{
+    return (uint32_t)Data[0] | ((uint32_t)Data[1] << 8) | ((uint32_t)Data[2] << 16) | ((uint32_t)Data[3] << 24);
+}
+
+static uint64_t KTX2ReadU64(const uint8_t* Data)
+{
+    return (uint64_t)KTX2ReadU32(Data) | ((uint64_t)KTX2ReadU32(Data + 4) << 32);
+}
+
+// Parses the container and decodes every level. Prints the reason and returns false for anything unsupported.
+bool KTX2Load(const char* Path, SKTX2Texture* Texture)
+{
+    static const uint8_t Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    constexpr size_t HeaderSize = 80;
+    constexpr size_t LevelIndexEntrySize = 24;
+
+    FILE* File = fopen(Path, "rb");
+    if(!File)
+    {
+        printf("KTX2: couldn't open %s\n", Path);
+        return false;
+    }
+
+    fseek(File, 0, SEEK_END);
+    size_t FileSize = (size_t)ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    std::vector<uint8_t> FileData(FileSize);
+    size_t BytesRead = fread(FileData.data(), 1, FileSize, File);
+    fclose(File);
+
+    const uint8_t* Data = FileData.data();
+    if(BytesRead != FileSize || FileSize < HeaderSize || memcmp(Data, Identifier, sizeof(Identifier)) != 0)
+    {
+        printf("KTX2: %s is not a KTX2 file\n", Path);
+        return false;
+    }
+
+    Texture->Format = (VkFormat)KTX2ReadU32(Data + 12);
+    Texture->Width = KTX2ReadU32(Data + 20);
+    Texture->Height = KTX2ReadU32(Data + 24);
+    uint32_t Depth = KTX2ReadU32(Data + 28);
+    uint32_t LayerCount = KTX2ReadU32(Data + 32);
+    uint32_t FaceCount = KTX2ReadU32(Data + 36);
+    Texture->LevelCount = std::max(KTX2ReadU32(Data + 40), 1u);
+    uint32_t Supercompression = KTX2ReadU32(Data + 44);
+
+    if(Depth > 1 || LayerCount > 1 || FaceCount != 1 || Texture->Width == 0 || Texture->Height == 0)
+    {
+        printf("KTX2: %s is not a 2D texture\n", Path);
+        return false;
+    }
+    if(Texture->LevelCount > 32 || HeaderSize + Texture->LevelCount * LevelIndexEntrySize > FileSize)
+    {
+        printf("KTX2: %s has an invalid level index\n", Path);
+        return false;
+    }
+    if(!GetFormatBlockInfo(Texture->Format, &Texture->BlockInfo))
+    {
+        printf("KTX2: %s has unsupported format %u (Basis Universal textures need transcoding)\n", Path, (uint32_t)Texture->Format);
+        return false;
+    }
+    if(Supercompression != KTX2Supercompression_None && Supercompression != KTX2Supercompression_Zlib)
+    {
+        printf("KTX2: %s uses unsupported supercompression scheme %u\n", Path, Supercompression);
+        return false;
+    }
+
+    Texture->Levels.resize(Texture->LevelCount);
+    for(uint32_t Level = 0; Level < Texture->LevelCount; ++Level)
+    {
+        const uint8_t* Entry = Data + HeaderSize + Level * LevelIndexEntrySize;
+        uint64_t ByteOffset = KTX2ReadU64(Entry);
+        uint64_t ByteLength = KTX2ReadU64(Entry + 8);
+        uint64_t UncompressedByteLength = KTX2ReadU64(Entry + 16);
+
+        uint32_t BlockRowSize, BlockRowCount;
+        GetMipBlockRows(Texture, Level, &BlockRowSize, &BlockRowCount);
+        uint64_t ExpectedSize = (uint64_t)BlockRowSize * BlockRowCount;
+
+        if(ByteOffset + ByteLength > FileSize ||
+           (Supercompression == KTX2Supercompression_None && ByteLength != ExpectedSize) ||
+           (Supercompression == KTX2Supercompression_Zlib && UncompressedByteLength != ExpectedSize))
+        {
+            printf("KTX2: %s level %u has an unexpected size\n", Path, Level);
+            return false;
+        }
+
+        std::vector<uint8_t>& LevelData = Texture->Levels[Level];
+        LevelData.resize((size_t)ExpectedSize);
+        if(Supercompression == KTX2Supercompression_Zlib)
+        {
+            if(!ZlibDecompress(Data + ByteOffset, (size_t)ByteLength, LevelData.data(), LevelData.size()))
+            {
+                printf("KTX2: %s level %u failed to decompress\n", Path, Level);
+                return false;
+            }
+        }
+        else
+        {
+            memcpy(LevelData.data(), Data + ByteOffset, LevelData.size());
+        }
+    }
+
+    return true;
+}
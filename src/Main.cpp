@@ -1,979 +1,2494 @@
-#include <cstdio>
-#include <cassert>
-#include <cassert>
-
-#include <vulkan/vulkan.h>
-#include <Windows.h>
-#include <vulkan/vulkan_win32.h>
-
-#include <cinttypes>
-#include <vector>
-#include <array>
-#include <cstring>
-
-#define ArrayCount(a) (sizeof((a)) / sizeof((a)[0]))
-
-#undef min
-#undef max
-
-template<typename T>
-T Clamp(T Val, T Min, T Max)
-{
-    return std::max(Min, std::min(Val, Max));
-}
-
-struct SVulkanVersion
-{
-    uint32_t ApiVersion;
-    uint32_t MajorVersion;
-    uint32_t MinorVersion;
-    uint32_t PatchVersion;
-};
-
-inline SVulkanVersion VulkanExtractVersion(uint32_t ApiVersion)
-{
-    SVulkanVersion Version = {};
-    Version.ApiVersion = ApiVersion;
-    Version.MajorVersion = VK_VERSION_MAJOR(ApiVersion);
-    Version.MinorVersion = VK_VERSION_MINOR(ApiVersion);
-    Version.PatchVersion = VK_VERSION_PATCH(ApiVersion);
-    return Version;
-}
-
-struct SVulkanLayer
-{
-    VkLayerProperties Properties;
-    std::vector<VkExtensionProperties> Extensions;
-};
-
-struct SVulkanPhysicalDevice
-{
-    VkPhysicalDevice Device;
-
-    SVulkanVersion Version;
-
-    VkPhysicalDeviceProperties Properties;
-    VkPhysicalDeviceFeatures Features;
-    VkPhysicalDeviceMemoryProperties MemoryProperties;
-    std::vector<SVulkanLayer> Layers;
-    std::vector<VkExtensionProperties> Extensions;
-    std::vector<VkQueueFamilyProperties> QueueFamilies;
-};
-
-struct SVulkanState
-{
-    SVulkanVersion Version;
-
-    std::vector<SVulkanLayer> InstanceLayers;
-    std::vector<VkExtensionProperties> InstanceExtensions;
-
-    VkInstance Instance;
-
-    std::vector<SVulkanPhysicalDevice> PhysicalDevices;
-
-    VkPhysicalDevice SelectedDevice = VK_NULL_HANDLE;
-    uint32_t SelectedDeviceQueueFamilyIndex = 0;
-
-    VkSurfaceKHR Surface;
-    VkExtent2D SurfaceExtent;
-    VkFormat SurfaceFormat;
-    VkColorSpaceKHR SurfaceColorSpace;
-
-    VkPresentModeKHR SurfacePresentMode;
-    VkSurfaceCapabilitiesKHR SurfaceCapabilities;
-
-    VkDevice Device;
-    VkQueue Queue;
-
-    VkSwapchainKHR Swapchain;
-    std::vector<VkImage> SwapchainImages;
-    std::vector<VkImageView> SwapchainImageViews;
-
-    VkShaderModule Shader;
-
-    VkRenderPass RenderPass;
-    VkPipeline Pipeline;
-
-    std::vector<VkFramebuffer> Framebuffers;
-
-    VkCommandPool CommandPool;
-    std::vector<VkCommandBuffer> CommandBuffers;
-};
-
-
-VkBool32 DebugCallback(VkDebugReportFlagsEXT Flags, VkDebugReportObjectTypeEXT ObjectType, uint64_t Object, size_t Location,
-                       int32_t MessageCode, const char* LayerPrefix, const char* Message, void* pUserData)
-{
-    printf("%s\n", Message);
-    return VK_FALSE;
-}
-
-struct SBuffer
-{
-    uint32_t Size;
-    void* Data;
-};
-
-void ReleaseBuffer(SBuffer* Buffer)
-{
-    delete[] Buffer->Data;
-    Buffer->Size = 0;
-    Buffer->Data = nullptr;
-}
-
-SBuffer win32LoadFile(const char* Path)
-{
-    SBuffer Buffer = {};
-
-    HANDLE File = CreateFile(Path, GENERIC_READ, FILE_SHARE_READ, nullptr,
-                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-
-    if(File && File != INVALID_HANDLE_VALUE)
-    {
-        Buffer.Size = GetFileSize(File, nullptr);
-        Buffer.Data = new uint8_t[Buffer.Size];
-
-        DWORD BytesRead;
-        ReadFile(File, Buffer.Data, Buffer.Size, &BytesRead, nullptr);
-
-        assert(BytesRead == Buffer.Size);
-        CloseHandle(File);
-    }
-    else
-    {
-        assert(!"Invalid file");
-    }
-    return Buffer;
-}
-
-LRESULT CALLBACK win32MainWindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam)
-{
-    LRESULT Result = 0;
-
-    switch(Message)
-    {
-        case WM_CLOSE:
-            PostQuitMessage(0);
-            break;
-        default:
-            Result = DefWindowProc(Window, Message, WParam, LParam);
-            break;
-    }
-
-    return Result;
-}
-
-HWND win32OpenWindow(const char* Title, int32_t Width, int32_t Height)
-{
-    static uint32_t _CallCount = 0;
-    assert(_CallCount++ == 0);
-
-    WNDCLASS WindowClass = {};
-    WindowClass.style = CS_OWNDC;
-    WindowClass.lpfnWndProc = &win32MainWindowProc;
-    WindowClass.hInstance = nullptr;
-    WindowClass.lpszClassName = "vkclass";
-
-    assert(RegisterClass(&WindowClass));
-    
-    int32_t MonitorWidth, MonitorHeight;
-    {
-        POINT P = { 0, 0 };
-        HMONITOR Monitor = MonitorFromPoint(P, MONITOR_DEFAULTTOPRIMARY);
-
-        MONITORINFO MonitorInfo = { sizeof(MONITORINFO) };
-        GetMonitorInfo(Monitor, &MonitorInfo);
-
-        MonitorWidth = MonitorInfo.rcMonitor.right - MonitorInfo.rcMonitor.left;
-        MonitorHeight = MonitorInfo.rcMonitor.bottom - MonitorInfo.rcMonitor.top;
-    }
-
-    RECT WindowRect = {};
-    WindowRect.left = (MonitorWidth - Width) / 2;
-    WindowRect.right = WindowRect.left + Width;
-    WindowRect.top = (MonitorHeight - Height) / 2;
-    WindowRect.bottom = WindowRect.top + Height;
-
-    DWORD WindowStyle = WS_OVERLAPPEDWINDOW & (~WS_MAXIMIZEBOX) & (~WS_THICKFRAME);
-    AdjustWindowRect(&WindowRect, WindowStyle, FALSE);
-
-    HWND Window = CreateWindow(WindowClass.lpszClassName, Title, WindowStyle,
-                               WindowRect.left, WindowRect.top,
-                               WindowRect.right - WindowRect.left,
-                               WindowRect.bottom - WindowRect.top,
-                               nullptr, nullptr, nullptr, nullptr);
-
-    assert(Window);
-
-    ShowWindow(Window, SW_SHOW);
-
-    return Window;
-}
-
-int main(int ArgCount, char** Args)
-{
-    constexpr uint32_t Width = 800;
-    constexpr uint32_t Height = 600;
-
-    HINSTANCE Instance = GetModuleHandle(nullptr);
-
-    HWND Window = win32OpenWindow("vktest", Width, Height);
-
-    VkResult Result = VK_SUCCESS;
-
-    SVulkanState VulkanState = {};
-
-    // Enumerate version
-    {
-        uint32_t ApiVersion;
-        vkEnumerateInstanceVersion(&ApiVersion);
-
-        VulkanState.Version = VulkanExtractVersion(ApiVersion);
-
-        assert(VulkanState.Version.MajorVersion >= 1 && VulkanState.Version.MinorVersion >= 1);
-    }
-
-    // Enumerate instance layers and extensions
-    {
-        // Global extensions
-        {
-            uint32_t ExtensionCount;
-            vkEnumerateInstanceExtensionProperties(nullptr, &ExtensionCount, nullptr);
-            VulkanState.InstanceExtensions.resize(ExtensionCount);
-            vkEnumerateInstanceExtensionProperties(nullptr, &ExtensionCount, VulkanState.InstanceExtensions.data());
-        }
-
-        // Layers and layer extensions
-        uint32_t LayerCount;
-        vkEnumerateInstanceLayerProperties(&LayerCount, nullptr);
-        std::vector<VkLayerProperties> LayerProperties(LayerCount);
-        vkEnumerateInstanceLayerProperties(&LayerCount, LayerProperties.data());
-
-        // SoA to AoS conversion
-        VulkanState.InstanceLayers.resize(LayerCount);
-        for(uint32_t LayerIndex = 0; LayerIndex < LayerCount; ++LayerIndex)
-        {
-            SVulkanLayer& Layer = VulkanState.InstanceLayers[LayerIndex];
-            Layer.Properties = LayerProperties[LayerIndex];
-
-            uint32_t ExtensionCount;
-            vkEnumerateInstanceExtensionProperties(Layer.Properties.layerName, &ExtensionCount, nullptr);
-            Layer.Extensions.resize(ExtensionCount);
-            vkEnumerateInstanceExtensionProperties(Layer.Properties.layerName, &ExtensionCount, Layer.Extensions.data());
-        }
-    }
-
-    // Create instance
-    {
-        VkApplicationInfo AppInfo = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
-        AppInfo.pNext = nullptr;
-        AppInfo.pApplicationName = "Ladybug";
-        AppInfo.applicationVersion = 1;
-        AppInfo.pEngineName = "LadybugEngine";
-        AppInfo.engineVersion = 1;
-        AppInfo.apiVersion = VK_API_VERSION_1_1;
-
-
-        const char* const Extensions[] =
-        {
-            VK_KHR_SURFACE_EXTENSION_NAME,
-            VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
-            VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
-            VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
-        };
-
-        constexpr uint32_t ExtensionCount = ArrayCount(Extensions);
-
-        // Find required extensions
-        std::array<bool, ExtensionCount> ExtensionsFound = {};
-        for(const VkExtensionProperties& Extension : VulkanState.InstanceExtensions)
-        {
-            for(uint32_t i = 0; i < ExtensionCount; ++i)
-            {
-                if(strcmp(Extension.extensionName, Extensions[i]) == 0)
-                {
-                    ExtensionsFound[i] = true;
-                }
-            }
-        }
-
-        if(std::find(ExtensionsFound.begin(), ExtensionsFound.end(), false) != ExtensionsFound.end())
-        {
-            printf("Unavailable extension\n");
-            return -1;
-        }
-
-        const char* const Layers[] =
-        {
-            "VK_LAYER_KHRONOS_validation",
-        };
-
-        constexpr uint32_t LayerCount = ArrayCount(Layers);
-
-        // Find required layers
-        std::array<bool, LayerCount> LayersFound = {};
-        for(const SVulkanLayer& Layer : VulkanState.InstanceLayers)
-        {
-            for(uint32_t i = 0; i < LayerCount; ++i)
-            {
-                if(strcmp(Layer.Properties.layerName, Layers[i]) == 0)
-                {
-                    LayersFound[i] = true;
-                }
-            }
-        }
-
-        if(std::find(LayersFound.begin(), LayersFound.end(), false) != LayersFound.end())
-        {
-            printf("Unavailable layer\n");
-            return -1;
-        }
-
-        VkInstanceCreateInfo InstanceCreateInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
-        InstanceCreateInfo.pNext = nullptr;
-        InstanceCreateInfo.flags = 0;
-        InstanceCreateInfo.pApplicationInfo = &AppInfo;
-        InstanceCreateInfo.enabledExtensionCount = ExtensionCount;
-        InstanceCreateInfo.ppEnabledExtensionNames = Extensions;
-        InstanceCreateInfo.enabledLayerCount = LayerCount;
-        InstanceCreateInfo.ppEnabledLayerNames = Layers;
-
-        Result = vkCreateInstance(&InstanceCreateInfo, nullptr, &VulkanState.Instance);
-        assert(Result == VK_SUCCESS);
-    }
-
-    // Initialize debug callback
-    PFN_vkCreateDebugReportCallbackEXT vkCreateDebugReportCallback = VK_NULL_HANDLE;
-    vkCreateDebugReportCallback = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(VulkanState.Instance, "vkCreateDebugReportCallbackEXT");
-    if(vkCreateDebugReportCallback)
-    {
-
-        VkDebugReportCallbackCreateInfoEXT DebugReportCallbackCreateInfo = { VK_STRUCTURE_TYPE_DEBUG_REPORT_CREATE_INFO_EXT };
-        DebugReportCallbackCreateInfo.pNext = nullptr;
-        DebugReportCallbackCreateInfo.flags = VK_DEBUG_REPORT_WARNING_BIT_EXT|VK_DEBUG_REPORT_ERROR_BIT_EXT|VK_DEBUG_REPORT_DEBUG_BIT_EXT;
-        DebugReportCallbackCreateInfo.pfnCallback = &DebugCallback;
-        DebugReportCallbackCreateInfo.pUserData = nullptr;
-
-        VkDebugReportCallbackEXT DebugCallbackObj;
-        vkCreateDebugReportCallback(VulkanState.Instance, &DebugReportCallbackCreateInfo, nullptr, &DebugCallbackObj);
-    }
-
-    // Enumerate physical devices
-    {
-        uint32_t PhysicalDeviceCount;
-        vkEnumeratePhysicalDevices(VulkanState.Instance, &PhysicalDeviceCount, nullptr);
-        std::vector<VkPhysicalDevice> PhysicalDevices(PhysicalDeviceCount);
-        vkEnumeratePhysicalDevices(VulkanState.Instance, &PhysicalDeviceCount, PhysicalDevices.data());
-
-        VulkanState.PhysicalDevices.resize(PhysicalDeviceCount);
-        for(uint32_t DeviceIndex = 0; DeviceIndex < PhysicalDeviceCount; ++DeviceIndex)
-        {
-            SVulkanPhysicalDevice& Device = VulkanState.PhysicalDevices[DeviceIndex];
-            Device.Device = PhysicalDevices[DeviceIndex];
-
-            // Get device properties
-            vkGetPhysicalDeviceProperties(Device.Device, &Device.Properties);
-            Device.Version = VulkanExtractVersion(Device.Properties.apiVersion);
-
-            // Get device memory properties
-            vkGetPhysicalDeviceMemoryProperties(Device.Device, &Device.MemoryProperties);
-
-            // Get device features
-            vkGetPhysicalDeviceFeatures(Device.Device, &Device.Features);
-
-            // Get queue families
-            {
-                uint32_t QueueFamilyCount;
-                vkGetPhysicalDeviceQueueFamilyProperties(Device.Device, &QueueFamilyCount, nullptr);
-                Device.QueueFamilies.resize(QueueFamilyCount);
-                vkGetPhysicalDeviceQueueFamilyProperties(Device.Device, &QueueFamilyCount, Device.QueueFamilies.data());
-            }
-
-            // Enumerate global device extensions
-            {
-                uint32_t ExtensionCount;
-                vkEnumerateDeviceExtensionProperties(Device.Device, nullptr, &ExtensionCount, nullptr);
-                Device.Extensions.resize(ExtensionCount);
-                vkEnumerateDeviceExtensionProperties(Device.Device, nullptr, &ExtensionCount, Device.Extensions.data());
-            }
-
-            // Enumerate device layers
-            uint32_t DeviceLayerCount;
-            vkEnumerateDeviceLayerProperties(Device.Device, &DeviceLayerCount, nullptr);
-            std::vector<VkLayerProperties> DeviceLayers(DeviceLayerCount);
-            vkEnumerateDeviceLayerProperties(Device.Device, &DeviceLayerCount, DeviceLayers.data());
-
-            Device.Layers.resize(DeviceLayerCount);
-            for(uint32_t LayerIndex = 0; LayerIndex < DeviceLayerCount; ++LayerIndex)
-            {
-                SVulkanLayer& Layer = Device.Layers[LayerIndex];
-                Layer.Properties = DeviceLayers[LayerIndex];
-
-                uint32_t LayerExtensionCount;
-                vkEnumerateDeviceExtensionProperties(Device.Device, Layer.Properties.layerName, &LayerExtensionCount, nullptr);
-                Layer.Extensions.resize(LayerExtensionCount);
-                vkEnumerateDeviceExtensionProperties(Device.Device, Layer.Properties.layerName, &LayerExtensionCount, Layer.Extensions.data());
-            }
-        }
-    }
-
-    // Create surface
-    {
-        VkWin32SurfaceCreateInfoKHR SurfaceCreateInfo = { VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR };
-        SurfaceCreateInfo.pNext = nullptr;
-        SurfaceCreateInfo.flags = 0;
-        SurfaceCreateInfo.hinstance = Instance;
-        SurfaceCreateInfo.hwnd = Window;
-
-        vkCreateWin32SurfaceKHR(VulkanState.Instance, &SurfaceCreateInfo, nullptr, &VulkanState.Surface);
-    }
-
-    // Select device
-    for(SVulkanPhysicalDevice& Device : VulkanState.PhysicalDevices)
-    {
-        uint32_t QueueFamilyIndex;
-        for(QueueFamilyIndex = 0; QueueFamilyIndex < Device.QueueFamilies.size(); ++QueueFamilyIndex)
-        {
-            const VkQueueFamilyProperties& QueueFamily = Device.QueueFamilies[QueueFamilyIndex];
-
-            VkQueueFlagBits RequiredFlags[] =
-            {
-                VK_QUEUE_GRAPHICS_BIT,
-                VK_QUEUE_COMPUTE_BIT,
-                VK_QUEUE_TRANSFER_BIT,
-            };
-            uint32_t RequiredFlagCount = ArrayCount(RequiredFlags);
-
-            uint32_t FlagIndex;
-            for(FlagIndex = 0; FlagIndex < RequiredFlagCount; ++FlagIndex)
-            {
-                if((QueueFamily.queueFlags & RequiredFlags[FlagIndex]) == 0)
-                {
-                    break;
-                }
-            }
-
-            if(FlagIndex < RequiredFlagCount) continue;
-
-            VkBool32 IsSurfaceSupported;
-            vkGetPhysicalDeviceSurfaceSupportKHR(Device.Device, QueueFamilyIndex, VulkanState.Surface, &IsSurfaceSupported);
-
-            if(!IsSurfaceSupported) continue;
-
-            uint32_t SupportedSurfaceFormatCount;
-            vkGetPhysicalDeviceSurfaceFormatsKHR(Device.Device, VulkanState.Surface, &SupportedSurfaceFormatCount, nullptr);
-            std::vector<VkSurfaceFormatKHR> SupportedSurfaceFormats(SupportedSurfaceFormatCount);
-            vkGetPhysicalDeviceSurfaceFormatsKHR(Device.Device, VulkanState.Surface, &SupportedSurfaceFormatCount, SupportedSurfaceFormats.data());
-
-            VkFormat DesiredSurfaceFormat = VK_FORMAT_B8G8R8A8_UNORM;
-            VulkanState.SurfaceFormat = VK_FORMAT_UNDEFINED;
-            for(const VkSurfaceFormatKHR& CurrentSurfaceFormat : SupportedSurfaceFormats)
-            {
-                VulkanState.SurfaceFormat = CurrentSurfaceFormat.format;
-                VulkanState.SurfaceColorSpace = CurrentSurfaceFormat.colorSpace;
-                if(VulkanState.SurfaceFormat == DesiredSurfaceFormat)
-                {
-                    break;
-                }
-            }
-
-            if(VulkanState.SurfaceFormat == VK_FORMAT_UNDEFINED)
-            {
-                continue;
-            }
-            else if(VulkanState.SurfaceFormat == DesiredSurfaceFormat)
-            {
-                break;
-            }
-            else
-            {
-                printf("Warning: using undesired surface format %x\n", VulkanState.SurfaceFormat);
-            }
-        }
-
-        if(QueueFamilyIndex < Device.QueueFamilies.size())
-        {
-            VulkanState.SelectedDevice = Device.Device;
-            VulkanState.SelectedDeviceQueueFamilyIndex = QueueFamilyIndex;
-            break;
-        }
-    }
-
-    if(VulkanState.SelectedDevice == VK_NULL_HANDLE)
-    {
-        printf("Couldn't find suitable device\n");
-        return -1;
-    }
-
-    // Get surface properties
-    {
-        // Extent
-        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VulkanState.SelectedDevice, VulkanState.Surface, &VulkanState.SurfaceCapabilities);
-        if(VulkanState.SurfaceCapabilities.currentExtent.width == UINT32_MAX)
-        {
-            VkExtent2D MaxExtent = VulkanState.SurfaceCapabilities.maxImageExtent;
-            VkExtent2D MinExtent = VulkanState.SurfaceCapabilities.minImageExtent;
-
-            VulkanState.SurfaceExtent.width = Clamp(Width, MinExtent.width, MaxExtent.width);
-            VulkanState.SurfaceExtent.height = Clamp(Height, MinExtent.height, MaxExtent.height);
-        }
-        else
-        {
-            VulkanState.SurfaceExtent = VulkanState.SurfaceCapabilities.currentExtent;
-        }
-
-        // Present mode
-        uint32_t SurfacePresentModeCount;
-        vkGetPhysicalDeviceSurfacePresentModesKHR(VulkanState.SelectedDevice, VulkanState.Surface, &SurfacePresentModeCount, nullptr);
-        std::vector<VkPresentModeKHR> SurfacePresentModes(SurfacePresentModeCount);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(VulkanState.SelectedDevice, VulkanState.Surface, &SurfacePresentModeCount, SurfacePresentModes.data());
-
-        uint32_t PresentModeIndex;
-        for(PresentModeIndex = 0; PresentModeIndex < SurfacePresentModes.size(); PresentModeIndex++)
-        {
-            const VkPresentModeKHR& PresentMode = SurfacePresentModes[PresentModeIndex];
-            if(PresentMode == VK_PRESENT_MODE_FIFO_KHR)
-            {
-                VulkanState.SurfacePresentMode = PresentMode;
-                break;
-            }
-        }
-
-        if(PresentModeIndex >= SurfacePresentModes.size())
-        {
-            printf("Couldn't find suitable present mode\n");
-            return -1;
-        }
-    }
-
-    // Create logical device
-    {
-        float QueuePriorities[1] = { 0.0f };
-        VkDeviceQueueCreateInfo QueueCreateInfo = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
-        QueueCreateInfo.pNext = nullptr;
-        QueueCreateInfo.flags = 0;
-        QueueCreateInfo.queueFamilyIndex = VulkanState.SelectedDeviceQueueFamilyIndex;
-        QueueCreateInfo.queueCount = 1;
-        QueueCreateInfo.pQueuePriorities = QueuePriorities;
-
-        const char* const EnabledDeviceExtensions[] =
-        {
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-        };
-
-        uint32_t EnabledDeviceExtensionCount = ArrayCount(EnabledDeviceExtensions);
-
-        // TODO(boti): check for device extension support
-
-        VkDeviceCreateInfo DeviceCreateInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
-        DeviceCreateInfo.pNext = nullptr;
-        DeviceCreateInfo.flags = 0;
-        DeviceCreateInfo.queueCreateInfoCount = 1;
-        DeviceCreateInfo.pQueueCreateInfos = &QueueCreateInfo;
-        DeviceCreateInfo.enabledLayerCount = 0;
-        DeviceCreateInfo.ppEnabledLayerNames = nullptr;
-        DeviceCreateInfo.enabledExtensionCount = EnabledDeviceExtensionCount;
-        DeviceCreateInfo.ppEnabledExtensionNames = EnabledDeviceExtensions;
-        DeviceCreateInfo.pEnabledFeatures = nullptr;
-
-        vkCreateDevice(VulkanState.SelectedDevice, &DeviceCreateInfo, nullptr, &VulkanState.Device);
-
-        // Get queue
-        vkGetDeviceQueue(VulkanState.Device, VulkanState.SelectedDeviceQueueFamilyIndex, 0, &VulkanState.Queue);
-    }
-
-    // Create swapchain
-    {
-        // Create swapchain
-        VkSwapchainCreateInfoKHR SwapchainCreateInfo = { VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
-        SwapchainCreateInfo.pNext = nullptr;
-        SwapchainCreateInfo.flags = 0;
-        SwapchainCreateInfo.surface = VulkanState.Surface;
-        SwapchainCreateInfo.minImageCount = VulkanState.SurfaceCapabilities.minImageCount;
-        SwapchainCreateInfo.imageFormat = VulkanState.SurfaceFormat;
-        SwapchainCreateInfo.imageColorSpace = VulkanState.SurfaceColorSpace;
-        SwapchainCreateInfo.imageExtent = VulkanState.SurfaceExtent;
-        SwapchainCreateInfo.imageArrayLayers = 1;
-        SwapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-        SwapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        SwapchainCreateInfo.queueFamilyIndexCount = 1;
-        SwapchainCreateInfo.pQueueFamilyIndices = &VulkanState.SelectedDeviceQueueFamilyIndex;
-        SwapchainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-        SwapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-        SwapchainCreateInfo.presentMode = VulkanState.SurfacePresentMode;
-        SwapchainCreateInfo.clipped = VK_TRUE;
-        SwapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
-
-        vkCreateSwapchainKHR(VulkanState.Device, &SwapchainCreateInfo, nullptr, &VulkanState.Swapchain);
-
-        // Get images
-        uint32_t SwapchainImageCount;
-        vkGetSwapchainImagesKHR(VulkanState.Device, VulkanState.Swapchain, &SwapchainImageCount, nullptr);
-        VulkanState.SwapchainImages.resize(SwapchainImageCount);
-        vkGetSwapchainImagesKHR(VulkanState.Device, VulkanState.Swapchain, &SwapchainImageCount, VulkanState.SwapchainImages.data());
-
-        // Create image views
-        VulkanState.SwapchainImageViews.resize(SwapchainImageCount);
-        for(uint32_t ImageIndex = 0; ImageIndex < SwapchainImageCount; ++ImageIndex)
-        {
-            VkImageViewCreateInfo ImageViewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-            ImageViewCreateInfo.pNext = nullptr;
-            ImageViewCreateInfo.flags = 0;
-            ImageViewCreateInfo.image = VulkanState.SwapchainImages[ImageIndex];
-            ImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            ImageViewCreateInfo.format = VulkanState.SurfaceFormat;
-            ImageViewCreateInfo.components =
-            {
-                VK_COMPONENT_SWIZZLE_IDENTITY,
-                VK_COMPONENT_SWIZZLE_IDENTITY,
-                VK_COMPONENT_SWIZZLE_IDENTITY,
-                VK_COMPONENT_SWIZZLE_IDENTITY
-            };
-            ImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            ImageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-            ImageViewCreateInfo.subresourceRange.levelCount = 1;
-            ImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-            ImageViewCreateInfo.subresourceRange.layerCount = 1;
-
-            vkCreateImageView(VulkanState.Device, &ImageViewCreateInfo, nullptr, &VulkanState.SwapchainImageViews[ImageIndex]);
-        }
-    }
-
-    // Setup graphics pipeline
-    {
-        // Create shader modules
-        {
-            SBuffer ShaderBin = win32LoadFile("Shaders/shader.spv");
-
-            VkShaderModuleCreateInfo ShaderCreateInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-            ShaderCreateInfo.pNext = nullptr;
-            ShaderCreateInfo.flags = 0;
-            ShaderCreateInfo.codeSize = ShaderBin.Size;
-            ShaderCreateInfo.pCode = (uint32_t*)ShaderBin.Data;
-            vkCreateShaderModule(VulkanState.Device, &ShaderCreateInfo, nullptr, &VulkanState.Shader);
-        }
-
-        /* ================================== */
-        VkPipelineShaderStageCreateInfo VertexShaderStage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-        VertexShaderStage.pNext = nullptr;
-        VertexShaderStage.flags = 0;
-        VertexShaderStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        VertexShaderStage.module = VulkanState.Shader;
-        VertexShaderStage.pName = "main";
-        VertexShaderStage.pSpecializationInfo = nullptr;
-
-        VkPipelineShaderStageCreateInfo FragmentShaderStage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-        FragmentShaderStage.pNext = nullptr;
-        FragmentShaderStage.flags = 0;
-        FragmentShaderStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        FragmentShaderStage.module = VulkanState.Shader;
-        FragmentShaderStage.pName = "main";
-        FragmentShaderStage.pSpecializationInfo = nullptr;
-
-        VkPipelineShaderStageCreateInfo ShaderStages[] =
-        {
-            VertexShaderStage,
-            FragmentShaderStage,
-        };
-        uint32_t ShaderStageCount = ArrayCount(ShaderStages);
-
-        /* ================================== */
-        VkPipelineVertexInputStateCreateInfo VertexInputState = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
-        VertexInputState.pNext = nullptr;
-        VertexInputState.flags = 0;
-        VertexInputState.vertexBindingDescriptionCount = 0;
-        VertexInputState.pVertexBindingDescriptions = nullptr;
-        VertexInputState.vertexAttributeDescriptionCount = 0;
-        VertexInputState.pVertexAttributeDescriptions = nullptr;
-
-        /* ================================== */
-        VkPipelineInputAssemblyStateCreateInfo InputAssemblyState = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
-        InputAssemblyState.pNext = nullptr;
-        InputAssemblyState.flags = 0;
-        InputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        InputAssemblyState.primitiveRestartEnable = VK_FALSE;
-
-        /* ================================== */
-        VkViewport Viewport = {};
-        Viewport.x = 0.0f;
-        Viewport.y = 0.0f;
-        Viewport.width = (float)Width;
-        Viewport.height = (float)Height;
-        Viewport.minDepth = 0.0f;
-        Viewport.maxDepth = 1.0f;
-
-        VkRect2D Scissor = {};
-        Scissor.offset = { 0, 0 };
-        Scissor.extent = { Width, Height };
-
-        VkPipelineViewportStateCreateInfo ViewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
-        ViewportState.pNext = nullptr;
-        ViewportState.flags = 0;
-        ViewportState.viewportCount = 1;
-        ViewportState.pViewports = &Viewport;
-        ViewportState.scissorCount = 1;
-        ViewportState.pScissors = &Scissor;
-
-        /* ================================== */
-        VkPipelineRasterizationStateCreateInfo RasterizationState = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
-        RasterizationState.pNext = nullptr;
-        RasterizationState.flags = 0;
-        RasterizationState.depthClampEnable = VK_FALSE;
-        RasterizationState.rasterizerDiscardEnable = VK_FALSE;
-        RasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
-        RasterizationState.cullMode = VK_CULL_MODE_NONE;
-        RasterizationState.frontFace = VK_FRONT_FACE_CLOCKWISE;
-        RasterizationState.depthBiasEnable = VK_FALSE;
-        RasterizationState.depthBiasConstantFactor = 0.0f;
-        RasterizationState.depthBiasClamp = 0.0f;
-        RasterizationState.depthBiasSlopeFactor = 0.0f;
-        RasterizationState.lineWidth = 1.0f;
-
-        /* ================================== */
-        VkPipelineMultisampleStateCreateInfo MultisampleState = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
-        MultisampleState.pNext = nullptr;
-        MultisampleState.flags = 0;
-        MultisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-        MultisampleState.sampleShadingEnable = VK_FALSE;
-        MultisampleState.minSampleShading = 0.0f;
-        MultisampleState.pSampleMask = nullptr;
-        MultisampleState.alphaToCoverageEnable = VK_FALSE;
-        MultisampleState.alphaToOneEnable = VK_FALSE;
-
-        /* ================================== */
-        VkPipelineColorBlendAttachmentState ColorBlendAttachmentState = {};
-        ColorBlendAttachmentState.blendEnable = VK_FALSE;
-        ColorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-        ColorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-        ColorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-        ColorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-        ColorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-        ColorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-        ColorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-        VkPipelineColorBlendStateCreateInfo ColorBlendState = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
-        ColorBlendState.pNext = nullptr;
-        ColorBlendState.flags = 0;
-        ColorBlendState.logicOpEnable = VK_FALSE;
-        ColorBlendState.logicOp = VK_LOGIC_OP_COPY;
-        ColorBlendState.attachmentCount = 1;
-        ColorBlendState.pAttachments = &ColorBlendAttachmentState;
-        ColorBlendState.blendConstants[0] = 1.0f;
-        ColorBlendState.blendConstants[1] = 1.0f;
-        ColorBlendState.blendConstants[2] = 1.0f;
-        ColorBlendState.blendConstants[3] = 1.0f;
-
-        /* ================================== */
-        VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-        PipelineLayoutCreateInfo.pNext = nullptr;
-        PipelineLayoutCreateInfo.flags = 0;
-        PipelineLayoutCreateInfo.setLayoutCount = 0;
-        PipelineLayoutCreateInfo.pSetLayouts = nullptr;
-        PipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-        PipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-
-        VkPipelineLayout PipelineLayout;
-        vkCreatePipelineLayout(VulkanState.Device, &PipelineLayoutCreateInfo, nullptr, &PipelineLayout);
-
-        /* ================================== */
-        VkAttachmentDescription ColorAttachment = {};
-        ColorAttachment.flags = 0;
-        ColorAttachment.format = VulkanState.SurfaceFormat;
-        ColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        ColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        ColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-        ColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        ColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        ColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        ColorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-        VkAttachmentReference ColorAttachmentReference = {};
-        ColorAttachmentReference.attachment = 0;
-        ColorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-        VkSubpassDescription Subpass = {};
-        Subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        Subpass.colorAttachmentCount = 1;
-        Subpass.pColorAttachments = &ColorAttachmentReference;
-
-        VkRenderPassCreateInfo RenderPassCreateInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-        RenderPassCreateInfo.pNext = nullptr;
-        RenderPassCreateInfo.flags = 0;
-        RenderPassCreateInfo.attachmentCount = 1;
-        RenderPassCreateInfo.pAttachments = &ColorAttachment;
-        RenderPassCreateInfo.subpassCount = 1;
-        RenderPassCreateInfo.pSubpasses = &Subpass;
-        RenderPassCreateInfo.dependencyCount = 0;
-        RenderPassCreateInfo.pDependencies = nullptr;
-
-        vkCreateRenderPass(VulkanState.Device, &RenderPassCreateInfo, nullptr, &VulkanState.RenderPass);
-
-        /* ================================== */
-        VkGraphicsPipelineCreateInfo PipelineInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-        PipelineInfo.pNext = nullptr;
-        PipelineInfo.flags = 0;
-        PipelineInfo.stageCount = ShaderStageCount;
-        PipelineInfo.pStages = ShaderStages;
-        PipelineInfo.pVertexInputState = &VertexInputState;
-        PipelineInfo.pInputAssemblyState = &InputAssemblyState;
-        PipelineInfo.pTessellationState = nullptr;
-        PipelineInfo.pViewportState = &ViewportState;
-        PipelineInfo.pRasterizationState = &RasterizationState;
-        PipelineInfo.pMultisampleState = &MultisampleState;
-        PipelineInfo.pDepthStencilState = nullptr;
-        PipelineInfo.pColorBlendState = &ColorBlendState;
-        PipelineInfo.pDynamicState = nullptr;
-        PipelineInfo.layout = PipelineLayout;
-        PipelineInfo.renderPass = VulkanState.RenderPass;
-        PipelineInfo.subpass = 0;
-        PipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-        PipelineInfo.basePipelineIndex = -1;
-
-        vkCreateGraphicsPipelines(VulkanState.Device, VK_NULL_HANDLE, 1, &PipelineInfo, nullptr, &VulkanState.Pipeline);
-    }
-
-    // Create framebuffers
-    {
-        VulkanState.Framebuffers.resize(VulkanState.SwapchainImages.size());
-        for(uint32_t ImageIndex = 0; ImageIndex < VulkanState.SwapchainImages.size(); ++ImageIndex)
-        {
-            VkImageView Attachments[] =
-            {
-                VulkanState.SwapchainImageViews[ImageIndex],
-            };
-
-            uint32_t AttachmentCount = ArrayCount(Attachments);
-
-            VkFramebufferCreateInfo FramebufferCreateInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-            FramebufferCreateInfo.pNext = nullptr;
-            FramebufferCreateInfo.flags = 0;
-            FramebufferCreateInfo.renderPass = VulkanState.RenderPass;
-            FramebufferCreateInfo.attachmentCount = AttachmentCount;
-            FramebufferCreateInfo.pAttachments = Attachments;
-            FramebufferCreateInfo.width = VulkanState.SurfaceExtent.width;
-            FramebufferCreateInfo.height = VulkanState.SurfaceExtent.height;
-            FramebufferCreateInfo.layers = 1;
-
-            vkCreateFramebuffer(VulkanState.Device, &FramebufferCreateInfo, nullptr, &VulkanState.Framebuffers[ImageIndex]);
-        }
-    }
-
-    // Create command pool
-    {
-        VkCommandPoolCreateInfo CommandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
-        CommandPoolCreateInfo.pNext = nullptr;
-        CommandPoolCreateInfo.queueFamilyIndex = VulkanState.SelectedDeviceQueueFamilyIndex;
-        CommandPoolCreateInfo.flags = 0;
-
-        vkCreateCommandPool(VulkanState.Device, &CommandPoolCreateInfo, nullptr, &VulkanState.CommandPool);
-    }
-
-    // Allocate command buffers
-    {
-        VulkanState.CommandBuffers.resize(VulkanState.SwapchainImages.size());
-        VkCommandBufferAllocateInfo CommandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-        CommandBufferInfo.pNext = nullptr;
-        CommandBufferInfo.commandPool = VulkanState.CommandPool;
-        CommandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        CommandBufferInfo.commandBufferCount = (uint32_t)VulkanState.CommandBuffers.size();
-
-        vkAllocateCommandBuffers(VulkanState.Device, &CommandBufferInfo, VulkanState.CommandBuffers.data());
-    }
-
-    // Record command buffers
-    {
-        for(uint32_t BufferIndex = 0; BufferIndex < VulkanState.CommandBuffers.size(); ++BufferIndex)
-        {
-            VkCommandBufferBeginInfo CommandBufferBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-            CommandBufferBeginInfo.pNext = nullptr;
-            CommandBufferBeginInfo.flags = 0;
-            CommandBufferBeginInfo.pInheritanceInfo;
-
-            VkCommandBuffer& CommandBuffer = VulkanState.CommandBuffers[BufferIndex];
-            vkBeginCommandBuffer(CommandBuffer, &CommandBufferBeginInfo);
-            {
-                VkClearValue ClearValue = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-                VkRenderPassBeginInfo RenderPassBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-                RenderPassBeginInfo.pNext = nullptr;
-                RenderPassBeginInfo.renderPass = VulkanState.RenderPass;
-                RenderPassBeginInfo.framebuffer = VulkanState.Framebuffers[BufferIndex];
-                RenderPassBeginInfo.renderArea.offset = { 0, 0 };
-                RenderPassBeginInfo.renderArea.extent = VulkanState.SurfaceExtent;
-                RenderPassBeginInfo.clearValueCount = 1;
-                RenderPassBeginInfo.pClearValues = &ClearValue;
-
-                vkCmdBeginRenderPass(CommandBuffer, &RenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-                vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, VulkanState.Pipeline);
-                vkCmdDraw(CommandBuffer, 3, 1, 0, 0);
-
-                vkCmdEndRenderPass(CommandBuffer);
-
-            }
-            vkEndCommandBuffer(CommandBuffer);
-        }
-    }
-
-    VkSemaphore ImageAvailableSemaphore, RenderFinishedSemaphore;
-    {
-        VkSemaphoreCreateInfo SemaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-
-        vkCreateSemaphore(VulkanState.Device, &SemaphoreCreateInfo, nullptr, &ImageAvailableSemaphore);
-        vkCreateSemaphore(VulkanState.Device, &SemaphoreCreateInfo, nullptr, &RenderFinishedSemaphore);
-    }
-
-    bool bRunning = true;
-    while(bRunning)
-    {
-        MSG Message = {};
-        while(PeekMessage(&Message, nullptr, 0, 0, PM_REMOVE))
-        {
-            if(Message.message == WM_QUIT)
-            {
-                bRunning = false;
-                break;
-            }
-
-            TranslateMessage(&Message);
-            DispatchMessage(&Message);
-        }
-
-
-        // Render
-        {
-            uint32_t ImageIndex;
-            vkAcquireNextImageKHR(VulkanState.Device, VulkanState.Swapchain, UINT64_MAX, ImageAvailableSemaphore, VK_NULL_HANDLE, &ImageIndex);
-
-            VkSemaphore WaitSemaphores[] = { ImageAvailableSemaphore };
-            VkPipelineStageFlags WaitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-            VkSemaphore SignalSemaphores[] = { RenderFinishedSemaphore };
-
-            VkSubmitInfo SubmitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-            SubmitInfo.pNext = nullptr;
-            SubmitInfo.waitSemaphoreCount = 1;
-            SubmitInfo.pWaitSemaphores = WaitSemaphores;
-            SubmitInfo.pWaitDstStageMask = WaitStages;
-            SubmitInfo.commandBufferCount = 1;
-            SubmitInfo.pCommandBuffers = &VulkanState.CommandBuffers[ImageIndex];
-            SubmitInfo.signalSemaphoreCount = 1;
-            SubmitInfo.pSignalSemaphores = SignalSemaphores;
-            
-            vkQueueSubmit(VulkanState.Queue, 1, &SubmitInfo, VK_NULL_HANDLE);
-
-            VkPresentInfoKHR PresentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
-            PresentInfo.pNext = nullptr;
-            PresentInfo.waitSemaphoreCount = 1;
-            PresentInfo.pWaitSemaphores = SignalSemaphores;
-            PresentInfo.swapchainCount = 1;
-            PresentInfo.pSwapchains = &VulkanState.Swapchain;
-            PresentInfo.pImageIndices = &ImageIndex;
-            PresentInfo.pResults = nullptr;
-            
-            vkQueuePresentKHR(VulkanState.Queue, &PresentInfo);
-            vkQueueWaitIdle(VulkanState.Queue);
-        }
-    }
-
-    return 0;
-}
\ No newline at end of file
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+
+#include <vulkan/vulkan.h>
+
+#include <cinttypes>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstring>
+
+#define ArrayCount(a) (sizeof((a)) / sizeof((a)[0]))
+
+#include "Platform.h"
+
+#if defined(_WIN32)
+#include "win32Platform.cpp"
+#elif defined(__linux__)
+#include "linuxPlatform.cpp"
+#else
+#error "Unsupported platform"
+#endif
+
+#include "PresentTiming.cpp"
+#include "Timeline.cpp"
+#include "Resources.cpp"
+#include "JobSystem.cpp"
+
+template<typename T>
+T Clamp(T Val, T Min, T Max)
+{
+    return std::max(Min, std::min(Val, Max));
+}
+
+struct SVulkanVersion
+{
+    uint32_t ApiVersion;
+    uint32_t MajorVersion;
+    uint32_t MinorVersion;
+    uint32_t PatchVersion;
+};
+
+inline SVulkanVersion VulkanExtractVersion(uint32_t ApiVersion)
+{
+    SVulkanVersion Version = {};
+    Version.ApiVersion = ApiVersion;
+    Version.MajorVersion = VK_VERSION_MAJOR(ApiVersion);
+    Version.MinorVersion = VK_VERSION_MINOR(ApiVersion);
+    Version.PatchVersion = VK_VERSION_PATCH(ApiVersion);
+    return Version;
+}
+
+struct SVulkanLayer
+{
+    VkLayerProperties Properties;
+    std::vector<VkExtensionProperties> Extensions;
+};
+
+struct SVulkanPhysicalDevice
+{
+    VkPhysicalDevice Device;
+
+    SVulkanVersion Version;
+
+    VkPhysicalDeviceProperties Properties;
+    uint8_t DeviceUUID[VK_UUID_SIZE];
+    VkPhysicalDeviceFeatures Features;
+    VkPhysicalDeviceMemoryProperties MemoryProperties;
+    std::vector<SVulkanLayer> Layers;
+    std::vector<VkExtensionProperties> Extensions;
+    std::vector<VkQueueFamilyProperties> QueueFamilies;
+
+    // Optional features, only enabled on the logical device when supported
+    bool bPresentIdSupported;
+    bool bPresentWaitSupported;
+    bool bDisplayTimingSupported;
+
+    // Required, either through Vulkan 1.2 or VK_KHR_timeline_semaphore
+    bool bTimelineSemaphoreSupported;
+    bool bTimelineSemaphoreIsCore;
+};
+
+constexpr uint32_t MaxFramesInFlight = 2;
+// Draws recorded by a single job into its own secondary command buffer
+constexpr uint32_t DrawsPerRecordJob = 64;
+
+// Command pools can't be used from more than one thread, every job system worker records with its own
+struct SWorkerCommandPool
+{
+    SResourceHandle CommandPool;
+    // Secondary command buffers, reused whenever the frame comes around again
+    std::vector<VkCommandBuffer> CommandBuffers;
+    uint32_t UsedCount;
+};
+
+// The pools and the semaphore belong to the resource table, command buffers go with their pool
+struct SFrameContext
+{
+    SResourceHandle CommandPool;
+    VkCommandBuffer CommandBuffer;
+
+    // Indexed by job system worker
+    std::vector<SWorkerCommandPool> WorkerCommandPools;
+
+    SResourceHandle ImageAvailableSemaphore;
+
+    // Graphics timeline value of the last submission that used this frame's resources
+    uint64_t TimelineValue;
+};
+
+struct SVulkanState
+{
+    SVulkanVersion Version;
+    // The version we request in VkApplicationInfo
+    uint32_t ApiVersion;
+
+    std::vector<SVulkanLayer> InstanceLayers;
+    std::vector<VkExtensionProperties> InstanceExtensions;
+
+    VkInstance Instance;
+
+    std::vector<SVulkanPhysicalDevice> PhysicalDevices;
+
+    VkPhysicalDevice SelectedDevice = VK_NULL_HANDLE;
+    const SVulkanPhysicalDevice* SelectedDeviceInfo = nullptr;
+    uint32_t SelectedDeviceQueueFamilyIndex = 0;
+
+    VkSurfaceKHR Surface;
+    VkExtent2D SurfaceExtent;
+    VkFormat SurfaceFormat;
+    VkColorSpaceKHR SurfaceColorSpace;
+
+    VkPresentModeKHR SurfacePresentMode;
+    VkSurfaceCapabilitiesKHR SurfaceCapabilities;
+
+    VkDevice Device;
+    VkQueue Queue;
+
+    // Texture uploads, the graphics queue itself when there's no dedicated transfer queue
+    uint32_t TransferQueueFamilyIndex;
+    VkQueue TransferQueue;
+    SVulkanTimeline TransferTimeline;
+
+    // Particle simulation, a compute-only (async) queue when there is one, otherwise the graphics queue
+    uint32_t ComputeQueueFamilyIndex;
+    VkQueue ComputeQueue;
+    SVulkanTimeline ComputeTimeline;
+
+    // Device objects from here on are owned by the resource table and kept as handles, see Resources.cpp
+
+    // In headless mode there's no swapchain, the images are plain offscreen images owned by the resource table
+    // (one per frame in flight). SwapchainImages is what gets rendered to either way.
+    VkSwapchainKHR Swapchain;
+    std::vector<VkImage> SwapchainImages;
+    std::vector<SResourceHandle> OffscreenImages;
+    std::vector<SResourceHandle> OffscreenImageMemory;
+    std::vector<SResourceHandle> SwapchainImageViews;
+
+    // Multisampled color target, resolved into the swapchain image at the end of the subpass.
+    // Never stored, so it's a transient attachment backed by lazily allocated memory where possible.
+    VkSampleCountFlagBits SampleCount = VK_SAMPLE_COUNT_1_BIT;
+    SResourceHandle MSAAImage;
+    SResourceHandle MSAAMemory;
+    SResourceHandle MSAAImageView;
+
+    // Shared by all frames in flight like the MSAA image, and also never stored
+    VkFormat DepthFormat;
+    SResourceHandle DepthImage;
+    SResourceHandle DepthMemory;
+    SResourceHandle DepthImageView;
+
+    // Frame pacing, see PresentTiming.cpp
+    bool bPresentWaitEnabled;
+    bool bDisplayTimingEnabled;
+    uint64_t PresentId;
+    PFN_vkWaitForPresentKHR vkWaitForPresent;
+    PFN_vkGetPastPresentationTimingGOOGLE vkGetPastPresentationTiming;
+
+    SResourceHandle RenderPass;
+    SResourceHandle PipelineLayout;
+    SResourceHandle Pipeline;
+
+    // Only created when a mesh is drawn
+    SResourceHandle MeshPipelineLayout;
+    SResourceHandle MeshPipeline;
+
+    // Only created when particles are drawn
+    SResourceHandle ParticlePipelineLayout;
+    SResourceHandle ParticlePipeline;
+
+    std::vector<SResourceHandle> Framebuffers;
+
+    SVulkanTimeline GraphicsTimeline;
+
+    uint32_t FrameIndex;
+    SFrameContext Frames[MaxFramesInFlight];
+    // Presentation can't be tracked with timelines, these are per swapchain image so that a semaphore
+    // is never signaled again before the present that waits on it has consumed it
+    std::vector<SResourceHandle> RenderFinishedSemaphores;
+
+    SResourceTable Resources;
+};
+
+
+bool VulkanHasExtension(const std::vector<VkExtensionProperties>& Extensions, const char* Name)
+{
+    for(const VkExtensionProperties& Extension : Extensions)
+    {
+        if(strcmp(Extension.extensionName, Name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns UINT32_MAX if there's no memory type with the required properties
+uint32_t VulkanFindMemoryType(const VkPhysicalDeviceMemoryProperties* MemoryProperties, uint32_t MemoryTypeBits, VkMemoryPropertyFlags RequiredFlags)
+{
+    for(uint32_t TypeIndex = 0; TypeIndex < MemoryProperties->memoryTypeCount; ++TypeIndex)
+    {
+        if((MemoryTypeBits & (1u << TypeIndex)) &&
+           (MemoryProperties->memoryTypes[TypeIndex].propertyFlags & RequiredFlags) == RequiredFlags)
+        {
+            return TypeIndex;
+        }
+    }
+    return UINT32_MAX;
+}
+
+#include "DeviceSelection.cpp"
+#include "FrameCapture.cpp"
+#include "TextureStreaming.cpp"
+#include "Mesh.cpp"
+#include "MeshImport.cpp"
+#include "Scene.cpp"
+#include "Particles.cpp"
+#include "DrawQueue.cpp"
+#include "Regression.cpp"
+
+VkBool32 DebugCallback(VkDebugReportFlagsEXT Flags, VkDebugReportObjectTypeEXT ObjectType, uint64_t Object, size_t Location,
+                       int32_t MessageCode, const char* LayerPrefix, const char* Message, void* pUserData)
+{
+    printf("%s\n", Message);
+    return VK_FALSE;
+}
+
+struct SAppOptions
+{
+    // 0 means render on demand only (expose/paint events), otherwise frames are rendered at most at this rate
+    uint32_t TargetFrameRate = 0;
+    // CSV output for per-frame present timestamps
+    const char* PresentLogPath = nullptr;
+    // Benchmark every suitable device at startup (results are cached) instead of relying only on the static score
+    bool bProbeDevices = false;
+    // Color samples per pixel, clamped to what the device supports
+    uint32_t MSAASampleCount = 1;
+    // Render offscreen without a window or swapchain, as fast as possible
+    bool bHeadless = false;
+    // Stream every rendered frame to this file (.raw, .y4m or .png)
+    const char* CapturePath = nullptr;
+    // Exit after this many frames, 0 means run until the window is closed (headless defaults to 1)
+    uint32_t FrameCount = 0;
+    // KTX2 files, drawn as a grid of triangles
+    std::vector<const char*> TexturePaths;
+    // Device memory the texture streamer may use for mip levels above the mip tails
+    uint32_t TextureBudgetMiB = 256;
+    // Cooked mesh drawn instead of the triangles, textured with the first texture
+    const char* MeshPath = nullptr;
+    // Copies of the mesh on a field around the camera, frustum culled on the CPU every frame
+    uint32_t InstanceCount = 0;
+    // Cook a glTF file into a mesh file and exit, no window or device needed
+    const char* CookInputPath = nullptr;
+    const char* CookOutputPath = nullptr;
+    // Job system threads besides the main thread, UINT32_MAX means one per additional core
+    uint32_t JobThreadCount = UINT32_MAX;
+    // Per-job timings in Chrome trace format
+    const char* JobTracePath = nullptr;
+    // Simulated on the GPU and drawn instead of the triangles or the mesh
+    uint32_t ParticleCount = 0;
+    // Benchmark the culling kernels on this many objects and exit, no window or device needed
+    uint32_t CullBenchObjectCount = 0;
+    // Headless regression checks, the exit code is 1 when either fails
+    const char* GoldenPath = nullptr;
+    uint32_t GoldenTolerance = 2;
+    const char* BaselinePath = nullptr;
+    double PerfThresholdPercent = 25.0;
+    // Fail the run on a performance regression instead of only reporting it
+    bool bPerfGate = false;
+    // Write the golden and baseline from this run instead of checking against them
+    bool bUpdateReferences = false;
+};
+
+bool ParseOptions(int ArgCount, char** Args, SAppOptions* Options)
+{
+    for(int ArgIndex = 1; ArgIndex < ArgCount; ++ArgIndex)
+    {
+        const char* Arg = Args[ArgIndex];
+        const char* Value = (ArgIndex + 1 < ArgCount) ? Args[ArgIndex + 1] : nullptr;
+
+        if(strcmp(Arg, "-fps") == 0 && Value)
+        {
+            Options->TargetFrameRate = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-msaa") == 0 && Value)
+        {
+            Options->MSAASampleCount = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-probe") == 0)
+        {
+            Options->bProbeDevices = true;
+        }
+        else if(strcmp(Arg, "-headless") == 0)
+        {
+            Options->bHeadless = true;
+        }
+        else if(strcmp(Arg, "-capture") == 0 && Value)
+        {
+            Options->CapturePath = Value;
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-frames") == 0 && Value)
+        {
+            Options->FrameCount = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-texture") == 0 && Value)
+        {
+            Options->TexturePaths.push_back(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-texbudget") == 0 && Value)
+        {
+            Options->TextureBudgetMiB = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-mesh") == 0 && Value)
+        {
+            Options->MeshPath = Value;
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-instances") == 0 && Value)
+        {
+            Options->InstanceCount = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-cook") == 0 && Value && ArgIndex + 2 < ArgCount)
+        {
+            Options->CookInputPath = Value;
+            Options->CookOutputPath = Args[ArgIndex + 2];
+            ArgIndex += 2;
+        }
+        else if(strcmp(Arg, "-jobs") == 0 && Value)
+        {
+            Options->JobThreadCount = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-jobtrace") == 0 && Value)
+        {
+            Options->JobTracePath = Value;
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-particles") == 0 && Value)
+        {
+            Options->ParticleCount = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-cullbench") == 0 && Value)
+        {
+            Options->CullBenchObjectCount = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-golden") == 0 && Value)
+        {
+            Options->GoldenPath = Value;
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-tolerance") == 0 && Value)
+        {
+            Options->GoldenTolerance = (uint32_t)atoi(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-baseline") == 0 && Value)
+        {
+            Options->BaselinePath = Value;
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-perfthreshold") == 0 && Value)
+        {
+            Options->PerfThresholdPercent = atof(Value);
+            ++ArgIndex;
+        }
+        else if(strcmp(Arg, "-perfgate") == 0)
+        {
+            Options->bPerfGate = true;
+        }
+        else if(strcmp(Arg, "-update") == 0)
+        {
+            Options->bUpdateReferences = true;
+        }
+        else if(strcmp(Arg, "-presentlog") == 0 && Value)
+        {
+            Options->PresentLogPath = Value;
+            ++ArgIndex;
+        }
+        else
+        {
+            printf("Unknown or incomplete option: %s\n", Arg);
+            printf("Usage: %s [-fps <frames per second, 0 = on demand>] [-presentlog <file.csv>] [-probe] [-msaa <samples>]\n"
+                   "       [-headless] [-capture <file.raw|file.y4m|file.png>] [-frames <count>]\n"
+                   "       [-texture <file.ktx2>]... [-texbudget <MiB>] [-mesh <file.lbm> [-instances <count>]]\n"
+                   "       [-particles <count>] [-jobs <worker threads>] [-jobtrace <file.json>]\n"
+                   "       [-golden <file.png> [-tolerance <channel difference>]] [-baseline <file.txt> [-perfthreshold <percent>] [-perfgate]] [-update]\n"
+                   "       %s -cook <file.gltf|file.glb> <file.lbm>\n"
+                   "       %s -cullbench <objects> [-jobs <worker threads>]\n", Args[0], Args[0], Args[0]);
+            return false;
+        }
+    }
+
+    if(Options->bHeadless && Options->FrameCount == 0)
+    {
+        Options->FrameCount = 1;
+    }
+
+    // Windowed frames depend on the swapchain and the frame pacing, neither is reproducible
+    if((Options->GoldenPath || Options->BaselinePath) && !Options->bHeadless)
+    {
+        printf("-golden and -baseline only work with -headless\n");
+        return false;
+    }
+    return true;
+}
+
+// What differs between the graphics pipelines, everything else is shared
+struct SPipelineDesc
+{
+    const char* ShaderPath;
+    VkExtent2D Extent;
+    VkDescriptorSetLayout SetLayout;
+
+    uint32_t VertexBindingCount;
+    const VkVertexInputBindingDescription* VertexBindings;
+    uint32_t VertexAttributeCount;
+    const VkVertexInputAttributeDescription* VertexAttributes;
+
+    VkCullModeFlags CullMode;
+    VkFrontFace FrontFace;
+    bool bDepthTest;
+    bool bAdditiveBlend;
+
+    VkShaderStageFlags PushConstantStages;
+    uint32_t PushConstantSize;
+};
+
+// Only reads VulkanState and adds to the resource table, so several pipelines can be built at the same time
+void VulkanCreateGraphicsPipeline(SVulkanState* VulkanState, const SPipelineDesc* Desc,
+                                  SResourceHandle* PipelineLayoutHandle, SResourceHandle* PipelineHandle)
+{
+    // Create shader module
+    VkShaderModule Shader;
+    {
+        SBuffer ShaderBin = PlatformLoadFile(Desc->ShaderPath);
+
+        VkShaderModuleCreateInfo ShaderCreateInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+        ShaderCreateInfo.pNext = nullptr;
+        ShaderCreateInfo.flags = 0;
+        ShaderCreateInfo.codeSize = ShaderBin.Size;
+        ShaderCreateInfo.pCode = (uint32_t*)ShaderBin.Data;
+        vkCreateShaderModule(VulkanState->Device, &ShaderCreateInfo, nullptr, &Shader);
+        ReleaseBuffer(&ShaderBin);
+    }
+
+    /* ================================== */
+    VkPipelineShaderStageCreateInfo VertexShaderStage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+    VertexShaderStage.pNext = nullptr;
+    VertexShaderStage.flags = 0;
+    VertexShaderStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    VertexShaderStage.module = Shader;
+    VertexShaderStage.pName = "main";
+    VertexShaderStage.pSpecializationInfo = nullptr;
+
+    VkPipelineShaderStageCreateInfo FragmentShaderStage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+    FragmentShaderStage.pNext = nullptr;
+    FragmentShaderStage.flags = 0;
+    FragmentShaderStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    FragmentShaderStage.module = Shader;
+    FragmentShaderStage.pName = "main";
+    FragmentShaderStage.pSpecializationInfo = nullptr;
+
+    VkPipelineShaderStageCreateInfo ShaderStages[] =
+    {
+        VertexShaderStage,
+        FragmentShaderStage,
+    };
+    uint32_t ShaderStageCount = ArrayCount(ShaderStages);
+
+    /* ================================== */
+    VkPipelineVertexInputStateCreateInfo VertexInputState = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+    VertexInputState.pNext = nullptr;
+    VertexInputState.flags = 0;
+    VertexInputState.vertexBindingDescriptionCount = Desc->VertexBindingCount;
+    VertexInputState.pVertexBindingDescriptions = Desc->VertexBindings;
+    VertexInputState.vertexAttributeDescriptionCount = Desc->VertexAttributeCount;
+    VertexInputState.pVertexAttributeDescriptions = Desc->VertexAttributes;
+
+    /* ================================== */
+    VkPipelineInputAssemblyStateCreateInfo InputAssemblyState = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    InputAssemblyState.pNext = nullptr;
+    InputAssemblyState.flags = 0;
+    InputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    InputAssemblyState.primitiveRestartEnable = VK_FALSE;
+
+    /* ================================== */
+    VkViewport Viewport = {};
+    Viewport.x = 0.0f;
+    Viewport.y = 0.0f;
+    Viewport.width = (float)Desc->Extent.width;
+    Viewport.height = (float)Desc->Extent.height;
+    Viewport.minDepth = 0.0f;
+    Viewport.maxDepth = 1.0f;
+
+    VkRect2D Scissor = {};
+    Scissor.offset = { 0, 0 };
+    Scissor.extent = Desc->Extent;
+
+    VkPipelineViewportStateCreateInfo ViewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    ViewportState.pNext = nullptr;
+    ViewportState.flags = 0;
+    ViewportState.viewportCount = 1;
+    ViewportState.pViewports = &Viewport;
+    ViewportState.scissorCount = 1;
+    ViewportState.pScissors = &Scissor;
+
+    /* ================================== */
+    VkPipelineRasterizationStateCreateInfo RasterizationState = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    RasterizationState.pNext = nullptr;
+    RasterizationState.flags = 0;
+    RasterizationState.depthClampEnable = VK_FALSE;
+    RasterizationState.rasterizerDiscardEnable = VK_FALSE;
+    RasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    RasterizationState.cullMode = Desc->CullMode;
+    RasterizationState.frontFace = Desc->FrontFace;
+    RasterizationState.depthBiasEnable = VK_FALSE;
+    RasterizationState.depthBiasConstantFactor = 0.0f;
+    RasterizationState.depthBiasClamp = 0.0f;
+    RasterizationState.depthBiasSlopeFactor = 0.0f;
+    RasterizationState.lineWidth = 1.0f;
+
+    /* ================================== */
+    VkPipelineMultisampleStateCreateInfo MultisampleState = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    MultisampleState.pNext = nullptr;
+    MultisampleState.flags = 0;
+    MultisampleState.rasterizationSamples = VulkanState->SampleCount;
+    MultisampleState.sampleShadingEnable = VK_FALSE;
+    MultisampleState.minSampleShading = 0.0f;
+    MultisampleState.pSampleMask = nullptr;
+    MultisampleState.alphaToCoverageEnable = VK_FALSE;
+    MultisampleState.alphaToOneEnable = VK_FALSE;
+
+    /* ================================== */
+    VkPipelineColorBlendAttachmentState ColorBlendAttachmentState = {};
+    ColorBlendAttachmentState.blendEnable = Desc->bAdditiveBlend ? VK_TRUE : VK_FALSE;
+    ColorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    ColorBlendAttachmentState.dstColorBlendFactor = Desc->bAdditiveBlend ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ZERO;
+    ColorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+    ColorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    ColorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    ColorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    ColorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo ColorBlendState = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    ColorBlendState.pNext = nullptr;
+    ColorBlendState.flags = 0;
+    ColorBlendState.logicOpEnable = VK_FALSE;
+    ColorBlendState.logicOp = VK_LOGIC_OP_COPY;
+    ColorBlendState.attachmentCount = 1;
+    ColorBlendState.pAttachments = &ColorBlendAttachmentState;
+    ColorBlendState.blendConstants[0] = 1.0f;
+    ColorBlendState.blendConstants[1] = 1.0f;
+    ColorBlendState.blendConstants[2] = 1.0f;
+    ColorBlendState.blendConstants[3] = 1.0f;
+
+    /* ================================== */
+    VkPipelineDepthStencilStateCreateInfo DepthStencilState = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    DepthStencilState.pNext = nullptr;
+    DepthStencilState.flags = 0;
+    DepthStencilState.depthTestEnable = Desc->bDepthTest ? VK_TRUE : VK_FALSE;
+    DepthStencilState.depthWriteEnable = Desc->bDepthTest ? VK_TRUE : VK_FALSE;
+    DepthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
+    DepthStencilState.depthBoundsTestEnable = VK_FALSE;
+    DepthStencilState.stencilTestEnable = VK_FALSE;
+    DepthStencilState.front = {};
+    DepthStencilState.back = {};
+    DepthStencilState.minDepthBounds = 0.0f;
+    DepthStencilState.maxDepthBounds = 1.0f;
+
+    /* ================================== */
+    VkPushConstantRange PushConstantRange = {};
+    PushConstantRange.stageFlags = Desc->PushConstantStages;
+    PushConstantRange.offset = 0;
+    PushConstantRange.size = Desc->PushConstantSize;
+
+    VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    PipelineLayoutCreateInfo.pNext = nullptr;
+    PipelineLayoutCreateInfo.flags = 0;
+    PipelineLayoutCreateInfo.setLayoutCount = 1;
+    PipelineLayoutCreateInfo.pSetLayouts = &Desc->SetLayout;
+    PipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    PipelineLayoutCreateInfo.pPushConstantRanges = &PushConstantRange;
+
+    VkPipelineLayout PipelineLayout;
+    vkCreatePipelineLayout(VulkanState->Device, &PipelineLayoutCreateInfo, nullptr, &PipelineLayout);
+
+    /* ================================== */
+    VkGraphicsPipelineCreateInfo PipelineInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    PipelineInfo.pNext = nullptr;
+    PipelineInfo.flags = 0;
+    PipelineInfo.stageCount = ShaderStageCount;
+    PipelineInfo.pStages = ShaderStages;
+    PipelineInfo.pVertexInputState = &VertexInputState;
+    PipelineInfo.pInputAssemblyState = &InputAssemblyState;
+    PipelineInfo.pTessellationState = nullptr;
+    PipelineInfo.pViewportState = &ViewportState;
+    PipelineInfo.pRasterizationState = &RasterizationState;
+    PipelineInfo.pMultisampleState = &MultisampleState;
+    PipelineInfo.pDepthStencilState = &DepthStencilState;
+    PipelineInfo.pColorBlendState = &ColorBlendState;
+    PipelineInfo.pDynamicState = nullptr;
+    PipelineInfo.layout = PipelineLayout;
+    PipelineInfo.renderPass = ResourceGet<VkRenderPass>(&VulkanState->Resources, VulkanState->RenderPass, ResourceType_RenderPass);
+    PipelineInfo.subpass = 0;
+    PipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    PipelineInfo.basePipelineIndex = -1;
+
+    VkPipeline Pipeline;
+    vkCreateGraphicsPipelines(VulkanState->Device, VK_NULL_HANDLE, 1, &PipelineInfo, nullptr, &Pipeline);
+
+    // Pipelines don't reference their shader module once they're built
+    vkDestroyShaderModule(VulkanState->Device, Shader, nullptr);
+
+    *PipelineLayoutHandle = ResourceAdd(&VulkanState->Resources, ResourceType_PipelineLayout, PipelineLayout);
+    *PipelineHandle = ResourceAdd(&VulkanState->Resources, ResourceType_Pipeline, Pipeline);
+}
+
+// Secondary command buffer for the calling job system worker, continuing the frame's render pass
+VkCommandBuffer VulkanBeginSecondaryCommandBuffer(SVulkanState* VulkanState, SFrameContext* Frame, VkRenderPass RenderPass, VkFramebuffer Framebuffer)
+{
+    SWorkerCommandPool& Pool = Frame->WorkerCommandPools[JobSystemGetWorkerIndex()];
+    if(Pool.UsedCount == Pool.CommandBuffers.size())
+    {
+        VkCommandBufferAllocateInfo CommandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        CommandBufferInfo.pNext = nullptr;
+        CommandBufferInfo.commandPool = ResourceGet<VkCommandPool>(&VulkanState->Resources, Pool.CommandPool, ResourceType_CommandPool);
+        CommandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        CommandBufferInfo.commandBufferCount = 1;
+
+        VkCommandBuffer NewCommandBuffer;
+        vkAllocateCommandBuffers(VulkanState->Device, &CommandBufferInfo, &NewCommandBuffer);
+        Pool.CommandBuffers.push_back(NewCommandBuffer);
+    }
+    VkCommandBuffer CommandBuffer = Pool.CommandBuffers[Pool.UsedCount++];
+
+    VkCommandBufferInheritanceInfo InheritanceInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    InheritanceInfo.pNext = nullptr;
+    InheritanceInfo.renderPass = RenderPass;
+    InheritanceInfo.subpass = 0;
+    InheritanceInfo.framebuffer = Framebuffer;
+    InheritanceInfo.occlusionQueryEnable = VK_FALSE;
+    InheritanceInfo.queryFlags = 0;
+    InheritanceInfo.pipelineStatistics = 0;
+
+    VkCommandBufferBeginInfo CommandBufferBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    CommandBufferBeginInfo.pNext = nullptr;
+    CommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    CommandBufferBeginInfo.pInheritanceInfo = &InheritanceInfo;
+
+    vkBeginCommandBuffer(CommandBuffer, &CommandBufferBeginInfo);
+    return CommandBuffer;
+}
+
+int main(int ArgCount, char** Args)
+{
+    constexpr uint32_t Width = 800;
+    constexpr uint32_t Height = 600;
+    const uint64_t ProgramStartTime = PlatformGetTimeNs();
+
+    SAppOptions Options = {};
+    if(!ParseOptions(ArgCount, Args, &Options))
+    {
+        return -1;
+    }
+
+    if(Options.CookInputPath)
+    {
+        return MeshCook(Options.CookInputPath, Options.CookOutputPath) ? 0 : -1;
+    }
+
+    // The main thread is worker 0 and helps out whenever it waits on jobs
+    SJobSystem JobSystem;
+    {
+        uint32_t ThreadCount = Options.JobThreadCount;
+        if(ThreadCount == UINT32_MAX)
+        {
+            ThreadCount = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+        }
+        JobSystemInit(&JobSystem, ThreadCount, Options.JobTracePath != nullptr);
+        printf("Job system: %u worker threads\n", JobSystemGetWorkerCount(&JobSystem) - 1);
+    }
+
+    if(Options.CullBenchObjectCount)
+    {
+        bool bIsCorrect = SceneRunCullBenchmark(&JobSystem, Options.CullBenchObjectCount);
+        JobSystemShutdown(&JobSystem);
+        return bIsCorrect ? 0 : -1;
+    }
+
+    SPlatformWindow* Window = Options.bHeadless ? nullptr : PlatformOpenWindow("vktest", Width, Height);
+
+    VkResult Result = VK_SUCCESS;
+
+    SVulkanState VulkanState = {};
+
+    // Enumerate version
+    {
+        uint32_t ApiVersion;
+        vkEnumerateInstanceVersion(&ApiVersion);
+
+        VulkanState.Version = VulkanExtractVersion(ApiVersion);
+
+        assert(VulkanState.Version.MajorVersion >= 1 && VulkanState.Version.MinorVersion >= 1);
+
+        // Use 1.2 when the loader has it so that timeline semaphores can be used as a core feature
+        VulkanState.ApiVersion = (VulkanState.Version.MinorVersion >= 2) ? VK_API_VERSION_1_2 : VK_API_VERSION_1_1;
+    }
+
+    // Enumerate instance layers and extensions
+    {
+        // Global extensions
+        {
+            uint32_t ExtensionCount;
+            vkEnumerateInstanceExtensionProperties(nullptr, &ExtensionCount, nullptr);
+            VulkanState.InstanceExtensions.resize(ExtensionCount);
+            vkEnumerateInstanceExtensionProperties(nullptr, &ExtensionCount, VulkanState.InstanceExtensions.data());
+        }
+
+        // Layers and layer extensions
+        uint32_t LayerCount;
+        vkEnumerateInstanceLayerProperties(&LayerCount, nullptr);
+        std::vector<VkLayerProperties> LayerProperties(LayerCount);
+        vkEnumerateInstanceLayerProperties(&LayerCount, LayerProperties.data());
+
+        // SoA to AoS conversion, the loader may have to open every layer's manifest so each one is a job
+        SJobCounter LayerCounter;
+        VulkanState.InstanceLayers.resize(LayerCount);
+        for(uint32_t LayerIndex = 0; LayerIndex < LayerCount; ++LayerIndex)
+        {
+            SVulkanLayer& Layer = VulkanState.InstanceLayers[LayerIndex];
+            Layer.Properties = LayerProperties[LayerIndex];
+
+            JobSystemAdd(&JobSystem, "EnumerateLayer", &LayerCounter, [&Layer]
+            {
+                uint32_t ExtensionCount;
+                vkEnumerateInstanceExtensionProperties(Layer.Properties.layerName, &ExtensionCount, nullptr);
+                Layer.Extensions.resize(ExtensionCount);
+                vkEnumerateInstanceExtensionProperties(Layer.Properties.layerName, &ExtensionCount, Layer.Extensions.data());
+            });
+        }
+        JobSystemWait(&JobSystem, &LayerCounter);
+    }
+
+    // Create instance
+    {
+        VkApplicationInfo AppInfo = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
+        AppInfo.pNext = nullptr;
+        AppInfo.pApplicationName = "Ladybug";
+        AppInfo.applicationVersion = 1;
+        AppInfo.pEngineName = "LadybugEngine";
+        AppInfo.engineVersion = 1;
+        AppInfo.apiVersion = VulkanState.ApiVersion;
+
+
+        // Surface extensions are only needed when presenting, the debug extensions and the validation layer
+        // are used whenever they're installed (they usually aren't on CI machines)
+        std::vector<const char*> Extensions;
+        if(!Options.bHeadless)
+        {
+            Extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+            Extensions.push_back(PlatformGetSurfaceExtensionName());
+        }
+
+        for(const char* Extension : Extensions)
+        {
+            if(!VulkanHasExtension(VulkanState.InstanceExtensions, Extension))
+            {
+                printf("Unavailable extension: %s\n", Extension);
+                return -1;
+            }
+        }
+
+        const char* const OptionalExtensions[] =
+        {
+            VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
+            VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+        };
+        for(const char* Extension : OptionalExtensions)
+        {
+            if(VulkanHasExtension(VulkanState.InstanceExtensions, Extension))
+            {
+                Extensions.push_back(Extension);
+            }
+        }
+
+        std::vector<const char*> Layers;
+        for(const SVulkanLayer& Layer : VulkanState.InstanceLayers)
+        {
+            if(strcmp(Layer.Properties.layerName, "VK_LAYER_KHRONOS_validation") == 0)
+            {
+                Layers.push_back("VK_LAYER_KHRONOS_validation");
+            }
+        }
+
+        if(Layers.empty())
+        {
+            printf("Warning: validation layer not available\n");
+        }
+
+        VkInstanceCreateInfo InstanceCreateInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
+        InstanceCreateInfo.pNext = nullptr;
+        InstanceCreateInfo.flags = 0;
+        InstanceCreateInfo.pApplicationInfo = &AppInfo;
+        InstanceCreateInfo.enabledExtensionCount = (uint32_t)Extensions.size();
+        InstanceCreateInfo.ppEnabledExtensionNames = Extensions.data();
+        InstanceCreateInfo.enabledLayerCount = (uint32_t)Layers.size();
+        InstanceCreateInfo.ppEnabledLayerNames = Layers.data();
+
+        Result = vkCreateInstance(&InstanceCreateInfo, nullptr, &VulkanState.Instance);
+        assert(Result == VK_SUCCESS);
+    }
+
+    // Initialize debug callback
+    VkDebugReportCallbackEXT DebugCallbackObj = VK_NULL_HANDLE;
+    PFN_vkCreateDebugReportCallbackEXT vkCreateDebugReportCallback = VK_NULL_HANDLE;
+    vkCreateDebugReportCallback = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(VulkanState.Instance, "vkCreateDebugReportCallbackEXT");
+    if(vkCreateDebugReportCallback)
+    {
+
+        VkDebugReportCallbackCreateInfoEXT DebugReportCallbackCreateInfo = { VK_STRUCTURE_TYPE_DEBUG_REPORT_CREATE_INFO_EXT };
+        DebugReportCallbackCreateInfo.pNext = nullptr;
+        DebugReportCallbackCreateInfo.flags = VK_DEBUG_REPORT_WARNING_BIT_EXT|VK_DEBUG_REPORT_ERROR_BIT_EXT|VK_DEBUG_REPORT_DEBUG_BIT_EXT;
+        DebugReportCallbackCreateInfo.pfnCallback = &DebugCallback;
+        DebugReportCallbackCreateInfo.pUserData = nullptr;
+
+        vkCreateDebugReportCallback(VulkanState.Instance, &DebugReportCallbackCreateInfo, nullptr, &DebugCallbackObj);
+    }
+
+    // Enumerate physical devices
+    {
+        uint32_t PhysicalDeviceCount;
+        vkEnumeratePhysicalDevices(VulkanState.Instance, &PhysicalDeviceCount, nullptr);
+        std::vector<VkPhysicalDevice> PhysicalDevices(PhysicalDeviceCount);
+        vkEnumeratePhysicalDevices(VulkanState.Instance, &PhysicalDeviceCount, PhysicalDevices.data());
+
+        // Every device is queried by its own job
+        SJobCounter DeviceCounter;
+        VulkanState.PhysicalDevices.resize(PhysicalDeviceCount);
+        for(uint32_t DeviceIndex = 0; DeviceIndex < PhysicalDeviceCount; ++DeviceIndex)
+        {
+            SVulkanPhysicalDevice& Device = VulkanState.PhysicalDevices[DeviceIndex];
+            Device.Device = PhysicalDevices[DeviceIndex];
+
+            JobSystemAdd(&JobSystem, "QueryPhysicalDevice", &DeviceCounter, [&VulkanState, &Device]
+            {
+                // Get device properties
+                vkGetPhysicalDeviceProperties(Device.Device, &Device.Properties);
+                Device.Version = VulkanExtractVersion(Device.Properties.apiVersion);
+
+                if(Device.Version.MajorVersion > 1 || Device.Version.MinorVersion >= 1)
+                {
+                    VkPhysicalDeviceIDProperties IDProperties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+                    VkPhysicalDeviceProperties2 Properties2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+                    Properties2.pNext = &IDProperties;
+                    vkGetPhysicalDeviceProperties2(Device.Device, &Properties2);
+                    memcpy(Device.DeviceUUID, IDProperties.deviceUUID, VK_UUID_SIZE);
+                }
+
+                // Get device memory properties
+                vkGetPhysicalDeviceMemoryProperties(Device.Device, &Device.MemoryProperties);
+
+                // Get device features
+                vkGetPhysicalDeviceFeatures(Device.Device, &Device.Features);
+
+                // Get queue families
+                {
+                    uint32_t QueueFamilyCount;
+                    vkGetPhysicalDeviceQueueFamilyProperties(Device.Device, &QueueFamilyCount, nullptr);
+                    Device.QueueFamilies.resize(QueueFamilyCount);
+                    vkGetPhysicalDeviceQueueFamilyProperties(Device.Device, &QueueFamilyCount, Device.QueueFamilies.data());
+                }
+
+                // Enumerate global device extensions
+                {
+                    uint32_t ExtensionCount;
+                    vkEnumerateDeviceExtensionProperties(Device.Device, nullptr, &ExtensionCount, nullptr);
+                    Device.Extensions.resize(ExtensionCount);
+                    vkEnumerateDeviceExtensionProperties(Device.Device, nullptr, &ExtensionCount, Device.Extensions.data());
+                }
+
+                // Query optional features
+                Device.bDisplayTimingSupported = VulkanHasExtension(Device.Extensions, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+                if(Device.Version.MajorVersion > 1 || Device.Version.MinorVersion >= 1)
+                {
+                    VkPhysicalDeviceFeatures2 Features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+                    VkPhysicalDevicePresentIdFeaturesKHR PresentIdFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR };
+                    VkPhysicalDevicePresentWaitFeaturesKHR PresentWaitFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR };
+                    VkPhysicalDeviceTimelineSemaphoreFeatures TimelineSemaphoreFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+
+                    // Core 1.2 functionality is only usable if we also requested 1.2 for the instance
+                    Device.bTimelineSemaphoreIsCore = Device.Version.MinorVersion >= 2 && VulkanState.ApiVersion >= VK_API_VERSION_1_2;
+                    if(Device.bTimelineSemaphoreIsCore || VulkanHasExtension(Device.Extensions, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+                    {
+                        TimelineSemaphoreFeatures.pNext = Features2.pNext;
+                        Features2.pNext = &TimelineSemaphoreFeatures;
+                    }
+
+                    // Only chain the structures of extensions the device knows about
+                    if(VulkanHasExtension(Device.Extensions, VK_KHR_PRESENT_ID_EXTENSION_NAME))
+                    {
+                        PresentIdFeatures.pNext = Features2.pNext;
+                        Features2.pNext = &PresentIdFeatures;
+                    }
+                    if(VulkanHasExtension(Device.Extensions, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+                    {
+                        PresentWaitFeatures.pNext = Features2.pNext;
+                        Features2.pNext = &PresentWaitFeatures;
+                    }
+
+                    vkGetPhysicalDeviceFeatures2(Device.Device, &Features2);
+
+                    Device.bPresentIdSupported = PresentIdFeatures.presentId == VK_TRUE;
+                    Device.bPresentWaitSupported = Device.bPresentIdSupported && PresentWaitFeatures.presentWait == VK_TRUE;
+                    Device.bTimelineSemaphoreSupported = TimelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+                }
+
+                // Enumerate device layers
+                uint32_t DeviceLayerCount;
+                vkEnumerateDeviceLayerProperties(Device.Device, &DeviceLayerCount, nullptr);
+                std::vector<VkLayerProperties> DeviceLayers(DeviceLayerCount);
+                vkEnumerateDeviceLayerProperties(Device.Device, &DeviceLayerCount, DeviceLayers.data());
+
+                Device.Layers.resize(DeviceLayerCount);
+                for(uint32_t LayerIndex = 0; LayerIndex < DeviceLayerCount; ++LayerIndex)
+                {
+                    SVulkanLayer& Layer = Device.Layers[LayerIndex];
+                    Layer.Properties = DeviceLayers[LayerIndex];
+
+                    uint32_t LayerExtensionCount;
+                    vkEnumerateDeviceExtensionProperties(Device.Device, Layer.Properties.layerName, &LayerExtensionCount, nullptr);
+                    Layer.Extensions.resize(LayerExtensionCount);
+                    vkEnumerateDeviceExtensionProperties(Device.Device, Layer.Properties.layerName, &LayerExtensionCount, Layer.Extensions.data());
+                }
+            });
+        }
+        JobSystemWait(&JobSystem, &DeviceCounter);
+    }
+
+    // Create surface
+    if(!Options.bHeadless)
+    {
+        Result = PlatformCreateSurface(VulkanState.Instance, Window, &VulkanState.Surface);
+        assert(Result == VK_SUCCESS);
+    }
+
+    // Select device
+    {
+        // Collect every device that meets the requirements
+        std::vector<SDeviceCandidate> Candidates;
+        for(SVulkanPhysicalDevice& Device : VulkanState.PhysicalDevices)
+        {
+            if(!Device.bTimelineSemaphoreSupported)
+            {
+                continue;
+            }
+
+            uint32_t QueueFamilyIndex;
+            for(QueueFamilyIndex = 0; QueueFamilyIndex < Device.QueueFamilies.size(); ++QueueFamilyIndex)
+            {
+                const VkQueueFamilyProperties& QueueFamily = Device.QueueFamilies[QueueFamilyIndex];
+
+                VkQueueFlagBits RequiredFlags[] =
+                {
+                    VK_QUEUE_GRAPHICS_BIT,
+                    VK_QUEUE_COMPUTE_BIT,
+                    VK_QUEUE_TRANSFER_BIT,
+                };
+                uint32_t RequiredFlagCount = ArrayCount(RequiredFlags);
+
+                uint32_t FlagIndex;
+                for(FlagIndex = 0; FlagIndex < RequiredFlagCount; ++FlagIndex)
+                {
+                    if((QueueFamily.queueFlags & RequiredFlags[FlagIndex]) == 0)
+                    {
+                        break;
+                    }
+                }
+
+                if(FlagIndex < RequiredFlagCount) continue;
+
+                if(Options.bHeadless) break;
+
+                VkBool32 IsSurfaceSupported;
+                vkGetPhysicalDeviceSurfaceSupportKHR(Device.Device, QueueFamilyIndex, VulkanState.Surface, &IsSurfaceSupported);
+
+                if(IsSurfaceSupported) break;
+            }
+
+            if(QueueFamilyIndex >= Device.QueueFamilies.size())
+            {
+                continue;
+            }
+
+            SDeviceCandidate Candidate = {};
+            Candidate.Device = &Device;
+            Candidate.QueueFamilyIndex = QueueFamilyIndex;
+            Candidate.SurfaceFormat = VK_FORMAT_UNDEFINED;
+
+            // Offscreen rendering, color attachment and transfer source support is mandatory for this format
+            if(Options.bHeadless)
+            {
+                Candidate.SurfaceFormat = VK_FORMAT_R8G8B8A8_UNORM;
+                Candidate.SurfaceColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+                Candidates.push_back(Candidate);
+                continue;
+            }
+
+            uint32_t SupportedSurfaceFormatCount;
+            vkGetPhysicalDeviceSurfaceFormatsKHR(Device.Device, VulkanState.Surface, &SupportedSurfaceFormatCount, nullptr);
+            std::vector<VkSurfaceFormatKHR> SupportedSurfaceFormats(SupportedSurfaceFormatCount);
+            vkGetPhysicalDeviceSurfaceFormatsKHR(Device.Device, VulkanState.Surface, &SupportedSurfaceFormatCount, SupportedSurfaceFormats.data());
+
+            VkFormat DesiredSurfaceFormat = VK_FORMAT_B8G8R8A8_UNORM;
+            for(const VkSurfaceFormatKHR& CurrentSurfaceFormat : SupportedSurfaceFormats)
+            {
+                Candidate.SurfaceFormat = CurrentSurfaceFormat.format;
+                Candidate.SurfaceColorSpace = CurrentSurfaceFormat.colorSpace;
+                if(Candidate.SurfaceFormat == DesiredSurfaceFormat)
+                {
+                    break;
+                }
+            }
+
+            if(Candidate.SurfaceFormat == VK_FORMAT_UNDEFINED)
+            {
+                continue;
+            }
+
+            Candidates.push_back(Candidate);
+        }
+
+        if(!Candidates.empty())
+        {
+            uint32_t SelectedIndex = VulkanSelectDeviceCandidate(Candidates, Options.bProbeDevices);
+            const SDeviceCandidate& Selected = Candidates[SelectedIndex];
+
+            VulkanState.SelectedDevice = Selected.Device->Device;
+            VulkanState.SelectedDeviceInfo = Selected.Device;
+            VulkanState.SelectedDeviceQueueFamilyIndex = Selected.QueueFamilyIndex;
+            VulkanState.SurfaceFormat = Selected.SurfaceFormat;
+            VulkanState.SurfaceColorSpace = Selected.SurfaceColorSpace;
+
+            printf("Selected device: %s\n", Selected.Device->Properties.deviceName);
+            if(!Options.bHeadless && VulkanState.SurfaceFormat != VK_FORMAT_B8G8R8A8_UNORM)
+            {
+                printf("Warning: using undesired surface format %x\n", VulkanState.SurfaceFormat);
+            }
+        }
+    }
+
+    if(VulkanState.SelectedDevice == VK_NULL_HANDLE)
+    {
+        printf("Couldn't find suitable device (timeline semaphore support is required)\n");
+        return -1;
+    }
+
+    // Get surface properties
+    if(Options.bHeadless)
+    {
+        VulkanState.SurfaceExtent = { Width, Height };
+    }
+    else
+    {
+        // Extent
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VulkanState.SelectedDevice, VulkanState.Surface, &VulkanState.SurfaceCapabilities);
+        if(VulkanState.SurfaceCapabilities.currentExtent.width == UINT32_MAX)
+        {
+            VkExtent2D MaxExtent = VulkanState.SurfaceCapabilities.maxImageExtent;
+            VkExtent2D MinExtent = VulkanState.SurfaceCapabilities.minImageExtent;
+
+            VulkanState.SurfaceExtent.width = Clamp(Width, MinExtent.width, MaxExtent.width);
+            VulkanState.SurfaceExtent.height = Clamp(Height, MinExtent.height, MaxExtent.height);
+        }
+        else
+        {
+            VulkanState.SurfaceExtent = VulkanState.SurfaceCapabilities.currentExtent;
+        }
+
+        // Present mode
+        uint32_t SurfacePresentModeCount;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(VulkanState.SelectedDevice, VulkanState.Surface, &SurfacePresentModeCount, nullptr);
+        std::vector<VkPresentModeKHR> SurfacePresentModes(SurfacePresentModeCount);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(VulkanState.SelectedDevice, VulkanState.Surface, &SurfacePresentModeCount, SurfacePresentModes.data());
+
+        uint32_t PresentModeIndex;
+        for(PresentModeIndex = 0; PresentModeIndex < SurfacePresentModes.size(); PresentModeIndex++)
+        {
+            const VkPresentModeKHR& PresentMode = SurfacePresentModes[PresentModeIndex];
+            if(PresentMode == VK_PRESENT_MODE_FIFO_KHR)
+            {
+                VulkanState.SurfacePresentMode = PresentMode;
+                break;
+            }
+        }
+
+        if(PresentModeIndex >= SurfacePresentModes.size())
+        {
+            printf("Couldn't find suitable present mode\n");
+            return -1;
+        }
+    }
+
+    // Create logical device
+    {
+        const SVulkanPhysicalDevice* SelectedDevice = VulkanState.SelectedDeviceInfo;
+
+        // Use a dedicated transfer (DMA) queue for texture uploads when there is one.
+        // Only queues with texel granularity copies are usable, uploads are split along block rows.
+        VulkanState.TransferQueueFamilyIndex = VulkanState.SelectedDeviceQueueFamilyIndex;
+        for(uint32_t QueueFamilyIndex = 0; QueueFamilyIndex < SelectedDevice->QueueFamilies.size(); ++QueueFamilyIndex)
+        {
+            const VkQueueFamilyProperties& QueueFamily = SelectedDevice->QueueFamilies[QueueFamilyIndex];
+            const VkExtent3D& Granularity = QueueFamily.minImageTransferGranularity;
+            if((QueueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+               !(QueueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+               Granularity.width == 1 && Granularity.height == 1 && Granularity.depth == 1)
+            {
+                VulkanState.TransferQueueFamilyIndex = QueueFamilyIndex;
+                break;
+            }
+        }
+
+        // Async compute for the particle simulation, a family with compute but without graphics
+        VulkanState.ComputeQueueFamilyIndex = VulkanState.SelectedDeviceQueueFamilyIndex;
+        if(Options.ParticleCount)
+        {
+            for(uint32_t QueueFamilyIndex = 0; QueueFamilyIndex < SelectedDevice->QueueFamilies.size(); ++QueueFamilyIndex)
+            {
+                const VkQueueFamilyProperties& QueueFamily = SelectedDevice->QueueFamilies[QueueFamilyIndex];
+                if((QueueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(QueueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+                {
+                    VulkanState.ComputeQueueFamilyIndex = QueueFamilyIndex;
+                    break;
+                }
+            }
+        }
+
+        float QueuePriorities[1] = { 0.0f };
+        VkDeviceQueueCreateInfo QueueCreateInfos[3] = {};
+        uint32_t QueueCreateInfoCount = 0;
+
+        uint32_t QueueFamilyIndices[3] = { VulkanState.SelectedDeviceQueueFamilyIndex, VulkanState.TransferQueueFamilyIndex, VulkanState.ComputeQueueFamilyIndex };
+        for(uint32_t i = 0; i < ArrayCount(QueueFamilyIndices); ++i)
+        {
+            // One queue per distinct family
+            bool bIsDuplicate = false;
+            for(uint32_t j = 0; j < i; ++j)
+            {
+                bIsDuplicate |= QueueFamilyIndices[j] == QueueFamilyIndices[i];
+            }
+            if(bIsDuplicate) continue;
+
+            VkDeviceQueueCreateInfo& QueueCreateInfo = QueueCreateInfos[QueueCreateInfoCount++];
+            QueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            QueueCreateInfo.pNext = nullptr;
+            QueueCreateInfo.flags = 0;
+            QueueCreateInfo.queueFamilyIndex = QueueFamilyIndices[i];
+            QueueCreateInfo.queueCount = 1;
+            QueueCreateInfo.pQueuePriorities = QueuePriorities;
+        }
+
+        // Block compressed texture formats, whichever the device has
+        VkPhysicalDeviceFeatures EnabledFeatures = {};
+        EnabledFeatures.textureCompressionBC = SelectedDevice->Features.textureCompressionBC;
+        EnabledFeatures.textureCompressionETC2 = SelectedDevice->Features.textureCompressionETC2;
+        EnabledFeatures.textureCompressionASTC_LDR = SelectedDevice->Features.textureCompressionASTC_LDR;
+
+        std::vector<const char*> EnabledDeviceExtensions;
+        if(!Options.bHeadless)
+        {
+            if(!VulkanHasExtension(SelectedDevice->Extensions, VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+            {
+                printf("Unavailable device extension\n");
+                return -1;
+            }
+            EnabledDeviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+        void* DeviceCreateInfoNext = nullptr;
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures TimelineSemaphoreFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+        TimelineSemaphoreFeatures.pNext = DeviceCreateInfoNext;
+        TimelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+        DeviceCreateInfoNext = &TimelineSemaphoreFeatures;
+        if(!SelectedDevice->bTimelineSemaphoreIsCore)
+        {
+            EnabledDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        }
+
+        // Frame pacing extensions
+        VkPhysicalDevicePresentIdFeaturesKHR PresentIdFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR };
+        VkPhysicalDevicePresentWaitFeaturesKHR PresentWaitFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR };
+        if(Options.bHeadless)
+        {
+            // Nothing is presented
+        }
+        else if(SelectedDevice->bPresentWaitSupported)
+        {
+            EnabledDeviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            EnabledDeviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+            PresentIdFeatures.pNext = DeviceCreateInfoNext;
+            PresentIdFeatures.presentId = VK_TRUE;
+            PresentWaitFeatures.pNext = &PresentIdFeatures;
+            PresentWaitFeatures.presentWait = VK_TRUE;
+            DeviceCreateInfoNext = &PresentWaitFeatures;
+
+            VulkanState.bPresentWaitEnabled = true;
+        }
+        else if(SelectedDevice->bDisplayTimingSupported)
+        {
+            EnabledDeviceExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+            VulkanState.bDisplayTimingEnabled = true;
+        }
+
+        uint32_t EnabledDeviceExtensionCount = (uint32_t)EnabledDeviceExtensions.size();
+
+        VkDeviceCreateInfo DeviceCreateInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+        DeviceCreateInfo.pNext = DeviceCreateInfoNext;
+        DeviceCreateInfo.flags = 0;
+        DeviceCreateInfo.queueCreateInfoCount = QueueCreateInfoCount;
+        DeviceCreateInfo.pQueueCreateInfos = QueueCreateInfos;
+        DeviceCreateInfo.enabledLayerCount = 0;
+        DeviceCreateInfo.ppEnabledLayerNames = nullptr;
+        DeviceCreateInfo.enabledExtensionCount = EnabledDeviceExtensionCount;
+        DeviceCreateInfo.ppEnabledExtensionNames = EnabledDeviceExtensions.data();
+        DeviceCreateInfo.pEnabledFeatures = &EnabledFeatures;
+
+        vkCreateDevice(VulkanState.SelectedDevice, &DeviceCreateInfo, nullptr, &VulkanState.Device);
+
+        // Get queues
+        vkGetDeviceQueue(VulkanState.Device, VulkanState.SelectedDeviceQueueFamilyIndex, 0, &VulkanState.Queue);
+        vkGetDeviceQueue(VulkanState.Device, VulkanState.TransferQueueFamilyIndex, 0, &VulkanState.TransferQueue);
+        vkGetDeviceQueue(VulkanState.Device, VulkanState.ComputeQueueFamilyIndex, 0, &VulkanState.ComputeQueue);
+
+        // Get extension functions
+        PFN_vkWaitSemaphores WaitSemaphores;
+        PFN_vkGetSemaphoreCounterValue GetSemaphoreCounterValue;
+        if(SelectedDevice->bTimelineSemaphoreIsCore)
+        {
+            WaitSemaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(VulkanState.Device, "vkWaitSemaphores");
+            GetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(VulkanState.Device, "vkGetSemaphoreCounterValue");
+        }
+        else
+        {
+            WaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(VulkanState.Device, "vkWaitSemaphoresKHR");
+            GetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(VulkanState.Device, "vkGetSemaphoreCounterValueKHR");
+        }
+        assert(WaitSemaphores && GetSemaphoreCounterValue);
+
+        TimelineInit(&VulkanState.GraphicsTimeline, VulkanState.Device, VulkanState.Queue, WaitSemaphores, GetSemaphoreCounterValue);
+        ResourceTableInit(&VulkanState.Resources, VulkanState.Device, &VulkanState.GraphicsTimeline);
+        TimelineInit(&VulkanState.TransferTimeline, VulkanState.Device, VulkanState.TransferQueue, WaitSemaphores, GetSemaphoreCounterValue);
+        TimelineInit(&VulkanState.ComputeTimeline, VulkanState.Device, VulkanState.ComputeQueue, WaitSemaphores, GetSemaphoreCounterValue);
+
+        if(VulkanState.bPresentWaitEnabled)
+        {
+            VulkanState.vkWaitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(VulkanState.Device, "vkWaitForPresentKHR");
+            assert(VulkanState.vkWaitForPresent);
+        }
+        if(VulkanState.bDisplayTimingEnabled)
+        {
+            VulkanState.vkGetPastPresentationTiming = (PFN_vkGetPastPresentationTimingGOOGLE)vkGetDeviceProcAddr(VulkanState.Device, "vkGetPastPresentationTimingGOOGLE");
+            assert(VulkanState.vkGetPastPresentationTiming);
+        }
+
+        if(!Options.bHeadless && !VulkanState.bPresentWaitEnabled && !VulkanState.bDisplayTimingEnabled)
+        {
+            printf("Warning: neither present wait nor display timing is supported, present times won't be logged\n");
+        }
+    }
+
+    // Frames are copied out of the swapchain (or offscreen) image after rendering
+    bool bIsCapturing = Options.CapturePath != nullptr || Options.GoldenPath != nullptr;
+    if(bIsCapturing && !Options.bHeadless && !(VulkanState.SurfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+    {
+        printf("Warning: swapchain images can't be copied from, frame capture disabled\n");
+        bIsCapturing = false;
+    }
+
+    // Create swapchain, or the images that stand in for it when running headless
+    if(Options.bHeadless)
+    {
+        // One image per frame in flight so that the readback of a frame never races the rendering of the next one
+        VulkanState.SwapchainImages.resize(MaxFramesInFlight);
+        VulkanState.OffscreenImages.resize(MaxFramesInFlight);
+        VulkanState.OffscreenImageMemory.resize(MaxFramesInFlight);
+        for(uint32_t ImageIndex = 0; ImageIndex < MaxFramesInFlight; ++ImageIndex)
+        {
+            VkImageCreateInfo ImageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+            ImageCreateInfo.pNext = nullptr;
+            ImageCreateInfo.flags = 0;
+            ImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            ImageCreateInfo.format = VulkanState.SurfaceFormat;
+            ImageCreateInfo.extent = { VulkanState.SurfaceExtent.width, VulkanState.SurfaceExtent.height, 1 };
+            ImageCreateInfo.mipLevels = 1;
+            ImageCreateInfo.arrayLayers = 1;
+            ImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            ImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            ImageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            ImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ImageCreateInfo.queueFamilyIndexCount = 0;
+            ImageCreateInfo.pQueueFamilyIndices = nullptr;
+            ImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VkImage Image;
+            Result = vkCreateImage(VulkanState.Device, &ImageCreateInfo, nullptr, &Image);
+            assert(Result == VK_SUCCESS);
+            VulkanState.SwapchainImages[ImageIndex] = Image;
+            VulkanState.OffscreenImages[ImageIndex] = ResourceAdd(&VulkanState.Resources, ResourceType_Image, Image);
+
+            VkMemoryRequirements MemoryRequirements;
+            vkGetImageMemoryRequirements(VulkanState.Device, Image, &MemoryRequirements);
+
+            uint32_t MemoryTypeIndex = VulkanFindMemoryType(&VulkanState.SelectedDeviceInfo->MemoryProperties, MemoryRequirements.memoryTypeBits,
+                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            assert(MemoryTypeIndex != UINT32_MAX);
+
+            VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+            AllocateInfo.pNext = nullptr;
+            AllocateInfo.allocationSize = MemoryRequirements.size;
+            AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+
+            VkDeviceMemory Memory;
+            Result = vkAllocateMemory(VulkanState.Device, &AllocateInfo, nullptr, &Memory);
+            assert(Result == VK_SUCCESS);
+            VulkanState.OffscreenImageMemory[ImageIndex] = ResourceAdd(&VulkanState.Resources, ResourceType_Memory, Memory);
+            vkBindImageMemory(VulkanState.Device, Image, Memory, 0);
+        }
+    }
+    else
+    {
+        // Create swapchain
+        VkSwapchainCreateInfoKHR SwapchainCreateInfo = { VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
+        SwapchainCreateInfo.pNext = nullptr;
+        SwapchainCreateInfo.flags = 0;
+        SwapchainCreateInfo.surface = VulkanState.Surface;
+        SwapchainCreateInfo.minImageCount = VulkanState.SurfaceCapabilities.minImageCount;
+        SwapchainCreateInfo.imageFormat = VulkanState.SurfaceFormat;
+        SwapchainCreateInfo.imageColorSpace = VulkanState.SurfaceColorSpace;
+        SwapchainCreateInfo.imageExtent = VulkanState.SurfaceExtent;
+        SwapchainCreateInfo.imageArrayLayers = 1;
+        SwapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (bIsCapturing ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+        SwapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        SwapchainCreateInfo.queueFamilyIndexCount = 1;
+        SwapchainCreateInfo.pQueueFamilyIndices = &VulkanState.SelectedDeviceQueueFamilyIndex;
+        SwapchainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+        SwapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        SwapchainCreateInfo.presentMode = VulkanState.SurfacePresentMode;
+        SwapchainCreateInfo.clipped = VK_TRUE;
+        SwapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+
+        vkCreateSwapchainKHR(VulkanState.Device, &SwapchainCreateInfo, nullptr, &VulkanState.Swapchain);
+
+        // Get images
+        uint32_t SwapchainImageCount;
+        vkGetSwapchainImagesKHR(VulkanState.Device, VulkanState.Swapchain, &SwapchainImageCount, nullptr);
+        VulkanState.SwapchainImages.resize(SwapchainImageCount);
+        vkGetSwapchainImagesKHR(VulkanState.Device, VulkanState.Swapchain, &SwapchainImageCount, VulkanState.SwapchainImages.data());
+    }
+
+    // Create image views
+    {
+        VulkanState.SwapchainImageViews.resize(VulkanState.SwapchainImages.size());
+        for(uint32_t ImageIndex = 0; ImageIndex < VulkanState.SwapchainImages.size(); ++ImageIndex)
+        {
+            VkImageViewCreateInfo ImageViewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+            ImageViewCreateInfo.pNext = nullptr;
+            ImageViewCreateInfo.flags = 0;
+            ImageViewCreateInfo.image = VulkanState.SwapchainImages[ImageIndex];
+            ImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            ImageViewCreateInfo.format = VulkanState.SurfaceFormat;
+            ImageViewCreateInfo.components =
+            {
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY
+            };
+            ImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            ImageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+            ImageViewCreateInfo.subresourceRange.levelCount = 1;
+            ImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+            ImageViewCreateInfo.subresourceRange.layerCount = 1;
+
+            VkImageView ImageView;
+            vkCreateImageView(VulkanState.Device, &ImageViewCreateInfo, nullptr, &ImageView);
+            VulkanState.SwapchainImageViews[ImageIndex] = ResourceAdd(&VulkanState.Resources, ResourceType_ImageView, ImageView);
+        }
+    }
+
+    // Create multisampled color target
+    {
+        // Highest sample count not above the requested one that both the color and the depth attachment support
+        const VkPhysicalDeviceLimits& Limits = VulkanState.SelectedDeviceInfo->Properties.limits;
+        VkSampleCountFlags SupportedSampleCounts = Limits.framebufferColorSampleCounts & Limits.framebufferDepthSampleCounts;
+        for(uint32_t SampleCount = VK_SAMPLE_COUNT_64_BIT; SampleCount > VK_SAMPLE_COUNT_1_BIT; SampleCount >>= 1)
+        {
+            if(SampleCount <= Options.MSAASampleCount && (SupportedSampleCounts & SampleCount))
+            {
+                VulkanState.SampleCount = (VkSampleCountFlagBits)SampleCount;
+                break;
+            }
+        }
+
+        if(VulkanState.SampleCount != VK_SAMPLE_COUNT_1_BIT)
+        {
+            VkImageCreateInfo ImageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+            ImageCreateInfo.pNext = nullptr;
+            ImageCreateInfo.flags = 0;
+            ImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            ImageCreateInfo.format = VulkanState.SurfaceFormat;
+            ImageCreateInfo.extent = { VulkanState.SurfaceExtent.width, VulkanState.SurfaceExtent.height, 1 };
+            ImageCreateInfo.mipLevels = 1;
+            ImageCreateInfo.arrayLayers = 1;
+            ImageCreateInfo.samples = VulkanState.SampleCount;
+            ImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            ImageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            ImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ImageCreateInfo.queueFamilyIndexCount = 0;
+            ImageCreateInfo.pQueueFamilyIndices = nullptr;
+            ImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VkImage Image;
+            Result = vkCreateImage(VulkanState.Device, &ImageCreateInfo, nullptr, &Image);
+            assert(Result == VK_SUCCESS);
+            VulkanState.MSAAImage = ResourceAdd(&VulkanState.Resources, ResourceType_Image, Image);
+
+            VkMemoryRequirements MemoryRequirements;
+            vkGetImageMemoryRequirements(VulkanState.Device, Image, &MemoryRequirements);
+
+            // On tilers the samples only ever live in tile memory, lazily allocated memory lets the driver skip backing them
+            const VkPhysicalDeviceMemoryProperties* MemoryProperties = &VulkanState.SelectedDeviceInfo->MemoryProperties;
+            uint32_t MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits,
+                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+            if(MemoryTypeIndex == UINT32_MAX)
+            {
+                MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            }
+            assert(MemoryTypeIndex != UINT32_MAX);
+
+            VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+            AllocateInfo.pNext = nullptr;
+            AllocateInfo.allocationSize = MemoryRequirements.size;
+            AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+
+            VkDeviceMemory Memory;
+            Result = vkAllocateMemory(VulkanState.Device, &AllocateInfo, nullptr, &Memory);
+            assert(Result == VK_SUCCESS);
+            VulkanState.MSAAMemory = ResourceAdd(&VulkanState.Resources, ResourceType_Memory, Memory);
+            vkBindImageMemory(VulkanState.Device, Image, Memory, 0);
+
+            VkImageViewCreateInfo ImageViewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+            ImageViewCreateInfo.pNext = nullptr;
+            ImageViewCreateInfo.flags = 0;
+            ImageViewCreateInfo.image = Image;
+            ImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            ImageViewCreateInfo.format = VulkanState.SurfaceFormat;
+            ImageViewCreateInfo.components =
+            {
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY
+            };
+            ImageViewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            VkImageView ImageView;
+            vkCreateImageView(VulkanState.Device, &ImageViewCreateInfo, nullptr, &ImageView);
+            VulkanState.MSAAImageView = ResourceAdd(&VulkanState.Resources, ResourceType_ImageView, ImageView);
+
+            bool bIsLazilyAllocated = (MemoryProperties->memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+            printf("MSAA: %ux%s\n", (uint32_t)VulkanState.SampleCount, bIsLazilyAllocated ? " (lazily allocated)" : "");
+        }
+    }
+
+    // Create depth target
+    {
+        // D16 is always supported, D32 is preferred for the precision
+        VkFormatProperties FormatProperties;
+        vkGetPhysicalDeviceFormatProperties(VulkanState.SelectedDevice, VK_FORMAT_D32_SFLOAT, &FormatProperties);
+        bool bIsD32Supported = (FormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) != 0;
+        VulkanState.DepthFormat = bIsD32Supported ? VK_FORMAT_D32_SFLOAT : VK_FORMAT_D16_UNORM;
+
+        VkImageCreateInfo ImageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        ImageCreateInfo.pNext = nullptr;
+        ImageCreateInfo.flags = 0;
+        ImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        ImageCreateInfo.format = VulkanState.DepthFormat;
+        ImageCreateInfo.extent = { VulkanState.SurfaceExtent.width, VulkanState.SurfaceExtent.height, 1 };
+        ImageCreateInfo.mipLevels = 1;
+        ImageCreateInfo.arrayLayers = 1;
+        ImageCreateInfo.samples = VulkanState.SampleCount;
+        ImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        ImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ImageCreateInfo.queueFamilyIndexCount = 0;
+        ImageCreateInfo.pQueueFamilyIndices = nullptr;
+        ImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage Image;
+        Result = vkCreateImage(VulkanState.Device, &ImageCreateInfo, nullptr, &Image);
+        assert(Result == VK_SUCCESS);
+        VulkanState.DepthImage = ResourceAdd(&VulkanState.Resources, ResourceType_Image, Image);
+
+        VkMemoryRequirements MemoryRequirements;
+        vkGetImageMemoryRequirements(VulkanState.Device, Image, &MemoryRequirements);
+
+        const VkPhysicalDeviceMemoryProperties* MemoryProperties = &VulkanState.SelectedDeviceInfo->MemoryProperties;
+        uint32_t MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits,
+                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+        if(MemoryTypeIndex == UINT32_MAX)
+        {
+            MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        assert(MemoryTypeIndex != UINT32_MAX);
+
+        VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        AllocateInfo.pNext = nullptr;
+        AllocateInfo.allocationSize = MemoryRequirements.size;
+        AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+
+        VkDeviceMemory Memory;
+        Result = vkAllocateMemory(VulkanState.Device, &AllocateInfo, nullptr, &Memory);
+        assert(Result == VK_SUCCESS);
+        VulkanState.DepthMemory = ResourceAdd(&VulkanState.Resources, ResourceType_Memory, Memory);
+        vkBindImageMemory(VulkanState.Device, Image, Memory, 0);
+
+        VkImageViewCreateInfo ImageViewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        ImageViewCreateInfo.pNext = nullptr;
+        ImageViewCreateInfo.flags = 0;
+        ImageViewCreateInfo.image = Image;
+        ImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        ImageViewCreateInfo.format = VulkanState.DepthFormat;
+        ImageViewCreateInfo.components =
+        {
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY
+        };
+        ImageViewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+        VkImageView ImageView;
+        vkCreateImageView(VulkanState.Device, &ImageViewCreateInfo, nullptr, &ImageView);
+        VulkanState.DepthImageView = ResourceAdd(&VulkanState.Resources, ResourceType_ImageView, ImageView);
+    }
+
+    // The rest of the startup only creates objects, so it's spread over jobs: the render pass first, then the pipelines
+    // and framebuffers that need it, while the main thread sets up the texture streamer and the per-frame resources.
+    // Only the mesh upload submits anything, which is fine as nothing else uses the graphics queue before the main loop.
+    SJobCounter RenderPassCounter;
+    SJobCounter StartupCounter;
+
+    // Create render pass
+    JobSystemAdd(&JobSystem, "CreateRenderPass", &RenderPassCounter, [&VulkanState, &Options, bIsCapturing]
+    {
+        bool bIsMultisampled = VulkanState.SampleCount != VK_SAMPLE_COUNT_1_BIT;
+
+        // When capturing, the final image is left ready for the readback copy (and transitioned for presenting after it)
+        VkImageLayout OutputLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        if(bIsCapturing)
+        {
+            OutputLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        }
+        else if(Options.bHeadless)
+        {
+            OutputLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+
+        // Without MSAA only the swapchain image is used, otherwise the multisampled image is
+        // rendered to, then resolved into the swapchain image and discarded
+        VkAttachmentDescription ColorAttachment = {};
+        ColorAttachment.flags = 0;
+        ColorAttachment.format = VulkanState.SurfaceFormat;
+        ColorAttachment.samples = VulkanState.SampleCount;
+        ColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        ColorAttachment.storeOp = bIsMultisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+        ColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        ColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        ColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        ColorAttachment.finalLayout = bIsMultisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : OutputLayout;
+
+        VkAttachmentDescription ResolveAttachment = {};
+        ResolveAttachment.flags = 0;
+        ResolveAttachment.format = VulkanState.SurfaceFormat;
+        ResolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        ResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        ResolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        ResolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        ResolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        ResolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        ResolveAttachment.finalLayout = OutputLayout;
+
+        // Only needed during the subpass, like the MSAA image
+        VkAttachmentDescription DepthAttachment = {};
+        DepthAttachment.flags = 0;
+        DepthAttachment.format = VulkanState.DepthFormat;
+        DepthAttachment.samples = VulkanState.SampleCount;
+        DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        DepthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        DepthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        DepthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentDescription Attachments[] =
+        {
+            ColorAttachment,
+            DepthAttachment,
+            ResolveAttachment,
+        };
+        uint32_t AttachmentCount = bIsMultisampled ? 3 : 2;
+
+        VkAttachmentReference ColorAttachmentReference = {};
+        ColorAttachmentReference.attachment = 0;
+        ColorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference DepthAttachmentReference = {};
+        DepthAttachmentReference.attachment = 1;
+        DepthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference ResolveAttachmentReference = {};
+        ResolveAttachmentReference.attachment = 2;
+        ResolveAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription Subpass = {};
+        Subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        Subpass.colorAttachmentCount = 1;
+        Subpass.pColorAttachments = &ColorAttachmentReference;
+        Subpass.pResolveAttachments = bIsMultisampled ? &ResolveAttachmentReference : nullptr;
+        Subpass.pDepthStencilAttachment = &DepthAttachmentReference;
+
+        // Make the layout transition wait for the acquire semaphore, which is waited on at COLOR_ATTACHMENT_OUTPUT.
+        // This also orders the writes to the MSAA and depth images, which are shared by all frames in flight.
+        VkSubpassDependency AcquireDependency = {};
+        AcquireDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        AcquireDependency.dstSubpass = 0;
+        AcquireDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        AcquireDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        AcquireDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        AcquireDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        AcquireDependency.dependencyFlags = 0;
+
+        // Make the rendered image visible to the readback copy
+        VkSubpassDependency CaptureDependency = {};
+        CaptureDependency.srcSubpass = 0;
+        CaptureDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        CaptureDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        CaptureDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        CaptureDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        CaptureDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        CaptureDependency.dependencyFlags = 0;
+
+        VkSubpassDependency Dependencies[] =
+        {
+            AcquireDependency,
+            CaptureDependency,
+        };
+
+        VkRenderPassCreateInfo RenderPassCreateInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+        RenderPassCreateInfo.pNext = nullptr;
+        RenderPassCreateInfo.flags = 0;
+        RenderPassCreateInfo.attachmentCount = AttachmentCount;
+        RenderPassCreateInfo.pAttachments = Attachments;
+        RenderPassCreateInfo.subpassCount = 1;
+        RenderPassCreateInfo.pSubpasses = &Subpass;
+        RenderPassCreateInfo.dependencyCount = bIsCapturing ? 2 : 1;
+        RenderPassCreateInfo.pDependencies = Dependencies;
+
+        VkRenderPass RenderPass;
+        vkCreateRenderPass(VulkanState.Device, &RenderPassCreateInfo, nullptr, &RenderPass);
+        VulkanState.RenderPass = ResourceAdd(&VulkanState.Resources, ResourceType_RenderPass, RenderPass);
+    });
+
+    // Create texture streamer, this starts loading the textures in the background
+    STextureStreamer TextureStreamer = {};
+    {
+        VkDeviceSize Budget = (VkDeviceSize)Options.TextureBudgetMiB * 1024 * 1024;
+        if(!TextureStreamerInit(&TextureStreamer, &JobSystem, VulkanState.Device, VulkanState.SelectedDevice, &VulkanState.SelectedDeviceInfo->MemoryProperties,
+                                &VulkanState.Resources, &VulkanState.TransferTimeline, VulkanState.TransferQueueFamilyIndex, VulkanState.SelectedDeviceQueueFamilyIndex,
+                                Budget, Options.TexturePaths))
+        {
+            return -1;
+        }
+
+        if(VulkanState.TransferQueueFamilyIndex != VulkanState.SelectedDeviceQueueFamilyIndex)
+        {
+            printf("Texture uploads use dedicated transfer queue family %u\n", VulkanState.TransferQueueFamilyIndex);
+        }
+    }
+
+    // Particle state and simulation pipeline, the draw pipeline is built with the others
+    SParticleSystem ParticleSystem = {};
+    if(Options.ParticleCount)
+    {
+        if(!ParticleSystemInit(&ParticleSystem, VulkanState.Device, VulkanState.SelectedDeviceInfo, &VulkanState.GraphicsTimeline, &VulkanState.ComputeTimeline,
+                               VulkanState.SelectedDeviceQueueFamilyIndex, VulkanState.ComputeQueueFamilyIndex, Options.ParticleCount))
+        {
+            return -1;
+        }
+    }
+
+    // Load mesh, after the texture streamer since the transfer queue may be the graphics queue
+    SMesh Mesh = {};
+    bool bIsMeshLoaded = false;
+    if(Options.MeshPath)
+    {
+        JobSystemAdd(&JobSystem, "LoadMesh", &StartupCounter, [&Mesh, &VulkanState, &Options, &bIsMeshLoaded]
+        {
+            bIsMeshLoaded = MeshLoad(&Mesh, VulkanState.Device, &VulkanState.SelectedDeviceInfo->MemoryProperties,
+                                     &VulkanState.GraphicsTimeline, VulkanState.SelectedDeviceQueueFamilyIndex, Options.MeshPath);
+        });
+    }
+
+    // Setup graphics pipelines, they are all built at the same time once the render pass exists
+    SPipelineDesc TrianglePipelineDesc = {};
+    SPipelineDesc MeshPipelineDesc = {};
+    SPipelineDesc ParticlePipelineDesc = {};
+    {
+        // The triangles are flat and drawn without depth testing, their vertices come from the vertex index.
+        // Per draw: texture descriptor set and the triangle's scale/offset.
+        TrianglePipelineDesc.ShaderPath = "Shaders/shader.spv";
+        TrianglePipelineDesc.Extent = { Width, Height };
+        TrianglePipelineDesc.SetLayout = TextureStreamer.SetLayout;
+        TrianglePipelineDesc.CullMode = VK_CULL_MODE_NONE;
+        TrianglePipelineDesc.FrontFace = VK_FRONT_FACE_CLOCKWISE;
+        TrianglePipelineDesc.bDepthTest = false;
+        TrianglePipelineDesc.PushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+        TrianglePipelineDesc.PushConstantSize = 4 * sizeof(float);
+
+        JobSystemAddAfter(&JobSystem, "CreateTrianglePipeline", &RenderPassCounter, &StartupCounter, [&VulkanState, &TrianglePipelineDesc]
+        {
+            VulkanCreateGraphicsPipeline(&VulkanState, &TrianglePipelineDesc, &VulkanState.PipelineLayout, &VulkanState.Pipeline);
+        });
+
+        // glTF winding, the projection flips y so it stays counter-clockwise on screen
+        if(Options.MeshPath)
+        {
+            MeshPipelineDesc.ShaderPath = "Shaders/mesh.spv";
+            MeshPipelineDesc.Extent = { Width, Height };
+            MeshPipelineDesc.SetLayout = TextureStreamer.SetLayout;
+            MeshPipelineDesc.VertexBindingCount = 1;
+            MeshPipelineDesc.VertexBindings = &MeshVertexBinding;
+            MeshPipelineDesc.VertexAttributeCount = ArrayCount(MeshVertexAttributes);
+            MeshPipelineDesc.VertexAttributes = MeshVertexAttributes;
+            MeshPipelineDesc.CullMode = VK_CULL_MODE_BACK_BIT;
+            MeshPipelineDesc.FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+            MeshPipelineDesc.bDepthTest = true;
+            MeshPipelineDesc.PushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+            MeshPipelineDesc.PushConstantSize = sizeof(SMeshDrawConstants);
+
+            JobSystemAddAfter(&JobSystem, "CreateMeshPipeline", &RenderPassCounter, &StartupCounter, [&VulkanState, &MeshPipelineDesc]
+            {
+                VulkanCreateGraphicsPipeline(&VulkanState, &MeshPipelineDesc, &VulkanState.MeshPipelineLayout, &VulkanState.MeshPipeline);
+            });
+        }
+
+        // One triangle per particle instance, read from the state buffer, blended additively without depth
+        if(Options.ParticleCount)
+        {
+            ParticlePipelineDesc.ShaderPath = "Shaders/particles.spv";
+            ParticlePipelineDesc.Extent = { Width, Height };
+            ParticlePipelineDesc.SetLayout = ParticleSystem.DrawSetLayout;
+            ParticlePipelineDesc.CullMode = VK_CULL_MODE_NONE;
+            ParticlePipelineDesc.FrontFace = VK_FRONT_FACE_CLOCKWISE;
+            ParticlePipelineDesc.bDepthTest = false;
+            ParticlePipelineDesc.bAdditiveBlend = true;
+            ParticlePipelineDesc.PushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+            ParticlePipelineDesc.PushConstantSize = sizeof(SParticleDrawConstants);
+
+            JobSystemAddAfter(&JobSystem, "CreateParticlePipeline", &RenderPassCounter, &StartupCounter, [&VulkanState, &ParticlePipelineDesc]
+            {
+                VulkanCreateGraphicsPipeline(&VulkanState, &ParticlePipelineDesc, &VulkanState.ParticlePipelineLayout, &VulkanState.ParticlePipeline);
+            });
+        }
+    }
+
+    // Create framebuffers
+    JobSystemAddAfter(&JobSystem, "CreateFramebuffers", &RenderPassCounter, &StartupCounter, [&VulkanState]
+    {
+        SResourceTable* Resources = &VulkanState.Resources;
+        VkImageView MSAAImageView = ResourceGet<VkImageView>(Resources, VulkanState.MSAAImageView, ResourceType_ImageView);
+        VkImageView DepthImageView = ResourceGet<VkImageView>(Resources, VulkanState.DepthImageView, ResourceType_ImageView);
+
+        VulkanState.Framebuffers.resize(VulkanState.SwapchainImages.size());
+        for(uint32_t ImageIndex = 0; ImageIndex < VulkanState.SwapchainImages.size(); ++ImageIndex)
+        {
+            // Same order as the render pass attachments: color, depth, resolve
+            VkImageView SwapchainImageView = ResourceGet<VkImageView>(Resources, VulkanState.SwapchainImageViews[ImageIndex], ResourceType_ImageView);
+            VkImageView Attachments[3];
+            uint32_t AttachmentCount = 0;
+            if(VulkanState.SampleCount != VK_SAMPLE_COUNT_1_BIT)
+            {
+                Attachments[AttachmentCount++] = MSAAImageView;
+                Attachments[AttachmentCount++] = DepthImageView;
+                Attachments[AttachmentCount++] = SwapchainImageView;
+            }
+            else
+            {
+                Attachments[AttachmentCount++] = SwapchainImageView;
+                Attachments[AttachmentCount++] = DepthImageView;
+            }
+
+            VkFramebufferCreateInfo FramebufferCreateInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+            FramebufferCreateInfo.pNext = nullptr;
+            FramebufferCreateInfo.flags = 0;
+            FramebufferCreateInfo.renderPass = ResourceGet<VkRenderPass>(Resources, VulkanState.RenderPass, ResourceType_RenderPass);
+            FramebufferCreateInfo.attachmentCount = AttachmentCount;
+            FramebufferCreateInfo.pAttachments = Attachments;
+            FramebufferCreateInfo.width = VulkanState.SurfaceExtent.width;
+            FramebufferCreateInfo.height = VulkanState.SurfaceExtent.height;
+            FramebufferCreateInfo.layers = 1;
+
+            VkFramebuffer Framebuffer;
+            vkCreateFramebuffer(VulkanState.Device, &FramebufferCreateInfo, nullptr, &Framebuffer);
+            VulkanState.Framebuffers[ImageIndex] = ResourceAdd(Resources, ResourceType_Framebuffer, Framebuffer);
+        }
+    });
+
+    // Create per-frame resources
+    for(uint32_t FrameIndex = 0; FrameIndex < MaxFramesInFlight; ++FrameIndex)
+    {
+        SFrameContext& Frame = VulkanState.Frames[FrameIndex];
+
+        // Command pool
+        VkCommandPool CommandPool;
+        {
+            VkCommandPoolCreateInfo CommandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+            CommandPoolCreateInfo.pNext = nullptr;
+            CommandPoolCreateInfo.queueFamilyIndex = VulkanState.SelectedDeviceQueueFamilyIndex;
+            CommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+            vkCreateCommandPool(VulkanState.Device, &CommandPoolCreateInfo, nullptr, &CommandPool);
+            Frame.CommandPool = ResourceAdd(&VulkanState.Resources, ResourceType_CommandPool, CommandPool);
+        }
+
+        // Command buffer
+        {
+            VkCommandBufferAllocateInfo CommandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+            CommandBufferInfo.pNext = nullptr;
+            CommandBufferInfo.commandPool = CommandPool;
+            CommandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            CommandBufferInfo.commandBufferCount = 1;
+
+            vkAllocateCommandBuffers(VulkanState.Device, &CommandBufferInfo, &Frame.CommandBuffer);
+        }
+
+        // Secondary command buffer pools, one per job system worker
+        Frame.WorkerCommandPools.resize(JobSystemGetWorkerCount(&JobSystem));
+        for(SWorkerCommandPool& Pool : Frame.WorkerCommandPools)
+        {
+            VkCommandPoolCreateInfo CommandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+            CommandPoolCreateInfo.pNext = nullptr;
+            CommandPoolCreateInfo.queueFamilyIndex = VulkanState.SelectedDeviceQueueFamilyIndex;
+            CommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+            VkCommandPool WorkerCommandPool;
+            vkCreateCommandPool(VulkanState.Device, &CommandPoolCreateInfo, nullptr, &WorkerCommandPool);
+            Pool.CommandPool = ResourceAdd(&VulkanState.Resources, ResourceType_CommandPool, WorkerCommandPool);
+            Pool.UsedCount = 0;
+        }
+
+        VkSemaphoreCreateInfo SemaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+        VkSemaphore Semaphore;
+        vkCreateSemaphore(VulkanState.Device, &SemaphoreCreateInfo, nullptr, &Semaphore);
+        Frame.ImageAvailableSemaphore = ResourceAdd(&VulkanState.Resources, ResourceType_Semaphore, Semaphore);
+
+        Frame.TimelineValue = 0;
+    }
+
+    // Create per swapchain image semaphores
+    if(!Options.bHeadless)
+    {
+        VulkanState.RenderFinishedSemaphores.resize(VulkanState.SwapchainImages.size());
+        for(SResourceHandle& SemaphoreHandle : VulkanState.RenderFinishedSemaphores)
+        {
+            VkSemaphoreCreateInfo SemaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+            VkSemaphore Semaphore;
+            vkCreateSemaphore(VulkanState.Device, &SemaphoreCreateInfo, nullptr, &Semaphore);
+            SemaphoreHandle = ResourceAdd(&VulkanState.Resources, ResourceType_Semaphore, Semaphore);
+        }
+    }
+
+    SPresentTimingLog PresentTimingLog;
+    PresentTimingInit(&PresentTimingLog, Options.PresentLogPath);
+
+    SPresentWaiter PresentWaiter = {};
+    if(VulkanState.bPresentWaitEnabled)
+    {
+        PresentWaiterInit(&PresentWaiter, VulkanState.Device, VulkanState.Swapchain, VulkanState.vkWaitForPresent, &PresentTimingLog);
+    }
+
+    SFrameCapture FrameCapture = {};
+    if(bIsCapturing)
+    {
+        FrameCapture.bKeepLastFrame = Options.GoldenPath != nullptr;
+        if(!FrameCaptureInit(&FrameCapture, VulkanState.Device, &VulkanState.SelectedDeviceInfo->MemoryProperties, Options.CapturePath,
+                             VulkanState.SurfaceExtent.width, VulkanState.SurfaceExtent.height, VulkanState.SurfaceFormat, Options.TargetFrameRate))
+        {
+            return -1;
+        }
+    }
+
+    // Wait for the startup jobs
+    JobSystemWait(&JobSystem, &RenderPassCounter);
+    JobSystemWait(&JobSystem, &StartupCounter);
+    if(Options.MeshPath && !bIsMeshLoaded)
+    {
+        return -1;
+    }
+
+    SScene Scene;
+    SceneInit(&Scene);
+    if(Options.MeshPath && Options.InstanceCount)
+    {
+        SceneAddMeshInstances(&Scene, &Mesh, Options.InstanceCount);
+        printf("Scene: %u mesh instances, culled with the %s kernel\n", SceneGetObjectCount(&Scene), CullKernelNames[Scene.Kernel]);
+    }
+
+    // Main loop
+    //
+    // Nothing is rendered while the window is hidden, otherwise we block on window events until either
+    // something needs to be redrawn or the next frame is due at the target frame rate.
+    // Headless runs render back to back until the requested number of frames is done.
+    const uint64_t FrameIntervalNs = Options.TargetFrameRate ? 1000000000ull / Options.TargetFrameRate : 0;
+    uint64_t NextFrameTime = PlatformGetTimeNs();
+    const uint64_t LoopStartTime = NextFrameTime;
+    uint32_t RenderedFrameCount = 0;
+    // Per frame, kept around to avoid reallocating them
+    SDrawQueue DrawQueue = {};
+    std::vector<VkCommandBuffer> SecondaryCommandBuffers;
+    while(Options.bHeadless || !Window->bCloseRequested)
+    {
+        if(Options.FrameCount && RenderedFrameCount >= Options.FrameCount)
+        {
+            break;
+        }
+
+        if(!Options.bHeadless)
+        {
+            uint64_t TimeoutNs = UINT64_MAX;
+            if(Window->bIsVisible)
+            {
+                if(Window->bNeedsRedraw)
+                {
+                    TimeoutNs = 0;
+                }
+                else if(FrameIntervalNs)
+                {
+                    uint64_t Now = PlatformGetTimeNs();
+                    TimeoutNs = (NextFrameTime > Now) ? NextFrameTime - Now : 0;
+                }
+            }
+
+            PlatformWaitForEvents(Window, TimeoutNs);
+
+            if(Window->bCloseRequested || !Window->bIsVisible)
+            {
+                continue;
+            }
+
+            uint64_t Now = PlatformGetTimeNs();
+            bool bIsFrameDue = FrameIntervalNs && Now >= NextFrameTime;
+            if(!Window->bNeedsRedraw && !bIsFrameDue)
+            {
+                continue;
+            }
+
+            Window->bNeedsRedraw = false;
+            if(FrameIntervalNs)
+            {
+                // Don't try to catch up on missed frames
+                NextFrameTime = std::max(NextFrameTime + FrameIntervalNs, Now);
+            }
+        }
+
+        // Wait for the previous frame to actually reach the display before starting on the next one.
+        // This keeps at most one frame queued up in front of the display, minimizing latency.
+        // The waiter thread does the actual vkWaitForPresentKHR (and records the present time) as soon as the
+        // present is queued, so this only blocks for as long as the present is still outstanding.
+        if(VulkanState.bPresentWaitEnabled && VulkanState.PresentId > 0)
+        {
+            constexpr uint64_t PresentWaitTimeoutNs = 100000000ull;
+            PresentWaiterWait(&PresentWaiter, VulkanState.PresentId, PresentWaitTimeoutNs);
+        }
+
+        // Render
+        {
+            uint32_t FrameIndex = VulkanState.FrameIndex;
+            SFrameContext& Frame = VulkanState.Frames[FrameIndex];
+            VulkanState.FrameIndex = (VulkanState.FrameIndex + 1) % MaxFramesInFlight;
+
+            // Wait until the GPU is done with the last submission that used this frame's resources
+            TimelineWait(&VulkanState.GraphicsTimeline, Frame.TimelineValue);
+
+            TextureStreamerUpdate(&TextureStreamer, &VulkanState.GraphicsTimeline);
+            ResourceCollect(&VulkanState.Resources);
+
+            // Windowed capture never holds up rendering, frames are dropped instead when the writer can't keep up.
+            // Headless runs exist to produce the frames, so they wait for a free slot.
+            uint32_t CaptureSlot = UINT32_MAX;
+            if(bIsCapturing)
+            {
+                CaptureSlot = FrameCaptureBeginFrame(&FrameCapture, &VulkanState.GraphicsTimeline, Options.bHeadless);
+            }
+
+            SResourceTable* Resources = &VulkanState.Resources;
+
+            // Headless images are per frame in flight
+            uint32_t ImageIndex = FrameIndex;
+            VkSemaphore ImageAvailableSemaphore = ResourceGet<VkSemaphore>(Resources, Frame.ImageAvailableSemaphore, ResourceType_Semaphore);
+            if(!Options.bHeadless)
+            {
+                vkAcquireNextImageKHR(VulkanState.Device, VulkanState.Swapchain, UINT64_MAX, ImageAvailableSemaphore, VK_NULL_HANDLE, &ImageIndex);
+            }
+
+            // Nothing recorded for this frame is in flight anymore
+            vkResetCommandPool(VulkanState.Device, ResourceGet<VkCommandPool>(Resources, Frame.CommandPool, ResourceType_CommandPool), 0);
+            for(SWorkerCommandPool& Pool : Frame.WorkerCommandPools)
+            {
+                vkResetCommandPool(VulkanState.Device, ResourceGet<VkCommandPool>(Resources, Pool.CommandPool, ResourceType_CommandPool), 0);
+                Pool.UsedCount = 0;
+            }
+
+            VkCommandBufferBeginInfo CommandBufferBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+            CommandBufferBeginInfo.pNext = nullptr;
+            CommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            CommandBufferBeginInfo.pInheritanceInfo = nullptr;
+
+            VkCommandBuffer CommandBuffer = Frame.CommandBuffer;
+            vkBeginCommandBuffer(CommandBuffer, &CommandBufferBeginInfo);
+
+            // Draws are recorded by jobs into secondary command buffers while the main thread starts the primary one.
+            // Texture requests stay on the main thread, the streamer isn't thread safe.
+            VkRenderPass RenderPass = ResourceGet<VkRenderPass>(Resources, VulkanState.RenderPass, ResourceType_RenderPass);
+            VkFramebuffer Framebuffer = ResourceGet<VkFramebuffer>(Resources, VulkanState.Framebuffers[ImageIndex], ResourceType_Framebuffer);
+            SJobCounter RecordCounter;
+            float ViewProjection[16];
+            DrawQueueBeginFrame(&DrawQueue);
+            if(Options.ParticleCount)
+            {
+                // Before the render pass: on the graphics queue the step is recorded into the primary command buffer
+                ParticleSystemSimulate(&ParticleSystem, CommandBuffer, FrameIndex);
+
+                // The camera orbits slowly, tied to the frame count so that captured frames are reproducible
+                float AspectRatio = (float)VulkanState.SurfaceExtent.width / (float)VulkanState.SurfaceExtent.height;
+                ParticleSystemGetViewProjection(0.005f * (float)RenderedFrameCount, AspectRatio, ViewProjection);
+
+                SecondaryCommandBuffers.resize(1);
+                JobSystemAdd(&JobSystem, "RecordParticles", &RecordCounter,
+                             [&VulkanState, &Frame, &ParticleSystem, &ViewProjection, &SecondaryCommandBuffers, RenderPass, Framebuffer, AspectRatio]
+                {
+                    SResourceTable* Resources = &VulkanState.Resources;
+                    VkCommandBuffer CommandBuffer = VulkanBeginSecondaryCommandBuffer(&VulkanState, &Frame, RenderPass, Framebuffer);
+                    ParticleSystemRecordDraw(&ParticleSystem, CommandBuffer,
+                                             ResourceGet<VkPipelineLayout>(Resources, VulkanState.ParticlePipelineLayout, ResourceType_PipelineLayout),
+                                             ResourceGet<VkPipeline>(Resources, VulkanState.ParticlePipeline, ResourceType_Pipeline),
+                                             ViewProjection, AspectRatio);
+                    vkEndCommandBuffer(CommandBuffer);
+                    SecondaryCommandBuffers[0] = CommandBuffer;
+                });
+            }
+            else if(Options.MeshPath && Options.InstanceCount)
+            {
+                // The camera turns slowly, tied to the frame count so that captured frames are reproducible
+                float Angle = 0.01f * (float)RenderedFrameCount;
+                float AspectRatio = (float)VulkanState.SurfaceExtent.width / (float)VulkanState.SurfaceExtent.height;
+                SceneSetFieldCamera(&Scene, Angle, AspectRatio);
+                SceneCull(&Scene, &JobSystem);
+
+                VkDescriptorSet DescriptorSet = TextureStreamer.DefaultTexture.Resident.DescriptorSet;
+                if(!Options.TexturePaths.empty())
+                {
+                    TextureStreamerRequest(&TextureStreamer, 0, 0.25f * (float)std::min(VulkanState.SurfaceExtent.width, VulkanState.SurfaceExtent.height));
+                    DescriptorSet = TextureStreamerGetDescriptorSet(&TextureStreamer, 0);
+                }
+
+                // Only the visible instances are emitted, front to back. The push constants of every instance are
+                // computed by jobs into the reserved packets.
+                uint32_t PipelineIndex = DrawQueueGetPipeline(&DrawQueue, ResourceGet<VkPipeline>(Resources, VulkanState.MeshPipeline, ResourceType_Pipeline),
+                                                              ResourceGet<VkPipelineLayout>(Resources, VulkanState.MeshPipelineLayout, ResourceType_PipelineLayout),
+                                                              VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+                uint32_t MaterialIndex = DrawQueueGetMaterial(&DrawQueue, DescriptorSet);
+                uint32_t FirstPacket = DrawQueueReserve(&DrawQueue, Scene.VisibleCount, sizeof(SMeshDrawConstants));
+
+                SJobCounter EmitCounter;
+                for(uint32_t FirstDraw = 0; FirstDraw < Scene.VisibleCount; FirstDraw += SceneCullChunkSize)
+                {
+                    JobSystemAdd(&JobSystem, "EmitMeshInstances", &EmitCounter,
+                                 [&DrawQueue, &Mesh, &Scene, FirstDraw, FirstPacket, PipelineIndex, MaterialIndex]
+                    {
+                        SDrawPacket Packet = {};
+                        Packet.VertexBuffer = Mesh.Buffer;
+                        Packet.IndexBuffer = Mesh.Buffer;
+                        Packet.IndexOffset = Mesh.IndexOffset;
+                        Packet.IndexType = Mesh.IndexType;
+                        Packet.Count = Mesh.IndexCount;
+
+                        uint32_t EndDraw = std::min(FirstDraw + SceneCullChunkSize, Scene.VisibleCount);
+                        for(uint32_t DrawIndex = FirstDraw; DrawIndex < EndDraw; ++DrawIndex)
+                        {
+                            const SSceneObject* Object = &Scene.Objects[Scene.VisibleObjects[DrawIndex]];
+
+                            // Clip space w is the view space depth
+                            const float* ViewProjection = Scene.ViewProjection;
+                            float Depth = ViewProjection[3] * Object->Position[0] + ViewProjection[7] * Object->Position[1] +
+                                          ViewProjection[11] * Object->Position[2] + ViewProjection[15];
+
+                            uint64_t Key = DrawQueueMakeKey(DrawPass_Opaque, PipelineIndex, MaterialIndex, Depth);
+                            void* PushConstants = DrawQueueWrite(&DrawQueue, FirstPacket + DrawIndex, Key, &Packet);
+                            MeshGetInstanceDrawConstants(&Mesh, Scene.ViewProjection, Object->Position, Object->Scale, Object->Angle,
+                                                         (SMeshDrawConstants*)PushConstants);
+                        }
+                    });
+                }
+                JobSystemWait(&JobSystem, &EmitCounter);
+            }
+            else if(Options.MeshPath)
+            {
+                // Slow spin, tied to the frame count so that captured frames are reproducible
+                float Angle = 0.01f * (float)RenderedFrameCount;
+                float AspectRatio = (float)VulkanState.SurfaceExtent.width / (float)VulkanState.SurfaceExtent.height;
+
+                VkDescriptorSet DescriptorSet = TextureStreamer.DefaultTexture.Resident.DescriptorSet;
+                if(!Options.TexturePaths.empty())
+                {
+                    TextureStreamerRequest(&TextureStreamer, 0, (float)std::min(VulkanState.SurfaceExtent.width, VulkanState.SurfaceExtent.height));
+                    DescriptorSet = TextureStreamerGetDescriptorSet(&TextureStreamer, 0);
+                }
+
+                uint32_t PipelineIndex = DrawQueueGetPipeline(&DrawQueue, ResourceGet<VkPipeline>(Resources, VulkanState.MeshPipeline, ResourceType_Pipeline),
+                                                              ResourceGet<VkPipelineLayout>(Resources, VulkanState.MeshPipelineLayout, ResourceType_PipelineLayout),
+                                                              VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+                uint32_t MaterialIndex = DrawQueueGetMaterial(&DrawQueue, DescriptorSet);
+
+                SDrawPacket Packet = {};
+                Packet.VertexBuffer = Mesh.Buffer;
+                Packet.IndexBuffer = Mesh.Buffer;
+                Packet.IndexOffset = Mesh.IndexOffset;
+                Packet.IndexType = Mesh.IndexType;
+                Packet.Count = Mesh.IndexCount;
+
+                uint32_t PacketIndex = DrawQueueReserve(&DrawQueue, 1, sizeof(SMeshDrawConstants));
+                void* PushConstants = DrawQueueWrite(&DrawQueue, PacketIndex, DrawQueueMakeKey(DrawPass_Opaque, PipelineIndex, MaterialIndex, 0.0f), &Packet);
+                MeshGetDrawConstants(&Mesh, Angle, AspectRatio, (SMeshDrawConstants*)PushConstants);
+            }
+            else
+            {
+                // One triangle per texture on a square grid, a single untextured (white) one without textures.
+                // Textures that aren't resident yet share the placeholder's descriptor set, sorting groups them.
+                uint32_t DrawCount = std::max((uint32_t)Options.TexturePaths.size(), 1u);
+                uint32_t GridSize = (uint32_t)ceilf(sqrtf((float)DrawCount));
+                float Scale = 1.0f / GridSize;
+
+                uint32_t PipelineIndex = DrawQueueGetPipeline(&DrawQueue, ResourceGet<VkPipeline>(Resources, VulkanState.Pipeline, ResourceType_Pipeline),
+                                                              ResourceGet<VkPipelineLayout>(Resources, VulkanState.PipelineLayout, ResourceType_PipelineLayout),
+                                                              VK_SHADER_STAGE_VERTEX_BIT);
+                uint32_t FirstPacket = DrawQueueReserve(&DrawQueue, DrawCount, 4 * sizeof(float));
+                for(uint32_t DrawIndex = 0; DrawIndex < DrawCount; ++DrawIndex)
+                {
+                    VkDescriptorSet DescriptorSet = TextureStreamer.DefaultTexture.Resident.DescriptorSet;
+                    if(!Options.TexturePaths.empty())
+                    {
+                        // The triangle's bounding box spans half of the scaled viewport
+                        float ScreenSize = 0.5f * Scale * (float)std::max(VulkanState.SurfaceExtent.width, VulkanState.SurfaceExtent.height);
+                        TextureStreamerRequest(&TextureStreamer, DrawIndex, ScreenSize);
+                        DescriptorSet = TextureStreamerGetDescriptorSet(&TextureStreamer, DrawIndex);
+                    }
+
+                    float Transform[4] =
+                    {
+                        Scale, Scale,
+                        -1.0f + Scale * (2 * (DrawIndex % GridSize) + 1),
+                        -1.0f + Scale * (2 * (DrawIndex / GridSize) + 1),
+                    };
+
+                    SDrawPacket Packet = {};
+                    Packet.Count = 3;
+
+                    uint64_t Key = DrawQueueMakeKey(DrawPass_Opaque, PipelineIndex, DrawQueueGetMaterial(&DrawQueue, DescriptorSet), 0.0f);
+                    void* PushConstants = DrawQueueWrite(&DrawQueue, FirstPacket + DrawIndex, Key, &Packet);
+                    memcpy(PushConstants, Transform, sizeof(Transform));
+                }
+            }
+
+            // Everything but the particles goes through the draw queue: sorted once all draws are in, then recorded in
+            // ranges by jobs. Bigger ranges with more draws so that there aren't thousands of secondary command buffers.
+            if(!Options.ParticleCount)
+            {
+                uint32_t WorkerCount = JobSystemGetWorkerCount(&JobSystem);
+                uint32_t PacketCount = (uint32_t)DrawQueue.Packets.size();
+                uint32_t DrawsPerJob = std::max(DrawsPerRecordJob, (PacketCount + 4 * WorkerCount - 1) / (4 * WorkerCount));
+                DrawQueueSort(&DrawQueue, DrawsPerJob);
+
+                SecondaryCommandBuffers.resize(DrawQueue.JobCount);
+                for(uint32_t JobIndex = 0; JobIndex < DrawQueue.JobCount; ++JobIndex)
+                {
+                    JobSystemAdd(&JobSystem, "RecordDraws", &RecordCounter,
+                                 [&VulkanState, &Frame, &DrawQueue, &SecondaryCommandBuffers, RenderPass, Framebuffer, JobIndex]
+                    {
+                        VkCommandBuffer CommandBuffer = VulkanBeginSecondaryCommandBuffer(&VulkanState, &Frame, RenderPass, Framebuffer);
+                        DrawQueueRecord(&DrawQueue, CommandBuffer, JobIndex);
+                        vkEndCommandBuffer(CommandBuffer);
+                        SecondaryCommandBuffers[JobIndex] = CommandBuffer;
+                    });
+                }
+            }
+
+            {
+                // Indexed by attachment, the resolve attachment's clear value is ignored
+                VkClearValue ClearValues[3] = {};
+                ClearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+                ClearValues[1].depthStencil = { 1.0f, 0 };
+
+                VkRenderPassBeginInfo RenderPassBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+                RenderPassBeginInfo.pNext = nullptr;
+                RenderPassBeginInfo.renderPass = RenderPass;
+                RenderPassBeginInfo.framebuffer = Framebuffer;
+                RenderPassBeginInfo.renderArea.offset = { 0, 0 };
+                RenderPassBeginInfo.renderArea.extent = VulkanState.SurfaceExtent;
+                RenderPassBeginInfo.clearValueCount = 2;
+                RenderPassBeginInfo.pClearValues = ClearValues;
+
+                vkCmdBeginRenderPass(CommandBuffer, &RenderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+                // Runs record jobs itself until they're all done
+                JobSystemWait(&JobSystem, &RecordCounter);
+                DrawQueueEndFrame(&DrawQueue);
+                if(!SecondaryCommandBuffers.empty())
+                {
+                    vkCmdExecuteCommands(CommandBuffer, (uint32_t)SecondaryCommandBuffers.size(), SecondaryCommandBuffers.data());
+                }
+
+                vkCmdEndRenderPass(CommandBuffer);
+
+                if(bIsCapturing)
+                {
+                    if(CaptureSlot != UINT32_MAX)
+                    {
+                        FrameCaptureRecordCopy(&FrameCapture, CommandBuffer, CaptureSlot, VulkanState.SwapchainImages[ImageIndex]);
+                    }
+
+                    if(!Options.bHeadless)
+                    {
+                        VkImageMemoryBarrier PresentBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+                        PresentBarrier.pNext = nullptr;
+                        PresentBarrier.srcAccessMask = 0;
+                        PresentBarrier.dstAccessMask = 0;
+                        PresentBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                        PresentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+                        PresentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        PresentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        PresentBarrier.image = VulkanState.SwapchainImages[ImageIndex];
+                        PresentBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                             0, nullptr, 0, nullptr, 1, &PresentBarrier);
+                    }
+                }
+            }
+            vkEndCommandBuffer(CommandBuffer);
+
+            // Texture uploads are complete by the time they're used, the wait only provides the memory dependency
+            SVulkanSubmitSync SubmitSync = {};
+            SubmitWaitTimeline(&SubmitSync, &VulkanState.TransferTimeline, TextureStreamerGetWaitValue(&TextureStreamer), VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            if(Options.ParticleCount)
+            {
+                SubmitWaitTimeline(&SubmitSync, &VulkanState.ComputeTimeline, ParticleSystemGetWaitValue(&ParticleSystem),
+                                   VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+            }
+
+            if(Options.bHeadless)
+            {
+                Frame.TimelineValue = TimelineSubmit(&VulkanState.GraphicsTimeline, 1, &CommandBuffer, &SubmitSync);
+            }
+            else
+            {
+                VkSemaphore RenderFinishedSemaphore = ResourceGet<VkSemaphore>(Resources, VulkanState.RenderFinishedSemaphores[ImageIndex], ResourceType_Semaphore);
+
+                SubmitWaitBinary(&SubmitSync, ImageAvailableSemaphore, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+                SubmitSignalBinary(&SubmitSync, RenderFinishedSemaphore);
+
+                Frame.TimelineValue = TimelineSubmit(&VulkanState.GraphicsTimeline, 1, &CommandBuffer, &SubmitSync);
+
+                uint64_t PresentId = ++VulkanState.PresentId;
+
+                VkPresentIdKHR PresentIdInfo = { VK_STRUCTURE_TYPE_PRESENT_ID_KHR };
+                PresentIdInfo.pNext = nullptr;
+                PresentIdInfo.swapchainCount = 1;
+                PresentIdInfo.pPresentIds = &PresentId;
+
+                VkPresentTimeGOOGLE PresentTime = {};
+                PresentTime.presentID = (uint32_t)PresentId;
+                PresentTime.desiredPresentTime = 0;
+
+                VkPresentTimesInfoGOOGLE PresentTimesInfo = { VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE };
+                PresentTimesInfo.pNext = nullptr;
+                PresentTimesInfo.swapchainCount = 1;
+                PresentTimesInfo.pTimes = &PresentTime;
+
+                VkPresentInfoKHR PresentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+                PresentInfo.pNext = nullptr;
+                if(VulkanState.bPresentWaitEnabled)
+                {
+                    PresentInfo.pNext = &PresentIdInfo;
+                }
+                else if(VulkanState.bDisplayTimingEnabled)
+                {
+                    PresentInfo.pNext = &PresentTimesInfo;
+                }
+                PresentInfo.waitSemaphoreCount = 1;
+                PresentInfo.pWaitSemaphores = &RenderFinishedSemaphore;
+                PresentInfo.swapchainCount = 1;
+                PresentInfo.pSwapchains = &VulkanState.Swapchain;
+                PresentInfo.pImageIndices = &ImageIndex;
+                PresentInfo.pResults = nullptr;
+
+                vkQueuePresentKHR(VulkanState.Queue, &PresentInfo);
+                if(VulkanState.bPresentWaitEnabled)
+                {
+                    PresentWaiterQueue(&PresentWaiter, PresentId);
+                }
+            }
+
+            if(Options.ParticleCount)
+            {
+                ParticleSystemEndFrame(&ParticleSystem, Frame.TimelineValue);
+            }
+
+            if(CaptureSlot != UINT32_MAX)
+            {
+                FrameCaptureEndFrame(&FrameCapture, CaptureSlot, Frame.TimelineValue);
+            }
+        }
+
+        RenderedFrameCount++;
+
+        // Keep rendering while textures are streaming in, even in on demand mode
+        if(!Options.bHeadless && TextureStreamerIsBusy(&TextureStreamer))
+        {
+            Window->bNeedsRedraw = true;
+        }
+
+        // Collect the timings the presentation engine has reported since the last frame
+        if(VulkanState.bDisplayTimingEnabled)
+        {
+            uint32_t TimingCount = 0;
+            VulkanState.vkGetPastPresentationTiming(VulkanState.Device, VulkanState.Swapchain, &TimingCount, nullptr);
+            if(TimingCount)
+            {
+                std::vector<VkPastPresentationTimingGOOGLE> Timings(TimingCount);
+                VulkanState.vkGetPastPresentationTiming(VulkanState.Device, VulkanState.Swapchain, &TimingCount, Timings.data());
+                for(uint32_t TimingIndex = 0; TimingIndex < TimingCount; ++TimingIndex)
+                {
+                    const VkPastPresentationTimingGOOGLE& Timing = Timings[TimingIndex];
+                    PresentTimingRecord(&PresentTimingLog, Timing.presentID, Timing.actualPresentTime, Timing.presentMargin);
+                }
+            }
+        }
+    }
+
+    if(VulkanState.bPresentWaitEnabled)
+    {
+        PresentWaiterShutdown(&PresentWaiter);
+    }
+
+    // Let the GPU finish everything before exiting
+    TimelineWait(&VulkanState.GraphicsTimeline, VulkanState.GraphicsTimeline.LastSubmittedValue);
+    TimelineWait(&VulkanState.ComputeTimeline, VulkanState.ComputeTimeline.LastSubmittedValue);
+
+    const uint64_t LoopEndTime = PlatformGetTimeNs();
+    double ElapsedMs = (double)(LoopEndTime - LoopStartTime) / 1000000.0;
+    if(Options.bHeadless)
+    {
+        printf("Rendered %u frames in %.3fms (%.1f fps)\n", RenderedFrameCount, ElapsedMs,
+               ElapsedMs > 0.0 ? 1000.0 * RenderedFrameCount / ElapsedMs : 0.0);
+    }
+
+    bool bRegressionPassed = true;
+    if(bIsCapturing)
+    {
+        FrameCaptureClose(&FrameCapture, &VulkanState.GraphicsTimeline);
+
+        if(Options.GoldenPath)
+        {
+            bRegressionPassed &= !FrameCapture.LastFrame.empty() &&
+                RegressionCheckGolden(Options.GoldenPath, FrameCapture.Width, FrameCapture.Height, FrameCapture.LastFrame.data(),
+                                      Options.GoldenTolerance, Options.bUpdateReferences);
+        }
+    }
+
+    if(!Options.TexturePaths.empty())
+    {
+        TextureStreamerPrintStats(&TextureStreamer);
+    }
+
+    // shutdown_ms only covers the teardown, the capture and golden check above are done by now
+    const uint64_t ShutdownStartTime = PlatformGetTimeNs();
+    TextureStreamerShutdown(&TextureStreamer);
+
+    if(Options.MeshPath)
+    {
+        MeshDestroy(&Mesh, VulkanState.Device);
+    }
+
+    if(Options.ParticleCount)
+    {
+        ParticleSystemPrintStats(&ParticleSystem);
+        ParticleSystemDestroy(&ParticleSystem);
+    }
+
+    // Everything is idle by now, the device goes after every object created from it
+    ResourceTableDestroy(&VulkanState.Resources);
+    TimelineDestroy(&VulkanState.ComputeTimeline);
+    TimelineDestroy(&VulkanState.TransferTimeline);
+    TimelineDestroy(&VulkanState.GraphicsTimeline);
+    if(VulkanState.Swapchain)
+    {
+        vkDestroySwapchainKHR(VulkanState.Device, VulkanState.Swapchain, nullptr);
+    }
+    vkDestroyDevice(VulkanState.Device, nullptr);
+    if(VulkanState.Surface)
+    {
+        vkDestroySurfaceKHR(VulkanState.Instance, VulkanState.Surface, nullptr);
+    }
+    if(Window)
+    {
+        PlatformCloseWindow(Window);
+    }
+    if(DebugCallbackObj)
+    {
+        PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallback =
+            (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(VulkanState.Instance, "vkDestroyDebugReportCallbackEXT");
+        vkDestroyDebugReportCallback(VulkanState.Instance, DebugCallbackObj, nullptr);
+    }
+    vkDestroyInstance(VulkanState.Instance, nullptr);
+    const uint64_t ShutdownEndTime = PlatformGetTimeNs();
+
+    if(Options.BaselinePath)
+    {
+        SPerfMetric Metrics[] =
+        {
+            { "startup_ms", (double)(LoopStartTime - ProgramStartTime) / 1000000.0 },
+            { "frame_ms", ElapsedMs / (double)std::max(RenderedFrameCount, 1u) },
+            { "shutdown_ms", (double)(ShutdownEndTime - ShutdownStartTime) / 1000000.0 },
+        };
+        bRegressionPassed &= RegressionCheckBaseline(Options.BaselinePath, Metrics, ArrayCount(Metrics), Options.PerfThresholdPercent,
+                                                     Options.bPerfGate, Options.bUpdateReferences);
+    }
+
+    ScenePrintStats(&Scene);
+    DrawQueuePrintStats(&DrawQueue);
+    JobSystemPrintStats(&JobSystem);
+    if(Options.JobTracePath)
+    {
+        JobSystemWriteTrace(&JobSystem, Options.JobTracePath);
+    }
+    JobSystemShutdown(&JobSystem);
+
+    PresentTimingClose(&PresentTimingLog);
+
+    return bRegressionPassed ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+//
+// Cooked mesh format (.lbm) and its runtime loading.
+//
+// The file is laid out exactly the way the GPU consumes it, so loading is a memory mapping, a header check
+// and one copy into device local memory. Meshes are cooked from glTF by MeshImport.cpp (-cook).
+//
+// Vertices are 16 bytes, half of what float position/normal/texcoord would take:
+//   Position  R16G16B16A16_SNORM  relative to the bounding box (w is padding)
+//   Normal    R16G16_SNORM        octahedral encoding
+//   TexCoord  R16G16_UNORM        relative to the texcoord bounds
+// The dequantization scale/offset is stored in the header and applied in the vertex shader.
+//
+
+constexpr uint32_t MeshFileMagic = 'L' | ('B' << 8) | ('M' << 16) | ('S' << 24);
+constexpr uint32_t MeshFileVersion = 1;
+// Vertex and index data start on this alignment
+constexpr uint32_t MeshFileDataAlignment = 16;
+
+struct SMeshVertex
+{
+    int16_t Position[4];
+    int16_t Normal[2];
+    uint16_t TexCoord[2];
+};
+static_assert(sizeof(SMeshVertex) == 16, "Vertex layout has to match the pipeline vertex input");
+
+// Pipeline vertex input for SMeshVertex: snorm positions, snorm octahedral normals, unorm texture coordinates
+const VkVertexInputBindingDescription MeshVertexBinding = { 0, sizeof(SMeshVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+const VkVertexInputAttributeDescription MeshVertexAttributes[] =
+{
+    { 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(SMeshVertex, Position) },
+    { 1, 0, VK_FORMAT_R16G16_SNORM, offsetof(SMeshVertex, Normal) },
+    { 2, 0, VK_FORMAT_R16G16_UNORM, offsetof(SMeshVertex, TexCoord) },
+};
+
+struct SMeshFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+    // 2 or 4
+    uint32_t IndexSize;
+    uint32_t Reserved;
+
+    // Dequantized value = quantized value * Scale + Offset
+    float PositionScale[3];
+    float PositionOffset[3];
+    float TexCoordScale[2];
+    float TexCoordOffset[2];
+
+    // xyz: center, w: radius
+    float BoundingSphere[4];
+
+    // From the start of the file
+    uint64_t VertexDataOffset;
+    uint64_t IndexDataOffset;
+};
+static_assert(sizeof(SMeshFileHeader) == 96, "The header is part of the file format");
+
+struct SMesh
+{
+    // Vertices and indices share one buffer, laid out like in the file
+    VkBuffer Buffer;
+    VkDeviceMemory Memory;
+    VkDeviceSize IndexOffset;
+    VkIndexType IndexType;
+
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+
+    float PositionScale[3];
+    float PositionOffset[3];
+    float TexCoordScale[2];
+    float TexCoordOffset[2];
+    float BoundingSphere[4];
+};
+
+// Push constants of the mesh pipeline, see Shaders/mesh.vert
+struct SMeshDrawConstants
+{
+    // Clip space from quantized position, column major
+    float Transform[16];
+    // Object space, w unused
+    float LightDirection[4];
+    // xy: scale, zw: offset
+    float TexCoordTransform[4];
+};
+
+// Loads a cooked mesh and uploads it on the given (graphics) queue, waiting for the upload to finish
+bool MeshLoad(SMesh* Mesh, VkDevice Device, const VkPhysicalDeviceMemoryProperties* MemoryProperties,
+              SVulkanTimeline* Timeline, uint32_t QueueFamilyIndex, const char* Path)
+{
+    SMappedFile File = PlatformMapFile(Path);
+    if(!File.Data)
+    {
+        printf("Mesh: couldn't open %s\n", Path);
+        return false;
+    }
+
+    // Only the header is checked, the cooker is trusted to have written valid indices
+    SMeshFileHeader Header = {};
+    if(File.Size >= sizeof(Header))
+    {
+        memcpy(&Header, File.Data, sizeof(Header));
+    }
+
+    uint64_t VertexDataSize = (uint64_t)Header.VertexCount * sizeof(SMeshVertex);
+    uint64_t IndexDataSize = (uint64_t)Header.IndexCount * Header.IndexSize;
+    if(File.Size < sizeof(Header) || Header.Magic != MeshFileMagic || Header.Version != MeshFileVersion ||
+       (Header.IndexSize != 2 && Header.IndexSize != 4) || Header.IndexCount == 0 || Header.IndexCount % 3 != 0 ||
+       Header.VertexDataOffset % MeshFileDataAlignment != 0 || Header.IndexDataOffset % MeshFileDataAlignment != 0 ||
+       Header.VertexDataOffset < sizeof(Header) || Header.IndexDataOffset < Header.VertexDataOffset + VertexDataSize ||
+       Header.IndexDataOffset + IndexDataSize > File.Size)
+    {
+        printf("Mesh: %s is not a valid cooked mesh (version %u expected)\n", Path, MeshFileVersion);
+        PlatformUnmapFile(&File);
+        return false;
+    }
+
+    Mesh->VertexCount = Header.VertexCount;
+    Mesh->IndexCount = Header.IndexCount;
+    Mesh->IndexType = (Header.IndexSize == 2) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    Mesh->IndexOffset = Header.IndexDataOffset - Header.VertexDataOffset;
+    memcpy(Mesh->PositionScale, Header.PositionScale, sizeof(Mesh->PositionScale));
+    memcpy(Mesh->PositionOffset, Header.PositionOffset, sizeof(Mesh->PositionOffset));
+    memcpy(Mesh->TexCoordScale, Header.TexCoordScale, sizeof(Mesh->TexCoordScale));
+    memcpy(Mesh->TexCoordOffset, Header.TexCoordOffset, sizeof(Mesh->TexCoordOffset));
+    memcpy(Mesh->BoundingSphere, Header.BoundingSphere, sizeof(Mesh->BoundingSphere));
+
+    VkDeviceSize DataSize = Mesh->IndexOffset + IndexDataSize;
+
+    // Device local buffer and a staging buffer the mapped file is copied into
+    VkBuffer StagingBuffer;
+    VkDeviceMemory StagingMemory;
+    for(uint32_t BufferIndex = 0; BufferIndex < 2; ++BufferIndex)
+    {
+        bool bIsStaging = BufferIndex == 1;
+
+        VkBufferCreateInfo BufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        BufferCreateInfo.pNext = nullptr;
+        BufferCreateInfo.flags = 0;
+        BufferCreateInfo.size = DataSize;
+        BufferCreateInfo.usage = bIsStaging ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT :
+            (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        BufferCreateInfo.queueFamilyIndexCount = 0;
+        BufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+        VkBuffer* Buffer = bIsStaging ? &StagingBuffer : &Mesh->Buffer;
+        VkDeviceMemory* Memory = bIsStaging ? &StagingMemory : &Mesh->Memory;
+
+        VkResult Result = vkCreateBuffer(Device, &BufferCreateInfo, nullptr, Buffer);
+        assert(Result == VK_SUCCESS);
+
+        VkMemoryRequirements MemoryRequirements;
+        vkGetBufferMemoryRequirements(Device, *Buffer, &MemoryRequirements);
+
+        VkMemoryPropertyFlags RequiredFlags = bIsStaging ? (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) :
+                                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        uint32_t MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits, RequiredFlags);
+        assert(MemoryTypeIndex != UINT32_MAX);
+
+        VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        AllocateInfo.pNext = nullptr;
+        AllocateInfo.allocationSize = MemoryRequirements.size;
+        AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+
+        Result = vkAllocateMemory(Device, &AllocateInfo, nullptr, Memory);
+        assert(Result == VK_SUCCESS);
+        vkBindBufferMemory(Device, *Buffer, *Memory, 0);
+    }
+
+    void* Mapped;
+    vkMapMemory(Device, StagingMemory, 0, VK_WHOLE_SIZE, 0, &Mapped);
+    memcpy(Mapped, File.Data + Header.VertexDataOffset, (size_t)DataSize);
+    vkUnmapMemory(Device, StagingMemory);
+    PlatformUnmapFile(&File);
+
+    VkCommandPool CommandPool;
+    {
+        VkCommandPoolCreateInfo CommandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        CommandPoolCreateInfo.pNext = nullptr;
+        CommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        CommandPoolCreateInfo.queueFamilyIndex = QueueFamilyIndex;
+        vkCreateCommandPool(Device, &CommandPoolCreateInfo, nullptr, &CommandPool);
+    }
+
+    VkCommandBuffer CommandBuffer;
+    {
+        VkCommandBufferAllocateInfo CommandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        CommandBufferInfo.pNext = nullptr;
+        CommandBufferInfo.commandPool = CommandPool;
+        CommandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        CommandBufferInfo.commandBufferCount = 1;
+        vkAllocateCommandBuffers(Device, &CommandBufferInfo, &CommandBuffer);
+    }
+
+    VkCommandBufferBeginInfo BeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    BeginInfo.pNext = nullptr;
+    BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    BeginInfo.pInheritanceInfo = nullptr;
+    vkBeginCommandBuffer(CommandBuffer, &BeginInfo);
+    {
+        VkBufferCopy Region = { 0, 0, DataSize };
+        vkCmdCopyBuffer(CommandBuffer, StagingBuffer, Mesh->Buffer, 1, &Region);
+
+        // Later submissions on this queue are ordered after the barrier
+        VkBufferMemoryBarrier Barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+        Barrier.pNext = nullptr;
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.buffer = Mesh->Buffer;
+        Barrier.offset = 0;
+        Barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                             0, nullptr, 1, &Barrier, 0, nullptr);
+    }
+    vkEndCommandBuffer(CommandBuffer);
+
+    uint64_t UploadValue = TimelineSubmit(Timeline, 1, &CommandBuffer, nullptr);
+    TimelineWait(Timeline, UploadValue);
+
+    vkDestroyCommandPool(Device, CommandPool, nullptr);
+    vkDestroyBuffer(Device, StagingBuffer, nullptr);
+    vkFreeMemory(Device, StagingMemory, nullptr);
+
+    printf("Mesh: %s, %u vertices, %u triangles (%.1f KiB)\n", Path, Mesh->VertexCount, Mesh->IndexCount / 3, DataSize / 1024.0);
+    return true;
+}
+
+void MeshDestroy(SMesh* Mesh, VkDevice Device)
+{
+    vkDestroyBuffer(Device, Mesh->Buffer, nullptr);
+    vkFreeMemory(Device, Mesh->Memory, nullptr);
+    *Mesh = {};
+}
+
+// Column major 4x4 matrix product, Result can't alias the inputs
+static void MeshMultiplyMatrix(float* Result, const float* A, const float* B)
+{
+    for(uint32_t Column = 0; Column < 4; ++Column)
+    {
+        for(uint32_t Row = 0; Row < 4; ++Row)
+        {
+            float Sum = 0.0f;
+            for(uint32_t k = 0; k < 4; ++k)
+            {
+                Sum += A[k * 4 + Row] * B[Column * 4 + k];
+            }
+            Result[Column * 4 + Row] = Sum;
+        }
+    }
+}
+
+// Object space from quantized position
+static void MeshGetDequantizeMatrix(const SMesh* Mesh, float* Dequantize)
+{
+    const float Matrix[16] =
+    {
+        Mesh->PositionScale[0], 0.0f, 0.0f, 0.0f,
+        0.0f, Mesh->PositionScale[1], 0.0f, 0.0f,
+        0.0f, 0.0f, Mesh->PositionScale[2], 0.0f,
+        Mesh->PositionOffset[0], Mesh->PositionOffset[1], Mesh->PositionOffset[2], 1.0f,
+    };
+    memcpy(Dequantize, Matrix, sizeof(Matrix));
+}
+
+// Fixed light from the upper front, rotated back into object space by the inverse of the rotation about the vertical axis
+static void MeshSetShadingConstants(const SMesh* Mesh, float Cos, float Sin, SMeshDrawConstants* Constants)
+{
+    float Light[3] = { 0.36f, 0.80f, 0.48f };
+    Constants->LightDirection[0] = Cos * Light[0] - Sin * Light[2];
+    Constants->LightDirection[1] = Light[1];
+    Constants->LightDirection[2] = Sin * Light[0] + Cos * Light[2];
+    Constants->LightDirection[3] = 0.0f;
+
+    Constants->TexCoordTransform[0] = Mesh->TexCoordScale[0];
+    Constants->TexCoordTransform[1] = Mesh->TexCoordScale[1];
+    Constants->TexCoordTransform[2] = Mesh->TexCoordOffset[0];
+    Constants->TexCoordTransform[3] = Mesh->TexCoordOffset[1];
+}
+
+// The mesh spins around the vertical axis through its bounding sphere, viewed from a fixed camera that fits the sphere.
+// The dequantization is folded into the transform so the vertex shader only does a single matrix multiply.
+void MeshGetDrawConstants(const SMesh* Mesh, float Angle, float AspectRatio, SMeshDrawConstants* Constants)
+{
+    const float* Sphere = Mesh->BoundingSphere;
+    float Radius = std::max(Sphere[3], 1e-6f);
+
+    float Dequantize[16];
+    MeshGetDequantizeMatrix(Mesh, Dequantize);
+
+    // View space from object space: center the sphere, rotate, then move it in front of the camera
+    float Cos = cosf(Angle);
+    float Sin = sinf(Angle);
+    constexpr float VerticalFov = 0.9f;
+    float Distance = 1.1f * Radius / sinf(0.5f * VerticalFov);
+    float ModelView[16] =
+    {
+        Cos, 0.0f, -Sin, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        Sin, 0.0f, Cos, 0.0f,
+        -(Cos * Sphere[0] + Sin * Sphere[2]), -Sphere[1], Sin * Sphere[0] - Cos * Sphere[2] - Distance, 1.0f,
+    };
+
+    // Right handed view space looking down -z, Vulkan clip space (y down, depth 0 to 1)
+    float Near = Distance - 1.5f * Radius;
+    float Far = Distance + 1.5f * Radius;
+    float Focal = 1.0f / tanf(0.5f * VerticalFov);
+    float Projection[16] =
+    {
+        Focal / AspectRatio, 0.0f, 0.0f, 0.0f,
+        0.0f, -Focal, 0.0f, 0.0f,
+        0.0f, 0.0f, Far / (Near - Far), -1.0f,
+        0.0f, 0.0f, Near * Far / (Near - Far), 0.0f,
+    };
+
+    float ModelViewDequantize[16];
+    MeshMultiplyMatrix(ModelViewDequantize, ModelView, Dequantize);
+    MeshMultiplyMatrix(Constants->Transform, Projection, ModelViewDequantize);
+
+    MeshSetShadingConstants(Mesh, Cos, Sin, Constants);
+}
+
+// One of many copies of the mesh: placed at Position, uniformly scaled and rotated by Angle about the vertical axis
+void MeshGetInstanceDrawConstants(const SMesh* Mesh, const float* ViewProjection, const float* Position, float Scale, float Angle,
+                                  SMeshDrawConstants* Constants)
+{
+    float Dequantize[16];
+    MeshGetDequantizeMatrix(Mesh, Dequantize);
+
+    float Cos = cosf(Angle);
+    float Sin = sinf(Angle);
+    float Model[16] =
+    {
+        Scale * Cos, 0.0f, -Scale * Sin, 0.0f,
+        0.0f, Scale, 0.0f, 0.0f,
+        Scale * Sin, 0.0f, Scale * Cos, 0.0f,
+        Position[0], Position[1], Position[2], 1.0f,
+    };
+
+    float ModelDequantize[16];
+    MeshMultiplyMatrix(ModelDequantize, Model, Dequantize);
+    MeshMultiplyMatrix(Constants->Transform, ViewProjection, ModelDequantize);
+
+    MeshSetShadingConstants(Mesh, Cos, Sin, Constants);
+}
@@ -0,0 +1,990 @@
+//
+// glTF 2.0 import and mesh cooking (-cook).
+//
+// Every triangle primitive reachable from the default scene is merged into a single mesh in scene space,
+// then the mesh is optimized for the GPU and written in the cooked format described in Mesh.cpp:
+//   1. Vertex cache: triangles are reordered with Forsyth's linear-speed vertex cache optimization so that
+//      consecutive triangles reuse the post-transform cache as much as possible.
+//   2. Overdraw: the cache optimized order is cut into clusters where the cache is cold anyway (so the split
+//      costs almost nothing), and the clusters are sorted so that the outward facing ones on the outside of the
+//      mesh are drawn first and occlude the rest.
+//   3. Vertex fetch: vertices are renumbered in order of first use, so vertex fetch walks memory linearly.
+//   4. Quantization to 16 byte vertices.
+//
+// Not supported: sparse accessors, morph targets/skins (ignored), percent encoded URIs and non-triangle primitives.
+//
+
+#include <cfloat>
+
+#include "Json.cpp"
+
+// The optimizer targets a slightly larger LRU cache than the FIFO used to measure the result, the order
+// works well for a range of hardware cache sizes
+constexpr uint32_t VertexCacheOptimizerSize = 32;
+constexpr uint32_t VertexCacheMeasureSize = 16;
+constexpr uint32_t OverdrawMinClusterTriangles = 64;
+
+struct SImportMesh
+{
+    // 3 floats per vertex
+    std::vector<float> Positions;
+    std::vector<float> Normals;
+    // 2 floats per vertex
+    std::vector<float> TexCoords;
+
+    std::vector<uint32_t> Indices;
+
+    uint32_t GetVertexCount() const { return (uint32_t)(Positions.size() / 3); }
+};
+
+struct SImportAccessor
+{
+    const uint8_t* Data;
+    uint32_t Count;
+    uint32_t ComponentCount;
+    uint32_t ComponentType;
+    uint32_t Stride;
+    bool bNormalized;
+};
+
+enum EGltfComponentType
+{
+    GltfComponentType_Byte = 5120,
+    GltfComponentType_UnsignedByte = 5121,
+    GltfComponentType_Short = 5122,
+    GltfComponentType_UnsignedShort = 5123,
+    GltfComponentType_UnsignedInt = 5125,
+    GltfComponentType_Float = 5126,
+};
+
+static bool MeshImportReadFile(const std::string& Path, std::vector<uint8_t>* Data)
+{
+    FILE* File = fopen(Path.c_str(), "rb");
+    if(!File)
+    {
+        return false;
+    }
+
+    fseek(File, 0, SEEK_END);
+    size_t FileSize = (size_t)ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    Data->resize(FileSize);
+    size_t BytesRead = fread(Data->data(), 1, FileSize, File);
+    fclose(File);
+    return BytesRead == FileSize;
+}
+
+static bool MeshImportDecodeBase64(const char* Text, size_t Length, std::vector<uint8_t>* Data)
+{
+    uint32_t Bits = 0;
+    uint32_t BitCount = 0;
+    for(size_t i = 0; i < Length && Text[i] != '='; ++i)
+    {
+        char C = Text[i];
+        uint32_t Value;
+        if(C >= 'A' && C <= 'Z') Value = C - 'A';
+        else if(C >= 'a' && C <= 'z') Value = C - 'a' + 26;
+        else if(C >= '0' && C <= '9') Value = C - '0' + 52;
+        else if(C == '+') Value = 62;
+        else if(C == '/') Value = 63;
+        else return false;
+
+        Bits = (Bits << 6) | Value;
+        BitCount += 6;
+        if(BitCount >= 8)
+        {
+            BitCount -= 8;
+            Data->push_back((uint8_t)(Bits >> BitCount));
+        }
+    }
+    return true;
+}
+
+static size_t GetComponentSize(uint32_t ComponentType)
+{
+    switch(ComponentType)
+    {
+        case GltfComponentType_Byte:
+        case GltfComponentType_UnsignedByte:
+            return 1;
+        case GltfComponentType_Short:
+        case GltfComponentType_UnsignedShort:
+            return 2;
+        case GltfComponentType_UnsignedInt:
+        case GltfComponentType_Float:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static bool MeshImportGetAccessor(const SJsonValue& Root, const std::vector<std::vector<uint8_t>>& Buffers, uint32_t Index, SImportAccessor* Accessor)
+{
+    const SJsonValue& Json = Root["accessors"].At(Index);
+    const SJsonValue& View = Root["bufferViews"].At(Json["bufferView"].GetUInt(UINT32_MAX));
+    if(Json.IsNull() || View.IsNull() || !Json["sparse"].IsNull())
+    {
+        return false;
+    }
+
+    const std::string& Type = Json["type"].String;
+    if(Type == "SCALAR") Accessor->ComponentCount = 1;
+    else if(Type == "VEC2") Accessor->ComponentCount = 2;
+    else if(Type == "VEC3") Accessor->ComponentCount = 3;
+    else if(Type == "VEC4") Accessor->ComponentCount = 4;
+    else return false;
+
+    Accessor->ComponentType = Json["componentType"].GetUInt();
+    Accessor->Count = Json["count"].GetUInt();
+    Accessor->bNormalized = Json["normalized"].Bool;
+
+    size_t ElementSize = GetComponentSize(Accessor->ComponentType) * Accessor->ComponentCount;
+    Accessor->Stride = View["byteStride"].GetUInt((uint32_t)ElementSize);
+
+    uint32_t BufferIndex = View["buffer"].GetUInt(UINT32_MAX);
+    size_t ViewOffset = View["byteOffset"].GetUInt();
+    size_t ViewLength = View["byteLength"].GetUInt();
+    size_t AccessorOffset = Json["byteOffset"].GetUInt();
+    if(ElementSize == 0 || Accessor->Count == 0 || BufferIndex >= Buffers.size() ||
+       ViewOffset + ViewLength > Buffers[BufferIndex].size() ||
+       AccessorOffset + (size_t)(Accessor->Count - 1) * Accessor->Stride + ElementSize > ViewLength)
+    {
+        return false;
+    }
+
+    Accessor->Data = Buffers[BufferIndex].data() + ViewOffset + AccessorOffset;
+    return true;
+}
+
+static float MeshImportReadFloat(const SImportAccessor* Accessor, uint32_t Element, uint32_t Component)
+{
+    const uint8_t* At = Accessor->Data + (size_t)Element * Accessor->Stride + Component * GetComponentSize(Accessor->ComponentType);
+    bool bNormalized = Accessor->bNormalized;
+    switch(Accessor->ComponentType)
+    {
+        case GltfComponentType_Byte: { int8_t V; memcpy(&V, At, 1); return bNormalized ? std::max(V / 127.0f, -1.0f) : V; }
+        case GltfComponentType_UnsignedByte: { uint8_t V = *At; return bNormalized ? V / 255.0f : V; }
+        case GltfComponentType_Short: { int16_t V; memcpy(&V, At, 2); return bNormalized ? std::max(V / 32767.0f, -1.0f) : V; }
+        case GltfComponentType_UnsignedShort: { uint16_t V; memcpy(&V, At, 2); return bNormalized ? V / 65535.0f : V; }
+        case GltfComponentType_UnsignedInt: { uint32_t V; memcpy(&V, At, 4); return (float)V; }
+        case GltfComponentType_Float: { float V; memcpy(&V, At, 4); return V; }
+        default: return 0.0f;
+    }
+}
+
+static uint32_t MeshImportReadIndex(const SImportAccessor* Accessor, uint32_t Element)
+{
+    const uint8_t* At = Accessor->Data + (size_t)Element * Accessor->Stride;
+    switch(Accessor->ComponentType)
+    {
+        case GltfComponentType_UnsignedByte: return *At;
+        case GltfComponentType_UnsignedShort: { uint16_t V; memcpy(&V, At, 2); return V; }
+        case GltfComponentType_UnsignedInt: { uint32_t V; memcpy(&V, At, 4); return V; }
+        default: return UINT32_MAX;
+    }
+}
+
+// Column major 4x4 matrix product
+static void MeshImportMultiply(float* Result, const float* A, const float* B)
+{
+    float Product[16];
+    for(uint32_t Column = 0; Column < 4; ++Column)
+    {
+        for(uint32_t Row = 0; Row < 4; ++Row)
+        {
+            float Sum = 0.0f;
+            for(uint32_t k = 0; k < 4; ++k)
+            {
+                Sum += A[k * 4 + Row] * B[Column * 4 + k];
+            }
+            Product[Column * 4 + Row] = Sum;
+        }
+    }
+    memcpy(Result, Product, sizeof(Product));
+}
+
+static void MeshImportGetNodeMatrix(const SJsonValue& Node, float* Matrix)
+{
+    const SJsonValue& MatrixJson = Node["matrix"];
+    if(MatrixJson.Array.size() == 16)
+    {
+        for(uint32_t i = 0; i < 16; ++i)
+        {
+            Matrix[i] = (float)MatrixJson.At(i).GetNumber();
+        }
+        return;
+    }
+
+    // T * R * S
+    const SJsonValue& T = Node["translation"];
+    const SJsonValue& R = Node["rotation"];
+    const SJsonValue& S = Node["scale"];
+    float Tx = (float)T.At(0).GetNumber(), Ty = (float)T.At(1).GetNumber(), Tz = (float)T.At(2).GetNumber();
+    float Qx = (float)R.At(0).GetNumber(), Qy = (float)R.At(1).GetNumber(), Qz = (float)R.At(2).GetNumber(), Qw = (float)R.At(3).GetNumber(1.0);
+    float Sx = (float)S.At(0).GetNumber(1.0), Sy = (float)S.At(1).GetNumber(1.0), Sz = (float)S.At(2).GetNumber(1.0);
+
+    float Rotation[9] =
+    {
+        1.0f - 2.0f * (Qy * Qy + Qz * Qz), 2.0f * (Qx * Qy + Qz * Qw), 2.0f * (Qx * Qz - Qy * Qw),
+        2.0f * (Qx * Qy - Qz * Qw), 1.0f - 2.0f * (Qx * Qx + Qz * Qz), 2.0f * (Qy * Qz + Qx * Qw),
+        2.0f * (Qx * Qz + Qy * Qw), 2.0f * (Qy * Qz - Qx * Qw), 1.0f - 2.0f * (Qx * Qx + Qy * Qy),
+    };
+    float Scale[3] = { Sx, Sy, Sz };
+    for(uint32_t Column = 0; Column < 3; ++Column)
+    {
+        for(uint32_t Row = 0; Row < 3; ++Row)
+        {
+            Matrix[Column * 4 + Row] = Rotation[Column * 3 + Row] * Scale[Column];
+        }
+        Matrix[Column * 4 + 3] = 0.0f;
+    }
+    Matrix[12] = Tx;
+    Matrix[13] = Ty;
+    Matrix[14] = Tz;
+    Matrix[15] = 1.0f;
+}
+
+// Appends a triangle primitive transformed by Matrix. Normals are transformed by the upper 3x3,
+// which is only exact for rotations and uniform scales.
+static bool MeshImportAddPrimitive(const SJsonValue& Root, const std::vector<std::vector<uint8_t>>& Buffers, const SJsonValue& Primitive,
+                                   const float* Matrix, SImportMesh* Mesh)
+{
+    if(Primitive["mode"].GetUInt(4) != 4)
+    {
+        printf("Cook: skipping non-triangle primitive\n");
+        return true;
+    }
+
+    const SJsonValue& Attributes = Primitive["attributes"];
+    SImportAccessor Positions, Normals, TexCoords, Indices;
+    if(!MeshImportGetAccessor(Root, Buffers, Attributes["POSITION"].GetUInt(UINT32_MAX), &Positions) || Positions.ComponentCount != 3)
+    {
+        printf("Cook: primitive has no usable POSITION attribute\n");
+        return false;
+    }
+
+    bool bHasNormals = MeshImportGetAccessor(Root, Buffers, Attributes["NORMAL"].GetUInt(UINT32_MAX), &Normals) &&
+                       Normals.ComponentCount == 3 && Normals.Count == Positions.Count;
+    bool bHasTexCoords = MeshImportGetAccessor(Root, Buffers, Attributes["TEXCOORD_0"].GetUInt(UINT32_MAX), &TexCoords) &&
+                         TexCoords.ComponentCount == 2 && TexCoords.Count == Positions.Count;
+    bool bHasIndices = !Primitive["indices"].IsNull();
+    if(bHasIndices && (!MeshImportGetAccessor(Root, Buffers, Primitive["indices"].GetUInt(), &Indices) || Indices.ComponentCount != 1))
+    {
+        printf("Cook: primitive has invalid indices\n");
+        return false;
+    }
+
+    uint32_t BaseVertex = Mesh->GetVertexCount();
+    for(uint32_t Vertex = 0; Vertex < Positions.Count; ++Vertex)
+    {
+        float P[3], N[3] = { 0.0f, 0.0f, 0.0f };
+        for(uint32_t c = 0; c < 3; ++c)
+        {
+            P[c] = MeshImportReadFloat(&Positions, Vertex, c);
+            N[c] = bHasNormals ? MeshImportReadFloat(&Normals, Vertex, c) : 0.0f;
+        }
+
+        for(uint32_t Row = 0; Row < 3; ++Row)
+        {
+            Mesh->Positions.push_back(Matrix[Row] * P[0] + Matrix[4 + Row] * P[1] + Matrix[8 + Row] * P[2] + Matrix[12 + Row]);
+            Mesh->Normals.push_back(Matrix[Row] * N[0] + Matrix[4 + Row] * N[1] + Matrix[8 + Row] * N[2]);
+        }
+        Mesh->TexCoords.push_back(bHasTexCoords ? MeshImportReadFloat(&TexCoords, Vertex, 0) : 0.0f);
+        Mesh->TexCoords.push_back(bHasTexCoords ? MeshImportReadFloat(&TexCoords, Vertex, 1) : 0.0f);
+    }
+
+    // Mirroring transforms flip the winding
+    float Determinant = Matrix[0] * (Matrix[5] * Matrix[10] - Matrix[9] * Matrix[6]) -
+                        Matrix[4] * (Matrix[1] * Matrix[10] - Matrix[9] * Matrix[2]) +
+                        Matrix[8] * (Matrix[1] * Matrix[6] - Matrix[5] * Matrix[2]);
+
+    size_t FirstIndex = Mesh->Indices.size();
+    uint32_t IndexCount = bHasIndices ? Indices.Count : Positions.Count;
+    for(uint32_t Triangle = 0; Triangle + 3 <= IndexCount; Triangle += 3)
+    {
+        uint32_t V[3];
+        for(uint32_t i = 0; i < 3; ++i)
+        {
+            V[i] = bHasIndices ? MeshImportReadIndex(&Indices, Triangle + i) : Triangle + i;
+            if(V[i] >= Positions.Count)
+            {
+                printf("Cook: index out of range\n");
+                return false;
+            }
+        }
+
+        // Degenerate triangles never produce pixels, they'd only confuse the optimizers
+        if(V[0] == V[1] || V[1] == V[2] || V[0] == V[2])
+        {
+            continue;
+        }
+        if(Determinant < 0.0f)
+        {
+            std::swap(V[1], V[2]);
+        }
+        for(uint32_t i = 0; i < 3; ++i)
+        {
+            Mesh->Indices.push_back(BaseVertex + V[i]);
+        }
+    }
+
+    // Missing normals are the area weighted average of the adjacent face normals
+    if(!bHasNormals)
+    {
+        for(size_t i = FirstIndex; i < Mesh->Indices.size(); i += 3)
+        {
+            const float* P0 = &Mesh->Positions[3 * Mesh->Indices[i + 0]];
+            const float* P1 = &Mesh->Positions[3 * Mesh->Indices[i + 1]];
+            const float* P2 = &Mesh->Positions[3 * Mesh->Indices[i + 2]];
+            float E1[3] = { P1[0] - P0[0], P1[1] - P0[1], P1[2] - P0[2] };
+            float E2[3] = { P2[0] - P0[0], P2[1] - P0[1], P2[2] - P0[2] };
+            float FaceNormal[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+            for(uint32_t k = 0; k < 3; ++k)
+            {
+                float* N = &Mesh->Normals[3 * Mesh->Indices[i + k]];
+                N[0] += FaceNormal[0];
+                N[1] += FaceNormal[1];
+                N[2] += FaceNormal[2];
+            }
+        }
+    }
+
+    for(size_t Vertex = BaseVertex; Vertex < Mesh->GetVertexCount(); ++Vertex)
+    {
+        float* N = &Mesh->Normals[3 * Vertex];
+        float Length = sqrtf(N[0] * N[0] + N[1] * N[1] + N[2] * N[2]);
+        if(Length > 0.0f)
+        {
+            N[0] /= Length;
+            N[1] /= Length;
+            N[2] /= Length;
+        }
+        else
+        {
+            N[0] = 0.0f;
+            N[1] = 0.0f;
+            N[2] = 1.0f;
+        }
+    }
+    return true;
+}
+
+static bool MeshImportAddNode(const SJsonValue& Root, const std::vector<std::vector<uint8_t>>& Buffers, uint32_t NodeIndex,
+                              const float* ParentMatrix, uint32_t Depth, SImportMesh* Mesh)
+{
+    const SJsonValue& Node = Root["nodes"].At(NodeIndex);
+    if(Node.IsNull() || Depth > 64)
+    {
+        printf("Cook: invalid node hierarchy\n");
+        return false;
+    }
+
+    float Matrix[16];
+    MeshImportGetNodeMatrix(Node, Matrix);
+    MeshImportMultiply(Matrix, ParentMatrix, Matrix);
+
+    if(!Node["mesh"].IsNull())
+    {
+        for(const SJsonValue& Primitive : Root["meshes"].At(Node["mesh"].GetUInt())["primitives"].Array)
+        {
+            if(!MeshImportAddPrimitive(Root, Buffers, Primitive, Matrix, Mesh))
+            {
+                return false;
+            }
+        }
+    }
+
+    for(const SJsonValue& Child : Node["children"].Array)
+    {
+        if(!MeshImportAddNode(Root, Buffers, Child.GetUInt(), Matrix, Depth + 1, Mesh))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool MeshImportGltf(const char* Path, SImportMesh* Mesh)
+{
+    std::vector<uint8_t> File;
+    if(!MeshImportReadFile(Path, &File))
+    {
+        printf("Cook: couldn't open %s\n", Path);
+        return false;
+    }
+
+    // Binary glTF: 12 byte header, then a JSON chunk and an optional BIN chunk
+    const char* JsonText = (const char*)File.data();
+    size_t JsonLength = File.size();
+    std::vector<uint8_t> BinaryChunk;
+    constexpr uint32_t GlbMagic = 0x46546C67;
+    constexpr uint32_t GlbChunkJson = 0x4E4F534A;
+    constexpr uint32_t GlbChunkBin = 0x004E4942;
+    uint32_t Magic = 0;
+    if(File.size() >= 4)
+    {
+        memcpy(&Magic, File.data(), 4);
+    }
+    if(Magic == GlbMagic)
+    {
+        JsonLength = 0;
+        size_t Offset = 12;
+        while(Offset + 8 <= File.size())
+        {
+            uint32_t ChunkLength, ChunkType;
+            memcpy(&ChunkLength, File.data() + Offset, 4);
+            memcpy(&ChunkType, File.data() + Offset + 4, 4);
+            Offset += 8;
+            if(Offset + ChunkLength > File.size())
+            {
+                break;
+            }
+
+            if(ChunkType == GlbChunkJson)
+            {
+                JsonText = (const char*)File.data() + Offset;
+                JsonLength = ChunkLength;
+            }
+            else if(ChunkType == GlbChunkBin && BinaryChunk.empty())
+            {
+                BinaryChunk.assign(File.data() + Offset, File.data() + Offset + ChunkLength);
+            }
+            Offset += (ChunkLength + 3) & ~3u;
+        }
+    }
+
+    SJsonValue Root;
+    if(JsonLength == 0 || !JsonParse(JsonText, JsonLength, &Root))
+    {
+        printf("Cook: %s is not a valid glTF file\n", Path);
+        return false;
+    }
+
+    // Buffer URIs are relative to the file
+    std::string BasePath = Path;
+    size_t Separator = BasePath.find_last_of("/\\");
+    BasePath = (Separator == std::string::npos) ? std::string() : BasePath.substr(0, Separator + 1);
+
+    std::vector<std::vector<uint8_t>> Buffers;
+    for(const SJsonValue& Buffer : Root["buffers"].Array)
+    {
+        Buffers.emplace_back();
+        const std::string& Uri = Buffer["uri"].String;
+        bool bSuccess = true;
+        if(Uri.empty())
+        {
+            Buffers.back() = BinaryChunk;
+        }
+        else if(Uri.compare(0, 5, "data:") == 0)
+        {
+            size_t DataStart = Uri.find(";base64,");
+            bSuccess = DataStart != std::string::npos &&
+                       MeshImportDecodeBase64(Uri.c_str() + DataStart + 8, Uri.size() - DataStart - 8, &Buffers.back());
+        }
+        else
+        {
+            bSuccess = MeshImportReadFile(BasePath + Uri, &Buffers.back());
+        }
+
+        if(!bSuccess || Buffers.back().size() < Buffer["byteLength"].GetUInt())
+        {
+            printf("Cook: couldn't load buffer %s\n", Uri.empty() ? "(GLB binary chunk)" : Uri.c_str());
+            return false;
+        }
+    }
+
+    const float Identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    const SJsonValue& Scene = Root["scenes"].At(Root["scene"].GetUInt());
+    if(!Scene.IsNull())
+    {
+        for(const SJsonValue& Node : Scene["nodes"].Array)
+        {
+            if(!MeshImportAddNode(Root, Buffers, Node.GetUInt(), Identity, 0, Mesh))
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        // No scene, every mesh as is
+        for(const SJsonValue& MeshJson : Root["meshes"].Array)
+        {
+            for(const SJsonValue& Primitive : MeshJson["primitives"].Array)
+            {
+                if(!MeshImportAddPrimitive(Root, Buffers, Primitive, Identity, Mesh))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    if(Mesh->Indices.empty())
+    {
+        printf("Cook: %s has no triangles\n", Path);
+        return false;
+    }
+    return true;
+}
+
+// Average cache miss ratio (post-transform cache misses per triangle) with a FIFO cache
+static float MeshComputeACMR(const std::vector<uint32_t>& Indices, uint32_t VertexCount, uint32_t CacheSize)
+{
+    // Timestamp based FIFO: a vertex is cached if it was inserted within the last CacheSize insertions
+    std::vector<uint32_t> InsertTime(VertexCount, 0);
+    uint32_t Time = CacheSize + 1;
+    uint32_t MissCount = 0;
+    for(uint32_t Index : Indices)
+    {
+        if(Time - InsertTime[Index] > CacheSize)
+        {
+            InsertTime[Index] = Time++;
+            MissCount++;
+        }
+    }
+    return (float)MissCount / (float)(Indices.size() / 3);
+}
+
+static float MeshGetVertexScore(int32_t CachePosition, uint32_t RemainingValence)
+{
+    if(RemainingValence == 0)
+    {
+        return -1.0f;
+    }
+
+    float Score = 0.0f;
+    if(CachePosition >= 0)
+    {
+        if(CachePosition < 3)
+        {
+            // The vertices of the last triangle get a fixed score, so the next triangle doesn't just continue a strip
+            Score = 0.75f;
+        }
+        else
+        {
+            float Scale = 1.0f / (VertexCacheOptimizerSize - 3);
+            Score = powf(1.0f - (CachePosition - 3) * Scale, 1.5f);
+        }
+    }
+
+    // Prefer vertices with few triangles left so that they're finished off and don't need to be reloaded later
+    Score += 2.0f / sqrtf((float)RemainingValence);
+    return Score;
+}
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation"
+static void MeshOptimizeVertexCache(std::vector<uint32_t>* Indices, uint32_t VertexCount)
+{
+    uint32_t TriangleCount = (uint32_t)(Indices->size() / 3);
+    const uint32_t* In = Indices->data();
+
+    // Triangles adjacent to each vertex
+    std::vector<uint32_t> RemainingValence(VertexCount, 0);
+    for(uint32_t Index : *Indices)
+    {
+        RemainingValence[Index]++;
+    }
+    std::vector<uint32_t> AdjacencyOffsets(VertexCount + 1, 0);
+    for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+    {
+        AdjacencyOffsets[Vertex + 1] = AdjacencyOffsets[Vertex] + RemainingValence[Vertex];
+    }
+    std::vector<uint32_t> Adjacency(Indices->size());
+    {
+        std::vector<uint32_t> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+        for(uint32_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+        {
+            for(uint32_t k = 0; k < 3; ++k)
+            {
+                Adjacency[Fill[In[3 * Triangle + k]]++] = Triangle;
+            }
+        }
+    }
+
+    std::vector<int32_t> CachePositions(VertexCount, -1);
+    std::vector<float> VertexScores(VertexCount);
+    for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+    {
+        VertexScores[Vertex] = MeshGetVertexScore(-1, RemainingValence[Vertex]);
+    }
+
+    std::vector<float> TriangleScores(TriangleCount);
+    std::vector<bool> bIsEmitted(TriangleCount, false);
+    int32_t BestTriangle = -1;
+    float BestScore = -1.0f;
+    for(uint32_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+    {
+        TriangleScores[Triangle] = VertexScores[In[3 * Triangle]] + VertexScores[In[3 * Triangle + 1]] + VertexScores[In[3 * Triangle + 2]];
+        if(TriangleScores[Triangle] > BestScore)
+        {
+            BestScore = TriangleScores[Triangle];
+            BestTriangle = (int32_t)Triangle;
+        }
+    }
+
+    // Simulated LRU cache, with room for the vertices pushed out by the last triangle
+    uint32_t Cache[VertexCacheOptimizerSize + 3];
+    uint32_t CacheCount = 0;
+
+    std::vector<uint32_t> Out;
+    Out.reserve(Indices->size());
+    uint32_t Cursor = 0;
+    for(uint32_t EmittedCount = 0; EmittedCount < TriangleCount; ++EmittedCount)
+    {
+        // Nothing in the cache has any triangles left, continue with the next triangle in the original order
+        if(BestTriangle < 0)
+        {
+            while(bIsEmitted[Cursor])
+            {
+                Cursor++;
+            }
+            BestTriangle = (int32_t)Cursor;
+        }
+
+        const uint32_t* Vertices = In + 3 * BestTriangle;
+        bIsEmitted[BestTriangle] = true;
+        for(uint32_t k = 0; k < 3; ++k)
+        {
+            Out.push_back(Vertices[k]);
+            RemainingValence[Vertices[k]]--;
+        }
+
+        // Move the triangle's vertices to the front
+        uint32_t NewCache[VertexCacheOptimizerSize + 3] = { Vertices[0], Vertices[1], Vertices[2] };
+        uint32_t NewCacheCount = 3;
+        for(uint32_t i = 0; i < CacheCount; ++i)
+        {
+            uint32_t Vertex = Cache[i];
+            if(Vertex != Vertices[0] && Vertex != Vertices[1] && Vertex != Vertices[2])
+            {
+                NewCache[NewCacheCount++] = Vertex;
+            }
+        }
+
+        for(uint32_t i = 0; i < NewCacheCount; ++i)
+        {
+            uint32_t Vertex = NewCache[i];
+            CachePositions[Vertex] = (i < VertexCacheOptimizerSize) ? (int32_t)i : -1;
+            VertexScores[Vertex] = MeshGetVertexScore(CachePositions[Vertex], RemainingValence[Vertex]);
+        }
+
+        // Only triangles touching vertices whose score changed need to be rescored, the best one is picked among them
+        BestTriangle = -1;
+        BestScore = -1.0f;
+        for(uint32_t i = 0; i < NewCacheCount; ++i)
+        {
+            uint32_t Vertex = NewCache[i];
+            for(uint32_t a = AdjacencyOffsets[Vertex]; a < AdjacencyOffsets[Vertex + 1]; ++a)
+            {
+                uint32_t Triangle = Adjacency[a];
+                if(bIsEmitted[Triangle])
+                {
+                    continue;
+                }
+
+                float Score = VertexScores[In[3 * Triangle]] + VertexScores[In[3 * Triangle + 1]] + VertexScores[In[3 * Triangle + 2]];
+                TriangleScores[Triangle] = Score;
+                if(Score > BestScore)
+                {
+                    BestScore = Score;
+                    BestTriangle = (int32_t)Triangle;
+                }
+            }
+        }
+
+        CacheCount = std::min(NewCacheCount, VertexCacheOptimizerSize);
+        memcpy(Cache, NewCache, CacheCount * sizeof(uint32_t));
+    }
+
+    *Indices = std::move(Out);
+}
+
+// Cuts the cache optimized triangle order into clusters where the cache is mostly cold anyway and sorts the
+// clusters front to back from the outside in: clusters that are far out from the mesh centroid and face away from
+// it occlude the others from most view directions (Sander et al., "Fast Triangle Reordering for Vertex Locality
+// and Reduced Overdraw"). Returns the number of clusters.
+static uint32_t MeshOptimizeOverdraw(std::vector<uint32_t>* Indices, const std::vector<float>& Positions, uint32_t VertexCount)
+{
+    uint32_t TriangleCount = (uint32_t)(Indices->size() / 3);
+    const uint32_t* In = Indices->data();
+
+    std::vector<uint32_t> ClusterStarts;
+    {
+        std::vector<uint32_t> InsertTime(VertexCount, 0);
+        uint32_t Time = VertexCacheMeasureSize + 1;
+        uint32_t ClusterSize = 0;
+        for(uint32_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+        {
+            uint32_t MissCount = 0;
+            for(uint32_t k = 0; k < 3; ++k)
+            {
+                uint32_t Index = In[3 * Triangle + k];
+                if(Time - InsertTime[Index] > VertexCacheMeasureSize)
+                {
+                    InsertTime[Index] = Time++;
+                    MissCount++;
+                }
+            }
+
+            if(Triangle == 0 || (MissCount >= 2 && ClusterSize >= OverdrawMinClusterTriangles))
+            {
+                ClusterStarts.push_back(Triangle);
+                ClusterSize = 0;
+            }
+            ClusterSize++;
+        }
+    }
+    uint32_t ClusterCount = (uint32_t)ClusterStarts.size();
+    ClusterStarts.push_back(TriangleCount);
+
+    // Area weighted centroids and normals
+    std::vector<float> ClusterData(ClusterCount * 6, 0.0f);
+    std::vector<float> ClusterAreas(ClusterCount, 0.0f);
+    double MeshCentroid[3] = {};
+    double MeshArea = 0.0;
+    for(uint32_t Cluster = 0; Cluster < ClusterCount; ++Cluster)
+    {
+        float* Data = &ClusterData[Cluster * 6];
+        for(uint32_t Triangle = ClusterStarts[Cluster]; Triangle < ClusterStarts[Cluster + 1]; ++Triangle)
+        {
+            const float* P0 = &Positions[3 * In[3 * Triangle + 0]];
+            const float* P1 = &Positions[3 * In[3 * Triangle + 1]];
+            const float* P2 = &Positions[3 * In[3 * Triangle + 2]];
+            float E1[3] = { P1[0] - P0[0], P1[1] - P0[1], P1[2] - P0[2] };
+            float E2[3] = { P2[0] - P0[0], P2[1] - P0[1], P2[2] - P0[2] };
+            float Normal[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+            float Area = 0.5f * sqrtf(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+
+            for(uint32_t c = 0; c < 3; ++c)
+            {
+                float Center = (P0[c] + P1[c] + P2[c]) / 3.0f;
+                Data[c] += Center * Area;
+                Data[3 + c] += Normal[c];
+                MeshCentroid[c] += Center * Area;
+            }
+            ClusterAreas[Cluster] += Area;
+            MeshArea += Area;
+        }
+    }
+    for(uint32_t c = 0; c < 3; ++c)
+    {
+        MeshCentroid[c] = (MeshArea > 0.0) ? MeshCentroid[c] / MeshArea : 0.0;
+    }
+
+    std::vector<float> SortKeys(ClusterCount);
+    for(uint32_t Cluster = 0; Cluster < ClusterCount; ++Cluster)
+    {
+        const float* Data = &ClusterData[Cluster * 6];
+        float Area = std::max(ClusterAreas[Cluster], 1e-20f);
+        float NormalLength = sqrtf(Data[3] * Data[3] + Data[4] * Data[4] + Data[5] * Data[5]);
+        float Key = 0.0f;
+        if(NormalLength > 0.0f)
+        {
+            for(uint32_t c = 0; c < 3; ++c)
+            {
+                Key += (Data[c] / Area - (float)MeshCentroid[c]) * Data[3 + c] / NormalLength;
+            }
+        }
+        SortKeys[Cluster] = Key;
+    }
+
+    std::vector<uint32_t> ClusterOrder(ClusterCount);
+    for(uint32_t Cluster = 0; Cluster < ClusterCount; ++Cluster)
+    {
+        ClusterOrder[Cluster] = Cluster;
+    }
+    std::stable_sort(ClusterOrder.begin(), ClusterOrder.end(), [&SortKeys](uint32_t A, uint32_t B) { return SortKeys[A] > SortKeys[B]; });
+
+    std::vector<uint32_t> Out;
+    Out.reserve(Indices->size());
+    for(uint32_t Cluster : ClusterOrder)
+    {
+        Out.insert(Out.end(), In + 3 * ClusterStarts[Cluster], In + 3 * ClusterStarts[Cluster + 1]);
+    }
+    *Indices = std::move(Out);
+    return ClusterCount;
+}
+
+// Renumbers the vertices in order of first use, unreferenced vertices are dropped
+static void MeshOptimizeVertexFetch(SImportMesh* Mesh)
+{
+    std::vector<uint32_t> Remap(Mesh->GetVertexCount(), UINT32_MAX);
+    SImportMesh Out;
+    for(uint32_t& Index : Mesh->Indices)
+    {
+        if(Remap[Index] == UINT32_MAX)
+        {
+            Remap[Index] = Out.GetVertexCount();
+            Out.Positions.insert(Out.Positions.end(), &Mesh->Positions[3 * Index], &Mesh->Positions[3 * Index] + 3);
+            Out.Normals.insert(Out.Normals.end(), &Mesh->Normals[3 * Index], &Mesh->Normals[3 * Index] + 3);
+            Out.TexCoords.insert(Out.TexCoords.end(), &Mesh->TexCoords[2 * Index], &Mesh->TexCoords[2 * Index] + 2);
+        }
+        Index = Remap[Index];
+    }
+
+    Out.Indices = std::move(Mesh->Indices);
+    *Mesh = std::move(Out);
+}
+
+static int16_t QuantizeSnorm16(float Value)
+{
+    return (int16_t)lroundf(Clamp(Value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static uint16_t QuantizeUnorm16(float Value)
+{
+    return (uint16_t)lroundf(Clamp(Value, 0.0f, 1.0f) * 65535.0f);
+}
+
+// Converts a glTF file into a cooked mesh, printing the statistics of every optimization step
+bool MeshCook(const char* InputPath, const char* OutputPath)
+{
+    SImportMesh Mesh;
+    if(!MeshImportGltf(InputPath, &Mesh))
+    {
+        return false;
+    }
+
+    uint32_t TriangleCount = (uint32_t)(Mesh.Indices.size() / 3);
+    float OriginalACMR = MeshComputeACMR(Mesh.Indices, Mesh.GetVertexCount(), VertexCacheMeasureSize);
+
+    MeshOptimizeVertexCache(&Mesh.Indices, Mesh.GetVertexCount());
+    float CacheOptimizedACMR = MeshComputeACMR(Mesh.Indices, Mesh.GetVertexCount(), VertexCacheMeasureSize);
+
+    uint32_t ClusterCount = MeshOptimizeOverdraw(&Mesh.Indices, Mesh.Positions, Mesh.GetVertexCount());
+    float FinalACMR = MeshComputeACMR(Mesh.Indices, Mesh.GetVertexCount(), VertexCacheMeasureSize);
+
+    MeshOptimizeVertexFetch(&Mesh);
+    uint32_t VertexCount = Mesh.GetVertexCount();
+
+    // Quantization ranges
+    float PositionMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float PositionMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    float TexCoordMin[2] = { FLT_MAX, FLT_MAX };
+    float TexCoordMax[2] = { -FLT_MAX, -FLT_MAX };
+    for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+    {
+        for(uint32_t c = 0; c < 3; ++c)
+        {
+            PositionMin[c] = std::min(PositionMin[c], Mesh.Positions[3 * Vertex + c]);
+            PositionMax[c] = std::max(PositionMax[c], Mesh.Positions[3 * Vertex + c]);
+        }
+        for(uint32_t c = 0; c < 2; ++c)
+        {
+            TexCoordMin[c] = std::min(TexCoordMin[c], Mesh.TexCoords[2 * Vertex + c]);
+            TexCoordMax[c] = std::max(TexCoordMax[c], Mesh.TexCoords[2 * Vertex + c]);
+        }
+    }
+
+    SMeshFileHeader Header = {};
+    Header.Magic = MeshFileMagic;
+    Header.Version = MeshFileVersion;
+    Header.VertexCount = VertexCount;
+    Header.IndexCount = (uint32_t)Mesh.Indices.size();
+    Header.IndexSize = (VertexCount <= 65536) ? 2 : 4;
+    for(uint32_t c = 0; c < 3; ++c)
+    {
+        Header.PositionOffset[c] = 0.5f * (PositionMin[c] + PositionMax[c]);
+        Header.PositionScale[c] = 0.5f * (PositionMax[c] - PositionMin[c]);
+        if(Header.PositionScale[c] <= 0.0f)
+        {
+            Header.PositionScale[c] = 1.0f;
+        }
+    }
+    for(uint32_t c = 0; c < 2; ++c)
+    {
+        Header.TexCoordOffset[c] = TexCoordMin[c];
+        Header.TexCoordScale[c] = TexCoordMax[c] - TexCoordMin[c];
+        if(Header.TexCoordScale[c] <= 0.0f)
+        {
+            Header.TexCoordScale[c] = 1.0f;
+        }
+    }
+
+    std::vector<SMeshVertex> Vertices(VertexCount);
+    float Radius = 0.0f;
+    for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+    {
+        SMeshVertex& Out = Vertices[Vertex];
+        const float* P = &Mesh.Positions[3 * Vertex];
+        const float* N = &Mesh.Normals[3 * Vertex];
+        const float* T = &Mesh.TexCoords[2 * Vertex];
+
+        float DistanceSq = 0.0f;
+        for(uint32_t c = 0; c < 3; ++c)
+        {
+            Out.Position[c] = QuantizeSnorm16((P[c] - Header.PositionOffset[c]) / Header.PositionScale[c]);
+            DistanceSq += (P[c] - Header.PositionOffset[c]) * (P[c] - Header.PositionOffset[c]);
+        }
+        Out.Position[3] = 0;
+        Radius = std::max(Radius, sqrtf(DistanceSq));
+
+        // Octahedral: project onto the L1 unit sphere, fold the lower hemisphere over the diagonals
+        float L1 = fabsf(N[0]) + fabsf(N[1]) + fabsf(N[2]);
+        float X = N[0] / L1;
+        float Y = N[1] / L1;
+        if(N[2] < 0.0f)
+        {
+            float FoldedX = (1.0f - fabsf(Y)) * (X >= 0.0f ? 1.0f : -1.0f);
+            float FoldedY = (1.0f - fabsf(X)) * (Y >= 0.0f ? 1.0f : -1.0f);
+            X = FoldedX;
+            Y = FoldedY;
+        }
+        Out.Normal[0] = QuantizeSnorm16(X);
+        Out.Normal[1] = QuantizeSnorm16(Y);
+
+        Out.TexCoord[0] = QuantizeUnorm16((T[0] - Header.TexCoordOffset[0]) / Header.TexCoordScale[0]);
+        Out.TexCoord[1] = QuantizeUnorm16((T[1] - Header.TexCoordOffset[1]) / Header.TexCoordScale[1]);
+    }
+
+    // The bounding box center is good enough as the sphere center
+    Header.BoundingSphere[0] = Header.PositionOffset[0];
+    Header.BoundingSphere[1] = Header.PositionOffset[1];
+    Header.BoundingSphere[2] = Header.PositionOffset[2];
+    Header.BoundingSphere[3] = Radius;
+
+    size_t VertexDataSize = Vertices.size() * sizeof(SMeshVertex);
+    size_t IndexDataSize = Mesh.Indices.size() * Header.IndexSize;
+    Header.VertexDataOffset = sizeof(Header);
+    Header.IndexDataOffset = (Header.VertexDataOffset + VertexDataSize + MeshFileDataAlignment - 1) & ~(uint64_t)(MeshFileDataAlignment - 1);
+
+    std::vector<uint8_t> FileData((size_t)Header.IndexDataOffset + IndexDataSize, 0);
+    memcpy(FileData.data(), &Header, sizeof(Header));
+    memcpy(FileData.data() + Header.VertexDataOffset, Vertices.data(), VertexDataSize);
+    uint8_t* IndexData = FileData.data() + Header.IndexDataOffset;
+    for(size_t i = 0; i < Mesh.Indices.size(); ++i)
+    {
+        if(Header.IndexSize == 2)
+        {
+            uint16_t Index = (uint16_t)Mesh.Indices[i];
+            memcpy(IndexData + 2 * i, &Index, 2);
+        }
+        else
+        {
+            memcpy(IndexData + 4 * i, &Mesh.Indices[i], 4);
+        }
+    }
+
+    FILE* File = fopen(OutputPath, "wb");
+    if(!File || fwrite(FileData.data(), 1, FileData.size(), File) != FileData.size())
+    {
+        printf("Cook: couldn't write %s\n", OutputPath);
+        if(File)
+        {
+            fclose(File);
+        }
+        return false;
+    }
+    fclose(File);
+
+    // Uncompressed float position, normal and texcoord for comparison
+    constexpr size_t FloatVertexSize = (3 + 3 + 2) * sizeof(float);
+    printf("Cook: %s -> %s, %u vertices, %u triangles\n", InputPath, OutputPath, VertexCount, TriangleCount);
+    printf("  ACMR (%u entry FIFO): %.3f original, %.3f cache optimized, %.3f after overdraw ordering (%u clusters)\n",
+           VertexCacheMeasureSize, OriginalACMR, CacheOptimizedACMR, FinalACMR, ClusterCount);
+    printf("  Vertex data: %.1f KiB (%.1f KiB as floats), index data: %.1f KiB (%u bit)\n",
+           VertexDataSize / 1024.0, VertexCount * FloatVertexSize / 1024.0, IndexDataSize / 1024.0, Header.IndexSize * 8);
+    return true;
+}
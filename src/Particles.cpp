@@ -0,0 +1,571 @@
+//
+// GPU particle simulation (-particles).
+//
+// A particle fountain integrated by a compute shader (Shaders/particles.comp) and drawn as one instanced triangle per
+// particle. The state lives in two storage buffers: every step reads one and writes the other, and the frame draws the
+// one that was just written. The simulation also writes the draw's VkDrawIndirectCommand, so how many particles are
+// drawn is decided on the GPU.
+//
+// When the device has a compute queue family without graphics the steps are submitted on it (async compute) with
+// their own timeline: the frame's graphics submission waits for the step that wrote the buffer it draws, and the next
+// step only waits for the frame that last drew the buffer it overwrites, so simulating frame N+1 overlaps drawing
+// frame N. The buffers use concurrent sharing like the streamed textures, there are no ownership transfers.
+// Without such a queue the step is recorded at the start of the frame's command buffer instead.
+//
+// Each step is timed with timestamp queries (when the queue supports them), the GPU side particles/s come from that.
+//
+
+constexpr uint32_t ParticleGroupSize = 256;
+// Fixed, so that runs (and captured frames) are reproducible
+constexpr float ParticleTimeStep = 1.0f / 60.0f;
+// Steps until every particle has been emitted
+constexpr uint32_t ParticleEmitSteps = 120;
+
+// Matches SParticle in the shaders
+struct SParticle
+{
+    float PositionLife[4];
+    float VelocityMaxLife[4];
+};
+static_assert(sizeof(SParticle) == 32, "Particle layout has to match the shaders");
+
+// Push constants of the simulation, see Shaders/particles.comp
+struct SParticleSimulateConstants
+{
+    uint32_t ParticleCount;
+    uint32_t EmittedCount;
+    uint32_t Step;
+    float TimeStep;
+};
+
+// Push constants of the particle pipeline, see Shaders/particles.vert
+struct SParticleDrawConstants
+{
+    float ViewProjection[16];
+    // xy: particle radius in clip space, z: brightness
+    float Params[4];
+};
+
+struct SParticleSystem
+{
+    VkDevice Device;
+    uint32_t ParticleCount;
+
+    // The same timeline when there's no async compute queue
+    SVulkanTimeline* GraphicsTimeline;
+    SVulkanTimeline* ComputeTimeline;
+    bool bIsAsync;
+
+    VkBuffer StateBuffers[2];
+    VkDeviceMemory StateMemory[2];
+    // One draw command per state buffer, IndirectStride apart so that each can be bound as a storage buffer on its own
+    VkBuffer IndirectBuffer;
+    VkDeviceMemory IndirectMemory;
+    VkDeviceSize IndirectStride;
+
+    VkDescriptorSetLayout SimulateSetLayout;
+    VkDescriptorSetLayout DrawSetLayout;
+    VkDescriptorPool DescriptorPool;
+    // Indexed by the state buffer that is read
+    VkDescriptorSet SimulateSets[2];
+    VkDescriptorSet DrawSets[2];
+
+    VkShaderModule SimulateShader;
+    VkPipelineLayout SimulatePipelineLayout;
+    VkPipeline SimulatePipeline;
+
+    // Async compute only, per frame in flight
+    VkCommandPool CommandPools[MaxFramesInFlight];
+    VkCommandBuffer CommandBuffers[MaxFramesInFlight];
+
+    // Two timestamps around each step, per frame in flight
+    VkQueryPool QueryPool;
+    bool bHasTimestamps;
+    uint64_t TimestampMask;
+    double TimestampPeriodNs;
+    bool bIsQueryPending[MaxFramesInFlight];
+
+    // Steps done so far, the current state is in StateBuffers[StepCount % 2]
+    uint32_t StepCount;
+    // Compute timeline value of the last step (async only)
+    uint64_t StepTimelineValue;
+    // Graphics timeline value of the last frame that drew each state buffer (async only)
+    uint64_t DrawTimelineValues[2];
+
+    // Wall clock time of the first and the last step
+    uint64_t StartTimeNs;
+    uint64_t LastStepTimeNs;
+    uint64_t GpuTimeNs;
+    uint32_t TimedStepCount;
+};
+
+static void ParticleSystemCreateBuffer(SParticleSystem* System, const VkPhysicalDeviceMemoryProperties* MemoryProperties,
+                                       const uint32_t* QueueFamilyIndices, VkDeviceSize Size, VkBufferUsageFlags Usage,
+                                       VkBuffer* Buffer, VkDeviceMemory* Memory)
+{
+    VkBufferCreateInfo BufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    BufferCreateInfo.pNext = nullptr;
+    BufferCreateInfo.flags = 0;
+    BufferCreateInfo.size = Size;
+    BufferCreateInfo.usage = Usage;
+    BufferCreateInfo.sharingMode = System->bIsAsync ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    BufferCreateInfo.queueFamilyIndexCount = System->bIsAsync ? 2 : 0;
+    BufferCreateInfo.pQueueFamilyIndices = System->bIsAsync ? QueueFamilyIndices : nullptr;
+
+    VkResult Result = vkCreateBuffer(System->Device, &BufferCreateInfo, nullptr, Buffer);
+    assert(Result == VK_SUCCESS);
+
+    VkMemoryRequirements MemoryRequirements;
+    vkGetBufferMemoryRequirements(System->Device, *Buffer, &MemoryRequirements);
+
+    uint32_t MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    assert(MemoryTypeIndex != UINT32_MAX);
+
+    VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    AllocateInfo.pNext = nullptr;
+    AllocateInfo.allocationSize = MemoryRequirements.size;
+    AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+
+    Result = vkAllocateMemory(System->Device, &AllocateInfo, nullptr, Memory);
+    assert(Result == VK_SUCCESS);
+    vkBindBufferMemory(System->Device, *Buffer, *Memory, 0);
+}
+
+// ComputeTimeline is the graphics timeline when ComputeQueueFamilyIndex is the graphics queue family
+bool ParticleSystemInit(SParticleSystem* System, VkDevice Device, const SVulkanPhysicalDevice* PhysicalDevice,
+                        SVulkanTimeline* GraphicsTimeline, SVulkanTimeline* ComputeTimeline,
+                        uint32_t GraphicsQueueFamilyIndex, uint32_t ComputeQueueFamilyIndex, uint32_t ParticleCount)
+{
+    const VkPhysicalDeviceLimits& Limits = PhysicalDevice->Properties.limits;
+
+    // A single storage buffer binding and a 1D dispatch have to cover every particle
+    uint64_t MaxParticleCount = std::min((uint64_t)Limits.maxStorageBufferRange / sizeof(SParticle),
+                                         (uint64_t)Limits.maxComputeWorkGroupCount[0] * ParticleGroupSize);
+    if(ParticleCount == 0 || ParticleCount > MaxParticleCount)
+    {
+        printf("Unsupported particle count %u, the device supports at most %" PRIu64 "\n", ParticleCount, MaxParticleCount);
+        return false;
+    }
+
+    System->Device = Device;
+    System->ParticleCount = ParticleCount;
+    System->GraphicsTimeline = GraphicsTimeline;
+    System->ComputeTimeline = ComputeTimeline;
+    System->bIsAsync = ComputeQueueFamilyIndex != GraphicsQueueFamilyIndex;
+
+    // Buffers
+    {
+        uint32_t QueueFamilyIndices[2] = { GraphicsQueueFamilyIndex, ComputeQueueFamilyIndex };
+        const VkPhysicalDeviceMemoryProperties* MemoryProperties = &PhysicalDevice->MemoryProperties;
+        for(uint32_t BufferIndex = 0; BufferIndex < 2; ++BufferIndex)
+        {
+            ParticleSystemCreateBuffer(System, MemoryProperties, QueueFamilyIndices, (VkDeviceSize)ParticleCount * sizeof(SParticle),
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       &System->StateBuffers[BufferIndex], &System->StateMemory[BufferIndex]);
+        }
+
+        System->IndirectStride = std::max((VkDeviceSize)sizeof(VkDrawIndirectCommand), Limits.minStorageBufferOffsetAlignment);
+        ParticleSystemCreateBuffer(System, MemoryProperties, QueueFamilyIndices, 2 * System->IndirectStride,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   &System->IndirectBuffer, &System->IndirectMemory);
+    }
+
+    // Descriptors: source, destination and draw command for the simulation, the particles for drawing
+    {
+        VkDescriptorSetLayoutBinding SimulateBindings[3] = {};
+        for(uint32_t BindingIndex = 0; BindingIndex < ArrayCount(SimulateBindings); ++BindingIndex)
+        {
+            SimulateBindings[BindingIndex].binding = BindingIndex;
+            SimulateBindings[BindingIndex].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            SimulateBindings[BindingIndex].descriptorCount = 1;
+            SimulateBindings[BindingIndex].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            SimulateBindings[BindingIndex].pImmutableSamplers = nullptr;
+        }
+
+        VkDescriptorSetLayoutCreateInfo SetLayoutCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        SetLayoutCreateInfo.pNext = nullptr;
+        SetLayoutCreateInfo.flags = 0;
+        SetLayoutCreateInfo.bindingCount = ArrayCount(SimulateBindings);
+        SetLayoutCreateInfo.pBindings = SimulateBindings;
+        vkCreateDescriptorSetLayout(Device, &SetLayoutCreateInfo, nullptr, &System->SimulateSetLayout);
+
+        VkDescriptorSetLayoutBinding DrawBinding = {};
+        DrawBinding.binding = 0;
+        DrawBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        DrawBinding.descriptorCount = 1;
+        DrawBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        DrawBinding.pImmutableSamplers = nullptr;
+
+        SetLayoutCreateInfo.bindingCount = 1;
+        SetLayoutCreateInfo.pBindings = &DrawBinding;
+        vkCreateDescriptorSetLayout(Device, &SetLayoutCreateInfo, nullptr, &System->DrawSetLayout);
+
+        VkDescriptorPoolSize PoolSize = {};
+        PoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        PoolSize.descriptorCount = 2 * (ArrayCount(SimulateBindings) + 1);
+
+        VkDescriptorPoolCreateInfo PoolCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        PoolCreateInfo.pNext = nullptr;
+        PoolCreateInfo.flags = 0;
+        PoolCreateInfo.maxSets = 4;
+        PoolCreateInfo.poolSizeCount = 1;
+        PoolCreateInfo.pPoolSizes = &PoolSize;
+        vkCreateDescriptorPool(Device, &PoolCreateInfo, nullptr, &System->DescriptorPool);
+
+        VkDescriptorSetLayout SetLayouts[4] = { System->SimulateSetLayout, System->SimulateSetLayout, System->DrawSetLayout, System->DrawSetLayout };
+        VkDescriptorSet Sets[4];
+
+        VkDescriptorSetAllocateInfo SetAllocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        SetAllocateInfo.pNext = nullptr;
+        SetAllocateInfo.descriptorPool = System->DescriptorPool;
+        SetAllocateInfo.descriptorSetCount = 4;
+        SetAllocateInfo.pSetLayouts = SetLayouts;
+        vkAllocateDescriptorSets(Device, &SetAllocateInfo, Sets);
+
+        for(uint32_t Source = 0; Source < 2; ++Source)
+        {
+            uint32_t Destination = 1 - Source;
+            System->SimulateSets[Source] = Sets[Source];
+            System->DrawSets[Source] = Sets[2 + Source];
+
+            VkDescriptorBufferInfo BufferInfos[4] =
+            {
+                { System->StateBuffers[Source], 0, VK_WHOLE_SIZE },
+                { System->StateBuffers[Destination], 0, VK_WHOLE_SIZE },
+                { System->IndirectBuffer, Destination * System->IndirectStride, sizeof(VkDrawIndirectCommand) },
+                { System->StateBuffers[Source], 0, VK_WHOLE_SIZE },
+            };
+
+            VkWriteDescriptorSet Writes[4] = {};
+            for(uint32_t WriteIndex = 0; WriteIndex < 4; ++WriteIndex)
+            {
+                VkWriteDescriptorSet& Write = Writes[WriteIndex];
+                Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                Write.pNext = nullptr;
+                Write.dstSet = (WriteIndex < 3) ? System->SimulateSets[Source] : System->DrawSets[Source];
+                Write.dstBinding = (WriteIndex < 3) ? WriteIndex : 0;
+                Write.dstArrayElement = 0;
+                Write.descriptorCount = 1;
+                Write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                Write.pBufferInfo = &BufferInfos[WriteIndex];
+            }
+            vkUpdateDescriptorSets(Device, 4, Writes, 0, nullptr);
+        }
+    }
+
+    // Simulation pipeline
+    {
+        SBuffer ShaderBin = PlatformLoadFile("Shaders/particles_simulate.spv");
+
+        VkShaderModuleCreateInfo ShaderCreateInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+        ShaderCreateInfo.pNext = nullptr;
+        ShaderCreateInfo.flags = 0;
+        ShaderCreateInfo.codeSize = ShaderBin.Size;
+        ShaderCreateInfo.pCode = (uint32_t*)ShaderBin.Data;
+        vkCreateShaderModule(Device, &ShaderCreateInfo, nullptr, &System->SimulateShader);
+        ReleaseBuffer(&ShaderBin);
+
+        VkPushConstantRange PushConstantRange = {};
+        PushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        PushConstantRange.offset = 0;
+        PushConstantRange.size = sizeof(SParticleSimulateConstants);
+
+        VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        PipelineLayoutCreateInfo.pNext = nullptr;
+        PipelineLayoutCreateInfo.flags = 0;
+        PipelineLayoutCreateInfo.setLayoutCount = 1;
+        PipelineLayoutCreateInfo.pSetLayouts = &System->SimulateSetLayout;
+        PipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        PipelineLayoutCreateInfo.pPushConstantRanges = &PushConstantRange;
+        vkCreatePipelineLayout(Device, &PipelineLayoutCreateInfo, nullptr, &System->SimulatePipelineLayout);
+
+        VkComputePipelineCreateInfo PipelineInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        PipelineInfo.pNext = nullptr;
+        PipelineInfo.flags = 0;
+        PipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        PipelineInfo.stage.pNext = nullptr;
+        PipelineInfo.stage.flags = 0;
+        PipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        PipelineInfo.stage.module = System->SimulateShader;
+        PipelineInfo.stage.pName = "main";
+        PipelineInfo.stage.pSpecializationInfo = nullptr;
+        PipelineInfo.layout = System->SimulatePipelineLayout;
+        PipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        PipelineInfo.basePipelineIndex = -1;
+
+        VkResult Result = vkCreateComputePipelines(Device, VK_NULL_HANDLE, 1, &PipelineInfo, nullptr, &System->SimulatePipeline);
+        if(Result != VK_SUCCESS)
+        {
+            printf("Couldn't create the particle simulation pipeline\n");
+            return false;
+        }
+    }
+
+    if(System->bIsAsync)
+    {
+        for(uint32_t FrameIndex = 0; FrameIndex < MaxFramesInFlight; ++FrameIndex)
+        {
+            VkCommandPoolCreateInfo CommandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+            CommandPoolCreateInfo.pNext = nullptr;
+            CommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            CommandPoolCreateInfo.queueFamilyIndex = ComputeQueueFamilyIndex;
+            vkCreateCommandPool(Device, &CommandPoolCreateInfo, nullptr, &System->CommandPools[FrameIndex]);
+
+            VkCommandBufferAllocateInfo CommandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+            CommandBufferInfo.pNext = nullptr;
+            CommandBufferInfo.commandPool = System->CommandPools[FrameIndex];
+            CommandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            CommandBufferInfo.commandBufferCount = 1;
+            vkAllocateCommandBuffers(Device, &CommandBufferInfo, &System->CommandBuffers[FrameIndex]);
+        }
+    }
+
+    // Step timing
+    uint32_t TimestampValidBits = PhysicalDevice->QueueFamilies[ComputeQueueFamilyIndex].timestampValidBits;
+    System->bHasTimestamps = TimestampValidBits > 0 && Limits.timestampPeriod > 0.0f;
+    if(System->bHasTimestamps)
+    {
+        System->TimestampMask = (TimestampValidBits >= 64) ? UINT64_MAX : (1ull << TimestampValidBits) - 1;
+        System->TimestampPeriodNs = Limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo QueryPoolCreateInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        QueryPoolCreateInfo.pNext = nullptr;
+        QueryPoolCreateInfo.flags = 0;
+        QueryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        QueryPoolCreateInfo.queryCount = 2 * MaxFramesInFlight;
+        QueryPoolCreateInfo.pipelineStatistics = 0;
+        vkCreateQueryPool(Device, &QueryPoolCreateInfo, nullptr, &System->QueryPool);
+    }
+
+    printf("Particles: %u (%.1f MiB of state), simulated on %s\n", ParticleCount,
+           2.0 * ParticleCount * sizeof(SParticle) / (1024.0 * 1024.0),
+           System->bIsAsync ? "an async compute queue" : "the graphics queue");
+    return true;
+}
+
+static void ParticleSystemReadTimestamps(SParticleSystem* System, uint32_t FrameIndex)
+{
+    if(!System->bIsQueryPending[FrameIndex])
+    {
+        return;
+    }
+
+    // The frame's submissions are done, the results are available
+    uint64_t Timestamps[2];
+    VkResult Result = vkGetQueryPoolResults(System->Device, System->QueryPool, 2 * FrameIndex, 2, sizeof(Timestamps), Timestamps,
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if(Result == VK_SUCCESS)
+    {
+        uint64_t Ticks = (Timestamps[1] - Timestamps[0]) & System->TimestampMask;
+        System->GpuTimeNs += (uint64_t)((double)Ticks * System->TimestampPeriodNs);
+        System->TimedStepCount++;
+    }
+    System->bIsQueryPending[FrameIndex] = false;
+}
+
+static void ParticleSystemRecordStep(SParticleSystem* System, VkCommandBuffer CommandBuffer, uint32_t FrameIndex)
+{
+    uint32_t Source = System->StepCount % 2;
+
+    if(System->bHasTimestamps)
+    {
+        ParticleSystemReadTimestamps(System, FrameIndex);
+        vkCmdResetQueryPool(CommandBuffer, System->QueryPool, 2 * FrameIndex, 2);
+        vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, System->QueryPool, 2 * FrameIndex);
+    }
+
+    // The state starts out zeroed, which makes every particle dead and so emitted on its first step
+    if(System->StepCount == 0)
+    {
+        vkCmdFillBuffer(CommandBuffer, System->StateBuffers[Source], 0, VK_WHOLE_SIZE, 0);
+
+        VkMemoryBarrier FillBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        FillBarrier.pNext = nullptr;
+        FillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        FillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &FillBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    // The previous step's writes have to be visible. On the graphics queue the draw of the previous frame that read
+    // the destination also has to be done, on the compute queue the submission waits for that frame instead.
+    {
+        VkPipelineStageFlags SourceStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        if(!System->bIsAsync)
+        {
+            SourceStages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        }
+
+        VkMemoryBarrier Barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        Barrier.pNext = nullptr;
+        Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(CommandBuffer, SourceStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+    }
+
+    SParticleSimulateConstants Constants = {};
+    Constants.ParticleCount = System->ParticleCount;
+    Constants.EmittedCount = (uint32_t)std::min((uint64_t)System->ParticleCount,
+                                                (uint64_t)System->ParticleCount * (System->StepCount + 1) / ParticleEmitSteps);
+    Constants.Step = System->StepCount;
+    Constants.TimeStep = ParticleTimeStep;
+
+    vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, System->SimulatePipeline);
+    vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, System->SimulatePipelineLayout, 0, 1, &System->SimulateSets[Source], 0, nullptr);
+    vkCmdPushConstants(CommandBuffer, System->SimulatePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants), &Constants);
+    vkCmdDispatch(CommandBuffer, (System->ParticleCount + ParticleGroupSize - 1) / ParticleGroupSize, 1, 1);
+
+    if(System->bHasTimestamps)
+    {
+        vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, System->QueryPool, 2 * FrameIndex + 1);
+        System->bIsQueryPending[FrameIndex] = true;
+    }
+
+    // Cross queue, the graphics submission's semaphore wait covers this
+    if(!System->bIsAsync)
+    {
+        VkMemoryBarrier Barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        Barrier.pNext = nullptr;
+        Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+                             1, &Barrier, 0, nullptr, 0, nullptr);
+    }
+
+    System->StepCount++;
+}
+
+// Advances the simulation by one step. Without async compute the step is recorded into GraphicsCommandBuffer (outside
+// of a render pass), otherwise it's submitted on the compute queue right away.
+// The frame in flight's previous submissions have to be complete.
+void ParticleSystemSimulate(SParticleSystem* System, VkCommandBuffer GraphicsCommandBuffer, uint32_t FrameIndex)
+{
+    System->LastStepTimeNs = PlatformGetTimeNs();
+    if(System->StartTimeNs == 0)
+    {
+        System->StartTimeNs = System->LastStepTimeNs;
+    }
+
+    if(!System->bIsAsync)
+    {
+        ParticleSystemRecordStep(System, GraphicsCommandBuffer, FrameIndex);
+        return;
+    }
+
+    // The destination was last drawn by the frame before the previous one, that's all this step has to wait for
+    uint32_t Destination = (System->StepCount + 1) % 2;
+    uint64_t DrawTimelineValue = System->DrawTimelineValues[Destination];
+
+    vkResetCommandPool(System->Device, System->CommandPools[FrameIndex], 0);
+
+    VkCommandBufferBeginInfo BeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    BeginInfo.pNext = nullptr;
+    BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    BeginInfo.pInheritanceInfo = nullptr;
+
+    VkCommandBuffer CommandBuffer = System->CommandBuffers[FrameIndex];
+    vkBeginCommandBuffer(CommandBuffer, &BeginInfo);
+    ParticleSystemRecordStep(System, CommandBuffer, FrameIndex);
+    vkEndCommandBuffer(CommandBuffer);
+
+    SVulkanSubmitSync SubmitSync = {};
+    SubmitWaitTimeline(&SubmitSync, System->GraphicsTimeline, DrawTimelineValue, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    System->StepTimelineValue = TimelineSubmit(System->ComputeTimeline, 1, &CommandBuffer, &SubmitSync);
+}
+
+// Compute timeline value the graphics queue has to wait for before drawing, 0 when the step is on the graphics queue
+uint64_t ParticleSystemGetWaitValue(const SParticleSystem* System)
+{
+    return System->bIsAsync ? System->StepTimelineValue : 0;
+}
+
+// GraphicsTimelineValue is the value of the submission that draws the current state
+void ParticleSystemEndFrame(SParticleSystem* System, uint64_t GraphicsTimelineValue)
+{
+    System->DrawTimelineValues[System->StepCount % 2] = GraphicsTimelineValue;
+}
+
+// Draws the current state inside the render pass, PipelineLayout/Pipeline are the particle pipeline (Shaders/particles.spv)
+void ParticleSystemRecordDraw(const SParticleSystem* System, VkCommandBuffer CommandBuffer, VkPipelineLayout PipelineLayout, VkPipeline Pipeline,
+                              const float* ViewProjection, float AspectRatio)
+{
+    uint32_t Current = System->StepCount % 2;
+
+    // A few pixels wide at 1080p, dimmer the more particles there are so that the additive blend doesn't saturate
+    SParticleDrawConstants Constants = {};
+    memcpy(Constants.ViewProjection, ViewProjection, sizeof(Constants.ViewProjection));
+    Constants.Params[0] = 0.003f / AspectRatio;
+    Constants.Params[1] = 0.003f;
+    Constants.Params[2] = std::min(1.0f, 100000.0f / (float)System->ParticleCount);
+
+    vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+    vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, 1, &System->DrawSets[Current], 0, nullptr);
+    vkCmdPushConstants(CommandBuffer, PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Constants), &Constants);
+    vkCmdDrawIndirect(CommandBuffer, System->IndirectBuffer, Current * System->IndirectStride, 1, sizeof(VkDrawIndirectCommand));
+}
+
+// Orbits around the fountain, slightly above it
+void ParticleSystemGetViewProjection(float Angle, float AspectRatio, float* ViewProjection)
+{
+    constexpr float Distance = 7.0f;
+    constexpr float Height = 2.5f;
+    constexpr float TargetHeight = 1.2f;
+    float Eye[3] = { -sinf(Angle) * Distance, Height, cosf(Angle) * Distance };
+    float Pitch = atanf((Height - TargetHeight) / Distance);
+    SceneGetViewProjection(Eye, Angle, Pitch, AspectRatio, 0.1f, 50.0f, ViewProjection);
+}
+
+void ParticleSystemPrintStats(const SParticleSystem* System)
+{
+    if(System->StepCount < 2)
+    {
+        return;
+    }
+
+    // Overall: every step simulates every particle, the rate is bounded by whatever limits the frame rate
+    double ElapsedSeconds = (double)(System->LastStepTimeNs - System->StartTimeNs) / 1000000000.0;
+    double ParticlesPerSecond = (double)System->ParticleCount * (System->StepCount - 1) / ElapsedSeconds;
+    printf("Particles: %u particles, %u steps, %.1f M particles/s overall\n", System->ParticleCount, System->StepCount,
+           ParticlesPerSecond / 1000000.0);
+
+    if(System->TimedStepCount)
+    {
+        double StepMs = (double)System->GpuTimeNs / 1000000.0 / System->TimedStepCount;
+        printf("Particles: %.3f ms per step on the GPU, %.1f M particles/s simulated\n", StepMs,
+               (double)System->ParticleCount / (StepMs / 1000.0) / 1000000.0);
+    }
+}
+
+// The GPU has to be done with every step and frame
+void ParticleSystemDestroy(SParticleSystem* System)
+{
+    VkDevice Device = System->Device;
+    if(System->QueryPool)
+    {
+        vkDestroyQueryPool(Device, System->QueryPool, nullptr);
+    }
+    for(VkCommandPool CommandPool : System->CommandPools)
+    {
+        if(CommandPool)
+        {
+            vkDestroyCommandPool(Device, CommandPool, nullptr);
+        }
+    }
+
+    vkDestroyPipeline(Device, System->SimulatePipeline, nullptr);
+    vkDestroyPipelineLayout(Device, System->SimulatePipelineLayout, nullptr);
+    vkDestroyShaderModule(Device, System->SimulateShader, nullptr);
+
+    vkDestroyDescriptorPool(Device, System->DescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(Device, System->DrawSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(Device, System->SimulateSetLayout, nullptr);
+
+    vkDestroyBuffer(Device, System->IndirectBuffer, nullptr);
+    vkFreeMemory(Device, System->IndirectMemory, nullptr);
+    for(uint32_t BufferIndex = 0; BufferIndex < 2; ++BufferIndex)
+    {
+        vkDestroyBuffer(Device, System->StateBuffers[BufferIndex], nullptr);
+        vkFreeMemory(Device, System->StateMemory[BufferIndex], nullptr);
+    }
+    *System = {};
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+//
+// Thin platform interface. Exactly one implementation (win32Platform.cpp or linuxPlatform.cpp)
+// is compiled into the program, the rest of the code only talks to the OS through these functions.
+//
+
+struct SBuffer
+{
+    uint32_t Size;
+    void* Data;
+};
+
+void ReleaseBuffer(SBuffer* Buffer)
+{
+    delete[] (uint8_t*)Buffer->Data;
+    Buffer->Size = 0;
+    Buffer->Data = nullptr;
+}
+
+struct SPlatformWindowData;
+
+struct SPlatformWindow
+{
+    uint32_t Width;
+    uint32_t Height;
+
+    // Cleared while the window is minimized or hidden, and on X11 while it's fully obscured (the Windows compositor
+    // doesn't tell a window when others cover it); nothing should be rendered then.
+    bool bIsVisible;
+    // Set by expose/paint events, the main loop clears it once it has rendered a frame.
+    bool bNeedsRedraw;
+    bool bCloseRequested;
+
+    SPlatformWindowData* Data;
+};
+
+SBuffer PlatformLoadFile(const char* Path);
+
+// Read-only memory mapping of a whole file, Data is null if the file couldn't be mapped
+struct SMappedFile
+{
+    size_t Size;
+    const uint8_t* Data;
+    void* Handle;
+};
+
+SMappedFile PlatformMapFile(const char* Path);
+void PlatformUnmapFile(SMappedFile* File);
+
+// Monotonic clock, only meaningful relative to other calls
+uint64_t PlatformGetTimeNs();
+
+SPlatformWindow* PlatformOpenWindow(const char* Title, uint32_t Width, uint32_t Height);
+// The surface created for the window has to be destroyed first
+void PlatformCloseWindow(SPlatformWindow* Window);
+
+const char* PlatformGetSurfaceExtensionName();
+VkResult PlatformCreateSurface(VkInstance Instance, SPlatformWindow* Window, VkSurfaceKHR* Surface);
+
+// Blocks until at least one window event arrives or TimeoutNs elapses (UINT64_MAX waits indefinitely, 0 only polls),
+// then processes every pending event.
+void PlatformWaitForEvents(SPlatformWindow* Window, uint64_t TimeoutNs);
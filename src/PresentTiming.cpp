@@ -0,0 +1,194 @@
+//
+// Per-frame present timestamps for jitter analysis.
+// Samples come either from VK_KHR_present_wait or from VK_GOOGLE_display_timing (actual present time reported by
+// the presentation engine). With present wait a waiter thread waits for every present ID right after it was queued
+// and records the CPU time the wait returned, which is as close to the time the image reached the display as we can
+// get without the engine telling us. The main thread's frame pacing waits on the same thread instead of calling
+// vkWaitForPresentKHR itself, so the samples don't depend on when the main loop gets around to waiting.
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+constexpr uint32_t PresentTimingReportInterval = 120;
+
+struct SPresentTimingLog
+{
+    FILE* CsvFile;
+
+    uint64_t LastTimeNs;
+
+    // Interval statistics over the current reporting window
+    uint32_t SampleCount;
+    double SumMs;
+    double SumSqMs;
+    double MinMs;
+    double MaxMs;
+};
+
+void PresentTimingInit(SPresentTimingLog* Log, const char* CsvPath)
+{
+    *Log = {};
+    if(CsvPath)
+    {
+        Log->CsvFile = fopen(CsvPath, "w");
+        if(Log->CsvFile)
+        {
+            fprintf(Log->CsvFile, "PresentId,TimeNs,IntervalNs,PresentMarginNs\n");
+        }
+        else
+        {
+            printf("Couldn't open present timing log %s\n", CsvPath);
+        }
+    }
+}
+
+void PresentTimingClose(SPresentTimingLog* Log)
+{
+    if(Log->CsvFile)
+    {
+        fclose(Log->CsvFile);
+        Log->CsvFile = nullptr;
+    }
+}
+
+// TimeNs is the time the present reached the display (or the best approximation we have of it),
+// PresentMarginNs is 0 when unknown.
+void PresentTimingRecord(SPresentTimingLog* Log, uint64_t PresentId, uint64_t TimeNs, uint64_t PresentMarginNs)
+{
+    uint64_t IntervalNs = Log->LastTimeNs ? TimeNs - Log->LastTimeNs : 0;
+    Log->LastTimeNs = TimeNs;
+
+    if(Log->CsvFile)
+    {
+        fprintf(Log->CsvFile, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", PresentId, TimeNs, IntervalNs, PresentMarginNs);
+    }
+
+    if(IntervalNs == 0)
+    {
+        return;
+    }
+
+    double IntervalMs = (double)IntervalNs / 1000000.0;
+    if(Log->SampleCount == 0)
+    {
+        Log->MinMs = IntervalMs;
+        Log->MaxMs = IntervalMs;
+    }
+    Log->SampleCount++;
+    Log->SumMs += IntervalMs;
+    Log->SumSqMs += IntervalMs * IntervalMs;
+    Log->MinMs = std::min(Log->MinMs, IntervalMs);
+    Log->MaxMs = std::max(Log->MaxMs, IntervalMs);
+
+    if(Log->SampleCount == PresentTimingReportInterval)
+    {
+        double Mean = Log->SumMs / Log->SampleCount;
+        double Variance = std::max(Log->SumSqMs / Log->SampleCount - Mean * Mean, 0.0);
+        printf("Present interval: mean %.3fms, jitter (stddev) %.3fms, min %.3fms, max %.3fms\n",
+               Mean, sqrt(Variance), Log->MinMs, Log->MaxMs);
+
+        Log->SampleCount = 0;
+        Log->SumMs = 0.0;
+        Log->SumSqMs = 0.0;
+    }
+}
+
+struct SPresentWaiter
+{
+    VkDevice Device;
+    VkSwapchainKHR Swapchain;
+    PFN_vkWaitForPresentKHR vkWaitForPresent;
+    // Only written by the waiter thread while it runs
+    SPresentTimingLog* Log;
+
+    // The mutex protects the present IDs and bQuit
+    std::thread Thread;
+    std::mutex Mutex;
+    std::condition_variable QueuedCondition;
+    std::condition_variable CompletedCondition;
+    // Last present ID queued by the main thread and the last one the waiter is done with
+    uint64_t QueuedPresentId;
+    uint64_t CompletedPresentId;
+    bool bQuit;
+};
+
+void PresentWaiterThread(SPresentWaiter* Waiter)
+{
+    // Short enough to notice bQuit when presents stop completing (e.g. the window got minimized)
+    constexpr uint64_t WaitTimeoutNs = 100000000ull;
+
+    for(;;)
+    {
+        uint64_t PresentId;
+        {
+            std::unique_lock<std::mutex> Lock(Waiter->Mutex);
+            Waiter->QueuedCondition.wait(Lock, [Waiter] { return Waiter->bQuit || Waiter->QueuedPresentId > Waiter->CompletedPresentId; });
+            if(Waiter->bQuit)
+            {
+                return;
+            }
+            PresentId = Waiter->CompletedPresentId + 1;
+        }
+
+        VkResult Result = Waiter->vkWaitForPresent(Waiter->Device, Waiter->Swapchain, PresentId, WaitTimeoutNs);
+        if(Result == VK_TIMEOUT)
+        {
+            continue;
+        }
+        if(Result == VK_SUCCESS)
+        {
+            PresentTimingRecord(Waiter->Log, PresentId, PlatformGetTimeNs(), 0);
+        }
+
+        // Failed waits count as completed too, otherwise the pacing would stall on them
+        {
+            std::lock_guard<std::mutex> Lock(Waiter->Mutex);
+            Waiter->CompletedPresentId = PresentId;
+        }
+        Waiter->CompletedCondition.notify_all();
+    }
+}
+
+void PresentWaiterInit(SPresentWaiter* Waiter, VkDevice Device, VkSwapchainKHR Swapchain, PFN_vkWaitForPresentKHR vkWaitForPresent,
+                       SPresentTimingLog* Log)
+{
+    Waiter->Device = Device;
+    Waiter->Swapchain = Swapchain;
+    Waiter->vkWaitForPresent = vkWaitForPresent;
+    Waiter->Log = Log;
+    Waiter->QueuedPresentId = 0;
+    Waiter->CompletedPresentId = 0;
+    Waiter->bQuit = false;
+    Waiter->Thread = std::thread(PresentWaiterThread, Waiter);
+}
+
+// Called right after vkQueuePresentKHR with the ID that was passed in VkPresentIdKHR
+void PresentWaiterQueue(SPresentWaiter* Waiter, uint64_t PresentId)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Waiter->Mutex);
+        Waiter->QueuedPresentId = PresentId;
+    }
+    Waiter->QueuedCondition.notify_one();
+}
+
+// Frame pacing: blocks until PresentId reached the display or TimeoutNs elapsed
+void PresentWaiterWait(SPresentWaiter* Waiter, uint64_t PresentId, uint64_t TimeoutNs)
+{
+    std::unique_lock<std::mutex> Lock(Waiter->Mutex);
+    Waiter->CompletedCondition.wait_for(Lock, std::chrono::nanoseconds(TimeoutNs),
+                                        [Waiter, PresentId] { return Waiter->CompletedPresentId >= PresentId; });
+}
+
+void PresentWaiterShutdown(SPresentWaiter* Waiter)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Waiter->Mutex);
+        Waiter->bQuit = true;
+    }
+    Waiter->QueuedCondition.notify_one();
+    Waiter->Thread.join();
+}
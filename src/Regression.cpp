@@ -0,0 +1,327 @@
+//
+// Regression checks for headless runs (-golden, -baseline).
+//
+// -golden compares the last rendered frame against a reference PNG. Pixels where any channel differs by more than
+// the tolerance count as mismatches and the check fails when more than a small fraction of the image mismatches,
+// so that rasterization differences between drivers don't fail it but a broken scene does. On failure a difference
+// image is written next to the golden.
+//
+// -baseline compares timings (lower is better) against the values stored in a text file, one "name value" pair per
+// line ('#' starts a comment line), and reports the ones that got slower than the threshold allows. Timings are
+// only comparable on the machine the baseline was measured on, so by default the comparison is only reported and
+// -perfgate has to be passed for a regression (or a missing baseline) to fail the run. Metrics the file doesn't
+// have yet are only reported.
+//
+// A missing golden fails the check, so a run without a reference image can't pass by accident. With -update the
+// references are (re)written from the current run instead of being compared against.
+//
+// Both are meant to be run on a software driver like lavapipe, where rendering is deterministic and timings don't
+// depend on the GPU of the machine running them.
+//
+
+// Fraction of the pixels that may differ by more than the tolerance
+constexpr double GoldenMaxMismatchFraction = 0.001;
+
+struct SPerfMetric
+{
+    const char* Name;
+    double Value;
+};
+
+struct SPerfMetricBaseline
+{
+    char Name[64];
+    double Value;
+};
+
+static uint32_t PNGGetU32(const uint8_t* Data)
+{
+    return ((uint32_t)Data[0] << 24) | ((uint32_t)Data[1] << 16) | ((uint32_t)Data[2] << 8) | (uint32_t)Data[3];
+}
+
+static uint8_t PNGPaeth(uint8_t Left, uint8_t Up, uint8_t UpLeft)
+{
+    int32_t Estimate = (int32_t)Left + (int32_t)Up - (int32_t)UpLeft;
+    int32_t DistanceLeft = abs(Estimate - (int32_t)Left);
+    int32_t DistanceUp = abs(Estimate - (int32_t)Up);
+    int32_t DistanceUpLeft = abs(Estimate - (int32_t)UpLeft);
+    if(DistanceLeft <= DistanceUp && DistanceLeft <= DistanceUpLeft) return Left;
+    if(DistanceUp <= DistanceUpLeft) return Up;
+    return UpLeft;
+}
+
+// Reads 8-bit non-interlaced RGB or RGBA PNGs (what WritePNG and most tools write) into tightly packed RGBA
+static bool ReadPNG(const char* Path, uint32_t* Width, uint32_t* Height, std::vector<uint8_t>& Pixels)
+{
+    FILE* File = fopen(Path, "rb");
+    if(!File)
+    {
+        printf("Couldn't open %s\n", Path);
+        return false;
+    }
+    std::vector<uint8_t> Data;
+    uint8_t Buffer[65536];
+    size_t ReadSize;
+    while((ReadSize = fread(Buffer, 1, sizeof(Buffer), File)) > 0)
+    {
+        Data.insert(Data.end(), Buffer, Buffer + ReadSize);
+    }
+    fclose(File);
+
+    static const uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if(Data.size() < 8 || memcmp(Data.data(), Signature, 8) != 0)
+    {
+        printf("%s is not a PNG file\n", Path);
+        return false;
+    }
+
+    uint32_t ChannelCount = 0;
+    std::vector<uint8_t> Compressed;
+    for(size_t Offset = 8; Offset + 12 <= Data.size();)
+    {
+        uint32_t ChunkSize = PNGGetU32(&Data[Offset]);
+        const char* Type = (const char*)&Data[Offset + 4];
+        const uint8_t* ChunkData = &Data[Offset + 8];
+        if(Offset + 12 + (size_t)ChunkSize > Data.size())
+        {
+            break;
+        }
+
+        if(memcmp(Type, "IHDR", 4) == 0 && ChunkSize >= 13)
+        {
+            *Width = PNGGetU32(ChunkData);
+            *Height = PNGGetU32(ChunkData + 4);
+            uint8_t BitDepth = ChunkData[8];
+            uint8_t ColorType = ChunkData[9];
+            uint8_t Interlace = ChunkData[12];
+            ChannelCount = (ColorType == 6) ? 4 : (ColorType == 2) ? 3 : 0;
+            if(BitDepth != 8 || ChannelCount == 0 || Interlace != 0)
+            {
+                printf("%s: only 8-bit non-interlaced RGB/RGBA PNGs are supported\n", Path);
+                return false;
+            }
+        }
+        else if(memcmp(Type, "IDAT", 4) == 0)
+        {
+            Compressed.insert(Compressed.end(), ChunkData, ChunkData + ChunkSize);
+        }
+        else if(memcmp(Type, "IEND", 4) == 0)
+        {
+            break;
+        }
+        Offset += 12 + (size_t)ChunkSize;
+    }
+
+    if(ChannelCount == 0)
+    {
+        printf("%s: missing PNG header\n", Path);
+        return false;
+    }
+
+    // Every row starts with its filter type
+    size_t Stride = (size_t)*Width * ChannelCount;
+    std::vector<uint8_t> Filtered((Stride + 1) * *Height);
+    if(!ZlibDecompress(Compressed.data(), Compressed.size(), Filtered.data(), Filtered.size()))
+    {
+        printf("%s: corrupt PNG image data\n", Path);
+        return false;
+    }
+
+    std::vector<uint8_t> Rows(Stride * *Height);
+    for(uint32_t Y = 0; Y < *Height; ++Y)
+    {
+        uint8_t FilterType = Filtered[Y * (Stride + 1)];
+        const uint8_t* Source = &Filtered[Y * (Stride + 1) + 1];
+        uint8_t* Row = &Rows[Y * Stride];
+        const uint8_t* PreviousRow = (Y > 0) ? Row - Stride : nullptr;
+        for(size_t X = 0; X < Stride; ++X)
+        {
+            uint8_t Left = (X >= ChannelCount) ? Row[X - ChannelCount] : 0;
+            uint8_t Up = PreviousRow ? PreviousRow[X] : 0;
+            uint8_t UpLeft = (PreviousRow && X >= ChannelCount) ? PreviousRow[X - ChannelCount] : 0;
+            switch(FilterType)
+            {
+                case 0: Row[X] = Source[X]; break;
+                case 1: Row[X] = Source[X] + Left; break;
+                case 2: Row[X] = Source[X] + Up; break;
+                case 3: Row[X] = Source[X] + (uint8_t)(((uint32_t)Left + Up) / 2); break;
+                case 4: Row[X] = Source[X] + PNGPaeth(Left, Up, UpLeft); break;
+                default:
+                {
+                    printf("%s: invalid PNG filter type %u\n", Path, FilterType);
+                    return false;
+                }
+            }
+        }
+    }
+
+    size_t PixelCount = (size_t)*Width * *Height;
+    Pixels.resize(PixelCount * 4);
+    for(size_t PixelIndex = 0; PixelIndex < PixelCount; ++PixelIndex)
+    {
+        const uint8_t* Source = &Rows[PixelIndex * ChannelCount];
+        Pixels[4 * PixelIndex + 0] = Source[0];
+        Pixels[4 * PixelIndex + 1] = Source[1];
+        Pixels[4 * PixelIndex + 2] = Source[2];
+        Pixels[4 * PixelIndex + 3] = (ChannelCount == 4) ? Source[3] : 255;
+    }
+    return true;
+}
+
+// Pixels are tightly packed 8-bit RGBA. Tolerance is the largest per channel difference that still counts as a match.
+bool RegressionCheckGolden(const char* GoldenPath, uint32_t Width, uint32_t Height, const uint8_t* Pixels, uint32_t Tolerance, bool bUpdate)
+{
+    if(bUpdate)
+    {
+        if(!WritePNG(GoldenPath, Width, Height, Pixels))
+        {
+            printf("Golden image: FAILED, couldn't write %s\n", GoldenPath);
+            return false;
+        }
+        printf("Golden image: %s written from this run\n", GoldenPath);
+        return true;
+    }
+
+    FILE* GoldenFile = fopen(GoldenPath, "rb");
+    if(!GoldenFile)
+    {
+        printf("Golden image: FAILED, %s doesn't exist (run with -update to create it)\n", GoldenPath);
+        return false;
+    }
+    fclose(GoldenFile);
+
+    uint32_t GoldenWidth = 0;
+    uint32_t GoldenHeight = 0;
+    std::vector<uint8_t> Golden;
+    if(!ReadPNG(GoldenPath, &GoldenWidth, &GoldenHeight, Golden))
+    {
+        printf("Golden image: FAILED, couldn't read %s\n", GoldenPath);
+        return false;
+    }
+
+    if(GoldenWidth != Width || GoldenHeight != Height)
+    {
+        printf("Golden image: FAILED, %s is %ux%u but the frame is %ux%u\n", GoldenPath, GoldenWidth, GoldenHeight, Width, Height);
+        return false;
+    }
+
+    // The difference image shows mismatching pixels in red over a dimmed copy of the frame
+    size_t PixelCount = (size_t)Width * Height;
+    std::vector<uint8_t> Difference(PixelCount * 4);
+    uint64_t MismatchCount = 0;
+    uint32_t MaxDifference = 0;
+    for(size_t PixelIndex = 0; PixelIndex < PixelCount; ++PixelIndex)
+    {
+        uint32_t PixelDifference = 0;
+        for(uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            uint32_t ChannelDifference = (uint32_t)abs((int32_t)Pixels[4 * PixelIndex + Channel] - (int32_t)Golden[4 * PixelIndex + Channel]);
+            PixelDifference = std::max(PixelDifference, ChannelDifference);
+        }
+        MaxDifference = std::max(MaxDifference, PixelDifference);
+
+        uint8_t* Output = &Difference[4 * PixelIndex];
+        if(PixelDifference > Tolerance)
+        {
+            MismatchCount++;
+            Output[0] = 255;
+            Output[1] = 0;
+            Output[2] = 0;
+        }
+        else
+        {
+            Output[0] = Pixels[4 * PixelIndex + 0] / 4;
+            Output[1] = Pixels[4 * PixelIndex + 1] / 4;
+            Output[2] = Pixels[4 * PixelIndex + 2] / 4;
+        }
+        Output[3] = 255;
+    }
+
+    bool bPassed = (double)MismatchCount <= GoldenMaxMismatchFraction * (double)PixelCount;
+    printf("Golden image: %s, %" PRIu64 " of %zu pixels differ by more than %u (max difference %u)\n",
+           bPassed ? "passed" : "FAILED", MismatchCount, PixelCount, Tolerance, MaxDifference);
+
+    if(!bPassed)
+    {
+        // golden.png -> golden_diff.png
+        char DifferencePath[600];
+        const char* Extension = strrchr(GoldenPath, '.');
+        int StemLength = Extension ? (int)(Extension - GoldenPath) : (int)strlen(GoldenPath);
+        snprintf(DifferencePath, sizeof(DifferencePath), "%.*s_diff.png", StemLength, GoldenPath);
+        if(WritePNG(DifferencePath, Width, Height, Difference.data()))
+        {
+            printf("  Difference image written to %s\n", DifferencePath);
+        }
+    }
+    return bPassed;
+}
+
+// Fails when a metric is more than ThresholdPercent above its baseline, but only when bGate is set
+bool RegressionCheckBaseline(const char* BaselinePath, const SPerfMetric* Metrics, uint32_t MetricCount, double ThresholdPercent,
+                             bool bGate, bool bUpdate)
+{
+    if(bUpdate)
+    {
+        FILE* File = fopen(BaselinePath, "w");
+        if(!File)
+        {
+            printf("Performance baseline: FAILED, couldn't write %s\n", BaselinePath);
+            return false;
+        }
+        for(uint32_t MetricIndex = 0; MetricIndex < MetricCount; ++MetricIndex)
+        {
+            fprintf(File, "%s %.3f\n", Metrics[MetricIndex].Name, Metrics[MetricIndex].Value);
+        }
+        fclose(File);
+        printf("Performance baseline: %s written from this run\n", BaselinePath);
+        return true;
+    }
+
+    FILE* File = fopen(BaselinePath, "r");
+    if(!File)
+    {
+        printf("Performance baseline: %s, %s doesn't exist (run with -update to create it)\n",
+               bGate ? "FAILED" : "not checked", BaselinePath);
+        return !bGate;
+    }
+
+    std::vector<SPerfMetricBaseline> Baselines;
+    char Line[256];
+    while(fgets(Line, sizeof(Line), File))
+    {
+        SPerfMetricBaseline Baseline;
+        if(Line[0] != '#' && sscanf(Line, "%63s %lf", Baseline.Name, &Baseline.Value) == 2)
+        {
+            Baselines.push_back(Baseline);
+        }
+    }
+    fclose(File);
+
+    bool bPassed = true;
+    printf("Performance baseline (%s, +%.0f%% allowed):\n", BaselinePath, ThresholdPercent);
+    for(uint32_t MetricIndex = 0; MetricIndex < MetricCount; ++MetricIndex)
+    {
+        const SPerfMetric& Metric = Metrics[MetricIndex];
+        const SPerfMetricBaseline* MetricBaseline = nullptr;
+        for(const SPerfMetricBaseline& Entry : Baselines)
+        {
+            if(strcmp(Entry.Name, Metric.Name) == 0)
+            {
+                MetricBaseline = &Entry;
+            }
+        }
+        if(!MetricBaseline)
+        {
+            printf("  %-12s %10.3f (no baseline)\n", Metric.Name, Metric.Value);
+            continue;
+        }
+
+        double Change = (MetricBaseline->Value > 0.0) ? 100.0 * (Metric.Value - MetricBaseline->Value) / MetricBaseline->Value : 0.0;
+        bool bRegressed = Change > ThresholdPercent;
+        bPassed &= !bRegressed;
+        printf("  %-12s %10.3f vs %10.3f (%+.1f%%)%s\n", Metric.Name, Metric.Value, MetricBaseline->Value, Change,
+               bRegressed ? " REGRESSED" : "");
+    }
+    printf("Performance baseline: %s\n", bPassed ? "passed" : (bGate ? "FAILED" : "regressed (reported only, -perfgate fails the run)"));
+    return bPassed || !bGate;
+}
@@ -0,0 +1,277 @@
+//
+// Vulkan object lifetimes.
+//
+// Device objects that outlive a single module (the render pass, pipelines, attachments, framebuffers, command pools,
+// semaphores, streamed texture images) are added to the table as they are created and referred to by handles: a slot
+// index and the slot's generation. Users keep the handle and resolve it where the object is used. Releasing a handle
+// bumps the generation, so a stale handle resolves to null (and trips an assert when released again) instead of
+// silently reaching a reused slot.
+//
+// Released objects aren't destroyed right away but queued with the graphics timeline value of the last submission
+// that might still use them (see Timeline.cpp). The queue is collected once per frame and an object is destroyed
+// as soon as its value is reached, without waiting on anything. Teardown waits for the timeline once and destroys
+// whatever is left, live objects in the reverse of the order they were added, so objects that reference others
+// (framebuffers, views, descriptor sets) go before what they reference.
+//
+// Startup jobs add what they create, so adding, resolving and releasing take the table's lock. Collection and
+// teardown are main thread only.
+//
+
+#include <mutex>
+
+enum EResourceType
+{
+    ResourceType_Image,
+    ResourceType_ImageView,
+    ResourceType_Memory,
+    ResourceType_Buffer,
+    ResourceType_PipelineLayout,
+    ResourceType_Pipeline,
+    ResourceType_RenderPass,
+    ResourceType_Framebuffer,
+    ResourceType_CommandPool,
+    ResourceType_Semaphore,
+    ResourceType_Sampler,
+    ResourceType_DescriptorSetLayout,
+    ResourceType_DescriptorPool,
+    ResourceType_DescriptorSet,
+
+    ResourceType_Count,
+};
+
+static const char* ResourceTypeNames[ResourceType_Count] =
+{
+    "image", "image view", "memory", "buffer", "pipeline layout", "pipeline", "render pass", "framebuffer",
+    "command pool", "semaphore", "sampler", "descriptor set layout", "descriptor pool", "descriptor set",
+};
+
+// Generation 0 is never handed out, a zero initialized handle is invalid
+struct SResourceHandle
+{
+    uint32_t Index;
+    uint32_t Generation;
+};
+
+struct SResourceSlot
+{
+    EResourceType Type;
+    // The Vulkan handle, non-dispatchable handles are 64-bit on every platform
+    uint64_t Object;
+    // Pool the object was allocated from, only for descriptor sets
+    uint64_t Parent;
+    uint32_t Generation;
+    // Order of creation, teardown goes backwards. 0 when the slot is free.
+    uint64_t Sequence;
+};
+
+struct SRetiredResource
+{
+    EResourceType Type;
+    uint64_t Object;
+    uint64_t Parent;
+    uint64_t GraphicsTimelineValue;
+};
+
+struct SResourceTable
+{
+    VkDevice Device;
+    SVulkanTimeline* GraphicsTimeline;
+
+    // Protects everything below
+    std::mutex Mutex;
+
+    std::vector<SResourceSlot> Slots;
+    std::vector<uint32_t> FreeSlots;
+    uint64_t NextSequence;
+
+    std::vector<SRetiredResource> RetiredResources;
+
+    uint32_t LiveCounts[ResourceType_Count];
+    uint64_t DeferredDestroyCount;
+};
+
+void ResourceTableInit(SResourceTable* Table, VkDevice Device, SVulkanTimeline* GraphicsTimeline)
+{
+    Table->Device = Device;
+    Table->GraphicsTimeline = GraphicsTimeline;
+    Table->NextSequence = 1;
+}
+
+static void ResourceDestroyObject(VkDevice Device, EResourceType Type, uint64_t Object, uint64_t Parent)
+{
+    switch(Type)
+    {
+        case ResourceType_Image:                vkDestroyImage(Device, (VkImage)Object, nullptr); break;
+        case ResourceType_ImageView:            vkDestroyImageView(Device, (VkImageView)Object, nullptr); break;
+        case ResourceType_Memory:               vkFreeMemory(Device, (VkDeviceMemory)Object, nullptr); break;
+        case ResourceType_Buffer:               vkDestroyBuffer(Device, (VkBuffer)Object, nullptr); break;
+        case ResourceType_PipelineLayout:       vkDestroyPipelineLayout(Device, (VkPipelineLayout)Object, nullptr); break;
+        case ResourceType_Pipeline:             vkDestroyPipeline(Device, (VkPipeline)Object, nullptr); break;
+        case ResourceType_RenderPass:           vkDestroyRenderPass(Device, (VkRenderPass)Object, nullptr); break;
+        case ResourceType_Framebuffer:          vkDestroyFramebuffer(Device, (VkFramebuffer)Object, nullptr); break;
+        case ResourceType_CommandPool:          vkDestroyCommandPool(Device, (VkCommandPool)Object, nullptr); break;
+        case ResourceType_Semaphore:            vkDestroySemaphore(Device, (VkSemaphore)Object, nullptr); break;
+        case ResourceType_Sampler:              vkDestroySampler(Device, (VkSampler)Object, nullptr); break;
+        case ResourceType_DescriptorSetLayout:  vkDestroyDescriptorSetLayout(Device, (VkDescriptorSetLayout)Object, nullptr); break;
+        case ResourceType_DescriptorPool:       vkDestroyDescriptorPool(Device, (VkDescriptorPool)Object, nullptr); break;
+        case ResourceType_DescriptorSet:
+        {
+            VkDescriptorSet DescriptorSet = (VkDescriptorSet)Object;
+            vkFreeDescriptorSets(Device, (VkDescriptorPool)Parent, 1, &DescriptorSet);
+        } break;
+        default: assert(!"Invalid resource type");
+    }
+}
+
+// Takes ownership of Object, null handles aren't added (and get an invalid handle back).
+// Descriptor sets are freed back to Pool, which has to be added before them.
+template<typename T>
+SResourceHandle ResourceAdd(SResourceTable* Table, EResourceType Type, T Object, VkDescriptorPool Pool = VK_NULL_HANDLE)
+{
+    if(Object == VK_NULL_HANDLE)
+    {
+        return {};
+    }
+
+    std::lock_guard<std::mutex> Lock(Table->Mutex);
+    uint32_t SlotIndex;
+    if(!Table->FreeSlots.empty())
+    {
+        SlotIndex = Table->FreeSlots.back();
+        Table->FreeSlots.pop_back();
+    }
+    else
+    {
+        SlotIndex = (uint32_t)Table->Slots.size();
+        Table->Slots.push_back({});
+    }
+
+    SResourceSlot& Slot = Table->Slots[SlotIndex];
+    Slot.Type = Type;
+    Slot.Object = (uint64_t)Object;
+    Slot.Parent = (uint64_t)Pool;
+    Slot.Generation++;
+    Slot.Sequence = Table->NextSequence++;
+    Table->LiveCounts[Type]++;
+    return { SlotIndex, Slot.Generation };
+}
+
+// The table's lock has to be held
+static SResourceSlot* ResourceGetSlot(SResourceTable* Table, SResourceHandle Handle)
+{
+    if(Handle.Index >= Table->Slots.size())
+    {
+        return nullptr;
+    }
+
+    SResourceSlot* Slot = &Table->Slots[Handle.Index];
+    return (Slot->Sequence != 0 && Slot->Generation == Handle.Generation) ? Slot : nullptr;
+}
+
+// VK_NULL_HANDLE for released (and invalid) handles
+template<typename T>
+T ResourceGet(SResourceTable* Table, SResourceHandle Handle, EResourceType Type)
+{
+    std::lock_guard<std::mutex> Lock(Table->Mutex);
+    SResourceSlot* Slot = ResourceGetSlot(Table, Handle);
+    if(!Slot)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    assert(Slot->Type == Type);
+    return (T)Slot->Object;
+}
+
+// The object is destroyed once the graphics timeline reaches GraphicsTimelineValue, the last submission that
+// might use it. The handle is invalid from here on.
+void ResourceRelease(SResourceTable* Table, SResourceHandle Handle, uint64_t GraphicsTimelineValue)
+{
+    std::lock_guard<std::mutex> Lock(Table->Mutex);
+    SResourceSlot* Slot = ResourceGetSlot(Table, Handle);
+    assert(Slot && "Released a stale resource handle");
+    if(!Slot)
+    {
+        return;
+    }
+
+    SRetiredResource Retired = {};
+    Retired.Type = Slot->Type;
+    Retired.Object = Slot->Object;
+    Retired.Parent = Slot->Parent;
+    Retired.GraphicsTimelineValue = GraphicsTimelineValue;
+    Table->RetiredResources.push_back(Retired);
+
+    Table->LiveCounts[Slot->Type]--;
+    Slot->Object = 0;
+    Slot->Parent = 0;
+    Slot->Sequence = 0;
+    Slot->Generation++;
+    Table->FreeSlots.push_back(Handle.Index);
+}
+
+// Destroys the released objects the GPU is done with, never blocks.
+// Objects go in the order they were released in, so a set of objects released together can reference each other.
+void ResourceCollect(SResourceTable* Table)
+{
+    std::lock_guard<std::mutex> Lock(Table->Mutex);
+    size_t KeptCount = 0;
+    for(SRetiredResource& Retired : Table->RetiredResources)
+    {
+        if(TimelineIsComplete(Table->GraphicsTimeline, Retired.GraphicsTimelineValue))
+        {
+            ResourceDestroyObject(Table->Device, Retired.Type, Retired.Object, Retired.Parent);
+            Table->DeferredDestroyCount++;
+        }
+        else
+        {
+            Table->RetiredResources[KeptCount++] = Retired;
+        }
+    }
+    Table->RetiredResources.resize(KeptCount);
+}
+
+// Waits for the graphics timeline once and destroys every object, released or not
+void ResourceTableDestroy(SResourceTable* Table)
+{
+    uint64_t StartTime = PlatformGetTimeNs();
+    TimelineWait(Table->GraphicsTimeline, Table->GraphicsTimeline->LastSubmittedValue);
+
+    for(SRetiredResource& Retired : Table->RetiredResources)
+    {
+        ResourceDestroyObject(Table->Device, Retired.Type, Retired.Object, Retired.Parent);
+        Table->DeferredDestroyCount++;
+    }
+    Table->RetiredResources.clear();
+
+    std::vector<SResourceSlot*> LiveSlots;
+    for(SResourceSlot& Slot : Table->Slots)
+    {
+        if(Slot.Sequence)
+        {
+            LiveSlots.push_back(&Slot);
+        }
+    }
+    std::sort(LiveSlots.begin(), LiveSlots.end(), [](const SResourceSlot* A, const SResourceSlot* B) { return A->Sequence > B->Sequence; });
+    for(SResourceSlot* Slot : LiveSlots)
+    {
+        ResourceDestroyObject(Table->Device, Slot->Type, Slot->Object, Slot->Parent);
+    }
+
+    printf("Resources: %u destroyed at exit in %.3fms (", (uint32_t)LiveSlots.size(), (double)(PlatformGetTimeNs() - StartTime) / 1000000.0);
+    bool bIsFirst = true;
+    for(uint32_t Type = 0; Type < ResourceType_Count; ++Type)
+    {
+        if(Table->LiveCounts[Type])
+        {
+            printf("%s%u %s", bIsFirst ? "" : ", ", Table->LiveCounts[Type], ResourceTypeNames[Type]);
+            bIsFirst = false;
+        }
+    }
+    printf("), %" PRIu64 " released while running\n", Table->DeferredDestroyCount);
+
+    Table->Slots.clear();
+    Table->FreeSlots.clear();
+    Table->DeferredDestroyCount = 0;
+    memset(Table->LiveCounts, 0, sizeof(Table->LiveCounts));
+}
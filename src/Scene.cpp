@@ -0,0 +1,698 @@
+//
+// Scene object store and CPU frustum culling.
+//
+// Object bounds are kept as a structure of arrays (one array per component of the bounding sphere and the
+// world space box extents) so that a SIMD kernel tests 4 (SSE, NEON) or 8 (AVX2) objects per iteration with
+// plain loads. Each object is tested against the 6 frustum planes with both its sphere and its box, for every
+// plane the tighter of the two decides. The kernels are branchless and write the indices of the visible objects
+// into a compact list that the draw recording walks; the rest of an object (its placement) is only touched
+// when it's visible.
+//
+// Culling is split into fixed size chunks run as jobs, each chunk writes its visible objects at its own offset
+// and the main thread closes the gaps afterwards, so the list stays in object order.
+//
+// The AVX2 kernel is picked at runtime when the CPU supports it, all kernels produce the same list as the
+// scalar one (no fused multiply-adds, same operation order), -cullbench checks that.
+//
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCENE_CULL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SCENE_TARGET_AVX2
+#else
+#define SCENE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define SCENE_CULL_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Objects per culling job
+constexpr uint32_t SceneCullChunkSize = 16384;
+// Minimum time each kernel runs for in -cullbench
+constexpr uint64_t SceneBenchmarkDurationNs = 250000000ull;
+
+enum ECullKernel
+{
+    CullKernel_Scalar,
+    CullKernel_SSE,
+    CullKernel_AVX2,
+    CullKernel_NEON,
+
+    CullKernel_Count,
+};
+
+static const char* CullKernelNames[CullKernel_Count] = { "scalar", "SSE", "AVX2", "NEON" };
+
+// Inside is where Plane.xyz * Point + Plane.w >= 0, the normals are unit length
+struct SFrustum
+{
+    float Planes[6][4];
+};
+
+// Placement of an object, the mesh's object space is scaled, rotated about the vertical axis and moved to Position
+struct SSceneObject
+{
+    float Position[3];
+    float Scale;
+    float Angle;
+};
+
+struct SScene
+{
+    // World space bounds, one array per component
+    std::vector<float> CenterX;
+    std::vector<float> CenterY;
+    std::vector<float> CenterZ;
+    std::vector<float> Radius;
+    // Box half extents around the same center
+    std::vector<float> ExtentX;
+    std::vector<float> ExtentY;
+    std::vector<float> ExtentZ;
+
+    std::vector<SSceneObject> Objects;
+
+    // Mesh instance field, see SceneAddMeshInstances
+    float FieldSize;
+    float InstanceRadius;
+
+    // Camera of the current frame, column major
+    float ViewProjection[16];
+    SFrustum Frustum;
+
+    ECullKernel Kernel;
+
+    // Indices of the visible objects in ascending order, only the first VisibleCount are valid
+    std::vector<uint32_t> VisibleObjects;
+    uint32_t VisibleCount;
+    std::vector<uint32_t> ChunkVisibleCounts;
+
+    // Totals over every SceneCull call
+    uint64_t CullCount;
+    uint64_t TestedObjectCount;
+    uint64_t VisibleObjectCount;
+    uint64_t CullTimeNs;
+};
+
+// Visible holds room for End - First indices, the kernels return how many they wrote
+typedef uint32_t (*PFN_SceneCull)(const SScene* Scene, const SFrustum* Frustum, uint32_t First, uint32_t End, uint32_t* Visible);
+
+uint32_t SceneGetObjectCount(const SScene* Scene)
+{
+    return (uint32_t)Scene->Objects.size();
+}
+
+void SceneAddObject(SScene* Scene, const SSceneObject* Object, const float* Center, float Radius, const float* Extent)
+{
+    Scene->CenterX.push_back(Center[0]);
+    Scene->CenterY.push_back(Center[1]);
+    Scene->CenterZ.push_back(Center[2]);
+    Scene->Radius.push_back(Radius);
+    Scene->ExtentX.push_back(Extent[0]);
+    Scene->ExtentY.push_back(Extent[1]);
+    Scene->ExtentZ.push_back(Extent[2]);
+    Scene->Objects.push_back(*Object);
+}
+
+// Extracts the planes from the clip space inequalities -w <= x <= w, -w <= y <= w and 0 <= z <= w (Gribb-Hartmann)
+static void SceneGetFrustum(const float* ViewProjection, SFrustum* Frustum)
+{
+    const float* M = ViewProjection;
+    for(uint32_t Component = 0; Component < 4; ++Component)
+    {
+        float Row0 = M[Component * 4 + 0];
+        float Row1 = M[Component * 4 + 1];
+        float Row2 = M[Component * 4 + 2];
+        float Row3 = M[Component * 4 + 3];
+
+        Frustum->Planes[0][Component] = Row3 + Row0;
+        Frustum->Planes[1][Component] = Row3 - Row0;
+        Frustum->Planes[2][Component] = Row3 + Row1;
+        Frustum->Planes[3][Component] = Row3 - Row1;
+        Frustum->Planes[4][Component] = Row2;
+        Frustum->Planes[5][Component] = Row3 - Row2;
+    }
+
+    for(uint32_t PlaneIndex = 0; PlaneIndex < 6; ++PlaneIndex)
+    {
+        float* Plane = Frustum->Planes[PlaneIndex];
+        float Length = sqrtf(Plane[0] * Plane[0] + Plane[1] * Plane[1] + Plane[2] * Plane[2]);
+        for(uint32_t Component = 0; Component < 4; ++Component)
+        {
+            Plane[Component] /= Length;
+        }
+    }
+}
+
+// Right handed view looking down -z after turning by Yaw about the vertical axis and pitching down by Pitch,
+// same projection as the single mesh
+void SceneGetViewProjection(const float* Eye, float Yaw, float Pitch, float AspectRatio, float Near, float Far, float* ViewProjection)
+{
+    float Forward[3] = { sinf(Yaw) * cosf(Pitch), -sinf(Pitch), -cosf(Yaw) * cosf(Pitch) };
+    float RightLength = sqrtf(Forward[0] * Forward[0] + Forward[2] * Forward[2]);
+    float Right[3] = { -Forward[2] / RightLength, 0.0f, Forward[0] / RightLength };
+    float Up[3] =
+    {
+        Right[1] * Forward[2] - Right[2] * Forward[1],
+        Right[2] * Forward[0] - Right[0] * Forward[2],
+        Right[0] * Forward[1] - Right[1] * Forward[0],
+    };
+
+    float View[16] =
+    {
+        Right[0], Up[0], -Forward[0], 0.0f,
+        Right[1], Up[1], -Forward[1], 0.0f,
+        Right[2], Up[2], -Forward[2], 0.0f,
+        -(Right[0] * Eye[0] + Right[1] * Eye[1] + Right[2] * Eye[2]),
+        -(Up[0] * Eye[0] + Up[1] * Eye[1] + Up[2] * Eye[2]),
+        Forward[0] * Eye[0] + Forward[1] * Eye[1] + Forward[2] * Eye[2],
+        1.0f,
+    };
+
+    constexpr float VerticalFov = 0.9f;
+    float Focal = 1.0f / tanf(0.5f * VerticalFov);
+    float Projection[16] =
+    {
+        Focal / AspectRatio, 0.0f, 0.0f, 0.0f,
+        0.0f, -Focal, 0.0f, 0.0f,
+        0.0f, 0.0f, Far / (Near - Far), -1.0f,
+        0.0f, 0.0f, Near * Far / (Near - Far), 0.0f,
+    };
+
+    MeshMultiplyMatrix(ViewProjection, Projection, View);
+}
+
+void SceneSetCamera(SScene* Scene, const float* Eye, float Yaw, float Pitch, float AspectRatio, float Near, float Far)
+{
+    SceneGetViewProjection(Eye, Yaw, Pitch, AspectRatio, Near, Far, Scene->ViewProjection);
+    SceneGetFrustum(Scene->ViewProjection, &Scene->Frustum);
+}
+
+static uint32_t SceneCullScalar(const SScene* Scene, const SFrustum* Frustum, uint32_t First, uint32_t End, uint32_t* Visible)
+{
+    uint32_t Count = 0;
+    for(uint32_t Index = First; Index < End; ++Index)
+    {
+        float CenterX = Scene->CenterX[Index];
+        float CenterY = Scene->CenterY[Index];
+        float CenterZ = Scene->CenterZ[Index];
+        float Radius = Scene->Radius[Index];
+        float ExtentX = Scene->ExtentX[Index];
+        float ExtentY = Scene->ExtentY[Index];
+        float ExtentZ = Scene->ExtentZ[Index];
+
+        bool bIsOutside = false;
+        for(uint32_t PlaneIndex = 0; PlaneIndex < 6; ++PlaneIndex)
+        {
+            const float* Plane = Frustum->Planes[PlaneIndex];
+            float Distance = Plane[0] * CenterX + Plane[1] * CenterY + Plane[2] * CenterZ + Plane[3];
+            float BoxRadius = fabsf(Plane[0]) * ExtentX + fabsf(Plane[1]) * ExtentY + fabsf(Plane[2]) * ExtentZ;
+            float EffectiveRadius = (Radius < BoxRadius) ? Radius : BoxRadius;
+            bIsOutside |= Distance < -EffectiveRadius;
+        }
+
+        Visible[Count] = Index;
+        Count += bIsOutside ? 0 : 1;
+    }
+    return Count;
+}
+
+#if SCENE_CULL_X86
+static uint32_t SceneCullSSE(const SScene* Scene, const SFrustum* Frustum, uint32_t First, uint32_t End, uint32_t* Visible)
+{
+    __m128 PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+    __m128 AbsPlaneX[6], AbsPlaneY[6], AbsPlaneZ[6];
+    for(uint32_t PlaneIndex = 0; PlaneIndex < 6; ++PlaneIndex)
+    {
+        const float* Plane = Frustum->Planes[PlaneIndex];
+        PlaneX[PlaneIndex] = _mm_set1_ps(Plane[0]);
+        PlaneY[PlaneIndex] = _mm_set1_ps(Plane[1]);
+        PlaneZ[PlaneIndex] = _mm_set1_ps(Plane[2]);
+        PlaneW[PlaneIndex] = _mm_set1_ps(Plane[3]);
+        AbsPlaneX[PlaneIndex] = _mm_set1_ps(fabsf(Plane[0]));
+        AbsPlaneY[PlaneIndex] = _mm_set1_ps(fabsf(Plane[1]));
+        AbsPlaneZ[PlaneIndex] = _mm_set1_ps(fabsf(Plane[2]));
+    }
+
+    const __m128 Zero = _mm_setzero_ps();
+    uint32_t Count = 0;
+    uint32_t Index = First;
+    for(; Index + 4 <= End; Index += 4)
+    {
+        __m128 CenterX = _mm_loadu_ps(&Scene->CenterX[Index]);
+        __m128 CenterY = _mm_loadu_ps(&Scene->CenterY[Index]);
+        __m128 CenterZ = _mm_loadu_ps(&Scene->CenterZ[Index]);
+        __m128 Radius = _mm_loadu_ps(&Scene->Radius[Index]);
+        __m128 ExtentX = _mm_loadu_ps(&Scene->ExtentX[Index]);
+        __m128 ExtentY = _mm_loadu_ps(&Scene->ExtentY[Index]);
+        __m128 ExtentZ = _mm_loadu_ps(&Scene->ExtentZ[Index]);
+
+        __m128 Outside = Zero;
+        for(uint32_t PlaneIndex = 0; PlaneIndex < 6; ++PlaneIndex)
+        {
+            __m128 Distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(PlaneX[PlaneIndex], CenterX), _mm_mul_ps(PlaneY[PlaneIndex], CenterY)),
+                                                    _mm_mul_ps(PlaneZ[PlaneIndex], CenterZ)), PlaneW[PlaneIndex]);
+            __m128 BoxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(AbsPlaneX[PlaneIndex], ExtentX), _mm_mul_ps(AbsPlaneY[PlaneIndex], ExtentY)),
+                                          _mm_mul_ps(AbsPlaneZ[PlaneIndex], ExtentZ));
+            __m128 EffectiveRadius = _mm_min_ps(Radius, BoxRadius);
+            Outside = _mm_or_ps(Outside, _mm_cmplt_ps(Distance, _mm_sub_ps(Zero, EffectiveRadius)));
+        }
+
+        uint32_t Mask = ~(uint32_t)_mm_movemask_ps(Outside);
+        for(uint32_t Lane = 0; Lane < 4; ++Lane)
+        {
+            Visible[Count] = Index + Lane;
+            Count += (Mask >> Lane) & 1;
+        }
+    }
+
+    return Count + SceneCullScalar(Scene, Frustum, Index, End, Visible + Count);
+}
+
+// Lane indices of the set bits of every 8 bit mask packed into bytes, and how many there are
+struct SSceneCompactTable
+{
+    uint64_t Lanes[256];
+    uint8_t Counts[256];
+};
+
+static constexpr SSceneCompactTable SceneBuildCompactTable()
+{
+    SSceneCompactTable Table = {};
+    for(uint32_t Mask = 0; Mask < 256; ++Mask)
+    {
+        uint32_t Count = 0;
+        for(uint32_t Lane = 0; Lane < 8; ++Lane)
+        {
+            if(Mask & (1u << Lane))
+            {
+                Table.Lanes[Mask] |= (uint64_t)Lane << (8 * Count);
+                Count++;
+            }
+        }
+        Table.Counts[Mask] = (uint8_t)Count;
+    }
+    return Table;
+}
+
+static constexpr SSceneCompactTable SceneCompactTable = SceneBuildCompactTable();
+
+// The visible indices are compacted with a single permute and stored 8 at a time, the lanes past the visible
+// ones are overwritten by the next store. Stores never go past Index + 8 so they stay within [First, End).
+SCENE_TARGET_AVX2
+static uint32_t SceneCullAVX2(const SScene* Scene, const SFrustum* Frustum, uint32_t First, uint32_t End, uint32_t* Visible)
+{
+    __m256 PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+    __m256 AbsPlaneX[6], AbsPlaneY[6], AbsPlaneZ[6];
+    for(uint32_t PlaneIndex = 0; PlaneIndex < 6; ++PlaneIndex)
+    {
+        const float* Plane = Frustum->Planes[PlaneIndex];
+        PlaneX[PlaneIndex] = _mm256_set1_ps(Plane[0]);
+        PlaneY[PlaneIndex] = _mm256_set1_ps(Plane[1]);
+        PlaneZ[PlaneIndex] = _mm256_set1_ps(Plane[2]);
+        PlaneW[PlaneIndex] = _mm256_set1_ps(Plane[3]);
+        AbsPlaneX[PlaneIndex] = _mm256_set1_ps(fabsf(Plane[0]));
+        AbsPlaneY[PlaneIndex] = _mm256_set1_ps(fabsf(Plane[1]));
+        AbsPlaneZ[PlaneIndex] = _mm256_set1_ps(fabsf(Plane[2]));
+    }
+
+    const __m256 Zero = _mm256_setzero_ps();
+    const __m256i LaneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    uint32_t Count = 0;
+    uint32_t Index = First;
+    for(; Index + 8 <= End; Index += 8)
+    {
+        __m256 CenterX = _mm256_loadu_ps(&Scene->CenterX[Index]);
+        __m256 CenterY = _mm256_loadu_ps(&Scene->CenterY[Index]);
+        __m256 CenterZ = _mm256_loadu_ps(&Scene->CenterZ[Index]);
+        __m256 Radius = _mm256_loadu_ps(&Scene->Radius[Index]);
+        __m256 ExtentX = _mm256_loadu_ps(&Scene->ExtentX[Index]);
+        __m256 ExtentY = _mm256_loadu_ps(&Scene->ExtentY[Index]);
+        __m256 ExtentZ = _mm256_loadu_ps(&Scene->ExtentZ[Index]);
+
+        __m256 Outside = Zero;
+        for(uint32_t PlaneIndex = 0; PlaneIndex < 6; ++PlaneIndex)
+        {
+            __m256 Distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(PlaneX[PlaneIndex], CenterX), _mm256_mul_ps(PlaneY[PlaneIndex], CenterY)),
+                                                          _mm256_mul_ps(PlaneZ[PlaneIndex], CenterZ)), PlaneW[PlaneIndex]);
+            __m256 BoxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(AbsPlaneX[PlaneIndex], ExtentX), _mm256_mul_ps(AbsPlaneY[PlaneIndex], ExtentY)),
+                                             _mm256_mul_ps(AbsPlaneZ[PlaneIndex], ExtentZ));
+            __m256 EffectiveRadius = _mm256_min_ps(Radius, BoxRadius);
+            Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(Distance, _mm256_sub_ps(Zero, EffectiveRadius), _CMP_LT_OQ));
+        }
+
+        uint32_t Mask = ~(uint32_t)_mm256_movemask_ps(Outside) & 0xFF;
+        __m256i Permutation = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long)SceneCompactTable.Lanes[Mask]));
+        __m256i Indices = _mm256_add_epi32(_mm256_set1_epi32((int)Index), LaneOffsets);
+        _mm256_storeu_si256((__m256i*)(Visible + Count), _mm256_permutevar8x32_epi32(Indices, Permutation));
+        Count += SceneCompactTable.Counts[Mask];
+    }
+
+    return Count + SceneCullScalar(Scene, Frustum, Index, End, Visible + Count);
+}
+
+static bool SceneCpuHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int Info[4];
+    __cpuid(Info, 0);
+    if(Info[0] < 7)
+    {
+        return false;
+    }
+
+    // AVX needs the OS to save the upper halves of the ymm registers
+    __cpuid(Info, 1);
+    bool bHasOSXSave = (Info[2] & (1 << 27)) != 0;
+    bool bHasAVX = (Info[2] & (1 << 28)) != 0;
+    if(!bHasOSXSave || !bHasAVX || (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+
+    __cpuidex(Info, 7, 0);
+    return (Info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#if SCENE_CULL_NEON
+static uint32_t SceneCullNEON(const SScene* Scene, const SFrustum* Frustum, uint32_t First, uint32_t End, uint32_t* Visible)
+{
+    float32x4_t PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+    float32x4_t AbsPlaneX[6], AbsPlaneY[6], AbsPlaneZ[6];
+    for(uint32_t PlaneIndex = 0; PlaneIndex < 6; ++PlaneIndex)
+    {
+        const float* Plane = Frustum->Planes[PlaneIndex];
+        PlaneX[PlaneIndex] = vdupq_n_f32(Plane[0]);
+        PlaneY[PlaneIndex] = vdupq_n_f32(Plane[1]);
+        PlaneZ[PlaneIndex] = vdupq_n_f32(Plane[2]);
+        PlaneW[PlaneIndex] = vdupq_n_f32(Plane[3]);
+        AbsPlaneX[PlaneIndex] = vdupq_n_f32(fabsf(Plane[0]));
+        AbsPlaneY[PlaneIndex] = vdupq_n_f32(fabsf(Plane[1]));
+        AbsPlaneZ[PlaneIndex] = vdupq_n_f32(fabsf(Plane[2]));
+    }
+
+    uint32_t Count = 0;
+    uint32_t Index = First;
+    for(; Index + 4 <= End; Index += 4)
+    {
+        float32x4_t CenterX = vld1q_f32(&Scene->CenterX[Index]);
+        float32x4_t CenterY = vld1q_f32(&Scene->CenterY[Index]);
+        float32x4_t CenterZ = vld1q_f32(&Scene->CenterZ[Index]);
+        float32x4_t Radius = vld1q_f32(&Scene->Radius[Index]);
+        float32x4_t ExtentX = vld1q_f32(&Scene->ExtentX[Index]);
+        float32x4_t ExtentY = vld1q_f32(&Scene->ExtentY[Index]);
+        float32x4_t ExtentZ = vld1q_f32(&Scene->ExtentZ[Index]);
+
+        uint32x4_t Outside = vdupq_n_u32(0);
+        for(uint32_t PlaneIndex = 0; PlaneIndex < 6; ++PlaneIndex)
+        {
+            // Separate multiplies and adds (vmlaq_f32 may be fused) to match the scalar kernel
+            float32x4_t Distance = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(PlaneX[PlaneIndex], CenterX), vmulq_f32(PlaneY[PlaneIndex], CenterY)),
+                                                       vmulq_f32(PlaneZ[PlaneIndex], CenterZ)), PlaneW[PlaneIndex]);
+            float32x4_t BoxRadius = vaddq_f32(vaddq_f32(vmulq_f32(AbsPlaneX[PlaneIndex], ExtentX), vmulq_f32(AbsPlaneY[PlaneIndex], ExtentY)),
+                                              vmulq_f32(AbsPlaneZ[PlaneIndex], ExtentZ));
+            float32x4_t EffectiveRadius = vminq_f32(Radius, BoxRadius);
+            Outside = vorrq_u32(Outside, vcltq_f32(Distance, vnegq_f32(EffectiveRadius)));
+        }
+
+        uint32_t Lanes[4];
+        vst1q_u32(Lanes, Outside);
+        for(uint32_t Lane = 0; Lane < 4; ++Lane)
+        {
+            Visible[Count] = Index + Lane;
+            Count += Lanes[Lane] ? 0 : 1;
+        }
+    }
+
+    return Count + SceneCullScalar(Scene, Frustum, Index, End, Visible + Count);
+}
+#endif
+
+static const PFN_SceneCull SceneCullFunctions[CullKernel_Count] =
+{
+    SceneCullScalar,
+#if SCENE_CULL_X86
+    SceneCullSSE,
+    SceneCullAVX2,
+#else
+    nullptr,
+    nullptr,
+#endif
+#if SCENE_CULL_NEON
+    SceneCullNEON,
+#else
+    nullptr,
+#endif
+};
+
+bool SceneIsKernelSupported(ECullKernel Kernel)
+{
+    switch(Kernel)
+    {
+        case CullKernel_Scalar: return true;
+#if SCENE_CULL_X86
+        case CullKernel_SSE: return true;
+        case CullKernel_AVX2: return SceneCpuHasAVX2();
+#endif
+#if SCENE_CULL_NEON
+        case CullKernel_NEON: return true;
+#endif
+        default: return false;
+    }
+}
+
+ECullKernel SceneGetBestKernel()
+{
+    for(int Kernel = CullKernel_Count - 1; Kernel > CullKernel_Scalar; --Kernel)
+    {
+        if(SceneIsKernelSupported((ECullKernel)Kernel))
+        {
+            return (ECullKernel)Kernel;
+        }
+    }
+    return CullKernel_Scalar;
+}
+
+void SceneInit(SScene* Scene)
+{
+    *Scene = {};
+    Scene->Kernel = SceneGetBestKernel();
+}
+
+// Small deterministic generator so that the scene (and captured frames) are the same on every run
+static float SceneRandom(uint32_t* State)
+{
+    *State ^= *State << 13;
+    *State ^= *State >> 17;
+    *State ^= *State << 5;
+    return (float)(*State >> 8) * (1.0f / 16777216.0f);
+}
+
+// Copies of the mesh on a jittered square grid on the ground plane, centered on the origin, with random size and
+// orientation. The world space box is the one around the rotated object space box.
+void SceneAddMeshInstances(SScene* Scene, const SMesh* Mesh, uint32_t Count)
+{
+    const float* Sphere = Mesh->BoundingSphere;
+    const float* Extent = Mesh->PositionScale;
+    float Radius = std::max(Sphere[3], 1e-6f);
+
+    uint32_t GridSize = (uint32_t)ceilf(sqrtf((float)Count));
+    float Spacing = 3.5f * Radius;
+    Scene->FieldSize = Spacing * GridSize;
+    Scene->InstanceRadius = Radius;
+
+    uint32_t RandomState = 0x2545F491u;
+    for(uint32_t InstanceIndex = 0; InstanceIndex < Count; ++InstanceIndex)
+    {
+        SSceneObject Object = {};
+        Object.Scale = 0.5f + SceneRandom(&RandomState);
+        Object.Angle = 6.2831853f * SceneRandom(&RandomState);
+
+        // Standing on the ground
+        float CellX = -0.5f * Scene->FieldSize + Spacing * ((InstanceIndex % GridSize) + 0.5f);
+        float CellZ = -0.5f * Scene->FieldSize + Spacing * ((InstanceIndex / GridSize) + 0.5f);
+        Object.Position[0] = CellX + 0.5f * Radius * (SceneRandom(&RandomState) - 0.5f);
+        Object.Position[1] = Object.Scale * (Extent[1] - Sphere[1]);
+        Object.Position[2] = CellZ + 0.5f * Radius * (SceneRandom(&RandomState) - 0.5f);
+
+        float Cos = cosf(Object.Angle);
+        float Sin = sinf(Object.Angle);
+        float Center[3] =
+        {
+            Object.Position[0] + Object.Scale * (Cos * Sphere[0] + Sin * Sphere[2]),
+            Object.Position[1] + Object.Scale * Sphere[1],
+            Object.Position[2] + Object.Scale * (-Sin * Sphere[0] + Cos * Sphere[2]),
+        };
+        float WorldExtent[3] =
+        {
+            Object.Scale * (fabsf(Cos) * Extent[0] + fabsf(Sin) * Extent[2]),
+            Object.Scale * Extent[1],
+            Object.Scale * (fabsf(Sin) * Extent[0] + fabsf(Cos) * Extent[2]),
+        };
+        SceneAddObject(Scene, &Object, Center, Object.Scale * Radius, WorldExtent);
+    }
+}
+
+// Looks around from the middle of the instance field, a little above the instances, the far plane is at the field's edge
+void SceneSetFieldCamera(SScene* Scene, float Angle, float AspectRatio)
+{
+    float Eye[3] = { 0.0f, 2.0f * Scene->InstanceRadius, 0.0f };
+    float Near = 0.1f * Scene->InstanceRadius;
+    float Far = 0.75f * Scene->FieldSize + Scene->InstanceRadius;
+    SceneSetCamera(Scene, Eye, Angle, 0.2f, AspectRatio, Near, Far);
+}
+
+// Culls every object against the current frustum into VisibleObjects/VisibleCount
+void SceneCull(SScene* Scene, SJobSystem* JobSystem)
+{
+    uint64_t StartTime = PlatformGetTimeNs();
+
+    uint32_t ObjectCount = SceneGetObjectCount(Scene);
+    uint32_t ChunkCount = (ObjectCount + SceneCullChunkSize - 1) / SceneCullChunkSize;
+    Scene->VisibleObjects.resize(ObjectCount);
+    Scene->ChunkVisibleCounts.resize(ChunkCount);
+
+    PFN_SceneCull Cull = SceneCullFunctions[Scene->Kernel];
+    SJobCounter CullCounter;
+    for(uint32_t ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+    {
+        JobSystemAdd(JobSystem, "CullObjects", &CullCounter, [Scene, Cull, ChunkIndex, ObjectCount]
+        {
+            uint32_t First = ChunkIndex * SceneCullChunkSize;
+            uint32_t End = std::min(First + SceneCullChunkSize, ObjectCount);
+            Scene->ChunkVisibleCounts[ChunkIndex] = Cull(Scene, &Scene->Frustum, First, End, Scene->VisibleObjects.data() + First);
+        });
+    }
+    JobSystemWait(JobSystem, &CullCounter);
+
+    // Every chunk wrote its list at its own offset
+    uint32_t VisibleCount = 0;
+    for(uint32_t ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+    {
+        uint32_t ChunkVisibleCount = Scene->ChunkVisibleCounts[ChunkIndex];
+        uint32_t First = ChunkIndex * SceneCullChunkSize;
+        if(First != VisibleCount)
+        {
+            memmove(Scene->VisibleObjects.data() + VisibleCount, Scene->VisibleObjects.data() + First, ChunkVisibleCount * sizeof(uint32_t));
+        }
+        VisibleCount += ChunkVisibleCount;
+    }
+    Scene->VisibleCount = VisibleCount;
+
+    Scene->CullCount++;
+    Scene->TestedObjectCount += ObjectCount;
+    Scene->VisibleObjectCount += VisibleCount;
+    Scene->CullTimeNs += PlatformGetTimeNs() - StartTime;
+}
+
+void ScenePrintStats(const SScene* Scene)
+{
+    if(Scene->CullCount == 0)
+    {
+        return;
+    }
+
+    printf("Culling (%s): %u objects, %.1f%% visible on average, %.3f ms per frame, %.1f M objects/s\n",
+           CullKernelNames[Scene->Kernel], SceneGetObjectCount(Scene),
+           100.0 * (double)Scene->VisibleObjectCount / (double)std::max(Scene->TestedObjectCount, (uint64_t)1),
+           (double)Scene->CullTimeNs / 1000000.0 / (double)Scene->CullCount,
+           (double)Scene->TestedObjectCount / ((double)std::max(Scene->CullTimeNs, (uint64_t)1) / 1000000000.0) / 1000000.0);
+}
+
+// -cullbench: random objects in a cube around a camera in its center. Every supported kernel runs on one core, the
+// best one also runs as jobs on every worker. Each kernel's list is checked against the scalar one.
+bool SceneRunCullBenchmark(SJobSystem* JobSystem, uint32_t ObjectCount)
+{
+    SScene Scene;
+    SceneInit(&Scene);
+
+    constexpr float HalfSize = 100.0f;
+    uint32_t RandomState = 0x9E3779B9u;
+    for(uint32_t ObjectIndex = 0; ObjectIndex < ObjectCount; ++ObjectIndex)
+    {
+        SSceneObject Object = {};
+        Object.Scale = 1.0f;
+        for(uint32_t Component = 0; Component < 3; ++Component)
+        {
+            Object.Position[Component] = HalfSize * (2.0f * SceneRandom(&RandomState) - 1.0f);
+        }
+
+        // The box fits in the sphere
+        float Radius = 0.5f + 1.5f * SceneRandom(&RandomState);
+        float Extent[3];
+        for(uint32_t Component = 0; Component < 3; ++Component)
+        {
+            Extent[Component] = Radius * (0.2f + 0.37f * SceneRandom(&RandomState));
+        }
+        SceneAddObject(&Scene, &Object, Object.Position, Radius, Extent);
+    }
+
+    float Eye[3] = { 0.0f, 0.0f, 0.0f };
+    SceneSetCamera(&Scene, Eye, 0.0f, 0.0f, 16.0f / 9.0f, 0.1f, HalfSize);
+
+    printf("Culling %u objects:\n", ObjectCount);
+
+    std::vector<uint32_t> Reference(ObjectCount);
+    uint32_t ReferenceCount = SceneCullScalar(&Scene, &Scene.Frustum, 0, ObjectCount, Reference.data());
+
+    bool bIsCorrect = true;
+    std::vector<uint32_t> Visible(ObjectCount);
+    for(uint32_t Kernel = 0; Kernel < CullKernel_Count; ++Kernel)
+    {
+        if(!SceneIsKernelSupported((ECullKernel)Kernel))
+        {
+            continue;
+        }
+
+        PFN_SceneCull Cull = SceneCullFunctions[Kernel];
+        uint32_t VisibleCount = Cull(&Scene, &Scene.Frustum, 0, ObjectCount, Visible.data());
+        if(VisibleCount != ReferenceCount || memcmp(Visible.data(), Reference.data(), VisibleCount * sizeof(uint32_t)) != 0)
+        {
+            printf("  %-6s visible list differs from the scalar kernel (%u vs %u objects)\n", CullKernelNames[Kernel], VisibleCount, ReferenceCount);
+            bIsCorrect = false;
+        }
+
+        uint64_t IterationCount = 0;
+        uint64_t StartTime = PlatformGetTimeNs();
+        uint64_t ElapsedNs = 0;
+        do
+        {
+            Cull(&Scene, &Scene.Frustum, 0, ObjectCount, Visible.data());
+            IterationCount++;
+            ElapsedNs = PlatformGetTimeNs() - StartTime;
+        } while(ElapsedNs < SceneBenchmarkDurationNs);
+
+        double ObjectsPerSecond = (double)ObjectCount * (double)IterationCount / ((double)ElapsedNs / 1000000000.0);
+        printf("  %-6s %8.1f M objects/s per core, %.3f ms per cull\n", CullKernelNames[Kernel],
+               ObjectsPerSecond / 1000000.0, (double)ElapsedNs / 1000000.0 / (double)IterationCount);
+    }
+
+    uint32_t WorkerCount = JobSystemGetWorkerCount(JobSystem);
+    if(WorkerCount > 1)
+    {
+        uint64_t StartTime = PlatformGetTimeNs();
+        do
+        {
+            SceneCull(&Scene, JobSystem);
+        } while(PlatformGetTimeNs() - StartTime < SceneBenchmarkDurationNs);
+
+        if(Scene.VisibleCount != ReferenceCount || memcmp(Scene.VisibleObjects.data(), Reference.data(), ReferenceCount * sizeof(uint32_t)) != 0)
+        {
+            printf("  Jobs visible list differs from the scalar kernel (%u vs %u objects)\n", Scene.VisibleCount, ReferenceCount);
+            bIsCorrect = false;
+        }
+
+        double ObjectsPerSecond = (double)Scene.TestedObjectCount / ((double)Scene.CullTimeNs / 1000000000.0);
+        printf("  %s on %u workers: %.1f M objects/s, %.1f M objects/s per core, %.3f ms per cull\n", CullKernelNames[Scene.Kernel], WorkerCount,
+               ObjectsPerSecond / 1000000.0, ObjectsPerSecond / 1000000.0 / WorkerCount, (double)Scene.CullTimeNs / 1000000.0 / (double)Scene.CullCount);
+    }
+
+    printf("  %u of %u objects visible (%.1f%%)\n", ReferenceCount, ObjectCount, 100.0 * ReferenceCount / std::max(ObjectCount, 1u));
+    return bIsCorrect;
+}
@@ -0,0 +1,21 @@
+#version 460 core
+
+layout(set = 0, binding = 0) uniform sampler2D Texture;
+
+layout(push_constant) uniform SMeshConstants
+{
+    mat4 Transform;
+    vec4 LightDirection;
+    vec4 TexCoordTransform;
+};
+
+layout(location = 0) in vec3 Normal;
+layout(location = 1) in vec2 TexCoord;
+
+layout(location = 0) out vec4 OutColor;
+
+void main()
+{
+    float Diffuse = max(dot(normalize(Normal), LightDirection.xyz), 0.0);
+    OutColor = vec4(texture(Texture, TexCoord).rgb * (0.15 + 0.85 * Diffuse), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#version 460 core
+
+// Quantized vertex, see Mesh.cpp
+layout(location = 0) in vec4 Position;
+layout(location = 1) in vec2 OctahedralNormal;
+layout(location = 2) in vec2 QuantizedTexCoord;
+
+layout(push_constant) uniform SMeshConstants
+{
+    // Clip space from quantized position, the dequantization is folded in
+    mat4 Transform;
+    // Object space
+    vec4 LightDirection;
+    // xy: scale, zw: offset
+    vec4 TexCoordTransform;
+};
+
+layout(location = 0) out vec3 Normal;
+layout(location = 1) out vec2 TexCoord;
+
+vec3 DecodeOctahedral(vec2 Encoded)
+{
+    vec3 N = vec3(Encoded, 1.0 - abs(Encoded.x) - abs(Encoded.y));
+    float Fold = max(-N.z, 0.0);
+    N.xy += vec2(N.x >= 0.0 ? -Fold : Fold, N.y >= 0.0 ? -Fold : Fold);
+    return normalize(N);
+}
+
+void main()
+{
+    gl_Position = Transform * vec4(Position.xyz, 1.0);
+    Normal = DecodeOctahedral(OctahedralNormal);
+    TexCoord = QuantizedTexCoord * TexCoordTransform.xy + TexCoordTransform.zw;
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 460 core
+
+layout(location = 0) in vec2 Corner;
+layout(location = 1) in vec3 Color;
+
+layout(location = 0) out vec4 OutColor;
+
+void main()
+{
+    // Round, soft particle, blended additively
+    float Falloff = clamp(1.0 - dot(Corner, Corner), 0.0, 1.0);
+    OutColor = vec4(Color * Falloff, 1.0);
+}
\ No newline at end of file
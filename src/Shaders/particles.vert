@@ -0,0 +1,42 @@
+#version 460 core
+
+struct SParticle
+{
+    vec4 PositionLife;
+    vec4 VelocityMaxLife;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer SParticles
+{
+    SParticle Particles[];
+};
+
+layout(push_constant) uniform SParticleDrawConstants
+{
+    mat4 ViewProjection;
+    // xy: particle radius in clip space (the same number of pixels at every distance), z: brightness
+    vec4 Params;
+};
+
+layout(location = 0) out vec2 Corner;
+layout(location = 1) out vec3 Color;
+
+// Triangle around the unit circle
+const vec2 Corners[3] = vec2[](
+    vec2(0.0, -2.0),
+    vec2(1.7320508, 1.0),
+    vec2(-1.7320508, 1.0)
+);
+
+void main()
+{
+    SParticle Particle = Particles[gl_InstanceIndex];
+    Corner = Corners[gl_VertexIndex];
+
+    vec4 ClipPosition = ViewProjection * vec4(Particle.PositionLife.xyz, 1.0);
+    gl_Position = ClipPosition + vec4(Corner * Params.xy * ClipPosition.w, 0.0, 0.0);
+
+    // Hot when emitted, cooling down with age
+    float Age = clamp(1.0 - Particle.PositionLife.w / max(Particle.VelocityMaxLife.w, 0.001), 0.0, 1.0);
+    Color = Params.z * mix(vec3(1.0, 0.8, 0.4), vec3(0.2, 0.4, 1.0), Age);
+}
\ No newline at end of file
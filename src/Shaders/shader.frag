@@ -1,10 +1,13 @@
 #version 460 core
 
+layout(set = 0, binding = 0) uniform sampler2D Texture;
+
 layout(location = 0) in vec3 Color;
+layout(location = 1) in vec2 TexCoord;
 
 layout(location = 0) out vec4 OutColor;
 
 void main()
 {
-    OutColor = vec4(Color, 1);
+    OutColor = vec4(Color, 1) * texture(Texture, TexCoord);
 }
\ No newline at end of file
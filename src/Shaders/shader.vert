@@ -12,10 +12,19 @@ vec3 Colors[3] = vec3[](
     vec3(0.0f, 0.0f, 1.0f)
 );
 
+// xy: scale, zw: offset in clip space
+layout(push_constant) uniform SDrawConstants
+{
+    vec4 Transform;
+};
+
 layout(location = 0) out vec3 Color;
+layout(location = 1) out vec2 TexCoord;
 
 void main()
 {
-    gl_Position = vec4(Positions[gl_VertexIndex], 0, 1);
+    vec2 Position = Positions[gl_VertexIndex];
+    gl_Position = vec4(Position * Transform.xy + Transform.zw, 0, 1);
     Color = Colors[gl_VertexIndex];
+    TexCoord = Position + vec2(0.5);
 }
\ No newline at end of file
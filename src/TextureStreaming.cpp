@@ -0,0 +1,791 @@
+//
+// Texture streaming.
+//
+// Files are read and decoded by background jobs so that startup never waits for them, draws use a 1x1 white
+// texture until a texture's mip tail is resident. Every texture starts with only its mip tail (the levels no larger
+// than MipTailSize) and is then promoted to the level requested from its screen space size, as long as that fits in
+// the memory budget. Textures that are requested at a coarser level than what's resident are demoted, freeing memory.
+//
+// Changing residency means creating a new image with the new level range, uploading every level of it from the
+// CPU side copy and swapping it in once the transfer timeline says the copies are done. The old image is released to
+// the resource table, which destroys it once the graphics timeline passes the last submission that could have used
+// it, so nothing ever stalls.
+//
+// Uploads go through a few fixed staging chunks, all copies that fit in a chunk are batched into a single submission
+// on the transfer queue (a dedicated one when the device has it). Images use concurrent sharing between the transfer
+// and graphics queue families, which avoids queue family ownership transfers.
+//
+
+#include "KTX2.cpp"
+
+constexpr uint32_t MaxStreamedTextures = 256;
+constexpr uint32_t MaxPendingTextureUploads = 8;
+constexpr uint32_t StagingChunkCount = 3;
+constexpr VkDeviceSize StagingChunkSize = 8 * 1024 * 1024;
+constexpr uint32_t MipTailSize = 64;
+
+// The objects belong to the resource table, uploads and draws use the raw handles
+struct SStreamedImage
+{
+    VkImage Image;
+    VkImageView View;
+    VkDescriptorSet DescriptorSet;
+    SResourceHandle ImageHandle;
+    SResourceHandle MemoryHandle;
+    SResourceHandle ViewHandle;
+    SResourceHandle DescriptorSetHandle;
+    VkDeviceSize Size;
+
+    // Most detailed level of the source texture the image contains, the image has every level from here down
+    uint32_t FirstMip;
+};
+
+struct SStreamedTexture
+{
+    bool bIsLoaded;
+    bool bIsFailed;
+    SKTX2Texture Source;
+
+    uint32_t TailMip;
+    uint32_t RequestedMip;
+
+    // Image.Image is null until the mip tail is uploaded
+    SStreamedImage Resident;
+
+    // Image being uploaded, replaces the resident one once every level has been copied
+    SStreamedImage Pending;
+    uint32_t UploadLevel;
+    uint32_t UploadRow;
+    uint64_t PendingTimelineValue;
+};
+
+struct SStagingChunk
+{
+    VkBuffer Buffer;
+    VkDeviceMemory Memory;
+    uint8_t* Mapped;
+
+    VkCommandPool CommandPool;
+    VkCommandBuffer CommandBuffer;
+
+    // Transfer timeline value of the last submission that read from this chunk
+    uint64_t TimelineValue;
+};
+
+struct STextureStreamer
+{
+    VkDevice Device;
+    VkPhysicalDevice PhysicalDevice;
+    const VkPhysicalDeviceMemoryProperties* MemoryProperties;
+
+    SResourceTable* Resources;
+    SVulkanTimeline* TransferTimeline;
+    uint32_t QueueFamilyIndices[2];
+    uint32_t QueueFamilyCount;
+
+    SStagingChunk StagingChunks[StagingChunkCount];
+    uint32_t NextStagingChunk;
+    bool bIsStagingCoherent;
+
+    // Owned by the resource table
+    VkSampler Sampler;
+    VkDescriptorSetLayout SetLayout;
+    VkDescriptorPool DescriptorPool;
+
+    VkDeviceSize Budget;
+    VkDeviceSize AllocatedSize;
+    uint64_t UploadedBytes;
+
+    // Transfer timeline value the graphics queue has to wait for before sampling the current resident images
+    uint64_t ResidentTimelineValue;
+
+    SStreamedTexture DefaultTexture;
+    std::vector<SStreamedTexture> Textures;
+
+    // One background decode job per file, the mutex protects LoadedTextures, FailedTextures and bQuit
+    std::vector<const char*> Paths;
+    SJobSystem* JobSystem;
+    SJobCounter LoadCounter;
+    std::mutex LoaderMutex;
+    std::deque<std::pair<uint32_t, SKTX2Texture>> LoadedTextures;
+    std::vector<uint32_t> FailedTextures;
+    bool bQuit;
+};
+
+void TextureStreamerLoadTexture(STextureStreamer* Streamer, uint32_t TextureIndex)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Streamer->LoaderMutex);
+        if(Streamer->bQuit)
+        {
+            return;
+        }
+    }
+
+    SKTX2Texture Texture = {};
+    bool bSuccess = KTX2Load(Streamer->Paths[TextureIndex], &Texture);
+
+    std::lock_guard<std::mutex> Lock(Streamer->LoaderMutex);
+    if(Streamer->bQuit)
+    {
+        return;
+    }
+
+    if(bSuccess)
+    {
+        Streamer->LoadedTextures.emplace_back(TextureIndex, std::move(Texture));
+    }
+    else
+    {
+        Streamer->FailedTextures.push_back(TextureIndex);
+    }
+}
+
+static VkDeviceSize TextureStreamerGetImageSize(const SStreamedTexture* Texture, uint32_t FirstMip)
+{
+    VkDeviceSize Size = 0;
+    for(uint32_t Level = FirstMip; Level < Texture->Source.LevelCount; ++Level)
+    {
+        Size += Texture->Source.Levels[Level].size();
+    }
+    return Size;
+}
+
+// The objects are destroyed once the graphics timeline reaches GraphicsTimelineValue, the memory counts as free right away
+static void TextureStreamerReleaseImage(STextureStreamer* Streamer, SStreamedImage* Image, uint64_t GraphicsTimelineValue)
+{
+    // Descriptor set and view before the image they refer to, the table destroys them in this order
+    if(Image->DescriptorSet)
+    {
+        ResourceRelease(Streamer->Resources, Image->DescriptorSetHandle, GraphicsTimelineValue);
+    }
+    if(Image->View)
+    {
+        ResourceRelease(Streamer->Resources, Image->ViewHandle, GraphicsTimelineValue);
+    }
+    ResourceRelease(Streamer->Resources, Image->ImageHandle, GraphicsTimelineValue);
+    ResourceRelease(Streamer->Resources, Image->MemoryHandle, GraphicsTimelineValue);
+    Streamer->AllocatedSize -= Image->Size;
+    *Image = {};
+}
+
+// Creates the pending image for the level range [FirstMip, LevelCount), the upload starts with the next staging chunk
+static void TextureStreamerBeginUpload(STextureStreamer* Streamer, SStreamedTexture* Texture, uint32_t FirstMip)
+{
+    const SKTX2Texture& Source = Texture->Source;
+    SStreamedImage& Image = Texture->Pending;
+    Image = {};
+    Image.FirstMip = FirstMip;
+
+    VkImageCreateInfo ImageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    ImageCreateInfo.pNext = nullptr;
+    ImageCreateInfo.flags = 0;
+    ImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    ImageCreateInfo.format = Source.Format;
+    ImageCreateInfo.extent = { GetMipDimension(Source.Width, FirstMip), GetMipDimension(Source.Height, FirstMip), 1 };
+    ImageCreateInfo.mipLevels = Source.LevelCount - FirstMip;
+    ImageCreateInfo.arrayLayers = 1;
+    ImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    ImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ImageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    ImageCreateInfo.sharingMode = (Streamer->QueueFamilyCount > 1) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    ImageCreateInfo.queueFamilyIndexCount = Streamer->QueueFamilyCount;
+    ImageCreateInfo.pQueueFamilyIndices = Streamer->QueueFamilyIndices;
+    ImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkResult Result = vkCreateImage(Streamer->Device, &ImageCreateInfo, nullptr, &Image.Image);
+    assert(Result == VK_SUCCESS);
+    Image.ImageHandle = ResourceAdd(Streamer->Resources, ResourceType_Image, Image.Image);
+
+    VkMemoryRequirements MemoryRequirements;
+    vkGetImageMemoryRequirements(Streamer->Device, Image.Image, &MemoryRequirements);
+
+    uint32_t MemoryTypeIndex = VulkanFindMemoryType(Streamer->MemoryProperties, MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    assert(MemoryTypeIndex != UINT32_MAX);
+
+    VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    AllocateInfo.pNext = nullptr;
+    AllocateInfo.allocationSize = MemoryRequirements.size;
+    AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+
+    VkDeviceMemory Memory;
+    Result = vkAllocateMemory(Streamer->Device, &AllocateInfo, nullptr, &Memory);
+    assert(Result == VK_SUCCESS);
+    Image.MemoryHandle = ResourceAdd(Streamer->Resources, ResourceType_Memory, Memory);
+    vkBindImageMemory(Streamer->Device, Image.Image, Memory, 0);
+
+    Image.Size = MemoryRequirements.size;
+    Streamer->AllocatedSize += Image.Size;
+
+    Texture->UploadLevel = FirstMip;
+    Texture->UploadRow = 0;
+    Texture->PendingTimelineValue = 0;
+}
+
+// Copies as much of the pending image's data into the staging chunk as fits.
+// Returns true when every level has been recorded.
+static bool TextureStreamerRecordUpload(STextureStreamer* Streamer, SStagingChunk* Chunk, VkDeviceSize* ChunkOffset, SStreamedTexture* Texture)
+{
+    const SKTX2Texture& Source = Texture->Source;
+    SStreamedImage& Image = Texture->Pending;
+    VkCommandBuffer CommandBuffer = Chunk->CommandBuffer;
+
+    VkImageMemoryBarrier Barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    Barrier.pNext = nullptr;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.image = Image.Image;
+    Barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+
+    if(Texture->UploadLevel == Image.FirstMip && Texture->UploadRow == 0)
+    {
+        Barrier.srcAccessMask = 0;
+        Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &Barrier);
+    }
+
+    while(Texture->UploadLevel < Source.LevelCount)
+    {
+        uint32_t Level = Texture->UploadLevel;
+        uint32_t BlockRowSize, BlockRowCount;
+        GetMipBlockRows(&Source, Level, &BlockRowSize, &BlockRowCount);
+
+        // Copies are split along block rows when a level doesn't fit into the rest of the chunk
+        VkDeviceSize Offset = (*ChunkOffset + 15) & ~(VkDeviceSize)15;
+        uint32_t AvailableRows = (Offset < StagingChunkSize) ? (uint32_t)((StagingChunkSize - Offset) / BlockRowSize) : 0;
+        uint32_t RowCount = std::min(AvailableRows, BlockRowCount - Texture->UploadRow);
+        if(RowCount == 0)
+        {
+            assert(BlockRowSize <= StagingChunkSize);
+            return false;
+        }
+
+        VkDeviceSize CopySize = (VkDeviceSize)RowCount * BlockRowSize;
+        memcpy(Chunk->Mapped + Offset, Source.Levels[Level].data() + (size_t)Texture->UploadRow * BlockRowSize, (size_t)CopySize);
+        *ChunkOffset = Offset + CopySize;
+        Streamer->UploadedBytes += CopySize;
+
+        uint32_t MipHeight = GetMipDimension(Source.Height, Level);
+        uint32_t FirstTexelRow = Texture->UploadRow * Source.BlockInfo.BlockHeight;
+
+        VkBufferImageCopy Region = {};
+        Region.bufferOffset = Offset;
+        Region.bufferRowLength = 0;
+        Region.bufferImageHeight = 0;
+        Region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, Level - Image.FirstMip, 0, 1 };
+        Region.imageOffset = { 0, (int32_t)FirstTexelRow, 0 };
+        Region.imageExtent =
+        {
+            GetMipDimension(Source.Width, Level),
+            std::min(RowCount * Source.BlockInfo.BlockHeight, MipHeight - FirstTexelRow),
+            1
+        };
+        vkCmdCopyBufferToImage(CommandBuffer, Chunk->Buffer, Image.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Region);
+
+        Texture->UploadRow += RowCount;
+        if(Texture->UploadRow == BlockRowCount)
+        {
+            Texture->UploadLevel++;
+            Texture->UploadRow = 0;
+        }
+    }
+
+    // The transfer queue might not support any of the shader stages, visibility comes from the timeline wait on the graphics queue
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = 0;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &Barrier);
+    return true;
+}
+
+static void TextureStreamerFinishUpload(STextureStreamer* Streamer, SStreamedTexture* Texture, uint64_t GraphicsTimelineValue)
+{
+    SStreamedImage& Image = Texture->Pending;
+
+    VkImageViewCreateInfo ImageViewCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    ImageViewCreateInfo.pNext = nullptr;
+    ImageViewCreateInfo.flags = 0;
+    ImageViewCreateInfo.image = Image.Image;
+    ImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    ImageViewCreateInfo.format = Texture->Source.Format;
+    ImageViewCreateInfo.components =
+    {
+        VK_COMPONENT_SWIZZLE_IDENTITY,
+        VK_COMPONENT_SWIZZLE_IDENTITY,
+        VK_COMPONENT_SWIZZLE_IDENTITY,
+        VK_COMPONENT_SWIZZLE_IDENTITY
+    };
+    ImageViewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+    vkCreateImageView(Streamer->Device, &ImageViewCreateInfo, nullptr, &Image.View);
+    Image.ViewHandle = ResourceAdd(Streamer->Resources, ResourceType_ImageView, Image.View);
+
+    VkDescriptorSetAllocateInfo SetAllocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    SetAllocateInfo.pNext = nullptr;
+    SetAllocateInfo.descriptorPool = Streamer->DescriptorPool;
+    SetAllocateInfo.descriptorSetCount = 1;
+    SetAllocateInfo.pSetLayouts = &Streamer->SetLayout;
+    VkResult Result = vkAllocateDescriptorSets(Streamer->Device, &SetAllocateInfo, &Image.DescriptorSet);
+    assert(Result == VK_SUCCESS);
+    Image.DescriptorSetHandle = ResourceAdd(Streamer->Resources, ResourceType_DescriptorSet, Image.DescriptorSet, Streamer->DescriptorPool);
+
+    VkDescriptorImageInfo ImageInfo = {};
+    ImageInfo.sampler = Streamer->Sampler;
+    ImageInfo.imageView = Image.View;
+    ImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet Write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    Write.pNext = nullptr;
+    Write.dstSet = Image.DescriptorSet;
+    Write.dstBinding = 0;
+    Write.dstArrayElement = 0;
+    Write.descriptorCount = 1;
+    Write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    Write.pImageInfo = &ImageInfo;
+    vkUpdateDescriptorSets(Streamer->Device, 1, &Write, 0, nullptr);
+
+    // Submissions up to now might still be sampling the old image
+    if(Texture->Resident.Image)
+    {
+        TextureStreamerReleaseImage(Streamer, &Texture->Resident, GraphicsTimelineValue);
+    }
+
+    Streamer->ResidentTimelineValue = std::max(Streamer->ResidentTimelineValue, Texture->PendingTimelineValue);
+    Texture->Resident = Image;
+    Image = {};
+}
+
+// Records and submits as many outstanding uploads as fit into the next staging chunk, doesn't block
+static void TextureStreamerSubmitUploads(STextureStreamer* Streamer)
+{
+    SStagingChunk* Chunk = &Streamer->StagingChunks[Streamer->NextStagingChunk];
+    if(!TimelineIsComplete(Streamer->TransferTimeline, Chunk->TimelineValue))
+    {
+        return;
+    }
+
+    std::vector<SStreamedTexture*> Uploads;
+    if(Streamer->DefaultTexture.Pending.Image && Streamer->DefaultTexture.UploadLevel < Streamer->DefaultTexture.Source.LevelCount)
+    {
+        Uploads.push_back(&Streamer->DefaultTexture);
+    }
+    for(SStreamedTexture& Texture : Streamer->Textures)
+    {
+        if(Texture.Pending.Image && Texture.UploadLevel < Texture.Source.LevelCount)
+        {
+            Uploads.push_back(&Texture);
+        }
+    }
+    if(Uploads.empty())
+    {
+        return;
+    }
+
+    vkResetCommandPool(Streamer->Device, Chunk->CommandPool, 0);
+
+    VkCommandBufferBeginInfo BeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    BeginInfo.pNext = nullptr;
+    BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    BeginInfo.pInheritanceInfo = nullptr;
+    vkBeginCommandBuffer(Chunk->CommandBuffer, &BeginInfo);
+
+    VkDeviceSize ChunkOffset = 0;
+    std::vector<SStreamedTexture*> RecordedUploads;
+    for(SStreamedTexture* Texture : Uploads)
+    {
+        bool bIsComplete = TextureStreamerRecordUpload(Streamer, Chunk, &ChunkOffset, Texture);
+        RecordedUploads.push_back(Texture);
+        if(!bIsComplete)
+        {
+            break;
+        }
+    }
+
+    vkEndCommandBuffer(Chunk->CommandBuffer);
+
+    if(!Streamer->bIsStagingCoherent)
+    {
+        VkMappedMemoryRange Range = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE };
+        Range.pNext = nullptr;
+        Range.memory = Chunk->Memory;
+        Range.offset = 0;
+        Range.size = VK_WHOLE_SIZE;
+        vkFlushMappedMemoryRanges(Streamer->Device, 1, &Range);
+    }
+
+    Chunk->TimelineValue = TimelineSubmit(Streamer->TransferTimeline, 1, &Chunk->CommandBuffer);
+    for(SStreamedTexture* Texture : RecordedUploads)
+    {
+        Texture->PendingTimelineValue = Chunk->TimelineValue;
+    }
+
+    Streamer->NextStagingChunk = (Streamer->NextStagingChunk + 1) % StagingChunkCount;
+}
+
+static bool TextureStreamerIsUploadDone(STextureStreamer* Streamer, SStreamedTexture* Texture)
+{
+    return Texture->Pending.Image &&
+           Texture->UploadLevel == Texture->Source.LevelCount &&
+           TimelineIsComplete(Streamer->TransferTimeline, Texture->PendingTimelineValue);
+}
+
+static void TextureStreamerAddTexture(STextureStreamer* Streamer, SStreamedTexture* Texture, SKTX2Texture&& Source)
+{
+    Texture->Source = std::move(Source);
+    Texture->bIsLoaded = true;
+
+    Texture->TailMip = Texture->Source.LevelCount - 1;
+    for(uint32_t Level = 0; Level < Texture->Source.LevelCount; ++Level)
+    {
+        if(std::max(GetMipDimension(Texture->Source.Width, Level), GetMipDimension(Texture->Source.Height, Level)) <= MipTailSize)
+        {
+            Texture->TailMip = Level;
+            break;
+        }
+    }
+    Texture->RequestedMip = Texture->TailMip;
+
+    // Mip tails are small and always resident, the budget only applies to the higher levels
+    TextureStreamerBeginUpload(Streamer, Texture, Texture->TailMip);
+}
+
+// TransferTimeline can be on the graphics queue itself when the device has no separate transfer queue.
+// Images, descriptor sets and the objects they need are added to Resources.
+bool TextureStreamerInit(STextureStreamer* Streamer, SJobSystem* JobSystem, VkDevice Device, VkPhysicalDevice PhysicalDevice,
+                         const VkPhysicalDeviceMemoryProperties* MemoryProperties, SResourceTable* Resources, SVulkanTimeline* TransferTimeline,
+                         uint32_t TransferQueueFamilyIndex, uint32_t GraphicsQueueFamilyIndex,
+                         VkDeviceSize Budget, const std::vector<const char*>& Paths)
+{
+    Streamer->JobSystem = JobSystem;
+    Streamer->Device = Device;
+    Streamer->PhysicalDevice = PhysicalDevice;
+    Streamer->MemoryProperties = MemoryProperties;
+    Streamer->Resources = Resources;
+    Streamer->TransferTimeline = TransferTimeline;
+    Streamer->Budget = Budget;
+    Streamer->Paths = Paths;
+
+    if(Paths.size() > MaxStreamedTextures)
+    {
+        printf("Too many textures (%u), at most %u are supported\n", (uint32_t)Paths.size(), MaxStreamedTextures);
+        return false;
+    }
+
+    Streamer->QueueFamilyIndices[0] = GraphicsQueueFamilyIndex;
+    Streamer->QueueFamilyIndices[1] = TransferQueueFamilyIndex;
+    Streamer->QueueFamilyCount = (TransferQueueFamilyIndex != GraphicsQueueFamilyIndex) ? 2 : 1;
+
+    // Sampler
+    {
+        VkSamplerCreateInfo SamplerCreateInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+        SamplerCreateInfo.pNext = nullptr;
+        SamplerCreateInfo.flags = 0;
+        SamplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+        SamplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+        SamplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        SamplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        SamplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        SamplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        SamplerCreateInfo.mipLodBias = 0.0f;
+        SamplerCreateInfo.anisotropyEnable = VK_FALSE;
+        SamplerCreateInfo.maxAnisotropy = 1.0f;
+        SamplerCreateInfo.compareEnable = VK_FALSE;
+        SamplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        SamplerCreateInfo.minLod = 0.0f;
+        SamplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+        SamplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        SamplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+        vkCreateSampler(Device, &SamplerCreateInfo, nullptr, &Streamer->Sampler);
+        ResourceAdd(Resources, ResourceType_Sampler, Streamer->Sampler);
+    }
+
+    // Descriptors, one set per texture image (two while an image is being replaced)
+    {
+        VkDescriptorSetLayoutBinding Binding = {};
+        Binding.binding = 0;
+        Binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        Binding.descriptorCount = 1;
+        Binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        Binding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutCreateInfo SetLayoutCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        SetLayoutCreateInfo.pNext = nullptr;
+        SetLayoutCreateInfo.flags = 0;
+        SetLayoutCreateInfo.bindingCount = 1;
+        SetLayoutCreateInfo.pBindings = &Binding;
+        vkCreateDescriptorSetLayout(Device, &SetLayoutCreateInfo, nullptr, &Streamer->SetLayout);
+        ResourceAdd(Resources, ResourceType_DescriptorSetLayout, Streamer->SetLayout);
+
+        constexpr uint32_t MaxSets = 2 * MaxStreamedTextures + 1;
+
+        VkDescriptorPoolSize PoolSize = {};
+        PoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        PoolSize.descriptorCount = MaxSets;
+
+        VkDescriptorPoolCreateInfo PoolCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        PoolCreateInfo.pNext = nullptr;
+        PoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        PoolCreateInfo.maxSets = MaxSets;
+        PoolCreateInfo.poolSizeCount = 1;
+        PoolCreateInfo.pPoolSizes = &PoolSize;
+        vkCreateDescriptorPool(Device, &PoolCreateInfo, nullptr, &Streamer->DescriptorPool);
+        ResourceAdd(Resources, ResourceType_DescriptorPool, Streamer->DescriptorPool);
+    }
+
+    // Staging chunks
+    for(SStagingChunk& Chunk : Streamer->StagingChunks)
+    {
+        VkBufferCreateInfo BufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        BufferCreateInfo.pNext = nullptr;
+        BufferCreateInfo.flags = 0;
+        BufferCreateInfo.size = StagingChunkSize;
+        BufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        BufferCreateInfo.queueFamilyIndexCount = 0;
+        BufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+        VkResult Result = vkCreateBuffer(Device, &BufferCreateInfo, nullptr, &Chunk.Buffer);
+        assert(Result == VK_SUCCESS);
+
+        VkMemoryRequirements MemoryRequirements;
+        vkGetBufferMemoryRequirements(Device, Chunk.Buffer, &MemoryRequirements);
+
+        // Write combined memory is fine, the CPU only ever writes it sequentially
+        uint32_t MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        if(MemoryTypeIndex == UINT32_MAX)
+        {
+            MemoryTypeIndex = VulkanFindMemoryType(MemoryProperties, MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        }
+        assert(MemoryTypeIndex != UINT32_MAX);
+        Streamer->bIsStagingCoherent = (MemoryProperties->memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+        VkMemoryAllocateInfo AllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        AllocateInfo.pNext = nullptr;
+        AllocateInfo.allocationSize = MemoryRequirements.size;
+        AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+
+        Result = vkAllocateMemory(Device, &AllocateInfo, nullptr, &Chunk.Memory);
+        assert(Result == VK_SUCCESS);
+        vkBindBufferMemory(Device, Chunk.Buffer, Chunk.Memory, 0);
+        vkMapMemory(Device, Chunk.Memory, 0, VK_WHOLE_SIZE, 0, (void**)&Chunk.Mapped);
+
+        VkCommandPoolCreateInfo CommandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        CommandPoolCreateInfo.pNext = nullptr;
+        CommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        CommandPoolCreateInfo.queueFamilyIndex = TransferQueueFamilyIndex;
+        vkCreateCommandPool(Device, &CommandPoolCreateInfo, nullptr, &Chunk.CommandPool);
+
+        VkCommandBufferAllocateInfo CommandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        CommandBufferInfo.pNext = nullptr;
+        CommandBufferInfo.commandPool = Chunk.CommandPool;
+        CommandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        CommandBufferInfo.commandBufferCount = 1;
+        vkAllocateCommandBuffers(Device, &CommandBufferInfo, &Chunk.CommandBuffer);
+
+        Chunk.TimelineValue = 0;
+    }
+
+    // The default texture is the only thing uploaded synchronously, everything has to have something to sample
+    {
+        SKTX2Texture White = {};
+        White.Format = VK_FORMAT_R8G8B8A8_UNORM;
+        White.Width = 1;
+        White.Height = 1;
+        White.LevelCount = 1;
+        GetFormatBlockInfo(White.Format, &White.BlockInfo);
+        White.Levels.push_back({ 0xFF, 0xFF, 0xFF, 0xFF });
+
+        TextureStreamerAddTexture(Streamer, &Streamer->DefaultTexture, std::move(White));
+        TextureStreamerSubmitUploads(Streamer);
+        TimelineWait(Streamer->TransferTimeline, Streamer->DefaultTexture.PendingTimelineValue);
+        TextureStreamerFinishUpload(Streamer, &Streamer->DefaultTexture, 0);
+    }
+
+    // Textures finish decoding in whatever order the workers get to them
+    Streamer->Textures.resize(Paths.size());
+    for(uint32_t TextureIndex = 0; TextureIndex < Paths.size(); ++TextureIndex)
+    {
+        JobSystemAddBackground(JobSystem, "DecodeTexture", &Streamer->LoadCounter, [Streamer, TextureIndex]
+        {
+            TextureStreamerLoadTexture(Streamer, TextureIndex);
+        });
+    }
+    return true;
+}
+
+// ScreenSize is the size in pixels the texture covers on screen along its larger dimension
+void TextureStreamerRequest(STextureStreamer* Streamer, uint32_t TextureIndex, float ScreenSize)
+{
+    SStreamedTexture& Texture = Streamer->Textures[TextureIndex];
+    if(!Texture.bIsLoaded)
+    {
+        return;
+    }
+
+    float TextureSize = (float)std::max(Texture.Source.Width, Texture.Source.Height);
+    float Mip = (ScreenSize > 0.0f) ? floorf(log2f(TextureSize / ScreenSize)) : (float)Texture.TailMip;
+    Texture.RequestedMip = (uint32_t)Clamp(Mip, 0.0f, (float)Texture.TailMip);
+}
+
+VkDescriptorSet TextureStreamerGetDescriptorSet(const STextureStreamer* Streamer, uint32_t TextureIndex)
+{
+    const SStreamedTexture& Texture = Streamer->Textures[TextureIndex];
+    return Texture.Resident.DescriptorSet ? Texture.Resident.DescriptorSet : Streamer->DefaultTexture.Resident.DescriptorSet;
+}
+
+// Called once per frame, replaced images are released at the graphics timeline's last submitted value
+void TextureStreamerUpdate(STextureStreamer* Streamer, SVulkanTimeline* GraphicsTimeline)
+{
+    // Pick up what the decode jobs have finished
+    {
+        std::lock_guard<std::mutex> Lock(Streamer->LoaderMutex);
+        while(!Streamer->LoadedTextures.empty())
+        {
+            uint32_t TextureIndex = Streamer->LoadedTextures.front().first;
+            SKTX2Texture& Source = Streamer->LoadedTextures.front().second;
+            SStreamedTexture& Texture = Streamer->Textures[TextureIndex];
+
+            VkFormatProperties FormatProperties;
+            vkGetPhysicalDeviceFormatProperties(Streamer->PhysicalDevice, Source.Format, &FormatProperties);
+            if(FormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+            {
+                TextureStreamerAddTexture(Streamer, &Texture, std::move(Source));
+            }
+            else
+            {
+                printf("Texture %s: format %u isn't supported by the device\n", Streamer->Paths[TextureIndex], (uint32_t)Source.Format);
+                Texture.bIsFailed = true;
+            }
+            Streamer->LoadedTextures.pop_front();
+        }
+
+        for(uint32_t TextureIndex : Streamer->FailedTextures)
+        {
+            Streamer->Textures[TextureIndex].bIsFailed = true;
+        }
+        Streamer->FailedTextures.clear();
+    }
+
+    // Swap in finished images
+    uint32_t PendingCount = 0;
+    for(SStreamedTexture& Texture : Streamer->Textures)
+    {
+        if(TextureStreamerIsUploadDone(Streamer, &Texture))
+        {
+            TextureStreamerFinishUpload(Streamer, &Texture, GraphicsTimeline->LastSubmittedValue);
+        }
+        else if(Texture.Pending.Image)
+        {
+            PendingCount++;
+        }
+    }
+
+    // Start residency changes: demotions first since they free memory, then promotions with the largest deficit first
+    std::vector<SStreamedTexture*> Promotions;
+    for(SStreamedTexture& Texture : Streamer->Textures)
+    {
+        if(!Texture.Resident.Image || Texture.Pending.Image || Texture.RequestedMip == Texture.Resident.FirstMip)
+        {
+            continue;
+        }
+
+        if(Texture.RequestedMip > Texture.Resident.FirstMip)
+        {
+            if(PendingCount < MaxPendingTextureUploads)
+            {
+                TextureStreamerBeginUpload(Streamer, &Texture, Texture.RequestedMip);
+                PendingCount++;
+            }
+        }
+        else
+        {
+            Promotions.push_back(&Texture);
+        }
+    }
+
+    std::sort(Promotions.begin(), Promotions.end(), [](const SStreamedTexture* A, const SStreamedTexture* B)
+    {
+        return (A->Resident.FirstMip - A->RequestedMip) > (B->Resident.FirstMip - B->RequestedMip);
+    });
+
+    for(SStreamedTexture* Texture : Promotions)
+    {
+        if(PendingCount >= MaxPendingTextureUploads)
+        {
+            break;
+        }
+
+        // Step down one level at a time until it fits, partial promotions are better than none
+        for(uint32_t FirstMip = Texture->RequestedMip; FirstMip < Texture->Resident.FirstMip; ++FirstMip)
+        {
+            if(Streamer->AllocatedSize + TextureStreamerGetImageSize(Texture, FirstMip) <= Streamer->Budget)
+            {
+                TextureStreamerBeginUpload(Streamer, Texture, FirstMip);
+                PendingCount++;
+                break;
+            }
+        }
+    }
+
+    TextureStreamerSubmitUploads(Streamer);
+}
+
+// True while textures are still loading or changing residency
+bool TextureStreamerIsBusy(const STextureStreamer* Streamer)
+{
+    for(const SStreamedTexture& Texture : Streamer->Textures)
+    {
+        if((!Texture.bIsLoaded && !Texture.bIsFailed) || Texture.Pending.Image ||
+           (Texture.Resident.Image && Texture.RequestedMip != Texture.Resident.FirstMip))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Transfer timeline value the graphics queue has to wait for before sampling the currently resident textures
+uint64_t TextureStreamerGetWaitValue(const STextureStreamer* Streamer)
+{
+    return Streamer->ResidentTimelineValue;
+}
+
+void TextureStreamerPrintStats(const STextureStreamer* Streamer)
+{
+    uint32_t ResidentCount = 0;
+    uint32_t FailedCount = 0;
+    for(const SStreamedTexture& Texture : Streamer->Textures)
+    {
+        ResidentCount += Texture.Resident.Image ? 1 : 0;
+        FailedCount += Texture.bIsFailed ? 1 : 0;
+    }
+
+    printf("Textures: %u/%u resident (%u failed), %.1f/%.1f MiB allocated, %.1f MiB uploaded\n",
+           ResidentCount, (uint32_t)Streamer->Textures.size(), FailedCount,
+           (double)Streamer->AllocatedSize / (1024.0 * 1024.0), (double)Streamer->Budget / (1024.0 * 1024.0),
+           (double)Streamer->UploadedBytes / (1024.0 * 1024.0));
+}
+
+// The graphics queue has to be idle. Images and descriptor objects are left to the resource table's teardown.
+void TextureStreamerShutdown(STextureStreamer* Streamer)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Streamer->LoaderMutex);
+        Streamer->bQuit = true;
+    }
+    JobSystemWait(Streamer->JobSystem, &Streamer->LoadCounter);
+
+    TimelineWait(Streamer->TransferTimeline, Streamer->TransferTimeline->LastSubmittedValue);
+
+    for(SStagingChunk& Chunk : Streamer->StagingChunks)
+    {
+        vkDestroyCommandPool(Streamer->Device, Chunk.CommandPool, nullptr);
+        vkDestroyBuffer(Streamer->Device, Chunk.Buffer, nullptr);
+        vkFreeMemory(Streamer->Device, Chunk.Memory, nullptr);
+    }
+}
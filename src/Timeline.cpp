@@ -0,0 +1,182 @@
+//
+// Timeline semaphore based synchronization.
+//
+// Every queue gets its own timeline semaphore and every submission to that queue signals the next value,
+// so any piece of GPU work (and every resource it touches) is identified by a (timeline, value) pair.
+// Reusing or destroying a resource only requires checking that the timeline has reached the value of the last
+// submission that used it, no fences needed. Binary semaphores are only used where the WSI requires them.
+//
+
+struct SVulkanTimeline
+{
+    VkDevice Device;
+    VkQueue Queue;
+    VkSemaphore Semaphore;
+
+    uint64_t LastSubmittedValue;
+    // Cached, only refreshed when a query can't be answered from it
+    uint64_t LastCompletedValue;
+
+    PFN_vkWaitSemaphores WaitSemaphores;
+    PFN_vkGetSemaphoreCounterValue GetSemaphoreCounterValue;
+};
+
+constexpr uint32_t MaxSubmitWaitCount = 8;
+constexpr uint32_t MaxSubmitSignalCount = 4;
+
+// Semaphores to wait on/signal (in addition to the submitting queue's timeline) for a single submission
+struct SVulkanSubmitSync
+{
+    uint32_t WaitCount;
+    VkSemaphore WaitSemaphores[MaxSubmitWaitCount];
+    uint64_t WaitValues[MaxSubmitWaitCount];
+    VkPipelineStageFlags WaitStages[MaxSubmitWaitCount];
+
+    uint32_t SignalCount;
+    VkSemaphore SignalSemaphores[MaxSubmitSignalCount];
+};
+
+// The function pointers can either be the core 1.2 or the KHR ones
+void TimelineInit(SVulkanTimeline* Timeline, VkDevice Device, VkQueue Queue,
+                  PFN_vkWaitSemaphores WaitSemaphores, PFN_vkGetSemaphoreCounterValue GetSemaphoreCounterValue)
+{
+    *Timeline = {};
+    Timeline->Device = Device;
+    Timeline->Queue = Queue;
+    Timeline->WaitSemaphores = WaitSemaphores;
+    Timeline->GetSemaphoreCounterValue = GetSemaphoreCounterValue;
+
+    VkSemaphoreTypeCreateInfo SemaphoreTypeCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    SemaphoreTypeCreateInfo.pNext = nullptr;
+    SemaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    SemaphoreTypeCreateInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo SemaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    SemaphoreCreateInfo.pNext = &SemaphoreTypeCreateInfo;
+    SemaphoreCreateInfo.flags = 0;
+
+    VkResult Result = vkCreateSemaphore(Device, &SemaphoreCreateInfo, nullptr, &Timeline->Semaphore);
+    assert(Result == VK_SUCCESS);
+}
+
+void TimelineDestroy(SVulkanTimeline* Timeline)
+{
+    vkDestroySemaphore(Timeline->Device, Timeline->Semaphore, nullptr);
+    Timeline->Semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t TimelineGetCompletedValue(SVulkanTimeline* Timeline)
+{
+    uint64_t Value = 0;
+    Timeline->GetSemaphoreCounterValue(Timeline->Device, Timeline->Semaphore, &Value);
+    Timeline->LastCompletedValue = std::max(Timeline->LastCompletedValue, Value);
+    return Timeline->LastCompletedValue;
+}
+
+bool TimelineIsComplete(SVulkanTimeline* Timeline, uint64_t Value)
+{
+    if(Value <= Timeline->LastCompletedValue)
+    {
+        return true;
+    }
+    return Value <= TimelineGetCompletedValue(Timeline);
+}
+
+VkResult TimelineWait(SVulkanTimeline* Timeline, uint64_t Value, uint64_t TimeoutNs = UINT64_MAX)
+{
+    if(Value <= Timeline->LastCompletedValue)
+    {
+        return VK_SUCCESS;
+    }
+
+    VkSemaphoreWaitInfo WaitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+    WaitInfo.pNext = nullptr;
+    WaitInfo.flags = 0;
+    WaitInfo.semaphoreCount = 1;
+    WaitInfo.pSemaphores = &Timeline->Semaphore;
+    WaitInfo.pValues = &Value;
+
+    VkResult Result = Timeline->WaitSemaphores(Timeline->Device, &WaitInfo, TimeoutNs);
+    if(Result == VK_SUCCESS)
+    {
+        Timeline->LastCompletedValue = std::max(Timeline->LastCompletedValue, Value);
+    }
+    return Result;
+}
+
+void SubmitWaitBinary(SVulkanSubmitSync* Sync, VkSemaphore Semaphore, VkPipelineStageFlags StageMask)
+{
+    assert(Sync->WaitCount < MaxSubmitWaitCount);
+    Sync->WaitSemaphores[Sync->WaitCount] = Semaphore;
+    Sync->WaitValues[Sync->WaitCount] = 0;
+    Sync->WaitStages[Sync->WaitCount] = StageMask;
+    Sync->WaitCount++;
+}
+
+// Cross-queue dependency: don't start StageMask until Timeline has reached Value
+void SubmitWaitTimeline(SVulkanSubmitSync* Sync, const SVulkanTimeline* Timeline, uint64_t Value, VkPipelineStageFlags StageMask)
+{
+    if(Value == 0)
+    {
+        return;
+    }
+
+    assert(Sync->WaitCount < MaxSubmitWaitCount);
+    Sync->WaitSemaphores[Sync->WaitCount] = Timeline->Semaphore;
+    Sync->WaitValues[Sync->WaitCount] = Value;
+    Sync->WaitStages[Sync->WaitCount] = StageMask;
+    Sync->WaitCount++;
+}
+
+void SubmitSignalBinary(SVulkanSubmitSync* Sync, VkSemaphore Semaphore)
+{
+    assert(Sync->SignalCount < MaxSubmitSignalCount);
+    Sync->SignalSemaphores[Sync->SignalCount++] = Semaphore;
+}
+
+// Returns the timeline value that will be signaled when the submitted work completes
+uint64_t TimelineSubmit(SVulkanTimeline* Timeline, uint32_t CommandBufferCount, const VkCommandBuffer* CommandBuffers,
+                        const SVulkanSubmitSync* Sync = nullptr)
+{
+    uint64_t SignalValue = Timeline->LastSubmittedValue + 1;
+
+    VkSemaphore SignalSemaphores[MaxSubmitSignalCount + 1] = { Timeline->Semaphore };
+    uint64_t SignalValues[MaxSubmitSignalCount + 1] = { SignalValue };
+    uint32_t SignalCount = 1;
+
+    SVulkanSubmitSync EmptySync = {};
+    if(!Sync)
+    {
+        Sync = &EmptySync;
+    }
+
+    for(uint32_t SignalIndex = 0; SignalIndex < Sync->SignalCount; ++SignalIndex)
+    {
+        SignalSemaphores[SignalCount] = Sync->SignalSemaphores[SignalIndex];
+        SignalValues[SignalCount] = 0;
+        SignalCount++;
+    }
+
+    VkTimelineSemaphoreSubmitInfo TimelineSubmitInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    TimelineSubmitInfo.pNext = nullptr;
+    TimelineSubmitInfo.waitSemaphoreValueCount = Sync->WaitCount;
+    TimelineSubmitInfo.pWaitSemaphoreValues = Sync->WaitValues;
+    TimelineSubmitInfo.signalSemaphoreValueCount = SignalCount;
+    TimelineSubmitInfo.pSignalSemaphoreValues = SignalValues;
+
+    VkSubmitInfo SubmitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    SubmitInfo.pNext = &TimelineSubmitInfo;
+    SubmitInfo.waitSemaphoreCount = Sync->WaitCount;
+    SubmitInfo.pWaitSemaphores = Sync->WaitSemaphores;
+    SubmitInfo.pWaitDstStageMask = Sync->WaitStages;
+    SubmitInfo.commandBufferCount = CommandBufferCount;
+    SubmitInfo.pCommandBuffers = CommandBuffers;
+    SubmitInfo.signalSemaphoreCount = SignalCount;
+    SubmitInfo.pSignalSemaphores = SignalSemaphores;
+
+    VkResult Result = vkQueueSubmit(Timeline->Queue, 1, &SubmitInfo, VK_NULL_HANDLE);
+    assert(Result == VK_SUCCESS);
+
+    Timeline->LastSubmittedValue = SignalValue;
+    return SignalValue;
+}
@@ -0,0 +1,289 @@
+#include <xcb/xcb.h>
+#include <vulkan/vulkan_xcb.h>
+
+#include <poll.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct SPlatformWindowData
+{
+    xcb_connection_t* Connection;
+    xcb_window_t Window;
+
+    xcb_atom_t WMProtocolsAtom;
+    xcb_atom_t WMDeleteWindowAtom;
+
+    bool bIsMapped;
+    bool bIsObscured;
+};
+
+static SPlatformWindow linuxWindow;
+static SPlatformWindowData linuxWindowData;
+
+SBuffer linuxLoadFile(const char* Path)
+{
+    SBuffer Buffer = {};
+
+    FILE* File = fopen(Path, "rb");
+    if(File)
+    {
+        fseek(File, 0, SEEK_END);
+        Buffer.Size = (uint32_t)ftell(File);
+        fseek(File, 0, SEEK_SET);
+        Buffer.Data = new uint8_t[Buffer.Size];
+
+        size_t BytesRead = fread(Buffer.Data, 1, Buffer.Size, File);
+
+        assert(BytesRead == Buffer.Size);
+        fclose(File);
+    }
+    else
+    {
+        assert(!"Invalid file");
+    }
+    return Buffer;
+}
+
+xcb_atom_t linuxGetAtom(xcb_connection_t* Connection, const char* Name)
+{
+    xcb_intern_atom_cookie_t Cookie = xcb_intern_atom(Connection, 0, (uint16_t)strlen(Name), Name);
+    xcb_intern_atom_reply_t* Reply = xcb_intern_atom_reply(Connection, Cookie, nullptr);
+    assert(Reply);
+
+    xcb_atom_t Atom = Reply->atom;
+    free(Reply);
+    return Atom;
+}
+
+xcb_window_t linuxOpenWindow(SPlatformWindowData* Data, const char* Title, int32_t Width, int32_t Height)
+{
+    static uint32_t _CallCount = 0;
+    assert(_CallCount++ == 0);
+
+    Data->Connection = xcb_connect(nullptr, nullptr);
+    assert(!xcb_connection_has_error(Data->Connection));
+
+    const xcb_setup_t* Setup = xcb_get_setup(Data->Connection);
+    xcb_screen_t* Screen = xcb_setup_roots_iterator(Setup).data;
+
+    xcb_window_t Window = xcb_generate_id(Data->Connection);
+
+    uint32_t ValueMask = XCB_CW_EVENT_MASK;
+    uint32_t ValueList[] =
+    {
+        XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_VISIBILITY_CHANGE,
+    };
+
+    // The position is only a hint, most window managers place the window themselves
+    xcb_create_window(Data->Connection, XCB_COPY_FROM_PARENT, Window, Screen->root,
+                      (int16_t)((Screen->width_in_pixels - Width) / 2),
+                      (int16_t)((Screen->height_in_pixels - Height) / 2),
+                      (uint16_t)Width, (uint16_t)Height, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, Screen->root_visual,
+                      ValueMask, ValueList);
+
+    xcb_change_property(Data->Connection, XCB_PROP_MODE_REPLACE, Window,
+                        XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, (uint32_t)strlen(Title), Title);
+
+    // Get notified instead of killed when the window is closed
+    Data->WMProtocolsAtom = linuxGetAtom(Data->Connection, "WM_PROTOCOLS");
+    Data->WMDeleteWindowAtom = linuxGetAtom(Data->Connection, "WM_DELETE_WINDOW");
+    xcb_change_property(Data->Connection, XCB_PROP_MODE_REPLACE, Window,
+                        Data->WMProtocolsAtom, XCB_ATOM_ATOM, 32, 1, &Data->WMDeleteWindowAtom);
+
+    // Fixed size window, same as the win32 one (WM_SIZE_HINTS with PMinSize|PMaxSize)
+    {
+        uint32_t SizeHints[18] = {};
+        SizeHints[0] = (1 << 4) | (1 << 5);
+        SizeHints[5] = (uint32_t)Width;
+        SizeHints[6] = (uint32_t)Height;
+        SizeHints[7] = (uint32_t)Width;
+        SizeHints[8] = (uint32_t)Height;
+        xcb_change_property(Data->Connection, XCB_PROP_MODE_REPLACE, Window,
+                            XCB_ATOM_WM_NORMAL_HINTS, XCB_ATOM_WM_SIZE_HINTS, 32, ArrayCount(SizeHints), SizeHints);
+    }
+
+    xcb_map_window(Data->Connection, Window);
+    xcb_flush(Data->Connection);
+
+    return Window;
+}
+
+void linuxProcessEvent(SPlatformWindow* Window, xcb_generic_event_t* Event)
+{
+    SPlatformWindowData* Data = Window->Data;
+
+    switch(Event->response_type & 0x7F)
+    {
+        case XCB_EXPOSE:
+        {
+            xcb_expose_event_t* Expose = (xcb_expose_event_t*)Event;
+            if(Expose->count == 0)
+            {
+                Window->bNeedsRedraw = true;
+            }
+        } break;
+        case XCB_MAP_NOTIFY:
+        {
+            Data->bIsMapped = true;
+            Window->bNeedsRedraw = true;
+        } break;
+        case XCB_UNMAP_NOTIFY:
+        {
+            Data->bIsMapped = false;
+        } break;
+        case XCB_VISIBILITY_NOTIFY:
+        {
+            xcb_visibility_notify_event_t* Visibility = (xcb_visibility_notify_event_t*)Event;
+            Data->bIsObscured = (Visibility->state == XCB_VISIBILITY_FULLY_OBSCURED);
+            if(!Data->bIsObscured)
+            {
+                Window->bNeedsRedraw = true;
+            }
+        } break;
+        case XCB_CONFIGURE_NOTIFY:
+        {
+            xcb_configure_notify_event_t* Configure = (xcb_configure_notify_event_t*)Event;
+            if(Configure->width != Window->Width || Configure->height != Window->Height)
+            {
+                Window->Width = Configure->width;
+                Window->Height = Configure->height;
+                Window->bNeedsRedraw = true;
+            }
+        } break;
+        case XCB_CLIENT_MESSAGE:
+        {
+            xcb_client_message_event_t* Message = (xcb_client_message_event_t*)Event;
+            if(Message->type == Data->WMProtocolsAtom && Message->data.data32[0] == Data->WMDeleteWindowAtom)
+            {
+                Window->bCloseRequested = true;
+            }
+        } break;
+        default:
+            break;
+    }
+
+    Window->bIsVisible = Data->bIsMapped && !Data->bIsObscured;
+}
+
+SBuffer PlatformLoadFile(const char* Path)
+{
+    return linuxLoadFile(Path);
+}
+
+SMappedFile PlatformMapFile(const char* Path)
+{
+    SMappedFile Result = {};
+
+    int File = open(Path, O_RDONLY);
+    if(File < 0)
+    {
+        return Result;
+    }
+
+    struct stat FileStat;
+    if(fstat(File, &FileStat) == 0 && FileStat.st_size > 0)
+    {
+        // The mapping stays valid after the descriptor is closed
+        void* Data = mmap(nullptr, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+        if(Data != MAP_FAILED)
+        {
+            Result.Size = (size_t)FileStat.st_size;
+            Result.Data = (const uint8_t*)Data;
+        }
+    }
+    close(File);
+    return Result;
+}
+
+void PlatformUnmapFile(SMappedFile* File)
+{
+    if(File->Data)
+    {
+        munmap((void*)File->Data, File->Size);
+    }
+    *File = {};
+}
+
+uint64_t PlatformGetTimeNs()
+{
+    timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (uint64_t)Time.tv_sec * 1000000000ull + (uint64_t)Time.tv_nsec;
+}
+
+SPlatformWindow* PlatformOpenWindow(const char* Title, uint32_t Width, uint32_t Height)
+{
+    linuxWindow.Width = Width;
+    linuxWindow.Height = Height;
+    linuxWindow.bIsVisible = false;
+    linuxWindow.bNeedsRedraw = true;
+    linuxWindow.bCloseRequested = false;
+    linuxWindow.Data = &linuxWindowData;
+
+    linuxWindowData.Window = linuxOpenWindow(&linuxWindowData, Title, Width, Height);
+
+    return &linuxWindow;
+}
+
+void PlatformCloseWindow(SPlatformWindow* Window)
+{
+    SPlatformWindowData* Data = Window->Data;
+    xcb_destroy_window(Data->Connection, Data->Window);
+    xcb_disconnect(Data->Connection);
+
+    *Data = {};
+    *Window = {};
+}
+
+const char* PlatformGetSurfaceExtensionName()
+{
+    return VK_KHR_XCB_SURFACE_EXTENSION_NAME;
+}
+
+VkResult PlatformCreateSurface(VkInstance Instance, SPlatformWindow* Window, VkSurfaceKHR* Surface)
+{
+    VkXcbSurfaceCreateInfoKHR SurfaceCreateInfo = { VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR };
+    SurfaceCreateInfo.pNext = nullptr;
+    SurfaceCreateInfo.flags = 0;
+    SurfaceCreateInfo.connection = Window->Data->Connection;
+    SurfaceCreateInfo.window = Window->Data->Window;
+
+    return vkCreateXcbSurfaceKHR(Instance, &SurfaceCreateInfo, nullptr, Surface);
+}
+
+void PlatformWaitForEvents(SPlatformWindow* Window, uint64_t TimeoutNs)
+{
+    xcb_connection_t* Connection = Window->Data->Connection;
+    xcb_flush(Connection);
+
+    xcb_generic_event_t* Event = xcb_poll_for_event(Connection);
+    if(!Event && TimeoutNs != 0)
+    {
+        pollfd PollFd = {};
+        PollFd.fd = xcb_get_file_descriptor(Connection);
+        PollFd.events = POLLIN;
+
+        timespec Timeout;
+        Timeout.tv_sec = (time_t)(TimeoutNs / 1000000000ull);
+        Timeout.tv_nsec = (long)(TimeoutNs % 1000000000ull);
+
+        ppoll(&PollFd, 1, TimeoutNs == UINT64_MAX ? nullptr : &Timeout, nullptr);
+        Event = xcb_poll_for_event(Connection);
+    }
+
+    while(Event)
+    {
+        linuxProcessEvent(Window, Event);
+        free(Event);
+        Event = xcb_poll_for_event(Connection);
+    }
+
+    if(xcb_connection_has_error(Connection))
+    {
+        Window->bCloseRequested = true;
+    }
+}
@@ -0,0 +1,264 @@
+#include <Windows.h>
+#include <vulkan/vulkan_win32.h>
+
+#undef min
+#undef max
+
+struct SPlatformWindowData
+{
+    HINSTANCE Instance;
+    HWND Window;
+};
+
+static SPlatformWindow win32Window;
+static SPlatformWindowData win32WindowData;
+
+SBuffer win32LoadFile(const char* Path)
+{
+    SBuffer Buffer = {};
+
+    HANDLE File = CreateFile(Path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if(File && File != INVALID_HANDLE_VALUE)
+    {
+        Buffer.Size = GetFileSize(File, nullptr);
+        Buffer.Data = new uint8_t[Buffer.Size];
+
+        DWORD BytesRead;
+        ReadFile(File, Buffer.Data, Buffer.Size, &BytesRead, nullptr);
+
+        assert(BytesRead == Buffer.Size);
+        CloseHandle(File);
+    }
+    else
+    {
+        assert(!"Invalid file");
+    }
+    return Buffer;
+}
+
+LRESULT CALLBACK win32MainWindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam)
+{
+    LRESULT Result = 0;
+
+    switch(Message)
+    {
+        case WM_CLOSE:
+            PostQuitMessage(0);
+            break;
+        case WM_PAINT:
+            // Validate instead of BeginPaint/EndPaint, Vulkan owns the client area
+            ValidateRect(Window, nullptr);
+            win32Window.bNeedsRedraw = true;
+            break;
+        case WM_WINDOWPOSCHANGED:
+        {
+            // Sent for minimizing, restoring, showing and hiding alike. Being covered by other windows isn't reported
+            // by the compositor, so an occluded window still counts as visible here.
+            bool bIsVisible = IsWindowVisible(Window) && !IsIconic(Window);
+            if(bIsVisible && !win32Window.bIsVisible)
+            {
+                win32Window.bNeedsRedraw = true;
+            }
+            win32Window.bIsVisible = bIsVisible;
+
+            // Generates WM_SIZE and WM_MOVE
+            Result = DefWindowProc(Window, Message, WParam, LParam);
+        } break;
+        case WM_SIZE:
+            if(WParam != SIZE_MINIMIZED)
+            {
+                win32Window.bNeedsRedraw = true;
+                win32Window.Width = LOWORD(LParam);
+                win32Window.Height = HIWORD(LParam);
+            }
+            break;
+        default:
+            Result = DefWindowProc(Window, Message, WParam, LParam);
+            break;
+    }
+
+    return Result;
+}
+
+HWND win32OpenWindow(const char* Title, int32_t Width, int32_t Height)
+{
+    static uint32_t _CallCount = 0;
+    assert(_CallCount++ == 0);
+
+    WNDCLASS WindowClass = {};
+    WindowClass.style = CS_OWNDC;
+    WindowClass.lpfnWndProc = &win32MainWindowProc;
+    WindowClass.hInstance = nullptr;
+    WindowClass.lpszClassName = "vkclass";
+
+    assert(RegisterClass(&WindowClass));
+
+    int32_t MonitorWidth, MonitorHeight;
+    {
+        POINT P = { 0, 0 };
+        HMONITOR Monitor = MonitorFromPoint(P, MONITOR_DEFAULTTOPRIMARY);
+
+        MONITORINFO MonitorInfo = { sizeof(MONITORINFO) };
+        GetMonitorInfo(Monitor, &MonitorInfo);
+
+        MonitorWidth = MonitorInfo.rcMonitor.right - MonitorInfo.rcMonitor.left;
+        MonitorHeight = MonitorInfo.rcMonitor.bottom - MonitorInfo.rcMonitor.top;
+    }
+
+    RECT WindowRect = {};
+    WindowRect.left = (MonitorWidth - Width) / 2;
+    WindowRect.right = WindowRect.left + Width;
+    WindowRect.top = (MonitorHeight - Height) / 2;
+    WindowRect.bottom = WindowRect.top + Height;
+
+    DWORD WindowStyle = WS_OVERLAPPEDWINDOW & (~WS_MAXIMIZEBOX) & (~WS_THICKFRAME);
+    AdjustWindowRect(&WindowRect, WindowStyle, FALSE);
+
+    HWND Window = CreateWindow(WindowClass.lpszClassName, Title, WindowStyle,
+                               WindowRect.left, WindowRect.top,
+                               WindowRect.right - WindowRect.left,
+                               WindowRect.bottom - WindowRect.top,
+                               nullptr, nullptr, nullptr, nullptr);
+
+    assert(Window);
+
+    ShowWindow(Window, SW_SHOW);
+
+    return Window;
+}
+
+SBuffer PlatformLoadFile(const char* Path)
+{
+    return win32LoadFile(Path);
+}
+
+SMappedFile PlatformMapFile(const char* Path)
+{
+    SMappedFile Result = {};
+
+    HANDLE File = CreateFile(Path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(File == INVALID_HANDLE_VALUE)
+    {
+        return Result;
+    }
+
+    LARGE_INTEGER FileSize;
+    GetFileSizeEx(File, &FileSize);
+
+    // The mapping keeps the file open, the file handle isn't needed anymore
+    HANDLE Mapping = (FileSize.QuadPart > 0) ? CreateFileMapping(File, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(File);
+    if(!Mapping)
+    {
+        return Result;
+    }
+
+    Result.Data = (const uint8_t*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+    if(Result.Data)
+    {
+        Result.Size = (size_t)FileSize.QuadPart;
+        Result.Handle = Mapping;
+    }
+    else
+    {
+        CloseHandle(Mapping);
+    }
+    return Result;
+}
+
+void PlatformUnmapFile(SMappedFile* File)
+{
+    if(File->Data)
+    {
+        UnmapViewOfFile(File->Data);
+        CloseHandle((HANDLE)File->Handle);
+    }
+    *File = {};
+}
+
+uint64_t PlatformGetTimeNs()
+{
+    static LARGE_INTEGER Frequency = {};
+    if(Frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&Frequency);
+    }
+
+    LARGE_INTEGER Counter;
+    QueryPerformanceCounter(&Counter);
+
+    // Split to avoid overflowing the multiplication
+    uint64_t Seconds = Counter.QuadPart / Frequency.QuadPart;
+    uint64_t Remainder = Counter.QuadPart % Frequency.QuadPart;
+    return Seconds * 1000000000ull + (Remainder * 1000000000ull) / Frequency.QuadPart;
+}
+
+SPlatformWindow* PlatformOpenWindow(const char* Title, uint32_t Width, uint32_t Height)
+{
+    win32Window.Width = Width;
+    win32Window.Height = Height;
+    win32Window.bIsVisible = true;
+    win32Window.bNeedsRedraw = true;
+    win32Window.bCloseRequested = false;
+    win32Window.Data = &win32WindowData;
+
+    win32WindowData.Instance = GetModuleHandle(nullptr);
+    win32WindowData.Window = win32OpenWindow(Title, Width, Height);
+
+    return &win32Window;
+}
+
+void PlatformCloseWindow(SPlatformWindow* Window)
+{
+    DestroyWindow(Window->Data->Window);
+    UnregisterClass("vkclass", nullptr);
+
+    *Window->Data = {};
+    *Window = {};
+}
+
+const char* PlatformGetSurfaceExtensionName()
+{
+    return VK_KHR_WIN32_SURFACE_EXTENSION_NAME;
+}
+
+VkResult PlatformCreateSurface(VkInstance Instance, SPlatformWindow* Window, VkSurfaceKHR* Surface)
+{
+    VkWin32SurfaceCreateInfoKHR SurfaceCreateInfo = { VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR };
+    SurfaceCreateInfo.pNext = nullptr;
+    SurfaceCreateInfo.flags = 0;
+    SurfaceCreateInfo.hinstance = Window->Data->Instance;
+    SurfaceCreateInfo.hwnd = Window->Data->Window;
+
+    return vkCreateWin32SurfaceKHR(Instance, &SurfaceCreateInfo, nullptr, Surface);
+}
+
+void PlatformWaitForEvents(SPlatformWindow* Window, uint64_t TimeoutNs)
+{
+    if(TimeoutNs != 0)
+    {
+        DWORD TimeoutMs = INFINITE;
+        if(TimeoutNs != UINT64_MAX)
+        {
+            // Round up so that we never wake before the deadline and spin
+            TimeoutMs = (DWORD)std::min<uint64_t>((TimeoutNs + 999999) / 1000000, INFINITE - 1);
+        }
+        MsgWaitForMultipleObjectsEx(0, nullptr, TimeoutMs, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+    }
+
+    MSG Message = {};
+    while(PeekMessage(&Message, nullptr, 0, 0, PM_REMOVE))
+    {
+        if(Message.message == WM_QUIT)
+        {
+            Window->bCloseRequested = true;
+            break;
+        }
+
+        TranslateMessage(&Message);
+        DispatchMessage(&Message);
+    }
+}